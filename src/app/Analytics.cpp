@@ -0,0 +1,335 @@
+#include "Analytics.h"
+
+#include "Archive.h"
+#include "Database.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace vsrm {
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+struct StringHash {
+	using is_transparent = void;
+	size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); }
+};
+// Heterogeneous lookup: rows are probed with string_views into SQLite's buffers, and a
+// std::string is only allocated the first time a key is seen
+using CountMap = std::unordered_map<std::string, int64_t, StringHash, std::equal_to<>>;
+
+struct CustomerTotals {
+	int64_t visits{};
+	int64_t vehicles{};
+};
+using CustomerMap = std::unordered_map<std::string, CustomerTotals, StringHash, std::equal_to<>>;
+
+constexpr char kSep = '\x1f'; // joins vin and customer in one key
+
+void bump(CountMap& m, std::string_view key, int64_t by = 1) {
+	auto it = m.find(key);
+	if (it == m.end()) m.emplace(std::string(key), by);
+	else it->second += by;
+}
+
+std::string_view columnView(sqlite3_stmt* stmt, int col) {
+	const unsigned char* t = sqlite3_column_text(stmt, col);
+	return t ? std::string_view(reinterpret_cast<const char*>(t), static_cast<size_t>(sqlite3_column_bytes(stmt, col))) : std::string_view();
+}
+
+// Per-thread state. (vin, customer) pairs are pre-split by VIN hash into one map per
+// merge shard, so the merge can also run in parallel without two threads sharing a key.
+struct Local {
+	CountMap months;
+	CountMap mechanics;
+	std::vector<CountMap> pairs;
+	int64_t records{0};
+	std::string error;
+};
+
+struct Shard {
+	int64_t vehicles{0};
+	int64_t repeatVehicles{0};
+	CustomerMap customers;
+};
+
+// Rows [lo, hi] by rowid of files[file]
+struct Range {
+	size_t file;
+	int64_t lo;
+	int64_t hi;
+};
+
+struct Reader {
+	sqlite3* db{nullptr};
+	sqlite3_stmt* stmt{nullptr};
+
+	~Reader() {
+		sqlite3_finalize(stmt);
+		sqlite3_close(db);
+	}
+
+	bool open(const std::string& path, const std::string& sql, const AnalyticsOptions& options, std::string& error) {
+		if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+			error = db ? sqlite3_errmsg(db) : "Cannot open database";
+			return false;
+		}
+		if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+		// Bound once; the options outlive every reader
+		if (options.fromDate) sqlite3_bind_text(stmt, 3, options.fromDate->c_str(), -1, SQLITE_STATIC);
+		if (options.toDate) sqlite3_bind_text(stmt, 4, options.toDate->c_str(), -1, SQLITE_STATIC);
+		return true;
+	}
+};
+
+bool rowidBounds(const std::string& path, sqlite3_int64& lo, sqlite3_int64& hi, std::string& error) {
+	sqlite3* db = nullptr;
+	if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+		error = db ? sqlite3_errmsg(db) : "Cannot open database";
+		sqlite3_close(db);
+		return false;
+	}
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT MIN(rowid), MAX(rowid) FROM service_records;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		sqlite3_close(db);
+		return false;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+		lo = sqlite3_column_int64(stmt, 0);
+		hi = sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
+	return true;
+}
+
+std::vector<AnalyticsBucket> sortedBuckets(const CountMap& m, bool byKey) {
+	std::vector<AnalyticsBucket> out;
+	out.reserve(m.size());
+	for (const auto& [k, v] : m) out.push_back(AnalyticsBucket{k, v, 0});
+	if (byKey) std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.key < b.key; });
+	else std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.visits != b.visits ? a.visits > b.visits : a.key < b.key; });
+	return out;
+}
+
+} // namespace
+
+bool runAnalytics(const std::string& dbPath, const AnalyticsOptions& options, AnalyticsReport& report, std::string& error) {
+	auto started = std::chrono::steady_clock::now();
+	report = AnalyticsReport{};
+	const int threads = options.threads > 0 ? options.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+	// Main first, then every archive partition whose dates can overlap [fromDate, toDate]
+	std::vector<std::string> files{dbPath};
+	std::vector<Range> ranges;
+	int64_t partitions = 0;
+	{
+		sqlite3* db = nullptr;
+		if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+			error = db ? sqlite3_errmsg(db) : "Cannot open database";
+			sqlite3_close(db);
+			return false;
+		}
+		std::vector<ArchivePartition> archived;
+		bool listed = listArchivePartitions(db, archived, error);
+		for (const auto& a : archived) {
+			if (a.records == 0) continue;
+			if (options.fromDate && a.lastDate < *options.fromDate) continue;
+			if (options.toDate && a.firstDate > *options.toDate) continue;
+			files.push_back(archivePartitionPath(db, a));
+		}
+		sqlite3_close(db);
+		if (!listed) return false;
+	}
+
+	// More ranges than threads, handed out on demand, so a slow range does not stall the pool
+	for (size_t f = 0; f < files.size(); ++f) {
+		sqlite3_int64 lo = 0, hi = -1;
+		if (!rowidBounds(files[f], lo, hi, error)) return false;
+		if (hi < lo) continue;
+		const int64_t count = std::min<int64_t>(hi - lo + 1, int64_t(threads) * 8);
+		const int64_t span = (hi - lo + count) / count;
+		for (int64_t p = 0; p < count; ++p) {
+			ranges.push_back(Range{f, lo + p * span, std::min<int64_t>(hi, lo + (p + 1) * span - 1)});
+		}
+		partitions += count;
+	}
+	std::atomic<size_t> nextRange{0};
+
+	std::string sql = "SELECT service_date, mechanic, customer_name, vin FROM service_records WHERE rowid BETWEEN ?1 AND ?2";
+	if (options.fromDate) sql += " AND service_date >= ?3";
+	if (options.toDate) sql += " AND service_date <= ?4";
+
+	std::vector<Local> locals(threads);
+	std::vector<std::thread> pool;
+	pool.reserve(threads);
+	for (int t = 0; t < threads; ++t) {
+		pool.emplace_back([&, t] {
+			Local& local = locals[t];
+			local.pairs.resize(threads);
+			// A connection per file, opened the first time this thread gets one of its ranges
+			std::vector<Reader> readers(files.size());
+			std::string pairKey;
+			StringHash hash;
+			for (size_t r; (r = nextRange.fetch_add(1)) < ranges.size();) {
+				const Range& range = ranges[r];
+				Reader& reader = readers[range.file];
+				if (!reader.stmt && !reader.open(files[range.file], sql, options, local.error)) break;
+				sqlite3_stmt* stmt = reader.stmt;
+				sqlite3_bind_int64(stmt, 1, range.lo);
+				sqlite3_bind_int64(stmt, 2, range.hi);
+				int rc;
+				while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+					++local.records;
+					bump(local.months, columnView(stmt, 0).substr(0, 7));
+					bump(local.mechanics, columnView(stmt, 1));
+					std::string_view vin = columnView(stmt, 3);
+					pairKey.assign(vin);
+					pairKey.push_back(kSep);
+					pairKey.append(columnView(stmt, 2));
+					bump(local.pairs[hash(vin) % threads], pairKey);
+				}
+				sqlite3_reset(stmt);
+				if (rc != SQLITE_DONE) { local.error = sqlite3_errmsg(reader.db); break; }
+			}
+		});
+	}
+	for (auto& th : pool) th.join();
+	pool.clear();
+	for (const auto& l : locals) {
+		if (!l.error.empty()) { error = l.error; return false; }
+	}
+
+	// Parallel merge: shard s owns every VIN hashing to s, so per-vehicle counts are complete
+	// within one shard and shards only need to be summed per customer afterwards
+	std::vector<Shard> shards(threads);
+	for (int s = 0; s < threads; ++s) {
+		pool.emplace_back([&, s] {
+			CountMap pairs = std::move(locals[0].pairs[s]);
+			for (int t = 1; t < threads; ++t) {
+				for (auto& [k, v] : locals[t].pairs[s]) bump(pairs, k, v);
+				CountMap().swap(locals[t].pairs[s]);
+			}
+			CountMap vins;
+			Shard& shard = shards[s];
+			for (const auto& [k, v] : pairs) {
+				size_t cut = k.find(kSep);
+				std::string_view vin(k.data(), cut);
+				std::string_view customer(k.data() + cut + 1, k.size() - cut - 1);
+				bump(vins, vin, v);
+				auto it = shard.customers.find(customer);
+				if (it == shard.customers.end()) it = shard.customers.emplace(std::string(customer), CustomerTotals{}).first;
+				it->second.visits += v;
+				it->second.vehicles += 1;
+			}
+			shard.vehicles = static_cast<int64_t>(vins.size());
+			for (const auto& [k, v] : vins) shard.repeatVehicles += v >= 2;
+		});
+	}
+	for (auto& th : pool) th.join();
+
+	CountMap months, mechanics;
+	CustomerMap customers;
+	for (auto& l : locals) {
+		report.records += l.records;
+		for (const auto& [k, v] : l.months) bump(months, k, v);
+		for (const auto& [k, v] : l.mechanics) bump(mechanics, k, v);
+	}
+	for (auto& s : shards) {
+		report.vehicles += s.vehicles;
+		report.repeatVehicles += s.repeatVehicles;
+		for (auto& [k, v] : s.customers) {
+			auto it = customers.find(k);
+			if (it == customers.end()) customers.emplace(k, v);
+			else { it->second.visits += v.visits; it->second.vehicles += v.vehicles; }
+		}
+	}
+
+	report.byMonth = sortedBuckets(months, true);
+	report.byMechanic = sortedBuckets(mechanics, false);
+	report.byCustomer.reserve(customers.size());
+	for (const auto& [k, v] : customers) {
+		report.byCustomer.push_back(AnalyticsBucket{k, v.visits, v.vehicles});
+		report.repeatCustomers += v.visits >= 2;
+	}
+	std::sort(report.byCustomer.begin(), report.byCustomer.end(),
+		[](const auto& a, const auto& b) { return a.visits != b.visits ? a.visits > b.visits : a.key < b.key; });
+	report.customers = static_cast<int64_t>(customers.size());
+	report.threads = threads;
+	report.partitions = static_cast<int>(partitions);
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	report.milliseconds = took.count();
+	return true;
+}
+
+bool writeSyntheticServiceDatabase(const std::string& dbPath, int64_t rows, uint32_t seed, std::string& error) {
+	std::error_code ec;
+	std::filesystem::remove(std::filesystem::path(std::u8string(dbPath.begin(), dbPath.end())), ec);
+	{
+		Database db;
+		if (!db.openOrCreate(dbPath) || !db.migrateSchema()) { error = db.getLastError(); return false; }
+	}
+	sqlite3* db = nullptr;
+	if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) { error = sqlite3_errmsg(db); sqlite3_close(db); return false; }
+	// Throwaway data: skip durability for the bulk load
+	sqlite3_exec(db, "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF; BEGIN;", nullptr, nullptr, nullptr);
+	sqlite3_stmt* stmt = nullptr;
+	const char* sql = "INSERT INTO service_records (vin, customer_name, service_date, description, mechanic) VALUES (?1, ?2, ?3, ?4, ?5);";
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); sqlite3_close(db); return false; }
+	static const char* const kJobs[] = {"Oil change", "Brake pads", "Tyre rotation", "Battery", "Timing belt", "Inspection"};
+	std::mt19937 rng(seed);
+	const int64_t vehicles = std::max<int64_t>(1, rows / 4);
+	const int64_t customers = std::max<int64_t>(1, vehicles * 3 / 4);
+	char vin[32], customer[32], mechanic[32], date[16];
+	for (int64_t i = 0; i < rows; ++i) {
+		int64_t v = static_cast<int64_t>(rng() % static_cast<uint64_t>(vehicles));
+		std::snprintf(vin, sizeof(vin), "JTD%014lld", static_cast<long long>(v));
+		std::snprintf(customer, sizeof(customer), "Customer %lld", static_cast<long long>(v % customers));
+		std::snprintf(mechanic, sizeof(mechanic), "Mechanic %02u", static_cast<unsigned>(rng() % 40));
+		std::snprintf(date, sizeof(date), "%04u-%02u-%02u", 2018 + static_cast<unsigned>(rng() % 8), 1 + static_cast<unsigned>(rng() % 12), 1 + static_cast<unsigned>(rng() % 28));
+		sqlite3_bind_text(stmt, 1, vin, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 2, customer, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 3, date, -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 4, kJobs[rng() % 6], -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 5, mechanic, -1, SQLITE_STATIC);
+		if (sqlite3_step(stmt) != SQLITE_DONE) { error = sqlite3_errmsg(db); sqlite3_finalize(stmt); sqlite3_close(db); return false; }
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+	bool ok = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+	if (!ok) error = sqlite3_errmsg(db);
+	sqlite3_close(db);
+	return ok;
+}
+
+#else
+
+bool runAnalytics(const std::string&, const AnalyticsOptions&, AnalyticsReport& report, std::string& error) {
+	report = AnalyticsReport{};
+	error = "SQLite not available.";
+	return false;
+}
+
+bool writeSyntheticServiceDatabase(const std::string&, int64_t, uint32_t, std::string& error) {
+	error = "SQLite not available.";
+	return false;
+}
+
+#endif
+
+} // namespace vsrm
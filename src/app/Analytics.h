@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vsrm {
+
+struct AnalyticsOptions {
+	int threads{0};                        // <= 0: one per core
+	std::optional<std::string> fromDate;   // service_date >= fromDate
+	std::optional<std::string> toDate;     // service_date <= toDate
+};
+
+struct AnalyticsBucket {
+	std::string key;     // YYYY-MM, mechanic or customer name
+	int64_t visits{};
+	int64_t vehicles{};  // distinct VINs (customers only; 0 elsewhere)
+};
+
+struct AnalyticsReport {
+	std::vector<AnalyticsBucket> byMonth;     // ascending month
+	std::vector<AnalyticsBucket> byMechanic;  // most visits first
+	std::vector<AnalyticsBucket> byCustomer;  // most visits first
+	int64_t records{};
+	int64_t vehicles{};
+	int64_t repeatVehicles{};   // vehicles with two or more visits
+	int64_t customers{};
+	int64_t repeatCustomers{};  // customers with two or more visits
+	double vehicleRepeatRate() const { return vehicles ? double(repeatVehicles) / double(vehicles) : 0.0; }
+	double customerRepeatRate() const { return customers ? double(repeatCustomers) / double(customers) : 0.0; }
+
+	int threads{};
+	int partitions{};
+	double milliseconds{};
+};
+
+// Splits service_records, in main and in every archive partition the date range can touch,
+// into rowid ranges handed out to a pool of threads, each with its own read-only connections. Threads aggregate into their own hash maps; the maps are merged
+// once at the end, so workers never share state while scanning.
+bool runAnalytics(const std::string& dbPath, const AnalyticsOptions& options, AnalyticsReport& report, std::string& error);
+
+// Creates (or replaces) a database at dbPath holding `rows` synthetic service records spread
+// over ~rows/4 vehicles, for measuring the engine's scaling.
+bool writeSyntheticServiceDatabase(const std::string& dbPath, int64_t rows, uint32_t seed, std::string& error);
+
+} // namespace vsrm
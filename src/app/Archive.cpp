@@ -0,0 +1,613 @@
+#include "Archive.h"
+
+#include "Dates.h"
+#include "FastHash.h"
+#include "ServiceImport.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+
+namespace fs = std::filesystem;
+
+namespace vsrm {
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+constexpr uint64_t kVinFilterSeed = 0xA4C41FE5;
+// Copied as stored (packed descriptions stay packed); scans return the text
+constexpr const char* kColumns = "id, vin, customer_name, service_date, description, mechanic";
+constexpr const char* kScanColumns = "id, vin, customer_name, service_date, vsrm_text(description) AS description, mechanic";
+
+// Same columns as main's service_records; ids are kept, so no AUTOINCREMENT
+constexpr const char* kPartitionSchema = R"sql(
+CREATE TABLE IF NOT EXISTS %s.service_records (
+	id INTEGER PRIMARY KEY,
+	vin TEXT NOT NULL,
+	customer_name TEXT NOT NULL,
+	service_date TEXT NOT NULL,
+	description TEXT NOT NULL,
+	mechanic TEXT NOT NULL,
+	fingerprint INTEGER
+);
+CREATE INDEX IF NOT EXISTS %s.idx_service_records_vin_date ON service_records (vin, service_date DESC);
+CREATE INDEX IF NOT EXISTS %s.idx_service_records_date ON service_records (service_date);
+CREATE INDEX IF NOT EXISTS %s.idx_service_records_fingerprint ON service_records (fingerprint);
+)sql";
+
+std::string partitionSchema(const std::string& schema) {
+	char ddl[1024];
+	std::snprintf(ddl, sizeof ddl, kPartitionSchema, schema.c_str(), schema.c_str(), schema.c_str(), schema.c_str());
+	return ddl;
+}
+
+fs::path pathFromUtf8(const std::string& s) { return fs::path(std::u8string(s.begin(), s.end())); }
+
+std::string pathToUtf8(const fs::path& p) {
+	std::u8string s = p.u8string();
+	return std::string(s.begin(), s.end());
+}
+
+bool exec(sqlite3* db, const std::string& sql, std::string& error) {
+	char* errMsg = nullptr;
+	if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) == SQLITE_OK) return true;
+	error = errMsg ? errMsg : sqlite3_errmsg(db);
+	sqlite3_free(errMsg);
+	return false;
+}
+
+// Runs a statement with ?1 = lo and ?2 = hi; rows changed go to changes if given
+bool execRange(sqlite3* db, const std::string& sql, const std::string& lo, const std::string& hi, std::string& error,
+	int64_t* changes = nullptr) {
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	sqlite3_bind_text(stmt, 1, lo.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt, 2, hi.c_str(), -1, SQLITE_TRANSIENT);
+	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+	if (!ok) error = sqlite3_errmsg(db);
+	else if (changes) *changes += sqlite3_changes(db);
+	sqlite3_finalize(stmt);
+	return ok;
+}
+
+std::string schemaName(int year) { return "archive_" + std::to_string(year); }
+std::string yearStart(int year) { return std::to_string(year) + "-01-01"; }
+
+fs::path databaseDirectory(sqlite3* db) {
+	const char* file = sqlite3_db_filename(db, "main");
+	if (!file || !*file) return {};
+	return pathFromUtf8(file).parent_path();
+}
+
+// ATTACH outside any transaction; DETACH only once no statement is running
+bool attach(sqlite3* db, const fs::path& path, int year, bool create, std::string& error) {
+	std::error_code ec;
+	if (!create && !fs::exists(path, ec)) {
+		error = "Archive partition " + std::to_string(year) + " is missing: " + pathToUtf8(path);
+		return false;
+	}
+	sqlite3_stmt* stmt = nullptr;
+	std::string sql = "ATTACH DATABASE ?1 AS " + schemaName(year) + ";";
+	if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	std::string file = pathToUtf8(path);
+	sqlite3_bind_text(stmt, 1, file.c_str(), -1, SQLITE_TRANSIENT);
+	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+	if (!ok) error = "Cannot attach archive " + file + ": " + sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	return ok;
+}
+
+void detach(sqlite3* db, int year) {
+	std::string ignored;
+	exec(db, "DETACH DATABASE " + schemaName(year) + ";", ignored);
+}
+
+struct Partition {
+	ArchivePartition info;
+	std::optional<BloomFilter> vins;
+};
+
+bool loadPartitions(sqlite3* db, bool withFilters, std::vector<Partition>& out, std::string& error) {
+	out.clear();
+	// Databases below the archive schema version simply have no partitions
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'archive_partitions';", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	bool present = sqlite3_step(stmt) == SQLITE_ROW;
+	sqlite3_finalize(stmt);
+	if (!present) return true;
+
+	const char* sql = withFilters
+		? "SELECT year, file, records, first_date, last_date, archived_at, vin_filter FROM archive_partitions ORDER BY year;"
+		: "SELECT year, file, records, first_date, last_date, archived_at FROM archive_partitions ORDER BY year;";
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		Partition p;
+		p.info.year = sqlite3_column_int(stmt, 0);
+		p.info.file = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+		p.info.records = sqlite3_column_int64(stmt, 2);
+		p.info.firstDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+		p.info.lastDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+		p.info.archivedAt = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+		if (withFilters) {
+			std::string_view blob(static_cast<const char*>(sqlite3_column_blob(stmt, 6)), sqlite3_column_bytes(stmt, 6));
+			BloomFilter filter(1);
+			// A filter that does not parse just means the partition is always searched
+			if (filter.deserialize(blob)) p.vins = std::move(filter);
+		}
+		out.push_back(std::move(p));
+	}
+	if (rc != SQLITE_DONE) error = sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	return rc == SQLITE_DONE;
+}
+
+// Folds an attached partition into archive_rollup, keeping the later visit of each key. Rerunning
+// it on the same rows changes nothing.
+// Keeps the later of two visits for one (vin, customer, mechanic)
+constexpr const char* kRollupUpsert =
+	" ON CONFLICT (vin, customer_name, mechanic) DO UPDATE SET last_date = excluded.last_date, last_id = excluded.last_id "
+	"WHERE excluded.last_date > archive_rollup.last_date "
+	"OR (excluded.last_date = archive_rollup.last_date AND excluded.last_id > archive_rollup.last_id);";
+
+// vinFilter, if given, is a condition on the partition's rows with ?1 and ?2 bound by the caller
+std::string rollUpSql(int year, const char* vinFilter = nullptr) {
+	return std::string("INSERT INTO main.archive_rollup (vin, customer_name, mechanic, last_date, last_id) "
+		"SELECT vin, customer_name, mechanic, MAX(service_date), id FROM ") + schemaName(year) + ".service_records WHERE " +
+		(vinFilter ? vinFilter : "true") + " GROUP BY vin, customer_name, mechanic" + kRollupUpsert;
+}
+
+bool rollUpPartition(sqlite3* db, int year, std::string& error) { return exec(db, rollUpSql(year), error); }
+
+// Recounts an attached partition and writes its registry row (inside the caller's transaction)
+bool registerPartition(sqlite3* db, int year, const std::string& file, std::string& error) {
+	const std::string schema = schemaName(year);
+	std::vector<uint64_t> hashes;
+	sqlite3_stmt* stmt = nullptr;
+	std::string sql = "SELECT DISTINCT vin FROM " + schema + ".service_records;";
+	if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		const char* vin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+		hashes.push_back(fastHash64(vin ? vin : "", kVinFilterSeed));
+	}
+	sqlite3_finalize(stmt);
+	BloomFilter filter(hashes.size());
+	for (uint64_t h : hashes) filter.add(h);
+	std::string blob = filter.serialize();
+
+	sql = "INSERT OR REPLACE INTO main.archive_partitions (year, file, records, first_date, last_date, vin_filter, archived_at) "
+		"SELECT ?1, ?2, COUNT(*), COALESCE(MIN(service_date), ''), COALESCE(MAX(service_date), ''), ?3, "
+		"strftime('%Y-%m-%dT%H:%M:%SZ', 'now') FROM " + schema + ".service_records;";
+	if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	sqlite3_bind_int(stmt, 1, year);
+	sqlite3_bind_text(stmt, 2, file.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_blob(stmt, 3, blob.data(), static_cast<int>(blob.size()), SQLITE_STATIC);
+	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+	if (!ok) error = sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	return ok;
+}
+
+bool archiveYear(sqlite3* db, int year, const std::string& cutoff, const fs::path& dir, const std::string& stem,
+	int64_t& moved, std::string& error) {
+	const std::string schema = schemaName(year);
+	const std::string file = stem + "-archive-" + std::to_string(year) + ".db";
+	const std::string lo = yearStart(year);
+	const std::string hi = std::min(cutoff, yearStart(year + 1));
+	if (!attach(db, dir / pathFromUtf8(file), year, true, error)) return false;
+
+	// 1. Copy into the partition and commit there
+	bool ok = exec(db, "BEGIN;", error);
+	if (ok) {
+		ok = exec(db, partitionSchema(schema), error) &&
+			execRange(db, "INSERT OR REPLACE INTO " + schema + ".service_records (" + kColumns + ", fingerprint) "
+				"SELECT " + kColumns + ", fingerprint FROM main.service_records WHERE service_date >= ?1 AND service_date < ?2;",
+				lo, hi, error) &&
+			exec(db, "COMMIT;", error);
+		if (!ok) { std::string ignored; exec(db, "ROLLBACK;", ignored); }
+	}
+
+	// 2. Drop from main only the rows the partition now holds unchanged, and update the registry
+	if (ok) {
+		ok = exec(db, "BEGIN IMMEDIATE;", error);
+		if (ok) {
+			ok = execRange(db, "DELETE FROM main.service_records WHERE service_date >= ?1 AND service_date < ?2 AND EXISTS ("
+					"SELECT 1 FROM " + schema + ".service_records a WHERE a.id = service_records.id AND a.vin = service_records.vin "
+					"AND a.customer_name = service_records.customer_name AND a.service_date = service_records.service_date "
+					"AND a.description = service_records.description AND a.mechanic = service_records.mechanic);",
+					lo, hi, error, &moved) &&
+				registerPartition(db, year, file, error) &&
+				rollUpPartition(db, year, error) &&
+				exec(db, "COMMIT;", error);
+			if (!ok) { std::string ignored; exec(db, "ROLLBACK;", ignored); }
+		}
+	}
+	detach(db, year);
+	if (!ok) error = "Archiving " + std::to_string(year) + " failed: " + error;
+	return ok;
+}
+
+// Runs one ordered segment and feeds its rows to row; stopped is set when row asks to stop
+bool scanSegment(sqlite3* db, const std::string& sql, const std::string& vin, const std::string& lo, const std::string& hi,
+	const std::function<bool(sqlite3_stmt*)>& row, bool& stopped, std::string& error) {
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	// Parameters the segment does not use are out of range; SQLite ignores those binds
+	if (!vin.empty()) sqlite3_bind_text(stmt, 1, vin.c_str(), -1, SQLITE_TRANSIENT);
+	if (!lo.empty()) sqlite3_bind_text(stmt, 2, lo.c_str(), -1, SQLITE_TRANSIENT);
+	if (!hi.empty()) sqlite3_bind_text(stmt, 3, hi.c_str(), -1, SQLITE_TRANSIENT);
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		if (!row(stmt)) { stopped = true; rc = SQLITE_DONE; break; }
+	}
+	if (rc != SQLITE_DONE) error = sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	return rc == SQLITE_DONE;
+}
+
+// SELECT over one table restricted to the VIN and [lo, hi); empty bounds are open
+std::string segmentSelect(const std::string& table, bool byVin, bool bounded, bool hasLo, bool hasHi) {
+	std::string sql = std::string("SELECT ") + kScanColumns + " FROM " + table;
+	std::vector<const char*> where;
+	if (byVin) where.push_back("vin = ?1");
+	if (bounded && hasLo) where.push_back("service_date >= ?2");
+	if (bounded && hasHi) where.push_back("service_date < ?3");
+	for (size_t i = 0; i < where.size(); ++i) sql += (i ? " AND " : " WHERE ") + std::string(where[i]);
+	return sql;
+}
+
+} // namespace
+
+bool listArchivePartitions(sqlite3* db, std::vector<ArchivePartition>& out, std::string& error) {
+	out.clear();
+	std::vector<Partition> partitions;
+	if (!loadPartitions(db, false, partitions, error)) return false;
+	for (auto& p : partitions) out.push_back(std::move(p.info));
+	return true;
+}
+
+std::string archivePartitionPath(sqlite3* db, const ArchivePartition& partition) {
+	return pathToUtf8(databaseDirectory(db) / pathFromUtf8(partition.file));
+}
+
+bool archiveServiceRecords(sqlite3* db, const std::string& cutoff, ArchiveStats& stats, std::string& error) {
+	stats = {};
+	auto started = std::chrono::steady_clock::now();
+	if (cutoff.size() != 10 || !isoToMinutes(cutoff)) { error = "Cutoff must be a date (YYYY-MM-DD)"; return false; }
+	if (!sqlite3_get_autocommit(db)) { error = "Archiving cannot run inside a transaction"; return false; }
+	const char* mainFile = sqlite3_db_filename(db, "main");
+	if (!mainFile || !*mainFile) { error = "Archiving needs a database file"; return false; }
+	const fs::path dir = databaseDirectory(db);
+	const std::string stem = pathToUtf8(pathFromUtf8(mainFile).stem());
+
+	// Only rows with a well-formed year can be placed in a partition
+	std::vector<int> years;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT DISTINCT CAST(substr(service_date, 1, 4) AS INTEGER) FROM main.service_records "
+			"WHERE service_date < ?1 AND service_date GLOB '[0-9][0-9][0-9][0-9]-*' ORDER BY 1;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_bind_text(stmt, 1, cutoff.c_str(), -1, SQLITE_TRANSIENT);
+	while (sqlite3_step(stmt) == SQLITE_ROW) years.push_back(sqlite3_column_int(stmt, 0));
+	sqlite3_finalize(stmt);
+	// Imports look archived records up by fingerprint, so none may move without one
+	if (!years.empty() && !fillMissingFingerprints(db, error)) return false;
+
+	for (int year : years) {
+		if (!archiveYear(db, year, cutoff, dir, stem, stats.moved, error)) return false;
+	}
+
+	std::vector<Partition> partitions;
+	if (!loadPartitions(db, false, partitions, error)) return false;
+	for (auto& p : partitions) {
+		if (std::binary_search(years.begin(), years.end(), p.info.year)) stats.partitions.push_back(std::move(p.info));
+	}
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	stats.milliseconds = took.count();
+	return true;
+}
+
+bool scanServiceRecords(sqlite3* db, const std::string& vin, const std::function<bool(sqlite3_stmt*)>& row,
+	std::string& error) {
+	std::vector<Partition> partitions;
+	if (!loadPartitions(db, !vin.empty(), partitions, error)) return false;
+	const uint64_t vinHash = fastHash64(vin, kVinFilterSeed);
+	std::erase_if(partitions, [&](const Partition& p) { return !vin.empty() && p.vins && !p.vins->mayContain(vinHash); });
+
+	const fs::path dir = databaseDirectory(db);
+	const bool byVin = !vin.empty();
+	const std::string order = " ORDER BY service_date, id;";
+	bool stopped = false;
+	std::string lo; // main rows from here on are not covered yet; empty: from the beginning
+	for (const Partition& p : partitions) {
+		const std::string start = yearStart(p.info.year), end = yearStart(p.info.year + 1);
+		// main's rows before this year
+		if (!scanSegment(db, segmentSelect("main.service_records", byVin, true, !lo.empty(), true) + order,
+				vin, lo, start, row, stopped, error)) return false;
+		if (stopped) return true;
+
+		if (!attach(db, dir / pathFromUtf8(p.info.file), p.info.year, false, error)) return false;
+		std::string sql = segmentSelect(schemaName(p.info.year) + ".service_records", byVin, true, true, true) +
+			" UNION ALL " + segmentSelect("main.service_records", byVin, true, true, true) + order;
+		bool ok = scanSegment(db, sql, vin, start, end, row, stopped, error);
+		detach(db, p.info.year);
+		if (!ok) return false;
+		if (stopped) return true;
+		lo = end;
+	}
+	return scanSegment(db, segmentSelect("main.service_records", byVin, true, !lo.empty(), false) + order,
+		vin, lo, "", row, stopped, error);
+}
+
+bool scanArchivedRecords(sqlite3* db, const std::string& vin, const std::function<bool(sqlite3_stmt*)>& row,
+	std::string& error) {
+	std::vector<Partition> partitions;
+	if (!loadPartitions(db, !vin.empty(), partitions, error)) return false;
+	const uint64_t vinHash = fastHash64(vin, kVinFilterSeed);
+	const fs::path dir = databaseDirectory(db);
+	bool stopped = false;
+	for (const Partition& p : partitions) {
+		if (p.info.records == 0 || (!vin.empty() && p.vins && !p.vins->mayContain(vinHash))) continue;
+		if (!attach(db, dir / pathFromUtf8(p.info.file), p.info.year, false, error)) return false;
+		std::string sql = segmentSelect(schemaName(p.info.year) + ".service_records", !vin.empty(), false, false, false) + " ORDER BY id;";
+		bool ok = scanSegment(db, sql, vin, "", "", row, stopped, error);
+		detach(db, p.info.year);
+		if (!ok) return false;
+		if (stopped) return true;
+	}
+	return true;
+}
+
+bool upgradeArchivePartitions(sqlite3* db, std::string& error) {
+	if (!sqlite3_get_autocommit(db)) { error = "Archive partitions cannot be upgraded inside a transaction"; return false; }
+	std::vector<Partition> partitions;
+	if (!loadPartitions(db, false, partitions, error)) return false;
+	// Also registers vsrm_fingerprint on the connection
+	if (!fillMissingFingerprints(db, error)) return false;
+	if (!exec(db, "DELETE FROM main.archive_rollup;", error)) return false;
+	const fs::path dir = databaseDirectory(db);
+	for (const Partition& p : partitions) {
+		if (!attach(db, dir / pathFromUtf8(p.info.file), p.info.year, false, error)) return false;
+		const std::string schema = schemaName(p.info.year);
+		bool ok = exec(db, partitionSchema(schema), error) &&
+			exec(db, "UPDATE " + schema + ".service_records SET fingerprint = "
+				"vsrm_fingerprint(vin, service_date, vsrm_text(description), mechanic) WHERE fingerprint IS NULL;", error) &&
+			rollUpPartition(db, p.info.year, error);
+		detach(db, p.info.year);
+		if (!ok) return false;
+	}
+	return true;
+}
+
+bool findArchivedRecordIds(sqlite3* db, std::vector<int64_t> ids, std::vector<int64_t>& found, std::string& error) {
+	found.clear();
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	// Probes one id per step; the partition's rows are not in main (except mid-move duplicates)
+	auto probe = [&](const std::string& table, std::vector<int64_t>& hits, std::vector<int64_t>& misses) {
+		sqlite3_stmt* stmt = nullptr;
+		std::string sql = "SELECT 1 FROM " + table + " WHERE id = ?1;";
+		if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+		int rc = SQLITE_DONE;
+		for (int64_t id : ids) {
+			sqlite3_bind_int64(stmt, 1, id);
+			rc = sqlite3_step(stmt);
+			if (rc == SQLITE_ROW) hits.push_back(id);
+			else if (rc == SQLITE_DONE) misses.push_back(id);
+			else break;
+			sqlite3_reset(stmt);
+		}
+		if (rc != SQLITE_ROW && rc != SQLITE_DONE) error = sqlite3_errmsg(db);
+		sqlite3_finalize(stmt);
+		return rc == SQLITE_ROW || rc == SQLITE_DONE;
+	};
+	std::vector<int64_t> inMain, rest;
+	if (!probe("main.service_records", inMain, rest)) return false;
+	ids = std::move(rest);
+	if (ids.empty()) return true;
+
+	std::vector<Partition> partitions;
+	if (!loadPartitions(db, false, partitions, error)) return false;
+	const fs::path dir = databaseDirectory(db);
+	for (const Partition& p : partitions) {
+		if (ids.empty()) break;
+		if (p.info.records == 0) continue;
+		if (!attach(db, dir / pathFromUtf8(p.info.file), p.info.year, false, error)) return false;
+		std::vector<int64_t> missing;
+		bool ok = probe(schemaName(p.info.year) + ".service_records", found, missing);
+		detach(db, p.info.year);
+		if (!ok) return false;
+		ids = std::move(missing);
+	}
+	std::sort(found.begin(), found.end());
+	return true;
+}
+
+bool updateArchivedRecord(sqlite3* db, int64_t id, const ArchivedRecordEdit& edit, bool& found, std::string& error) {
+	found = false;
+	if (!sqlite3_get_autocommit(db)) { error = "Archived records cannot be updated inside a transaction"; return false; }
+	std::vector<Partition> partitions;
+	if (!loadPartitions(db, true, partitions, error)) return false;
+	const fs::path dir = databaseDirectory(db);
+
+	// The partition holding id, and the vin it has now
+	const Partition* home = nullptr;
+	std::string oldVin;
+	for (const Partition& p : partitions) {
+		if (p.info.records == 0) continue;
+		if (!attach(db, dir / pathFromUtf8(p.info.file), p.info.year, false, error)) return false;
+		sqlite3_stmt* stmt = nullptr;
+		std::string sql = "SELECT vin FROM " + schemaName(p.info.year) + ".service_records WHERE id = ?1;";
+		bool ok = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK;
+		if (ok) {
+			sqlite3_bind_int64(stmt, 1, id);
+			int rc = sqlite3_step(stmt);
+			if (rc == SQLITE_ROW) { home = &p; oldVin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)); }
+			ok = rc == SQLITE_ROW || rc == SQLITE_DONE;
+		}
+		if (!ok) error = sqlite3_errmsg(db);
+		sqlite3_finalize(stmt);
+		if (home) break; // stays attached
+		detach(db, p.info.year);
+		if (!ok) return false;
+	}
+	if (!home) return true;
+	found = true;
+	const int year = home->info.year;
+	const std::string schema = schemaName(year);
+
+	// archive_rollup rows of both VINs are rebuilt. The other partitions' share is read first,
+	// one attach at a time, since nothing can be attached once the transaction below has begun.
+	struct Latest {
+		std::string vin, customer, mechanic, date;
+		int64_t id;
+	};
+	std::vector<Latest> others;
+	const char* vinFilter = "vin IN (?1, ?2)";
+	const uint64_t oldHash = fastHash64(oldVin, kVinFilterSeed), newHash = fastHash64(edit.vin, kVinFilterSeed);
+	auto bindVins = [&](sqlite3_stmt* stmt) {
+		sqlite3_bind_text(stmt, 1, oldVin.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 2, edit.vin.c_str(), -1, SQLITE_TRANSIENT);
+	};
+	for (const Partition& p : partitions) {
+		if (&p == home || p.info.records == 0) continue;
+		if (p.vins && !p.vins->mayContain(oldHash) && !p.vins->mayContain(newHash)) continue;
+		if (!attach(db, dir / pathFromUtf8(p.info.file), p.info.year, false, error)) { detach(db, year); return false; }
+		sqlite3_stmt* stmt = nullptr;
+		std::string sql = "SELECT vin, customer_name, mechanic, MAX(service_date), id FROM " + schemaName(p.info.year) +
+			".service_records WHERE " + vinFilter + " GROUP BY vin, customer_name, mechanic;";
+		bool ok = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK;
+		if (ok) {
+			bindVins(stmt);
+			int rc;
+			while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+				auto text = [&](int col) { return std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, col))); };
+				others.push_back(Latest{text(0), text(1), text(2), text(3), sqlite3_column_int64(stmt, 4)});
+			}
+			ok = rc == SQLITE_DONE;
+		}
+		if (!ok) error = sqlite3_errmsg(db);
+		sqlite3_finalize(stmt);
+		detach(db, p.info.year);
+		if (!ok) { detach(db, year); return false; }
+	}
+
+	// A new date outside the partition's year moves the record back to main (like any back-dated
+	// entry), so each partition keeps holding exactly its year
+	const bool stays = edit.serviceDate.compare(0, 5, std::to_string(year) + "-") == 0;
+	auto run = [&](const std::string& sql, const std::function<void(sqlite3_stmt*)>& bind) {
+		sqlite3_stmt* stmt = nullptr;
+		if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+		bind(stmt);
+		bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+		if (!ok) error = sqlite3_errmsg(db);
+		sqlite3_finalize(stmt);
+		return ok;
+	};
+	auto bindEdit = [&](sqlite3_stmt* stmt) {
+		sqlite3_bind_text(stmt, 1, edit.vin.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 2, edit.customerName.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 3, edit.serviceDate.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 4, edit.description.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 5, edit.mechanic.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64(stmt, 6, id);
+		sqlite3_bind_int64(stmt, 7, static_cast<sqlite3_int64>(edit.fingerprint));
+	};
+	bool ok = exec(db, "BEGIN IMMEDIATE;", error);
+	if (ok) {
+		ok = (stays
+				? run("UPDATE " + schema + ".service_records SET vin = ?1, customer_name = ?2, service_date = ?3, "
+					"description = vsrm_pack(?4), mechanic = ?5, fingerprint = ?7 WHERE id = ?6;", bindEdit)
+				: run("DELETE FROM " + schema + ".service_records WHERE id = ?6;", bindEdit) &&
+					run("INSERT INTO main.service_records (id, vin, customer_name, service_date, description, mechanic, fingerprint) "
+						"VALUES (?6, ?1, ?2, ?3, vsrm_pack(?4), ?5, ?7);", bindEdit)) &&
+			registerPartition(db, year, home->info.file, error) &&
+			run("DELETE FROM main.archive_rollup WHERE " + std::string(vinFilter) + ";", bindVins) &&
+			run(rollUpSql(year, vinFilter), bindVins);
+		for (size_t i = 0; ok && i < others.size(); ++i) {
+			const Latest& l = others[i];
+			ok = run(std::string("INSERT INTO main.archive_rollup (vin, customer_name, mechanic, last_date, last_id) "
+				"VALUES (?1, ?2, ?3, ?4, ?5)") + kRollupUpsert, [&](sqlite3_stmt* stmt) {
+					sqlite3_bind_text(stmt, 1, l.vin.c_str(), -1, SQLITE_TRANSIENT);
+					sqlite3_bind_text(stmt, 2, l.customer.c_str(), -1, SQLITE_TRANSIENT);
+					sqlite3_bind_text(stmt, 3, l.mechanic.c_str(), -1, SQLITE_TRANSIENT);
+					sqlite3_bind_text(stmt, 4, l.date.c_str(), -1, SQLITE_TRANSIENT);
+					sqlite3_bind_int64(stmt, 5, l.id);
+				});
+		}
+		ok = ok && exec(db, "COMMIT;", error);
+		if (!ok) { std::string ignored; exec(db, "ROLLBACK;", ignored); }
+	}
+	detach(db, year);
+	return ok;
+}
+
+bool countArchivedRecords(sqlite3* db, const std::string& first, const std::string& last, int64_t& count,
+	std::string& error) {
+	count = 0;
+	std::vector<Partition> partitions;
+	if (!loadPartitions(db, false, partitions, error)) return false;
+	const fs::path dir = databaseDirectory(db);
+	for (const Partition& p : partitions) {
+		if (p.info.records == 0 || p.info.lastDate < first || p.info.firstDate > last) continue;
+		if (p.info.firstDate >= first && p.info.lastDate <= last) { count += p.info.records; continue; }
+		if (!attach(db, dir / pathFromUtf8(p.info.file), p.info.year, false, error)) return false;
+		sqlite3_stmt* stmt = nullptr;
+		std::string sql = "SELECT COUNT(*) FROM " + schemaName(p.info.year) +
+			".service_records WHERE service_date >= ?1 AND service_date <= ?2;";
+		bool ok = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK;
+		if (ok) {
+			sqlite3_bind_text(stmt, 1, first.c_str(), -1, SQLITE_TRANSIENT);
+			sqlite3_bind_text(stmt, 2, last.c_str(), -1, SQLITE_TRANSIENT);
+			ok = sqlite3_step(stmt) == SQLITE_ROW;
+			if (ok) count += sqlite3_column_int64(stmt, 0);
+		}
+		if (!ok) error = sqlite3_errmsg(db);
+		sqlite3_finalize(stmt);
+		detach(db, p.info.year);
+		if (!ok) return false;
+	}
+	return true;
+}
+
+#else
+
+bool listArchivePartitions(sqlite3*, std::vector<ArchivePartition>& out, std::string& error) {
+	out.clear(); error = "SQLite not available."; return false;
+}
+std::string archivePartitionPath(sqlite3*, const ArchivePartition& partition) { return partition.file; }
+bool archiveServiceRecords(sqlite3*, const std::string&, ArchiveStats& stats, std::string& error) {
+	stats = {}; error = "SQLite not available."; return false;
+}
+bool scanServiceRecords(sqlite3*, const std::string&, const std::function<bool(sqlite3_stmt*)>&, std::string& error) {
+	error = "SQLite not available."; return false;
+}
+bool scanArchivedRecords(sqlite3*, const std::string&, const std::function<bool(sqlite3_stmt*)>&, std::string& error) {
+	error = "SQLite not available."; return false;
+}
+bool upgradeArchivePartitions(sqlite3*, std::string& error) { error = "SQLite not available."; return false; }
+bool findArchivedRecordIds(sqlite3*, std::vector<int64_t>, std::vector<int64_t>& found, std::string& error) {
+	found.clear(); error = "SQLite not available."; return false;
+}
+bool updateArchivedRecord(sqlite3*, int64_t, const ArchivedRecordEdit&, bool& found, std::string& error) {
+	found = false; error = "SQLite not available."; return false;
+}
+bool countArchivedRecords(sqlite3*, const std::string&, const std::string&, int64_t& count, std::string& error) {
+	count = 0; error = "SQLite not available."; return false;
+}
+
+#endif
+
+} // namespace vsrm
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace vsrm {
+
+// Year-partitioned archives of service_records.
+//
+// archiveServiceRecords() moves records dated before a cutoff into one database file per
+// service year (<db stem>-archive-YYYY.db beside the main file) and registers each file in
+// archive_partitions with its row count, date span and a Bloom filter of its VINs. The main
+// database keeps only the recent years, so its pages stay in the cache.
+//
+// Reads fan out without holding more than one partition open: scanServiceRecords() walks the
+// date axis in ascending segments. An archived year is one statement over the ATTACHed file
+// UNION ALL main's rows of that year (back-dated entries land in main); the gaps between
+// archived years are plain range scans of main. Concatenating the segments yields the global
+// service_date, id order. With a VIN, years whose filter rules the VIN out are never attached.
+// Full scans that do not need that order (column caches) read main themselves and add
+// scanArchivedRecords(); parallel scans open the partition files on their own connections.
+//
+// The move also folds each year into main's archive_rollup: per (vin, customer, mechanic) the
+// latest archived visit. Summaries, customer counts and customer look-ups join it with main
+// instead of opening any partition.
+
+struct ArchivePartition {
+	int year{};
+	std::string file;       // relative to the main database's directory
+	int64_t records{};
+	std::string firstDate;
+	std::string lastDate;
+	std::string archivedAt; // last archive run that wrote to it
+};
+
+struct ArchiveStats {
+	std::vector<ArchivePartition> partitions; // the ones written, after the run
+	int64_t moved{};
+	double milliseconds{};
+};
+
+// Registered partitions in year order
+bool listArchivePartitions(sqlite3* db, std::vector<ArchivePartition>& out, std::string& error);
+
+// Absolute path of a partition's file
+std::string archivePartitionPath(sqlite3* db, const ArchivePartition& partition);
+
+// Moves records with service_date < cutoff (YYYY-MM-DD) into their year's partition. Each year
+// is copied and committed in the partition first, then deleted from main in a second
+// transaction, so a crash in between leaves duplicates (shown twice until the next run
+// finishes the move), never a loss. Must not run inside a transaction.
+bool archiveServiceRecords(sqlite3* db, const std::string& cutoff, ArchiveStats& stats, std::string& error);
+
+// Calls row for every record (one VIN's, or all when vin is empty) across main and the
+// partitions in service_date, id order. The statement's columns are id, vin, customer_name,
+// service_date, description, mechanic; row returns false to stop early.
+bool scanServiceRecords(sqlite3* db, const std::string& vin, const std::function<bool(sqlite3_stmt*)>& row,
+	std::string& error);
+
+// Of ids, the ones main does not have but an archive partition does (found, ascending). Each
+// partition is attached once and probed by primary key; must not run inside a transaction.
+bool findArchivedRecordIds(sqlite3* db, std::vector<int64_t> ids, std::vector<int64_t>& found, std::string& error);
+
+// Calls row for every archived record (one VIN's, or all), a partition at a time in year order
+// and id order within it; main is not read. Same columns as scanServiceRecords.
+bool scanArchivedRecords(sqlite3* db, const std::string& vin, const std::function<bool(sqlite3_stmt*)>& row,
+	std::string& error);
+
+// Brings partitions written by earlier builds up to date (after migrating across
+// kArchiveRollupSchemaVersion): adds the fingerprint index, fills missing fingerprints and
+// refills archive_rollup. Must not run inside a transaction.
+bool upgradeArchivePartitions(sqlite3* db, std::string& error);
+
+struct ArchivedRecordEdit {
+	std::string vin;
+	std::string customerName;
+	std::string serviceDate;
+	std::string description; // text; packed with the connection's vsrm_pack
+	std::string mechanic;
+	uint64_t fingerprint{};
+};
+
+// Rewrites archived record id in its partition, refreshing the registry row and the VIN's
+// archive_rollup entries (old and new VIN) in the same transaction. A date outside the
+// partition's year moves the record back to main. found is false when no partition has id.
+// Must not run inside a transaction.
+bool updateArchivedRecord(sqlite3* db, int64_t id, const ArchivedRecordEdit& edit, bool& found, std::string& error);
+
+// Archived records with first <= service_date <= last (inclusive). Partitions entirely inside
+// the range are answered from the registry; only partial years are attached and counted.
+bool countArchivedRecords(sqlite3* db, const std::string& first, const std::string& last, int64_t& count,
+	std::string& error);
+
+} // namespace vsrm
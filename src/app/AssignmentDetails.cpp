@@ -0,0 +1,50 @@
+#include "AssignmentDetails.h"
+
+#include <cstring>
+
+namespace vsrm {
+
+void AssignmentDetailBatch::clear() {
+	assignmentIds.clear();
+	appointmentIds.clear();
+	mechanicIds.clear();
+	durations.clear();
+	refs.clear();
+	chars.clear();
+}
+
+void AssignmentDetailBatch::reserve(size_t rows, size_t textBytes) {
+	assignmentIds.reserve(rows);
+	appointmentIds.reserve(rows);
+	mechanicIds.reserve(rows);
+	durations.reserve(rows);
+	refs.reserve(rows * kTextColumns);
+	chars.reserve(textBytes);
+}
+
+void AssignmentDetailBatch::addRow(int assignmentId, int appointmentId, int mechanicId, int durationMin,
+	const char* const (&columns)[kTextColumns]) {
+	assignmentIds.push_back(assignmentId);
+	appointmentIds.push_back(appointmentId);
+	mechanicIds.push_back(mechanicId);
+	durations.push_back(durationMin);
+	for (const char* c : columns) {
+		if (!c) { refs.push_back(TextRef{0, kNull}); continue; }
+		size_t n = std::strlen(c);
+		refs.push_back(TextRef{static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(n)});
+		chars.append(c, n);
+	}
+}
+
+std::string_view AssignmentDetailBatch::text(size_t row, int column) const {
+	const TextRef& r = refs[row * kTextColumns + column];
+	if (r.length == kNull) return {};
+	return std::string_view(chars.data() + r.offset, r.length);
+}
+
+std::optional<std::string_view> AssignmentDetailBatch::completedAt(size_t row) const {
+	if (refs[row * kTextColumns + kCompletedAt].length == kNull) return std::nullopt;
+	return text(row, kCompletedAt);
+}
+
+} // namespace vsrm
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vsrm {
+
+// Filter for Database::listAssignmentDetails. Empty fields do not filter.
+struct AssignmentDetailQuery {
+	std::vector<int> mechanicIds;           // one mechanic, several, or all when empty
+	std::optional<std::string> fromDate;    // appointments.scheduled_at >= fromDate
+	std::optional<std::string> toDate;      // appointments.scheduled_at < toDate
+	bool openOnly{false};                   // only assignments without completed_at
+};
+
+// Assignments joined with their appointment, vehicle and mechanic, stored column-wise.
+// Text lives in one shared buffer addressed by {offset, length}, so a batch of
+// thousands of rows costs a few allocations instead of several strings per row.
+class AssignmentDetailBatch {
+public:
+	size_t size() const { return assignmentIds.size(); }
+	bool empty() const { return assignmentIds.empty(); }
+	void clear();
+	void reserve(size_t rows, size_t textBytes);
+
+	int assignmentId(size_t row) const { return assignmentIds[row]; }
+	int appointmentId(size_t row) const { return appointmentIds[row]; }
+	int mechanicId(size_t row) const { return mechanicIds[row]; }
+	int durationMin(size_t row) const { return durations[row]; }
+	std::string_view assignedAt(size_t row) const { return text(row, kAssignedAt); }
+	std::optional<std::string_view> completedAt(size_t row) const;
+	std::string_view scheduledAt(size_t row) const { return text(row, kScheduledAt); }
+	std::string_view status(size_t row) const { return text(row, kStatus); }
+	std::string_view vin(size_t row) const { return text(row, kVin); }
+	std::string_view customerName(size_t row) const { return text(row, kCustomer); }
+	std::string_view mechanicName(size_t row) const { return text(row, kMechanicName); }
+	std::string_view mechanicSkill(size_t row) const { return text(row, kMechanicSkill); }
+
+	// Row building, used by Database. Text columns are appended in column order
+	// (nullptr: NULL) after the ids.
+	enum TextColumn { kAssignedAt, kCompletedAt, kScheduledAt, kStatus, kVin, kCustomer, kMechanicName, kMechanicSkill, kTextColumns };
+	void addRow(int assignmentId, int appointmentId, int mechanicId, int durationMin, const char* const (&columns)[kTextColumns]);
+
+private:
+	struct TextRef {
+		uint32_t offset;
+		uint32_t length;
+	};
+	static constexpr uint32_t kNull = 0xFFFFFFFFu;
+
+	std::string_view text(size_t row, int column) const;
+
+	std::vector<int> assignmentIds;
+	std::vector<int> appointmentIds;
+	std::vector<int> mechanicIds;
+	std::vector<int> durations;
+	std::vector<TextRef> refs; // kTextColumns per row
+	std::string chars;
+};
+
+} // namespace vsrm
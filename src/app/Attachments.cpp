@@ -0,0 +1,371 @@
+#include "Attachments.h"
+
+#include "Archive.h"
+#include "Sha256.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace vsrm {
+
+namespace {
+
+fs::path pathFromUtf8(const std::string& s) { return fs::path(std::u8string(s.begin(), s.end())); }
+
+double msSince(std::chrono::steady_clock::time_point started) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
+
+} // namespace
+
+bool hashAttachmentFile(const std::string& path, std::string& sha256, int64_t& size, std::string& error) {
+	std::ifstream in(pathFromUtf8(path), std::ios::binary);
+	if (!in) { error = "Cannot open " + path; return false; }
+	std::vector<char> chunk(kAttachmentChunk);
+	Sha256 hash;
+	size = 0;
+	while (in) {
+		in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+		std::streamsize n = in.gcount();
+		hash.update(chunk.data(), static_cast<size_t>(n));
+		size += n;
+	}
+	if (in.bad()) { error = "Cannot read " + path; return false; }
+	Sha256Digest digest = hash.finish();
+	sha256 = toHex(digest.data(), digest.size());
+	return true;
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+struct Statement {
+	sqlite3_stmt* stmt{};
+	~Statement() { sqlite3_finalize(stmt); }
+};
+
+struct Blob {
+	sqlite3_blob* handle{};
+	~Blob() { if (handle) sqlite3_blob_close(handle); }
+};
+
+bool prepare(sqlite3* db, const char* sql, Statement& s, std::string& error) {
+	if (sqlite3_prepare_v2(db, sql, -1, &s.stmt, nullptr) == SQLITE_OK) return true;
+	error = sqlite3_errmsg(db);
+	return false;
+}
+
+std::string columnText(sqlite3_stmt* stmt, int column) {
+	const unsigned char* text = sqlite3_column_text(stmt, column);
+	return text ? reinterpret_cast<const char*>(text) : "";
+}
+
+// The attachment's row, and the attachment_blobs row holding its content
+bool loadInfo(sqlite3* db, int64_t id, AttachmentInfo& info, int64_t& blobId, std::string& error) {
+	Statement s;
+	if (!prepare(db, "SELECT service_record_id, file_name, media_type, size, sha256, added_at, blob_id "
+			"FROM attachments WHERE id = ?1;", s, error))
+		return false;
+	sqlite3_bind_int64(s.stmt, 1, id);
+	if (sqlite3_step(s.stmt) != SQLITE_ROW) { error = "Attachment " + std::to_string(id) + " not found"; return false; }
+	info.id = id;
+	info.serviceRecordId = sqlite3_column_int64(s.stmt, 0);
+	info.fileName = columnText(s.stmt, 1);
+	info.mediaType = columnText(s.stmt, 2);
+	info.size = sqlite3_column_int64(s.stmt, 3);
+	info.sha256 = columnText(s.stmt, 4);
+	info.addedAt = columnText(s.stmt, 5);
+	blobId = sqlite3_column_int64(s.stmt, 6);
+	return true;
+}
+
+// length bytes of a stored content from offset, a chunk at a time
+bool readBlob(sqlite3* db, int64_t blobId, int64_t offset, int64_t length,
+	const std::function<bool(std::string_view)>& sink, std::string& error) {
+	Blob blob;
+	if (sqlite3_blob_open(db, "main", "attachment_blobs", "data", blobId, 0, &blob.handle) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	const int64_t end = std::min<int64_t>(offset + length, sqlite3_blob_bytes(blob.handle));
+	std::vector<char> chunk(kAttachmentChunk);
+	for (int64_t at = offset; at < end;) {
+		int n = static_cast<int>(std::min<int64_t>(static_cast<int64_t>(chunk.size()), end - at));
+		if (int rc = sqlite3_blob_read(blob.handle, chunk.data(), n, static_cast<int>(at)); rc != SQLITE_OK) {
+			error = sqlite3_errstr(rc);
+			return false;
+		}
+		at += n;
+		if (!sink(std::string_view(chunk.data(), static_cast<size_t>(n)))) break;
+	}
+	return true;
+}
+
+bool execBound(sqlite3* db, const char* sql, int64_t value, std::string& error) {
+	Statement s;
+	if (!prepare(db, sql, s, error)) return false;
+	sqlite3_bind_int64(s.stmt, 1, value);
+	if (sqlite3_step(s.stmt) == SQLITE_DONE) return true;
+	error = sqlite3_errmsg(db);
+	return false;
+}
+
+} // namespace
+
+bool addAttachment(sqlite3* db, int64_t serviceRecordId, bool archived, const std::string& path,
+	const std::string& fileName, const std::string& sha256, int64_t size, AttachmentAddResult& out, std::string& error) {
+	auto started = std::chrono::steady_clock::now();
+	out.deduplicated = false;
+	std::ifstream in(pathFromUtf8(path), std::ios::binary);
+	if (!in) { error = "Cannot open " + path; return false; }
+	char head[16] = {};
+	in.read(head, sizeof(head));
+	const std::string mediaType = sniffMediaType(std::string_view(head, static_cast<size_t>(in.gcount())));
+	in.clear();
+	in.seekg(0);
+
+	// Archived rows never leave their partition; a current one is checked under the write lock
+	if (!archived) {
+		Statement s;
+		if (!prepare(db, "SELECT 1 FROM service_records WHERE id = ?1;", s, error)) return false;
+		sqlite3_bind_int64(s.stmt, 1, serviceRecordId);
+		if (sqlite3_step(s.stmt) != SQLITE_ROW) { error = "Service record " + std::to_string(serviceRecordId) + " not found"; return false; }
+	}
+
+	Statement find;
+	if (!prepare(db, "SELECT id FROM attachment_blobs WHERE sha256 = ?1;", find, error)) return false;
+	sqlite3_bind_text(find.stmt, 1, sha256.c_str(), -1, SQLITE_TRANSIENT);
+	int64_t blobId = sqlite3_step(find.stmt) == SQLITE_ROW ? sqlite3_column_int64(find.stmt, 0) : 0;
+	out.deduplicated = blobId != 0;
+
+	if (!blobId) {
+		// blob handles address offsets with int, and SQLite caps a value at SQLITE_LIMIT_LENGTH
+		const int64_t limit = std::min<int64_t>(sqlite3_limit(db, SQLITE_LIMIT_LENGTH, -1), INT32_MAX);
+		if (size > limit) { error = path + " is larger than the " + std::to_string(limit) + "-byte limit for one value"; return false; }
+		Statement insert;
+		if (!prepare(db, "INSERT INTO attachment_blobs (sha256, size, data) VALUES (?1, ?2, ?3);", insert, error)) return false;
+		sqlite3_bind_text(insert.stmt, 1, sha256.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64(insert.stmt, 2, size);
+		sqlite3_bind_zeroblob64(insert.stmt, 3, static_cast<sqlite3_uint64>(size));
+		if (sqlite3_step(insert.stmt) != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+		blobId = sqlite3_last_insert_rowid(db);
+
+		Blob blob;
+		if (sqlite3_blob_open(db, "main", "attachment_blobs", "data", blobId, 1, &blob.handle) != SQLITE_OK) {
+			error = sqlite3_errmsg(db);
+			return false;
+		}
+		std::vector<char> chunk(kAttachmentChunk);
+		Sha256 check;
+		int64_t offset = 0;
+		while (in) {
+			in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+			int n = static_cast<int>(in.gcount());
+			if (n == 0) break;
+			if (offset + n > size) { offset += n; break; }
+			if (int rc = sqlite3_blob_write(blob.handle, chunk.data(), n, static_cast<int>(offset)); rc != SQLITE_OK) {
+				error = sqlite3_errstr(rc);
+				return false;
+			}
+			check.update(chunk.data(), static_cast<size_t>(n));
+			offset += n;
+		}
+		if (in.bad()) { error = "Cannot read " + path; return false; }
+		Sha256Digest digest = check.finish();
+		if (offset != size || toHex(digest.data(), digest.size()) != sha256) { error = path + " changed while it was being attached"; return false; }
+	}
+
+	Statement row;
+	if (!prepare(db, "INSERT INTO attachments (service_record_id, blob_id, file_name, media_type, size, sha256, added_at) "
+			"VALUES (?1, ?2, ?3, ?4, ?5, ?6, strftime('%Y-%m-%dT%H:%M:%SZ', 'now'));", row, error))
+		return false;
+	sqlite3_bind_int64(row.stmt, 1, serviceRecordId);
+	sqlite3_bind_int64(row.stmt, 2, blobId);
+	sqlite3_bind_text(row.stmt, 3, fileName.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(row.stmt, 4, mediaType.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64(row.stmt, 5, size);
+	sqlite3_bind_text(row.stmt, 6, sha256.c_str(), -1, SQLITE_TRANSIENT);
+	if (sqlite3_step(row.stmt) != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+	int64_t ignored = 0;
+	if (!loadInfo(db, sqlite3_last_insert_rowid(db), out.info, ignored, error)) return false;
+	out.writeMilliseconds = msSince(started);
+	return true;
+}
+
+bool listAttachments(sqlite3* db, int64_t serviceRecordId, std::vector<AttachmentInfo>& out, std::string& error) {
+	out.clear();
+	Statement s;
+	if (!prepare(db, "SELECT id, file_name, media_type, size, sha256, added_at FROM attachments "
+			"WHERE service_record_id = ?1 ORDER BY id;", s, error))
+		return false;
+	sqlite3_bind_int64(s.stmt, 1, serviceRecordId);
+	int rc;
+	while ((rc = sqlite3_step(s.stmt)) == SQLITE_ROW) {
+		AttachmentInfo info;
+		info.id = sqlite3_column_int64(s.stmt, 0);
+		info.serviceRecordId = serviceRecordId;
+		info.fileName = columnText(s.stmt, 1);
+		info.mediaType = columnText(s.stmt, 2);
+		info.size = sqlite3_column_int64(s.stmt, 3);
+		info.sha256 = columnText(s.stmt, 4);
+		info.addedAt = columnText(s.stmt, 5);
+		out.push_back(std::move(info));
+	}
+	if (rc != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+	return true;
+}
+
+bool readAttachment(sqlite3* db, int64_t id, AttachmentInfo& info, const std::function<bool(std::string_view)>& sink,
+	std::string& error) {
+	int64_t blobId = 0;
+	return loadInfo(db, id, info, blobId, error) && readBlob(db, blobId, 0, info.size, sink, error);
+}
+
+bool removeAttachment(sqlite3* db, int64_t id, bool& contentFreed, std::string& error) {
+	contentFreed = false;
+	AttachmentInfo info;
+	int64_t blobId = 0;
+	if (!loadInfo(db, id, info, blobId, error) || !execBound(db, "DELETE FROM attachments WHERE id = ?1;", id, error))
+		return false;
+	Statement s;
+	if (!prepare(db, "SELECT 1 FROM attachments WHERE blob_id = ?1 LIMIT 1;", s, error)) return false;
+	sqlite3_bind_int64(s.stmt, 1, blobId);
+	if (sqlite3_step(s.stmt) == SQLITE_ROW) return true;
+	contentFreed = execBound(db, "DELETE FROM attachment_thumbnails WHERE blob_id = ?1;", blobId, error) &&
+		execBound(db, "DELETE FROM attachment_blobs WHERE id = ?1;", blobId, error);
+	return contentFreed;
+}
+
+bool findOrphanedAttachments(sqlite3* db, std::vector<int64_t>& ids, std::string& error) {
+	ids.clear();
+	// Records main lacks; usually only archived ones, and there are few attachments per record
+	std::vector<int64_t> records;
+	{
+		Statement s;
+		if (!prepare(db, "SELECT DISTINCT service_record_id FROM attachments a "
+				"WHERE NOT EXISTS (SELECT 1 FROM service_records r WHERE r.id = a.service_record_id);", s, error))
+			return false;
+		int rc;
+		while ((rc = sqlite3_step(s.stmt)) == SQLITE_ROW) records.push_back(sqlite3_column_int64(s.stmt, 0));
+		if (rc != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+	}
+	if (records.empty()) return true;
+	std::vector<int64_t> archived;
+	if (!findArchivedRecordIds(db, records, archived, error)) return false;
+
+	Statement s;
+	if (!prepare(db, "SELECT id FROM attachments WHERE service_record_id = ?1;", s, error)) return false;
+	for (int64_t record : records) {
+		if (std::binary_search(archived.begin(), archived.end(), record)) continue;
+		sqlite3_bind_int64(s.stmt, 1, record);
+		int rc;
+		while ((rc = sqlite3_step(s.stmt)) == SQLITE_ROW) ids.push_back(sqlite3_column_int64(s.stmt, 0));
+		if (rc != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+		sqlite3_reset(s.stmt);
+	}
+	std::sort(ids.begin(), ids.end());
+	return true;
+}
+
+bool attachmentThumbnail(sqlite3* db, int64_t id, int maxEdge, ThumbnailImage& out, bool& cached, std::string& error) {
+	out = {};
+	cached = false;
+	maxEdge = std::clamp(maxEdge, 16, kMaxThumbnailEdge);
+	AttachmentInfo info;
+	int64_t blobId = 0;
+	if (!loadInfo(db, id, info, blobId, error)) return false;
+	Statement find;
+	if (!prepare(db, "SELECT media_type, width, height, data FROM attachment_thumbnails WHERE blob_id = ?1 AND max_edge = ?2;", find, error))
+		return false;
+	sqlite3_bind_int64(find.stmt, 1, blobId);
+	sqlite3_bind_int(find.stmt, 2, maxEdge);
+	if (sqlite3_step(find.stmt) == SQLITE_ROW) {
+		cached = true;
+		out.mediaType = columnText(find.stmt, 0);
+		out.width = sqlite3_column_int(find.stmt, 1);
+		out.height = sqlite3_column_int(find.stmt, 2);
+		const char* data = static_cast<const char*>(sqlite3_column_blob(find.stmt, 3));
+		out.data.assign(data ? data : "", static_cast<size_t>(sqlite3_column_bytes(find.stmt, 3)));
+		return true;
+	}
+
+	// A JPEG's EXIF preview sits in its first bytes; a PNG has to be decoded whole
+	std::string bytes;
+	auto append = [&](std::string_view chunk) { bytes.append(chunk); return true; };
+	if (info.mediaType == "image/jpeg") {
+		if (!readBlob(db, blobId, 0, static_cast<int64_t>(kJpegPreviewScan), append, error)) return false;
+		exifThumbnail(bytes, out);
+	} else if (info.mediaType == "image/png" && info.size <= static_cast<int64_t>(kMaxPngThumbnailSource)) {
+		bytes.reserve(static_cast<size_t>(info.size));
+		if (!readBlob(db, blobId, 0, info.size, append, error)) return false;
+		pngThumbnail(bytes, maxEdge, out);
+	}
+
+	Statement store;
+	if (!prepare(db, "INSERT OR REPLACE INTO attachment_thumbnails (blob_id, max_edge, media_type, width, height, data) "
+			"VALUES (?1, ?2, ?3, ?4, ?5, ?6);", store, error))
+		return false;
+	sqlite3_bind_int64(store.stmt, 1, blobId);
+	sqlite3_bind_int(store.stmt, 2, maxEdge);
+	sqlite3_bind_text(store.stmt, 3, out.mediaType.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int(store.stmt, 4, out.width);
+	sqlite3_bind_int(store.stmt, 5, out.height);
+	sqlite3_bind_blob(store.stmt, 6, out.data.data(), static_cast<int>(out.data.size()), SQLITE_STATIC);
+	if (sqlite3_step(store.stmt) != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+	return true;
+}
+
+bool describeAttachmentStorage(sqlite3* db, AttachmentStorage& out, std::string& error) {
+	out = {};
+	struct Pair { const char* sql; int64_t* count; int64_t* bytes; };
+	// length() of a BLOB comes from the record header, so no content page is read
+	const Pair queries[] = {
+		{"SELECT COUNT(*), COALESCE(SUM(size), 0) FROM attachments;", &out.attachments, &out.attachedBytes},
+		{"SELECT COUNT(*), COALESCE(SUM(size), 0) FROM attachment_blobs;", &out.contents, &out.storedBytes},
+		{"SELECT COUNT(*), COALESCE(SUM(length(data)), 0) FROM attachment_thumbnails;", &out.thumbnails, &out.thumbnailBytes},
+	};
+	for (const Pair& q : queries) {
+		Statement s;
+		if (!prepare(db, q.sql, s, error)) return false;
+		if (sqlite3_step(s.stmt) != SQLITE_ROW) { error = sqlite3_errmsg(db); return false; }
+		*q.count = sqlite3_column_int64(s.stmt, 0);
+		*q.bytes = sqlite3_column_int64(s.stmt, 1);
+	}
+	return true;
+}
+
+#else
+
+bool addAttachment(sqlite3*, int64_t, bool, const std::string&, const std::string&, const std::string&, int64_t,
+	AttachmentAddResult&, std::string& error) { error = "SQLite not available."; return false; }
+bool listAttachments(sqlite3*, int64_t, std::vector<AttachmentInfo>& out, std::string& error) {
+	out.clear(); error = "SQLite not available."; return false;
+}
+bool readAttachment(sqlite3*, int64_t, AttachmentInfo&, const std::function<bool(std::string_view)>&, std::string& error) {
+	error = "SQLite not available."; return false;
+}
+bool removeAttachment(sqlite3*, int64_t, bool& contentFreed, std::string& error) {
+	contentFreed = false; error = "SQLite not available."; return false;
+}
+bool findOrphanedAttachments(sqlite3*, std::vector<int64_t>& ids, std::string& error) {
+	ids.clear(); error = "SQLite not available."; return false;
+}
+bool attachmentThumbnail(sqlite3*, int64_t, int, ThumbnailImage& out, bool& cached, std::string& error) {
+	out = {}; cached = false; error = "SQLite not available."; return false;
+}
+bool describeAttachmentStorage(sqlite3*, AttachmentStorage& out, std::string& error) {
+	out = {}; error = "SQLite not available."; return false;
+}
+
+#endif
+
+} // namespace vsrm
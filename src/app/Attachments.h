@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Thumbnail.h"
+
+struct sqlite3;
+
+namespace vsrm {
+
+// Photos and job cards attached to service records.
+//
+// Content is stored once per distinct SHA-256 in attachment_blobs, however many attachments (on
+// however many records) point at it. Bytes move in kAttachmentChunk pieces: a row is inserted
+// with zeroblob(size) and filled with sqlite3_blob_write, and read back with sqlite3_blob_read,
+// so neither direction holds a whole file in memory. attachments rows carry the name, type, size
+// and hash themselves, so listing never touches attachment_blobs. Thumbnails are made on first
+// request and cached per (content, edge) in attachment_thumbnails, including "none".
+//
+// service_record_id is not a foreign key: archived records keep their ids and their attachments,
+// and can be given new ones. A record deleted outright (by an applied changeset) leaves its rows
+// behind until findOrphanedAttachments() picks them up. Attachments stay in the database they
+// were added to (not replicated).
+
+constexpr size_t kAttachmentChunk = 64 * 1024;
+constexpr int kMaxThumbnailEdge = 1024;
+
+struct AttachmentInfo {
+	int64_t id{};
+	int64_t serviceRecordId{};
+	std::string fileName;
+	std::string mediaType;
+	int64_t size{};
+	std::string sha256; // hex
+	std::string addedAt;
+};
+
+struct AttachmentAddResult {
+	AttachmentInfo info;
+	bool deduplicated{false}; // the content was already stored; nothing was written but the row
+	double hashMilliseconds{};
+	double writeMilliseconds{};
+};
+
+// SHA-256 (hex) and size of a file, read in chunks. Run before the write transaction.
+bool hashAttachmentFile(const std::string& path, std::string& sha256, int64_t& size, std::string& error);
+
+// Adds the file (hashed beforehand) to a service record inside the caller's transaction. New
+// content is streamed in and hashed again on the way; a file that changed since fails. archived:
+// the caller found the record in an archive partition (they cannot be attached inside a
+// transaction); otherwise it has to be in main.
+bool addAttachment(sqlite3* db, int64_t serviceRecordId, bool archived, const std::string& path,
+	const std::string& fileName, const std::string& sha256, int64_t size, AttachmentAddResult& out, std::string& error);
+
+// Attachments of one record, oldest first, from attachments alone
+bool listAttachments(sqlite3* db, int64_t serviceRecordId, std::vector<AttachmentInfo>& out, std::string& error);
+
+// Streams the content to sink chunk by chunk; sink returns false to stop
+bool readAttachment(sqlite3* db, int64_t id, AttachmentInfo& info, const std::function<bool(std::string_view)>& sink,
+	std::string& error);
+
+// Removes the attachment, and its content and thumbnails when nothing else refers to them
+// (inside the caller's transaction)
+bool removeAttachment(sqlite3* db, int64_t id, bool& contentFreed, std::string& error);
+
+// Attachments whose record is in neither main nor an archive partition, in id order. Must not run
+// inside a transaction (the partitions are attached one at a time).
+bool findOrphanedAttachments(sqlite3* db, std::vector<int64_t>& ids, std::string& error);
+
+// Cached thumbnail, made and stored on a miss (a one-statement write of its own). An empty
+// mediaType means the content has none; maxEdge is clamped to 16..kMaxThumbnailEdge.
+bool attachmentThumbnail(sqlite3* db, int64_t id, int maxEdge, ThumbnailImage& out, bool& cached, std::string& error);
+
+struct AttachmentStorage {
+	int64_t attachments{};
+	int64_t attachedBytes{}; // what the attachments would take stored separately
+	int64_t contents{};
+	int64_t storedBytes{};
+	int64_t thumbnails{};
+	int64_t thumbnailBytes{};
+};
+
+bool describeAttachmentStorage(sqlite3* db, AttachmentStorage& out, std::string& error);
+
+} // namespace vsrm
@@ -0,0 +1,560 @@
+#include "Backup.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+#ifdef VSRM_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace vsrm {
+
+namespace {
+
+fs::path pathFromUtf8(const std::string& s) { return fs::path(std::u8string(s.begin(), s.end())); }
+
+std::string utf8(const fs::path& p) {
+	std::u8string s = p.u8string();
+	return std::string(s.begin(), s.end());
+}
+
+double msSince(std::chrono::steady_clock::time_point started) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
+
+constexpr std::string_view kArchiveInfix = "-archive-";
+
+bool isBackupName(const std::string& name, const std::string& prefix) {
+	auto endsWith = [&](std::string_view suffix) {
+		return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+	// <stem>-archive-YYYY.db[.gz] files belong to the backup named <stem>, they are not backups of their own
+	return name.size() > prefix.size() + 1 && name.compare(0, prefix.size(), prefix) == 0 && name[prefix.size()] == '-' &&
+		(endsWith(".db") || endsWith(".db.gz")) && name.find(kArchiveInfix, prefix.size()) == std::string::npos;
+}
+
+// The name a backup's files share: its file name without .db or .db.gz
+std::string backupStem(const fs::path& path) {
+	std::string name = utf8(path.filename());
+	for (std::string_view suffix : {".db.gz", ".db"}) {
+		if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+			return name.substr(0, name.size() - suffix.size());
+	}
+	return name;
+}
+
+// Copies of the archive partitions written with the backup at path
+std::vector<fs::path> archiveCopies(const fs::path& path) {
+	const std::string lead = backupStem(path) + std::string(kArchiveInfix);
+	std::vector<fs::path> found;
+	std::error_code ec;
+	for (fs::directory_iterator it(path.has_parent_path() ? path.parent_path() : fs::path("."), ec), end; !ec && it != end; it.increment(ec)) {
+		if (utf8(it->path().filename()).compare(0, lead.size(), lead) == 0) found.push_back(it->path());
+	}
+	return found;
+}
+
+// <prefix>-YYYYMMDD-HHMMSS in UTC, so names sort by age
+std::string stampedName(const std::string& prefix) {
+	std::time_t now = std::time(nullptr);
+	std::tm utc{};
+#ifdef _WIN32
+	gmtime_s(&utc, &now);
+#else
+	gmtime_r(&now, &utc);
+#endif
+	char stamp[32];
+	std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &utc);
+	return prefix + "-" + stamp;
+}
+
+void removeQuietly(const fs::path& p) {
+	std::error_code ec;
+	fs::remove(p, ec);
+}
+
+#ifdef VSRM_HAS_ZLIB
+constexpr size_t kChunk = 256 * 1024;
+
+bool gzipFile(const fs::path& from, const fs::path& to, std::string& error) {
+	std::ifstream in(from, std::ios::binary);
+	std::ofstream out(to, std::ios::binary | std::ios::trunc);
+	if (!in || !out) { error = "Cannot open " + utf8(in ? to : from); return false; }
+	z_stream z{};
+	// windowBits 15 + 16: gzip framing, so `gunzip` restores a backup without this program
+	if (deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) { error = "deflateInit failed"; return false; }
+	std::vector<char> src(kChunk), dst(kChunk);
+	int flush = Z_NO_FLUSH;
+	do {
+		in.read(src.data(), static_cast<std::streamsize>(src.size()));
+		z.next_in = reinterpret_cast<Bytef*>(src.data());
+		z.avail_in = static_cast<uInt>(in.gcount());
+		flush = in.eof() ? Z_FINISH : Z_NO_FLUSH;
+		do {
+			z.next_out = reinterpret_cast<Bytef*>(dst.data());
+			z.avail_out = static_cast<uInt>(dst.size());
+			deflate(&z, flush);
+			out.write(dst.data(), static_cast<std::streamsize>(dst.size() - z.avail_out));
+		} while (z.avail_out == 0);
+	} while (flush != Z_FINISH && in);
+	deflateEnd(&z);
+	if (in.bad() || !out.flush()) { error = "Cannot write " + utf8(to); return false; }
+	return true;
+}
+
+// Streams the decompressed bytes of a gzip file to sink; false on corrupt or truncated input
+bool gunzipFile(const fs::path& from, const std::function<bool(const char*, size_t)>& sink, std::string& error) {
+	std::ifstream in(from, std::ios::binary);
+	if (!in) { error = "Cannot open " + utf8(from); return false; }
+	z_stream z{};
+	if (inflateInit2(&z, 15 + 16) != Z_OK) { error = "inflateInit failed"; return false; }
+	std::vector<char> src(kChunk), dst(kChunk);
+	int rc = Z_OK;
+	while (rc != Z_STREAM_END) {
+		in.read(src.data(), static_cast<std::streamsize>(src.size()));
+		if (in.gcount() == 0) break;
+		z.next_in = reinterpret_cast<Bytef*>(src.data());
+		z.avail_in = static_cast<uInt>(in.gcount());
+		do {
+			z.next_out = reinterpret_cast<Bytef*>(dst.data());
+			z.avail_out = static_cast<uInt>(dst.size());
+			rc = inflate(&z, Z_NO_FLUSH);
+			if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+				inflateEnd(&z);
+				error = utf8(from) + " is not a valid gzip file";
+				return false;
+			}
+			if (!sink(dst.data(), dst.size() - z.avail_out)) { inflateEnd(&z); return false; }
+		} while (z.avail_out == 0 && rc != Z_STREAM_END);
+	}
+	inflateEnd(&z);
+	if (rc != Z_STREAM_END) { error = utf8(from) + " is truncated"; return false; }
+	return true;
+}
+
+// Decompresses `compressed` and compares it with `original` byte for byte
+bool sameAfterRoundTrip(const fs::path& compressed, const fs::path& original, std::string& error) {
+	std::ifstream in(original, std::ios::binary);
+	std::vector<char> expected;
+	bool same = true;
+	bool ok = gunzipFile(compressed, [&](const char* data, size_t n) {
+		expected.resize(n);
+		in.read(expected.data(), static_cast<std::streamsize>(n));
+		same = static_cast<size_t>(in.gcount()) == n && std::equal(data, data + n, expected.begin());
+		return same;
+	}, error);
+	if (ok && same && in.peek() != std::char_traits<char>::eof()) same = false;
+	if (!same) { error = "The compressed backup does not decompress to the copied database"; return false; }
+	return ok;
+}
+#endif
+
+#ifdef VSRM_HAS_SQLITE3
+bool integrityCheck(sqlite3* db, BackupCheck& check, std::string& error) {
+	check = BackupCheck{};
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "PRAGMA integrity_check;", -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		std::string line = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+		if (line != "ok") check.problems.push_back(std::move(line));
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+	if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr) == SQLITE_OK) {
+		if (sqlite3_step(stmt) == SQLITE_ROW) check.schemaVersion = sqlite3_column_int(stmt, 0);
+		sqlite3_finalize(stmt);
+	}
+	// Absent in a database that was never migrated; that is not a fault of the copy
+	if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM service_records;", -1, &stmt, nullptr) == SQLITE_OK) {
+		if (sqlite3_step(stmt) == SQLITE_ROW) check.serviceRecords = sqlite3_column_int64(stmt, 0);
+		sqlite3_finalize(stmt);
+	}
+	return true;
+}
+
+bool checkFile(const fs::path& path, BackupCheck& check, std::string& error) {
+	sqlite3* db = nullptr;
+	if (sqlite3_open_v2(utf8(path).c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+		error = "Cannot open " + utf8(path) + ": " + sqlite3_errmsg(db);
+		sqlite3_close(db);
+		return false;
+	}
+	bool ok = integrityCheck(db, check, error);
+	sqlite3_close(db);
+	return ok;
+}
+
+struct PartitionEntry {
+	int year{};
+	std::string file;
+	int64_t records{};
+};
+
+// archive_partitions as registered in db; empty before the archive migration
+bool readPartitions(sqlite3* db, std::vector<PartitionEntry>& out, std::string& error) {
+	out.clear();
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'archive_partitions';",
+			-1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	bool present = sqlite3_step(stmt) == SQLITE_ROW;
+	sqlite3_finalize(stmt);
+	if (!present) return true;
+	if (sqlite3_prepare_v2(db, "SELECT year, file, records FROM archive_partitions ORDER BY year;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		const char* file = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+		out.push_back({sqlite3_column_int(stmt, 0), file ? file : "", sqlite3_column_int64(stmt, 2)});
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+	return true;
+}
+
+// Copies one database file into copyPath a few pages at a time (see backupDatabase). Progress counts on from the
+// pages of the files already copied, so a backup with archive partitions reports one growing total.
+bool copyFile(const std::string& srcPath, const fs::path& copyPath, const BackupOptions& options, BackupResult& result,
+	const std::function<bool(const BackupProgress&)>& progress, std::string& error) {
+	auto started = std::chrono::steady_clock::now();
+	sqlite3* src = nullptr;
+	sqlite3* dst = nullptr;
+	auto close = [&](bool ok) {
+		if (dst) sqlite3_close(dst);
+		if (src) sqlite3_close(src);
+		result.copyMilliseconds += msSince(started);
+		return ok;
+	};
+	if (sqlite3_open_v2(srcPath.c_str(), &src, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+		error = "Cannot open " + srcPath + ": " + sqlite3_errmsg(src);
+		return close(false);
+	}
+	if (sqlite3_open_v2(utf8(copyPath).c_str(), &dst, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+		error = "Cannot create " + utf8(copyPath) + ": " + sqlite3_errmsg(dst);
+		return close(false);
+	}
+	sqlite3_backup* backup = sqlite3_backup_init(dst, "main", src, "main");
+	if (!backup) { error = sqlite3_errmsg(dst); return close(false); }
+
+	// Each step holds the source's read lock only while it copies pagesPerStep pages. A write from
+	// another connection between steps restarts the copy; after a few restarts the rest is copied
+	// in one step so a busy database still gets backed up (in WAL mode that step blocks no one).
+	constexpr int kRestartsBeforeOneStep = 3;
+	const int pages = std::max(1, options.pagesPerStep);
+	const int64_t pagesBefore = result.pages;
+	int restarts = 0;
+	int64_t lastRemaining = -1;
+	int rc = SQLITE_OK;
+	while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+		rc = sqlite3_backup_step(backup, restarts >= kRestartsBeforeOneStep ? -1 : pages);
+		++result.steps;
+		int64_t remaining = sqlite3_backup_remaining(backup);
+		int64_t total = sqlite3_backup_pagecount(backup);
+		if (lastRemaining >= 0 && remaining > lastRemaining) { ++restarts; ++result.restarts; }
+		lastRemaining = remaining;
+		if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) ++result.busyRetries;
+		if (progress && !progress(BackupProgress{pagesBefore + total - remaining, pagesBefore + total, result.restarts})) {
+			sqlite3_backup_finish(backup);
+			error = "Backup cancelled";
+			return close(false);
+		}
+		if (rc != SQLITE_DONE) std::this_thread::sleep_for(std::chrono::milliseconds(
+			rc == SQLITE_OK ? options.pauseMs : std::max(options.pauseMs, 10)));
+	}
+	result.pages += sqlite3_backup_pagecount(backup);
+	sqlite3_backup_finish(backup);
+	if (rc != SQLITE_DONE) { error = std::string("Backup failed: ") + sqlite3_errstr(rc); return close(false); }
+	if (sqlite3_errcode(dst) != SQLITE_OK) { error = sqlite3_errmsg(dst); return close(false); }
+	// The copy inherits the source's journal mode; a backup file stands alone
+	sqlite3_exec(dst, "PRAGMA journal_mode = DELETE;", nullptr, nullptr, nullptr);
+	return close(true);
+}
+
+bool verifyCopy(const fs::path& copyPath, BackupResult& result, std::string& error) {
+	auto started = std::chrono::steady_clock::now();
+	BackupCheck check;
+	if (!checkFile(copyPath, check, error)) return false;
+	if (!check.problems.empty()) {
+		error = utf8(copyPath.filename()) + " failed its integrity check: " + check.problems.front();
+		return false;
+	}
+	result.verifyMilliseconds += msSince(started);
+	return true;
+}
+
+// Gzips a finished copy (checked against it after decompression when verifying) or renames it into place
+bool publish(const fs::path& copyPath, const fs::path& finalPath, [[maybe_unused]] bool compress,
+	[[maybe_unused]] const BackupOptions& options, BackupResult& result, std::string& error) {
+	std::error_code ec;
+	result.databaseBytes += fs::file_size(copyPath, ec);
+#ifdef VSRM_HAS_ZLIB
+	if (compress) {
+		auto started = std::chrono::steady_clock::now();
+		fs::path gzPath = copyPath;
+		gzPath += ".gz";
+		// Checked against the verified copy, so the compressed file is as good as the database it replaces
+		if (!gzipFile(copyPath, gzPath, error) || (options.verify && !sameAfterRoundTrip(gzPath, copyPath, error))) {
+			removeQuietly(gzPath);
+			return false;
+		}
+		fs::rename(gzPath, finalPath, ec);
+		if (ec) { removeQuietly(gzPath); error = "Cannot rename the backup: " + ec.message(); return false; }
+		removeQuietly(copyPath);
+		result.compressMilliseconds += msSince(started);
+	} else
+#endif
+	{
+		fs::rename(copyPath, finalPath, ec);
+		if (ec) { error = "Cannot rename the backup: " + ec.message(); return false; }
+	}
+	result.fileBytes += fs::file_size(finalPath, ec);
+	return true;
+}
+
+// Runs check on path, or on a temporary decompressed copy when path is a .gz
+bool withDatabaseFile(const fs::path& path, const std::function<bool(const fs::path&)>& check, std::string& error) {
+	if (path.extension() != ".gz") return check(path);
+#ifdef VSRM_HAS_ZLIB
+	std::error_code ec;
+	fs::path temp = fs::temp_directory_path(ec) / pathFromUtf8(utf8(path.stem()) + ".verify");
+	if (ec) { error = ec.message(); return false; }
+	bool ok;
+	{
+		std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+		ok = out && gunzipFile(path, [&](const char* data, size_t n) {
+			return static_cast<bool>(out.write(data, static_cast<std::streamsize>(n)));
+		}, error);
+		if (ok && !out.flush()) { error = "Cannot write " + utf8(temp); ok = false; }
+	}
+	ok = ok && check(temp);
+	removeQuietly(temp);
+	return ok;
+#else
+	error = "Built without zlib; decompress the backup with gunzip and verify the .db";
+	return false;
+#endif
+}
+#endif
+
+} // namespace
+
+std::vector<std::string> listBackups(const std::string& directory, const std::string& prefix) {
+	std::vector<std::string> names;
+	std::error_code ec;
+	for (fs::directory_iterator it(pathFromUtf8(directory), ec), end; !ec && it != end; it.increment(ec)) {
+		std::string name = utf8(it->path().filename());
+		if (it->is_regular_file(ec) && isBackupName(name, prefix)) names.push_back(std::move(name));
+	}
+	std::sort(names.rbegin(), names.rend());
+	std::vector<std::string> paths;
+	for (const auto& name : names) paths.push_back(utf8(pathFromUtf8(directory) / pathFromUtf8(name)));
+	return paths;
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+bool backupDatabase(const std::string& dbPath, const BackupOptions& options, BackupResult& result, std::string& error,
+	const std::function<bool(const BackupProgress&)>& progress) {
+	result = BackupResult{};
+	const fs::path dir = pathFromUtf8(options.directory);
+	std::error_code ec;
+	fs::create_directories(dir, ec);
+	if (ec) { error = "Cannot create " + options.directory + ": " + ec.message(); return false; }
+#ifdef VSRM_HAS_ZLIB
+	const bool compress = options.compress;
+#else
+	const bool compress = false;
+#endif
+	const std::string extension = compress ? ".db.gz" : ".db";
+	// A second backup within the same second gets a counter
+	std::string stem = stampedName(options.prefix);
+	fs::path finalPath;
+	for (int n = 1;; ++n) {
+		std::string name = n == 1 ? stem : stem + "-" + std::to_string(n);
+		finalPath = dir / pathFromUtf8(name + extension);
+		if (!fs::exists(finalPath, ec)) { stem = name; break; }
+	}
+	const fs::path copyPath = dir / pathFromUtf8(stem + ".db.part");
+
+	// Everything written so far goes again unless the whole set makes it
+	std::vector<fs::path> written{copyPath};
+	sqlite3* copy = nullptr;
+	auto cleanup = [&](bool ok) {
+		if (copy) sqlite3_close(copy);
+		if (!ok) {
+			for (const auto& p : written) removeQuietly(p);
+			result.path.clear();
+			result.archives.clear();
+		}
+		return ok;
+	};
+	if (!copyFile(dbPath, copyPath, options, result, progress, error)) return cleanup(false);
+
+	// Archive partitions are copied after main, from main's copy of the registry: a record archived in between is
+	// then in both copies (the archive resolves such duplicates) rather than in neither. The copy's registry is
+	// pointed at <stem>-archive-YYYY.db so the backup restores as a set.
+	if (sqlite3_open_v2(utf8(copyPath).c_str(), &copy, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+		error = "Cannot open " + utf8(copyPath) + ": " + sqlite3_errmsg(copy);
+		return cleanup(false);
+	}
+	std::vector<PartitionEntry> partitions;
+	if (!readPartitions(copy, partitions, error)) return cleanup(false);
+	const fs::path sourceDir = pathFromUtf8(dbPath).parent_path();
+	for (const PartitionEntry& p : partitions) {
+		const fs::path source = sourceDir / pathFromUtf8(p.file);
+		if (!fs::is_regular_file(source, ec)) { error = "Archive partition " + utf8(source) + " is missing"; return cleanup(false); }
+		const std::string name = stem + std::string(kArchiveInfix) + std::to_string(p.year) + ".db";
+		const fs::path partCopy = dir / pathFromUtf8(name + ".part");
+		const fs::path partFinal = dir / pathFromUtf8(name + (compress ? ".gz" : ""));
+		written.push_back(partCopy);
+		written.push_back(partFinal);
+		if (!copyFile(utf8(source), partCopy, options, result, progress, error) ||
+			(options.verify && !verifyCopy(partCopy, result, error)) ||
+			!publish(partCopy, partFinal, compress, options, result, error)) return cleanup(false);
+		result.archives.push_back(utf8(partFinal));
+
+		sqlite3_stmt* stmt = nullptr;
+		if (sqlite3_prepare_v2(copy, "UPDATE archive_partitions SET file = ?1 WHERE year = ?2;", -1, &stmt, nullptr) != SQLITE_OK) {
+			error = sqlite3_errmsg(copy);
+			return cleanup(false);
+		}
+		sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int(stmt, 2, p.year);
+		int rc = sqlite3_step(stmt);
+		sqlite3_finalize(stmt);
+		if (rc != SQLITE_DONE) { error = sqlite3_errmsg(copy); return cleanup(false); }
+	}
+	sqlite3_close(copy);
+	copy = nullptr;
+
+	if (options.verify && !verifyCopy(copyPath, result, error)) return cleanup(false);
+	result.verified = options.verify;
+	written.push_back(finalPath);
+	if (!publish(copyPath, finalPath, compress, options, result, error)) return cleanup(false);
+	result.compressed = compress;
+	result.path = utf8(finalPath);
+
+	// Rotation by name: this backup is the newest, so it is never the one removed; its archive copies go with it
+	if (options.keep > 0) {
+		auto all = listBackups(options.directory, options.prefix);
+		for (size_t i = static_cast<size_t>(options.keep); i < all.size(); ++i) {
+			const fs::path old = pathFromUtf8(all[i]);
+			for (const auto& companion : archiveCopies(old)) {
+				if (fs::remove(companion, ec)) result.removed.push_back(utf8(companion));
+			}
+			if (fs::remove(old, ec)) result.removed.push_back(all[i]);
+		}
+	}
+	return cleanup(true);
+}
+
+bool verifyBackup(const std::string& backupPath, BackupCheck& check, std::string& error) {
+	check = BackupCheck{};
+	fs::path path = pathFromUtf8(backupPath);
+	std::error_code ec;
+	if (!fs::is_regular_file(path, ec)) { error = "No such backup: " + backupPath; return false; }
+	std::vector<PartitionEntry> partitions;
+	bool ok = withDatabaseFile(path, [&](const fs::path& file) {
+		if (!checkFile(file, check, error)) return false;
+		sqlite3* db = nullptr;
+		if (sqlite3_open_v2(utf8(file).c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+			error = "Cannot open " + utf8(file) + ": " + sqlite3_errmsg(db);
+			sqlite3_close(db);
+			return false;
+		}
+		bool read = readPartitions(db, partitions, error);
+		sqlite3_close(db);
+		return read;
+	}, error);
+	if (!ok) return false;
+
+	// The registry in the backup names the partition copies beside it (backups from before partitions were
+	// backed up name the live files, which are then reported missing)
+	const bool compressed = path.extension() == ".gz";
+	for (const PartitionEntry& p : partitions) {
+		fs::path copy = path.parent_path() / pathFromUtf8(p.file + (compressed ? ".gz" : ""));
+		const std::string name = utf8(copy.filename());
+		if (!fs::is_regular_file(copy, ec)) { check.problems.push_back("archive " + std::to_string(p.year) + " missing: " + name); continue; }
+		BackupCheck part;
+		if (!withDatabaseFile(copy, [&](const fs::path& file) { return checkFile(file, part, error); }, error)) return false;
+		for (const auto& problem : part.problems) check.problems.push_back(name + ": " + problem);
+		if (part.serviceRecords != p.records) {
+			check.problems.push_back(name + " holds " + std::to_string(part.serviceRecords) + " service records, the registry says " +
+				std::to_string(p.records));
+		}
+		++check.partitions;
+		check.archivedRecords += part.serviceRecords;
+	}
+	return true;
+}
+
+#else
+
+bool backupDatabase(const std::string&, const BackupOptions&, BackupResult& result, std::string& error,
+	const std::function<bool(const BackupProgress&)>&) {
+	result = BackupResult{};
+	error = "SQLite not available.";
+	return false;
+}
+
+bool verifyBackup(const std::string&, BackupCheck& check, std::string& error) {
+	check = BackupCheck{};
+	error = "SQLite not available.";
+	return false;
+}
+
+#endif
+
+BackupJob::~BackupJob() {
+	cancel();
+	if (worker.joinable()) worker.join();
+}
+
+bool BackupJob::start(const std::string& dbPath, const BackupOptions& options,
+	std::function<void(bool ok, const BackupResult&, const std::string& error)> onDone) {
+	if (busy.exchange(true)) return false;
+	if (worker.joinable()) worker.join();
+	cancelled = false;
+	pagesDone = 0;
+	pageCount = 0;
+	restarts = 0;
+	worker = std::thread([this, dbPath, options, onDone = std::move(onDone)] {
+		BackupResult result;
+		std::string error;
+		bool done = backupDatabase(dbPath, options, result, error, [this](const BackupProgress& p) {
+			pagesDone = p.pagesDone;
+			pageCount = p.pageCount;
+			restarts = p.restarts;
+			return !cancelled.load();
+		});
+		ok = done;
+		outcome = result;
+		failure = error;
+		if (onDone) onDone(done, result, error);
+		busy = false;
+	});
+	return true;
+}
+
+BackupProgress BackupJob::progress() const {
+	return BackupProgress{pagesDone.load(), pageCount.load(), restarts.load()};
+}
+
+bool BackupJob::wait(BackupResult& result, std::string& error) {
+	if (worker.joinable()) worker.join();
+	result = outcome;
+	if (!ok) error = failure;
+	return ok;
+}
+
+} // namespace vsrm
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vsrm {
+
+// Online backups with sqlite3_backup_step. The copy runs on its own connections a few pages at
+// a time and sleeps between steps, so the app keeps reading and writing while it runs (another
+// connection's write restarts the copy; in WAL mode readers and the copy never wait on each
+// other). The copy is written beside its final name, checked with PRAGMA integrity_check,
+// optionally gzip-compressed and only then renamed into place; the oldest backups beyond `keep`
+// are deleted afterwards. Archive partitions registered in the database are copied the same way
+// into <backup stem>-archive-YYYY.db[.gz] files that make up one backup with the main copy.
+
+struct BackupOptions {
+	std::string directory;      // created if missing
+	std::string prefix{"vsrm"}; // files are <prefix>-YYYYMMDD-HHMMSS.db, or .db.gz when compressed
+	int pagesPerStep{64};
+	int pauseMs{2};             // between steps: lets foreground statements take the lock
+	bool compress{true};        // ignored (plain .db) when built without zlib
+	bool verify{true};
+	int keep{7};                // newest backups kept with this prefix; 0 keeps all
+};
+
+struct BackupProgress {
+	int64_t pagesDone{};
+	int64_t pageCount{};
+	int restarts{}; // times a write on another connection forced the copy to start over
+};
+
+struct BackupResult {
+	std::string path;
+	int64_t pages{};
+	uint64_t databaseBytes{};    // totals over the main copy and its archive copies
+	uint64_t fileBytes{};        // on disk, after compression
+	int steps{};
+	int busyRetries{};           // steps that found the source locked and were retried
+	int restarts{};
+	bool compressed{false};
+	bool verified{false};
+	double copyMilliseconds{};
+	double verifyMilliseconds{};
+	double compressMilliseconds{};
+	std::vector<std::string> archives; // partition copies written with path
+	std::vector<std::string> removed;  // rotated out, archive copies included
+};
+
+// Backups with the given prefix in directory, newest first
+std::vector<std::string> listBackups(const std::string& directory, const std::string& prefix);
+
+// Copies dbPath into a new backup. progress is called after every step; returning false cancels.
+// Nothing is left behind on failure or cancellation.
+bool backupDatabase(const std::string& dbPath, const BackupOptions& options, BackupResult& result, std::string& error,
+	const std::function<bool(const BackupProgress&)>& progress = {});
+
+struct BackupCheck {
+	int schemaVersion{};
+	int64_t serviceRecords{};
+	int partitions{};         // archive copies checked with it
+	int64_t archivedRecords{};
+	std::vector<std::string> problems; // empty when integrity_check passed on every file
+};
+
+// Opens a backup (.db, or .db.gz decompressed to a temporary file) and runs PRAGMA integrity_check,
+// then does the same for each archive copy its registry names; a missing copy is a problem
+bool verifyBackup(const std::string& backupPath, BackupCheck& check, std::string& error);
+
+// backupDatabase() on a background thread; progress() can be polled from any thread
+class BackupJob {
+public:
+	BackupJob() = default;
+	~BackupJob();
+	BackupJob(const BackupJob&) = delete;
+	BackupJob& operator=(const BackupJob&) = delete;
+
+	// onDone runs on the backup thread when it finishes
+	bool start(const std::string& dbPath, const BackupOptions& options,
+		std::function<void(bool ok, const BackupResult&, const std::string& error)> onDone = {});
+	BackupProgress progress() const;
+	bool running() const { return busy.load(); }
+	void cancel() { cancelled = true; }
+	// Waits for the thread; false (with error) if the backup failed or was cancelled
+	bool wait(BackupResult& result, std::string& error);
+
+private:
+	std::thread worker;
+	std::atomic<bool> busy{false};
+	std::atomic<bool> cancelled{false};
+	std::atomic<int64_t> pagesDone{0};
+	std::atomic<int64_t> pageCount{0};
+	std::atomic<int> restarts{0};
+	bool ok{false};
+	BackupResult outcome;
+	std::string failure;
+};
+
+} // namespace vsrm
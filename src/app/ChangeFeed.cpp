@@ -0,0 +1,56 @@
+#include "ChangeFeed.h"
+
+#include <algorithm>
+
+namespace vsrm {
+
+bool CommitChanges::touches(std::string_view table) const {
+	return std::find(tables.begin(), tables.end(), table) != tables.end();
+}
+
+ChangeFeed::ChangeFeed(size_t maxCommits, size_t maxRowsPerCommit)
+	: maxCommits(maxCommits ? maxCommits : 1), maxRowsPerCommit(maxRowsPerCommit) {}
+
+void ChangeFeed::recordRow(RowOp op, const char* table, int64_t rowid) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!pending.touches(table)) pending.tables.emplace_back(table);
+	if (pending.truncated) return;
+	if (pending.rows.size() >= maxRowsPerCommit) {
+		pending.rows.clear();
+		pending.rows.shrink_to_fit();
+		pending.truncated = true;
+		return;
+	}
+	pending.rows.push_back(RowChange{op, table, rowid});
+}
+
+void ChangeFeed::commit() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (pending.tables.empty()) return; // read-only or no-op transaction
+	pending.sequence = ++seq;
+	log.push_back(std::move(pending));
+	pending = CommitChanges{};
+	while (log.size() > maxCommits) log.pop_front();
+}
+
+void ChangeFeed::rollback() {
+	std::lock_guard<std::mutex> lock(mutex);
+	pending = CommitChanges{};
+}
+
+uint64_t ChangeFeed::sequence() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return seq;
+}
+
+bool ChangeFeed::changesSince(uint64_t since, std::vector<CommitChanges>& out) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (since >= seq) return true;
+	bool complete = !log.empty() && log.front().sequence <= since + 1;
+	for (const auto& c : log) {
+		if (c.sequence > since) out.push_back(c);
+	}
+	return complete;
+}
+
+} // namespace vsrm
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vsrm {
+
+enum class RowOp { Insert, Update, Delete };
+
+struct RowChange {
+	RowOp op{};
+	std::string table;
+	int64_t rowid{};
+};
+
+// Rows touched by one committed transaction on this connection.
+struct CommitChanges {
+	uint64_t sequence{};
+	std::vector<std::string> tables;  // distinct tables, in first-touched order
+	std::vector<RowChange> rows;      // empty when `truncated`
+	bool truncated{false};            // too many rows to list; treat `tables` as fully changed
+
+	bool touches(std::string_view table) const;
+};
+
+// Collects sqlite3_update_hook events and publishes them once the commit hook
+// fires. Consumers remember the last sequence they saw and poll changesSince();
+// only a bounded window of commits is kept, so a consumer that falls behind is
+// told to resynchronize instead of getting a partial picture.
+class ChangeFeed {
+public:
+	explicit ChangeFeed(size_t maxCommits = 256, size_t maxRowsPerCommit = 10000);
+
+	// Hook entry points
+	void recordRow(RowOp op, const char* table, int64_t rowid);
+	void commit();
+	void rollback();
+
+	uint64_t sequence() const;
+
+	// Appends commits newer than `since` to out. Returns false if some of them
+	// were already dropped from the window (caller should reload everything).
+	bool changesSince(uint64_t since, std::vector<CommitChanges>& out) const;
+
+private:
+	mutable std::mutex mutex;
+	CommitChanges pending;
+	std::deque<CommitChanges> log;
+	uint64_t seq{0};
+	size_t maxCommits;
+	size_t maxRowsPerCommit;
+};
+
+} // namespace vsrm
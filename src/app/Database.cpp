@@ -1,22 +1,39 @@
 #include "Database.h"
 
+#include "Dates.h"
+#include "PasswordHash.h"
+#include "VinDecoder.h"
+
 #ifdef VSRM_HAS_SQLITE3
 #include <sqlite3.h>
 #endif
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
-#include <sstream>
 #include <fstream>
 
 namespace fs = std::filesystem;
 
 namespace vsrm {
 
-Database::Database() : handle(nullptr) {}
+// Paths cross the API as UTF-8; narrow std::string paths would go through the ANSI code page on Windows.
+static fs::path pathFromUtf8(const std::string& s) {
+	return fs::path(std::u8string(s.begin(), s.end()));
+}
+
+Database::Database()
+	: handle(nullptr), changeFeed(std::make_unique<ChangeFeed>()), summaryCache(std::make_unique<SummaryCache>()),
+	  bookingIndex(std::make_unique<BookingIndex>()), recorder(std::make_unique<ChangeRecorder>()),
+	  descriptions(std::make_unique<DescriptionCodec>()), maintenance(std::make_unique<MaintenanceScheduler>()) {}
 
 Database::~Database() { close(); }
 
-Database::Database(Database&& other) noexcept : handle(other.handle), lastError(std::move(other.lastError)) {
+Database::Database(Database&& other) noexcept
+	: handle(other.handle), lastError(std::move(other.lastError)), changeFeed(std::move(other.changeFeed)),
+	  summaryCache(std::move(other.summaryCache)), bookingIndex(std::move(other.bookingIndex)),
+	  columns(std::move(other.columns)), recorder(std::move(other.recorder)), descriptions(std::move(other.descriptions)),
+	  maintenance(std::move(other.maintenance)), busyWaitMs(other.busyWaitMs) {
 	other.handle = nullptr;
 }
 
@@ -25,11 +42,43 @@ Database& Database::operator=(Database&& other) noexcept {
 		close();
 		handle = other.handle;
 		lastError = std::move(other.lastError);
+		changeFeed = std::move(other.changeFeed);
+		summaryCache = std::move(other.summaryCache);
+		bookingIndex = std::move(other.bookingIndex);
+		columns = std::move(other.columns);
+		recorder = std::move(other.recorder);
+		descriptions = std::move(other.descriptions);
+		maintenance = std::move(other.maintenance);
+		busyWaitMs = other.busyWaitMs;
 		other.handle = nullptr;
 	}
 	return *this;
 }
 
+#ifdef VSRM_HAS_SQLITE3
+static void onRowChanged(void* feed, int op, const char* /*dbName*/, const char* table, sqlite3_int64 rowid) {
+	RowOp rowOp = op == SQLITE_INSERT ? RowOp::Insert : op == SQLITE_DELETE ? RowOp::Delete : RowOp::Update;
+	static_cast<ChangeFeed*>(feed)->recordRow(rowOp, table, rowid);
+}
+
+static int onCommit(void* feed) {
+	static_cast<ChangeFeed*>(feed)->commit();
+	return 0; // never veto the commit
+}
+
+static void onRollback(void* feed) {
+	static_cast<ChangeFeed*>(feed)->rollback();
+}
+#endif
+
+uint64_t Database::changeSequence() const {
+	return changeFeed ? changeFeed->sequence() : 0;
+}
+
+bool Database::changesSince(uint64_t sequence, std::vector<CommitChanges>& out) const {
+	return changeFeed ? changeFeed->changesSince(sequence, out) : false;
+}
+
 bool Database::openOrCreate(const std::string& dbPath) {
 #ifndef VSRM_HAS_SQLITE3
 	lastError = "SQLite not available. Build with vcpkg manifest.";
@@ -40,6 +89,37 @@ bool Database::openOrCreate(const std::string& dbPath) {
 		lastError += sqlite3_errmsg(handle);
 		return false;
 	}
+	// Per-connection setting, so it belongs here rather than in a migration
+	sqlite3_exec(handle, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+	// Applies to a new file (before its first table) and to older ones at their next VACUUM; lets
+	// idle maintenance hand free pages back with incremental_vacuum
+	sqlite3_exec(handle, "PRAGMA auto_vacuum = INCREMENTAL;", nullptr, nullptr, nullptr);
+	sqlite3_update_hook(handle, &onRowChanged, changeFeed.get());
+	sqlite3_commit_hook(handle, &onCommit, changeFeed.get());
+	sqlite3_rollback_hook(handle, &onRollback, changeFeed.get());
+	// Every statement touching service_records.description goes through vsrm_pack / vsrm_text
+	return registerDescriptionFunctions(handle, descriptions.get(), lastError);
+#endif
+}
+
+bool Database::enableWriteAheadLog(int busyTimeoutMs) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)busyTimeoutMs;
+	lastError = "SQLite not available.";
+	return false;
+#else
+	sqlite3_busy_timeout(handle, busyTimeoutMs);
+	busyWaitMs = busyTimeoutMs;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, "PRAGMA journal_mode = WAL;", -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
+	// The pragma reports the mode in effect; in-memory databases stay "memory"
+	std::string mode = sqlite3_step(stmt) == SQLITE_ROW ? reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) : "";
+	sqlite3_finalize(stmt);
+	if (mode != "wal" && mode != "memory") {
+		lastError = "Could not switch to WAL (journal_mode is " + (mode.empty() ? std::string(sqlite3_errmsg(handle)) : mode) + ")";
+		return false;
+	}
+	sqlite3_exec(handle, "PRAGMA synchronous = NORMAL;", nullptr, nullptr, nullptr);
 	return true;
 #endif
 }
@@ -47,6 +127,7 @@ bool Database::openOrCreate(const std::string& dbPath) {
 void Database::close() {
 #ifdef VSRM_HAS_SQLITE3
 	if (handle) {
+		if (recorder) recorder->detach(); // sessions must go before their connection
 		sqlite3_close(handle);
 		handle = nullptr;
 	}
@@ -55,44 +136,229 @@ void Database::close() {
 #endif
 }
 
-bool Database::initializeSchema(const std::string& schemaFilePath) {
+int Database::schemaVersion() {
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available.";
+	return -1;
+#else
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, "PRAGMA user_version;", -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return -1; }
+	int version = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : -1;
+	sqlite3_finalize(stmt);
+	return version;
+#endif
+}
+
+bool Database::migrateSchema(std::vector<MigrationStep>* applied) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)applied;
+	lastError = "SQLite not available.";
+	return false;
+#else
+	// Both header fields in one statement; an up-to-date file needs nothing else
+	sqlite3_stmt* header = nullptr;
+	if (sqlite3_prepare_v2(handle, "SELECT user_version, application_id FROM pragma_user_version, pragma_application_id;",
+		-1, &header, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
+	int current = -1;
+	int32_t applicationId = 0;
+	if (sqlite3_step(header) == SQLITE_ROW) {
+		current = sqlite3_column_int(header, 0);
+		applicationId = sqlite3_column_int(header, 1);
+	}
+	sqlite3_finalize(header);
+	if (current < 0) { lastError = "Cannot read the schema version"; return false; }
+	if (current >= latestSchemaVersion()) return resumeReplication(current, applicationId); // fast path: nothing to do
+	const int startVersion = current;
+
+	for (const Migration& m : schemaMigrations()) {
+		if (m.version <= current) continue;
+		auto started = std::chrono::steady_clock::now();
+		char* errMsg = nullptr;
+		// IMMEDIATE takes the write lock up front; re-read the version under it in case
+		// another process migrated while we were starting up.
+		if (sqlite3_exec(handle, "BEGIN IMMEDIATE;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+			lastError = errMsg ? errMsg : "Unknown SQL error";
+			sqlite3_free(errMsg);
+			return false;
+		}
+		current = schemaVersion();
+		if (current >= m.version) { sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, nullptr); continue; }
+
+		std::string sql = m.sql;
+		sql += "\nPRAGMA user_version = " + std::to_string(m.version) + ";";
+		if (sqlite3_exec(handle, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK ||
+			sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+			lastError = "Migration " + std::to_string(m.version) + " (" + m.name + ") failed: " + (errMsg ? errMsg : "Unknown SQL error");
+			sqlite3_free(errMsg);
+			sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+			return false;
+		}
+		current = m.version;
+		if (applied) {
+			std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+			applied->push_back(MigrationStep{m.version, m.name, took.count()});
+		}
+	}
+	// Existing records predate the sketches table
+	if (startVersion < kSketchSchemaVersion && current >= kSketchSchemaVersion && !rebuildSketches()) return false;
+	if (startVersion >= kReplicationSchemaVersion && startVersion < kBranchMarkerSchemaVersion &&
+		current >= kBranchMarkerSchemaVersion && !markLegacyBranch(applicationId)) return false;
+	// Partitions archived before the rollup and their fingerprint index existed
+	if (startVersion >= kArchiveSchemaVersion && startVersion < kArchiveRollupSchemaVersion &&
+		current >= kArchiveRollupSchemaVersion && !upgradeArchivePartitions(handle, lastError)) return false;
+	return resumeReplication(current, applicationId);
+#endif
+}
+
+bool Database::beginWrite() {
 #ifndef VSRM_HAS_SQLITE3
-	(void)schemaFilePath;
 	lastError = "SQLite not available.";
 	return false;
 #else
-	std::ifstream in(schemaFilePath);
-	if (!in) {
-		lastError = "Cannot open schema file: " + schemaFilePath;
+	char* errMsg = nullptr;
+	if (sqlite3_exec(handle, "BEGIN IMMEDIATE;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "BEGIN failed"; sqlite3_free(errMsg); return false;
+	}
+	return true;
+#endif
+}
+
+bool Database::commitWrite() {
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available.";
+	return false;
+#else
+	if (recorder && !recorder->stage(handle, lastError)) { rollbackWrite(); return false; }
+	char* errMsg = nullptr;
+	if (sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "COMMIT failed"; sqlite3_free(errMsg);
+		rollbackWrite();
 		return false;
 	}
-	std::ostringstream oss;
-	oss << in.rdbuf();
-	const std::string sql = oss.str();
+	return true;
+#endif
+}
 
+void Database::rollbackWrite() {
+#ifdef VSRM_HAS_SQLITE3
+	sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+	// The session keeps what it saw; start clean so nothing rolled back is staged later
+	std::string ignored;
+	if (recorder && recorder->attached()) recorder->attach(handle, ignored);
+#endif
+}
+
+bool Database::markLegacyBranch(int32_t& applicationId) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)applicationId;
+	return true;
+#else
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, "SELECT 1 FROM replication_state WHERE key = 'branch_number';", -1, &stmt, nullptr) != SQLITE_OK) {
+		lastError = sqlite3_errmsg(handle);
+		return false;
+	}
+	bool branch = sqlite3_step(stmt) == SQLITE_ROW;
+	sqlite3_finalize(stmt);
+	if (!branch) return true;
+	std::string sql = "PRAGMA application_id = " + std::to_string(kBranchApplicationId) + ";";
 	char* errMsg = nullptr;
-	int rc = sqlite3_exec(handle, sql.c_str(), nullptr, nullptr, &errMsg);
-	if (rc != SQLITE_OK) {
-		lastError = errMsg ? errMsg : "Unknown SQL error";
-		sqlite3_free(errMsg);
+	if (sqlite3_exec(handle, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "Cannot mark the branch"; sqlite3_free(errMsg); return false;
+	}
+	applicationId = kBranchApplicationId;
+	return true;
+#endif
+}
+
+bool Database::resumeReplication(int version, int32_t applicationId) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)version; (void)applicationId;
+	return true;
+#else
+	if (version < kReplicationSchemaVersion || recorder->attached()) return true;
+	// Since the marker version only branches carry the id; any other file has nothing to resume
+	if (version >= kBranchMarkerSchemaVersion && applicationId != kBranchApplicationId) return true;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, "SELECT value FROM replication_state WHERE key = 'branch_number';", -1, &stmt, nullptr) != SQLITE_OK) {
+		lastError = sqlite3_errmsg(handle);
+		return false;
+	}
+	std::string branch = sqlite3_step(stmt) == SQLITE_ROW ? reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) : "";
+	sqlite3_finalize(stmt);
+	if (branch.empty()) return true;
+	// A branch that cannot record would silently stop shipping its changes
+	if (!recorder->attach(handle, lastError)) {
+		lastError = "Branch " + branch + " cannot record changes: " + lastError;
 		return false;
 	}
 	return true;
 #endif
 }
 
+bool Database::enableReplication(int branchNumber, const std::string& branchName) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)branchNumber; (void)branchName; lastError = "SQLite not available."; return false;
+#else
+	if (!vsrm::enableReplication(handle, branchNumber, branchName, *recorder, lastError)) return false;
+	dropServiceColumns(); // ids moved
+	return true;
+#endif
+}
+
+bool Database::replicationStatus(ReplicationStatus& status) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)status; lastError = "SQLite not available."; return false;
+#else
+	return readReplicationStatus(handle, status, lastError);
+#endif
+}
+
+bool Database::exportChangesets(const std::string& path, std::optional<int64_t> fromSeq, ReplicationExport& out) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)path; (void)fromSeq; (void)out; lastError = "SQLite not available."; return false;
+#else
+	return vsrm::exportChangesets(handle, path, fromSeq, out, lastError);
+#endif
+}
+
+bool Database::applyChangesetFile(const std::string& path, ReplicationConflict policy, ReplicationApplyStats& stats) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)path; (void)policy; (void)stats; lastError = "SQLite not available."; return false;
+#else
+	if (!vsrm::applyChangesetFile(handle, path, policy, stats, lastError)) return false;
+	if (stats.deletes == 0) return true;
+	int64_t removed = 0, freed = 0;
+	if (pruneOrphanedAttachments(removed, freed)) return true;
+	lastError = "Changes applied, but removing attachments of deleted records failed: " + lastError;
+	return false;
+#endif
+}
+
+bool Database::pruneReplicationOutbox(int64_t& removed) {
+#ifndef VSRM_HAS_SQLITE3
+	removed = 0; lastError = "SQLite not available."; return false;
+#else
+	return vsrm::pruneReplicationOutbox(handle, removed, lastError);
+#endif
+}
+
 std::optional<int> Database::addServiceRecord(const ServiceRecord& record) {
 #ifndef VSRM_HAS_SQLITE3
 	(void)record;
 	lastError = "SQLite not available.";
 	return std::nullopt;
 #else
+	if (!validateVinForInsert(record.vin, lastError)) return std::nullopt;
+	// The month's sketches are updated in the same transaction as the insert
+	if (!beginWrite()) return std::nullopt;
 	const char* sql =
-		"INSERT INTO service_records (vin, customer_name, service_date, description, mechanic) "
-		"VALUES (?1, ?2, ?3, ?4, ?5);";
+		"INSERT INTO service_records (vin, customer_name, service_date, description, mechanic, fingerprint) "
+		"VALUES (?1, ?2, ?3, vsrm_pack(?4), ?5, ?6);";
 	sqlite3_stmt* stmt = nullptr;
 	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) {
 		lastError = sqlite3_errmsg(handle);
+		rollbackWrite();
 		return std::nullopt;
 	}
 	sqlite3_bind_text(stmt, 1, record.vin.c_str(), -1, SQLITE_TRANSIENT);
@@ -100,45 +366,90 @@ std::optional<int> Database::addServiceRecord(const ServiceRecord& record) {
 	sqlite3_bind_text(stmt, 3, record.serviceDate.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(stmt, 4, record.description.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(stmt, 5, record.mechanic.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(serviceFingerprint(record.vin, record.serviceDate, record.description, record.mechanic)));
 
 	if (sqlite3_step(stmt) != SQLITE_DONE) {
 		lastError = sqlite3_errmsg(handle);
 		sqlite3_finalize(stmt);
+		rollbackWrite();
 		return std::nullopt;
 	}
 	int id = static_cast<int>(sqlite3_last_insert_rowid(handle));
 	sqlite3_finalize(stmt);
+
+	SketchWriter sketches;
+	if (!sketches.add(handle, record.serviceDate, record.customerName, record.vin, record.mechanic, record.description, lastError) ||
+		!sketches.flush(handle, lastError)) {
+		rollbackWrite();
+		return std::nullopt;
+	}
+	if (!commitWrite()) return std::nullopt;
 	return id;
 #endif
 }
 
-std::vector<ServiceRecord> Database::listServiceRecordsByVin(const std::string& vin) {
-	std::vector<ServiceRecord> result;
+bool Database::addServiceRecordsBatch(const std::vector<ServiceRecord>& batch, std::vector<std::optional<int>>& ids,
+	std::vector<std::string>& errors) {
+	ids.assign(batch.size(), std::nullopt);
+	errors.assign(batch.size(), std::string());
 #ifndef VSRM_HAS_SQLITE3
-	(void)vin;
 	lastError = "SQLite not available.";
-	return result;
+	return false;
 #else
+	if (batch.empty()) return true;
+	if (!beginWrite()) return false;
 	const char* sql =
-		"SELECT id, vin, customer_name, service_date, description, mechanic "
-		"FROM service_records WHERE vin = ?1 ORDER BY service_date DESC, id DESC;";
+		"INSERT INTO service_records (vin, customer_name, service_date, description, mechanic, fingerprint) "
+		"VALUES (?1, ?2, ?3, vsrm_pack(?4), ?5, ?6);";
 	sqlite3_stmt* stmt = nullptr;
 	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) {
 		lastError = sqlite3_errmsg(handle);
-		return result;
+		rollbackWrite();
+		return false;
 	}
-	sqlite3_bind_text(stmt, 1, vin.c_str(), -1, SQLITE_TRANSIENT);
-	while (sqlite3_step(stmt) == SQLITE_ROW) {
-		ServiceRecord r{};
-		r.id = sqlite3_column_int(stmt, 0);
-		r.vin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-		r.customerName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-		r.serviceDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-		r.description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-		r.mechanic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-		result.push_back(std::move(r));
+	SketchWriter sketches;
+	for (size_t i = 0; i < batch.size(); ++i) {
+		const ServiceRecord& record = batch[i];
+		if (!validateVinForInsert(record.vin, errors[i])) continue;
+		sqlite3_exec(handle, "SAVEPOINT batch_row;", nullptr, nullptr, nullptr);
+		sqlite3_bind_text(stmt, 1, record.vin.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 2, record.customerName.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 3, record.serviceDate.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 4, record.description.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(stmt, 5, record.mechanic.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(serviceFingerprint(record.vin, record.serviceDate, record.description, record.mechanic)));
+		bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+		if (!ok) errors[i] = sqlite3_errmsg(handle);
+		sqlite3_reset(stmt);
+		if (ok) {
+			ids[i] = static_cast<int>(sqlite3_last_insert_rowid(handle));
+			ok = sketches.add(handle, record.serviceDate, record.customerName, record.vin, record.mechanic, record.description, errors[i]);
+			if (!ok) ids[i].reset();
+		}
+		if (!ok) sqlite3_exec(handle, "ROLLBACK TO batch_row;", nullptr, nullptr, nullptr);
+		sqlite3_exec(handle, "RELEASE batch_row;", nullptr, nullptr, nullptr);
 	}
 	sqlite3_finalize(stmt);
+	bool flushed = sketches.flush(handle, lastError);
+	if (!flushed) rollbackWrite();
+	if (!flushed || !commitWrite()) {
+		ids.assign(batch.size(), std::nullopt);
+		return false;
+	}
+	return true;
+#endif
+}
+
+std::vector<ServiceRecord> Database::listServiceRecordsByVin(const std::string& vin) {
+	std::vector<ServiceRecord> result;
+#ifndef VSRM_HAS_SQLITE3
+	(void)vin;
+	lastError = "SQLite not available.";
+	return result;
+#else
+	// Oldest first across the partitions, then flipped to newest first
+	forEachServiceRecord(vin, [&](const ServiceRecord& r) { result.push_back(r); return true; });
+	std::reverse(result.begin(), result.end());
 	return result;
 #endif
 }
@@ -146,16 +457,34 @@ bool Database::updateServiceRecord(const ServiceRecord& record) {
 #ifndef VSRM_HAS_SQLITE3
     (void)record; lastError = "SQLite not available."; return false;
 #else
-    const char* sql = "UPDATE service_records SET vin = ?1, customer_name = ?2, service_date = ?3, description = ?4, mechanic = ?5 WHERE id = ?6;";
-    sqlite3_stmt* stmt = nullptr; if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
+    if (!validateVinForInsert(record.vin, lastError)) return false;
+    const char* sql = "UPDATE service_records SET vin = ?1, customer_name = ?2, service_date = ?3, description = vsrm_pack(?4), mechanic = ?5, fingerprint = ?7 WHERE id = ?6;";
+    if (!beginWrite()) return false;
+    sqlite3_stmt* stmt = nullptr; if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); rollbackWrite(); return false; }
     sqlite3_bind_text(stmt, 1, record.vin.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 2, record.customerName.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 3, record.serviceDate.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 4, record.description.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 5, record.mechanic.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_int(stmt, 6, record.id);
+    sqlite3_bind_int64(stmt, 7, static_cast<sqlite3_int64>(serviceFingerprint(record.vin, record.serviceDate, record.description, record.mechanic)));
     bool ok = sqlite3_step(stmt) == SQLITE_DONE; if (!ok) lastError = sqlite3_errmsg(handle);
-    sqlite3_finalize(stmt); return ok;
+    sqlite3_finalize(stmt);
+    if (!ok) { rollbackWrite(); return false; }
+    if (sqlite3_changes(handle) > 0) return commitWrite();
+    rollbackWrite();
+
+    // Not in main: the record may be archived (listServiceRecordsByVin returns those too). The
+    // partition is local housekeeping, so like the archive run itself the edit is not shipped.
+    ArchivedRecordEdit edit{record.vin, record.customerName, record.serviceDate, record.description, record.mechanic,
+        serviceFingerprint(record.vin, record.serviceDate, record.description, record.mechanic)};
+    bool found = false;
+    if (!updateArchivedRecord(handle, record.id, edit, found, lastError)) return false;
+    if (!found) { lastError = "No service record with id " + std::to_string(record.id); return false; }
+    // Neither cache sees partition writes through the change feed
+    dropServiceColumns();
+    summaryCache->invalidateAll();
+    return true;
 #endif
 }
 
@@ -167,14 +496,16 @@ std::optional<int> Database::addMechanic(const Mechanic& mech) {
 	return std::nullopt;
 #else
 	const char* sql = "INSERT INTO mechanics (name, skill, active) VALUES (?1, ?2, ?3);";
+	if (!beginWrite()) return std::nullopt;
 	sqlite3_stmt* stmt = nullptr;
-	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return std::nullopt; }
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); rollbackWrite(); return std::nullopt; }
 	sqlite3_bind_text(stmt, 1, mech.name.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(stmt, 2, mech.skill.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_int(stmt, 3, mech.active ? 1 : 0);
-	if (sqlite3_step(stmt) != SQLITE_DONE) { lastError = sqlite3_errmsg(handle); sqlite3_finalize(stmt); return std::nullopt; }
+	if (sqlite3_step(stmt) != SQLITE_DONE) { lastError = sqlite3_errmsg(handle); sqlite3_finalize(stmt); rollbackWrite(); return std::nullopt; }
 	int id = (int)sqlite3_last_insert_rowid(handle);
 	sqlite3_finalize(stmt);
+	if (!commitWrite()) return std::nullopt;
 	return id;
 #endif
 }
@@ -208,8 +539,9 @@ bool Database::updateMechanic(const Mechanic& mech) {
 	(void)mech; lastError = "SQLite not available."; return false;
 #else
 	const char* sql = "UPDATE mechanics SET name = ?1, skill = ?2, active = ?3 WHERE id = ?4;";
+	if (!beginWrite()) return false;
 	sqlite3_stmt* stmt = nullptr;
-	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); rollbackWrite(); return false; }
 	sqlite3_bind_text(stmt, 1, mech.name.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(stmt, 2, mech.skill.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_int(stmt, 3, mech.active ? 1 : 0);
@@ -217,7 +549,8 @@ bool Database::updateMechanic(const Mechanic& mech) {
 	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
 	if (!ok) lastError = sqlite3_errmsg(handle);
 	sqlite3_finalize(stmt);
-	return ok;
+	if (!ok) { rollbackWrite(); return false; }
+	return commitWrite();
 #endif
 }
 
@@ -226,32 +559,65 @@ bool Database::deleteMechanic(int mechanicId) {
 	(void)mechanicId; lastError = "SQLite not available."; return false;
 #else
 	const char* sql = "DELETE FROM mechanics WHERE id = ?1;";
+	if (!beginWrite()) return false;
 	sqlite3_stmt* stmt = nullptr;
-	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); rollbackWrite(); return false; }
 	sqlite3_bind_int(stmt, 1, mechanicId);
 	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
 	if (!ok) lastError = sqlite3_errmsg(handle);
 	sqlite3_finalize(stmt);
-	return ok;
+	if (!ok) { rollbackWrite(); return false; }
+	return commitWrite();
 #endif
 }
 
+#ifdef VSRM_HAS_SQLITE3
+// Columns: id, vin, customer_name, scheduled_at, status, required_skill, duration_min
+static Appointment readAppointment(sqlite3_stmt* stmt) {
+	Appointment a{};
+	a.id = sqlite3_column_int(stmt, 0);
+	a.vin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+	a.customerName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+	a.scheduledAt = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+	a.status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+	if (sqlite3_column_type(stmt, 5) != SQLITE_NULL) a.requiredSkill = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5)));
+	a.durationMin = sqlite3_column_int(stmt, 6);
+	return a;
+}
+#endif
+
 std::optional<int> Database::addAppointment(const Appointment& appt) {
 #ifndef VSRM_HAS_SQLITE3
 	(void)appt;
 	lastError = "SQLite not available.";
 	return std::nullopt;
 #else
-	const char* sql = "INSERT INTO appointments (vin, customer_name, scheduled_at, status) VALUES (?1, ?2, ?3, ?4);";
+	if (!validateVinForInsert(appt.vin, lastError)) return std::nullopt;
+	const char* sql = "INSERT INTO appointments (vin, customer_name, scheduled_at, status, required_skill, duration_min) VALUES (?1, ?2, ?3, ?4, ?5, ?6);";
+	uint64_t before = changeSequence();
+	if (!beginWrite()) return std::nullopt;
 	sqlite3_stmt* stmt = nullptr;
-	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return std::nullopt; }
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); rollbackWrite(); return std::nullopt; }
 	sqlite3_bind_text(stmt, 1, appt.vin.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(stmt, 2, appt.customerName.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(stmt, 3, appt.scheduledAt.c_str(), -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(stmt, 4, appt.status.c_str(), -1, SQLITE_TRANSIENT);
-	if (sqlite3_step(stmt) != SQLITE_DONE) { lastError = sqlite3_errmsg(handle); sqlite3_finalize(stmt); return std::nullopt; }
+	if (appt.requiredSkill && !appt.requiredSkill->empty())
+		sqlite3_bind_text(stmt, 5, appt.requiredSkill->c_str(), -1, SQLITE_TRANSIENT);
+	else
+		sqlite3_bind_null(stmt, 5);
+	sqlite3_bind_int(stmt, 6, appt.durationMin);
+	if (sqlite3_step(stmt) != SQLITE_DONE) { lastError = sqlite3_errmsg(handle); sqlite3_finalize(stmt); rollbackWrite(); return std::nullopt; }
 	int id = (int)sqlite3_last_insert_rowid(handle);
 	sqlite3_finalize(stmt);
+	if (!commitWrite()) return std::nullopt;
+	// Keep the booking index current without a rebuild, unless it had already missed something
+	if (bookingIndex->built && bookingIndex->changeSequence == before) {
+		auto start = isoToMinutes(appt.scheduledAt);
+		if (start && (appt.status == "scheduled" || appt.status == "in_progress"))
+			bookingIndex->addAppointment(id, appt.vin, *start, *start + appt.durationMin);
+		bookingIndex->changeSequence = changeSequence();
+	}
 	return id;
 #endif
 }
@@ -261,31 +627,76 @@ std::vector<Appointment> Database::listAppointmentsByVin(const std::string& vin)
 #ifndef VSRM_HAS_SQLITE3
 	(void)vin; lastError = "SQLite not available."; return result;
 #else
-	const char* sql = "SELECT id, vin, customer_name, scheduled_at, status FROM appointments WHERE vin = ?1 ORDER BY scheduled_at DESC, id DESC;";
+	const char* sql = "SELECT id, vin, customer_name, scheduled_at, status, required_skill, duration_min FROM appointments WHERE vin = ?1 ORDER BY scheduled_at DESC, id DESC;";
 	sqlite3_stmt* stmt = nullptr;
 	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return result; }
 	sqlite3_bind_text(stmt, 1, vin.c_str(), -1, SQLITE_TRANSIENT);
+	while (sqlite3_step(stmt) == SQLITE_ROW) result.push_back(readAppointment(stmt));
+	sqlite3_finalize(stmt);
+	return result;
+#endif
+}
+
+std::vector<CalendarEntry> Database::listAppointmentsInRange(const std::string& from, const std::string& to, unsigned statusMask) {
+	std::vector<CalendarEntry> result;
+#ifndef VSRM_HAS_SQLITE3
+	(void)from; (void)to; (void)statusMask; lastError = "SQLite not available."; return result;
+#else
+	const char* sql =
+		"SELECT a.id, a.vin, a.customer_name, a.scheduled_at, a.status, a.required_skill, a.duration_min, m.id, m.name "
+		"FROM appointments a "
+		"LEFT JOIN assignments s ON s.id = (SELECT MAX(id) FROM assignments WHERE appointment_id = a.id) "
+		"LEFT JOIN mechanics m ON m.id = s.mechanic_id "
+		"WHERE a.scheduled_at >= ?1 AND a.scheduled_at < ?2 "
+		"AND (?3 & CASE a.status WHEN 'scheduled' THEN 1 WHEN 'in_progress' THEN 2 WHEN 'done' THEN 4 WHEN 'cancelled' THEN 8 ELSE 0 END) != 0 "
+		"ORDER BY a.scheduled_at, a.id;";
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return result; }
+	sqlite3_bind_text(stmt, 1, from.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(stmt, 2, to.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int(stmt, 3, static_cast<int>(statusMask));
 	while (sqlite3_step(stmt) == SQLITE_ROW) {
-		Appointment a{};
-		a.id = sqlite3_column_int(stmt, 0);
-		a.vin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-		a.customerName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-		a.scheduledAt = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-		a.status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-		result.push_back(std::move(a));
+		CalendarEntry e{};
+		e.appointment = readAppointment(stmt);
+		if (sqlite3_column_type(stmt, 7) != SQLITE_NULL) {
+			e.mechanicId = sqlite3_column_int(stmt, 7);
+			e.mechanicName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
+		}
+		result.push_back(std::move(e));
 	}
 	sqlite3_finalize(stmt);
 	return result;
 #endif
 }
 
+std::vector<Appointment> Database::listUnassignedAppointments(const std::optional<std::string>& day) {
+	std::vector<Appointment> result;
+#ifndef VSRM_HAS_SQLITE3
+	(void)day; lastError = "SQLite not available."; return result;
+#else
+	const char* sql =
+		"SELECT id, vin, customer_name, scheduled_at, status, required_skill, duration_min FROM appointments a "
+		"WHERE status = 'scheduled' AND (?1 IS NULL OR substr(scheduled_at, 1, 10) = ?1) "
+		"AND NOT EXISTS (SELECT 1 FROM assignments s WHERE s.appointment_id = a.id) "
+		"ORDER BY scheduled_at, id;";
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return result; }
+	if (day) sqlite3_bind_text(stmt, 1, day->c_str(), -1, SQLITE_TRANSIENT); else sqlite3_bind_null(stmt, 1);
+	while (sqlite3_step(stmt) == SQLITE_ROW) result.push_back(readAppointment(stmt));
+	sqlite3_finalize(stmt);
+	return result;
+#endif
+}
+
 std::optional<int> Database::addAssignment(const Assignment& asg) {
 #ifndef VSRM_HAS_SQLITE3
 	(void)asg; lastError = "SQLite not available."; return std::nullopt;
 #else
 	const char* sql = "INSERT INTO assignments (appointment_id, mechanic_id, assigned_at, completed_at) VALUES (?1, ?2, ?3, ?4);";
+	uint64_t before = changeSequence();
+	if (!beginWrite()) return std::nullopt;
 	sqlite3_stmt* stmt = nullptr;
-	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return std::nullopt; }
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); rollbackWrite(); return std::nullopt; }
 	sqlite3_bind_int(stmt, 1, asg.appointmentId);
 	sqlite3_bind_int(stmt, 2, asg.mechanicId);
 	sqlite3_bind_text(stmt, 3, asg.assignedAt.c_str(), -1, SQLITE_TRANSIENT);
@@ -293,9 +704,16 @@ std::optional<int> Database::addAssignment(const Assignment& asg) {
 		sqlite3_bind_text(stmt, 4, asg.completedAt->c_str(), -1, SQLITE_TRANSIENT);
 	else
 		sqlite3_bind_null(stmt, 4);
-	if (sqlite3_step(stmt) != SQLITE_DONE) { lastError = sqlite3_errmsg(handle); sqlite3_finalize(stmt); return std::nullopt; }
+	if (sqlite3_step(stmt) != SQLITE_DONE) { lastError = sqlite3_errmsg(handle); sqlite3_finalize(stmt); rollbackWrite(); return std::nullopt; }
 	int id = (int)sqlite3_last_insert_rowid(handle);
 	sqlite3_finalize(stmt);
+	if (!commitWrite()) return std::nullopt;
+	if (bookingIndex->built && bookingIndex->changeSequence == before) {
+		// The new row is the appointment's latest assignment
+		if (asg.completedAt) bookingIndex->unassign(asg.appointmentId);
+		else bookingIndex->assign(asg.appointmentId, asg.mechanicId);
+		bookingIndex->changeSequence = changeSequence();
+	}
 	return id;
 #endif
 }
@@ -323,12 +741,318 @@ std::vector<Assignment> Database::listAssignmentsByMechanic(int mechanicId) {
 #endif
 }
 
-} // namespace vsrm
+bool Database::listAssignmentDetails(const AssignmentDetailQuery& query, AssignmentDetailBatch& out) {
+	out.clear();
+#ifndef VSRM_HAS_SQLITE3
+	(void)query; lastError = "SQLite not available."; return false;
+#else
+	std::string sql =
+		"SELECT s.id, s.appointment_id, s.mechanic_id, a.duration_min, s.assigned_at, s.completed_at,\n"
+		"       a.scheduled_at, a.status, a.vin, a.customer_name, m.name, m.skill\n"
+		"FROM assignments s\n"
+		"JOIN appointments a ON a.id = s.appointment_id\n"
+		"JOIN mechanics m ON m.id = s.mechanic_id\n";
+	// The mechanic set travels as one JSON array parameter, so any number of ids is still one statement
+	std::string ids;
+	std::vector<std::string> where;
+	if (query.mechanicIds.size() == 1) where.push_back("s.mechanic_id = ?1");
+	else if (!query.mechanicIds.empty()) where.push_back("s.mechanic_id IN (SELECT value FROM json_each(?1))");
+	if (query.fromDate.has_value()) where.push_back("a.scheduled_at >= ?2");
+	if (query.toDate.has_value()) where.push_back("a.scheduled_at < ?3");
+	if (query.openOnly) where.push_back("s.completed_at IS NULL");
+	for (size_t i = 0; i < where.size(); ++i) {
+		sql += i ? " AND " : "WHERE ";
+		sql += where[i];
+	}
+	sql += " ORDER BY a.scheduled_at, s.id";
+
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
+	if (query.mechanicIds.size() == 1) {
+		sqlite3_bind_int(stmt, 1, query.mechanicIds.front());
+	} else if (!query.mechanicIds.empty()) {
+		ids = "[";
+		for (size_t i = 0; i < query.mechanicIds.size(); ++i) {
+			if (i) ids += ',';
+			ids += std::to_string(query.mechanicIds[i]);
+		}
+		ids += ']';
+		sqlite3_bind_text(stmt, 1, ids.c_str(), -1, SQLITE_STATIC);
+	}
+	if (query.fromDate.has_value()) sqlite3_bind_text(stmt, 2, query.fromDate->c_str(), -1, SQLITE_TRANSIENT);
+	if (query.toDate.has_value()) sqlite3_bind_text(stmt, 3, query.toDate->c_str(), -1, SQLITE_TRANSIENT);
+
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		const char* text[AssignmentDetailBatch::kTextColumns];
+		for (int c = 0; c < AssignmentDetailBatch::kTextColumns; ++c)
+			text[c] = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4 + c));
+		out.addRow(sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1), sqlite3_column_int(stmt, 2), sqlite3_column_int(stmt, 3), text);
+	}
+	if (rc != SQLITE_DONE) { lastError = sqlite3_errmsg(handle); sqlite3_finalize(stmt); out.clear(); return false; }
+	sqlite3_finalize(stmt);
+	return true;
+#endif
+}
+
+bool Database::vehicleTimeline(const std::string& vin, size_t limit, const std::optional<std::string>& cursor, TimelinePage& page) {
+	return readTimeline(handle, {vin}, limit, cursor, page, lastError);
+}
+
+bool Database::customerTimeline(const std::string& customerName, size_t limit, const std::optional<std::string>& cursor, TimelinePage& page) {
+	return readTimeline(handle, listCustomerVins(customerName), limit, cursor, page, lastError);
+}
+
+std::vector<std::string> Database::listCustomerVins(const std::string& customerName) {
+	std::vector<std::string> result;
+#ifndef VSRM_HAS_SQLITE3
+	(void)customerName; lastError = "SQLite not available."; return result;
+#else
+	const char* sql =
+		"SELECT vin FROM service_records WHERE customer_name = ?1 "
+		"UNION SELECT vin FROM archive_rollup WHERE customer_name = ?1 "
+		"UNION SELECT vin FROM appointments WHERE customer_name = ?1 ORDER BY 1;";
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return result; }
+	sqlite3_bind_text(stmt, 1, customerName.c_str(), -1, SQLITE_TRANSIENT);
+	while (sqlite3_step(stmt) == SQLITE_ROW) result.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+	sqlite3_finalize(stmt);
+	return result;
+#endif
+}
+
+bool Database::addAssignmentsBatch(const std::vector<Assignment>& batch) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)batch; lastError = "SQLite not available."; return false;
+#else
+	if (batch.empty()) return true;
+	uint64_t before = changeSequence();
+	if (!beginWrite()) return false;
+	const char* sql = "INSERT INTO assignments (appointment_id, mechanic_id, assigned_at, completed_at) VALUES (?1, ?2, ?3, ?4);";
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+		lastError = sqlite3_errmsg(handle); rollbackWrite(); return false;
+	}
+	for (const auto& asg : batch) {
+		sqlite3_bind_int(stmt, 1, asg.appointmentId);
+		sqlite3_bind_int(stmt, 2, asg.mechanicId);
+		sqlite3_bind_text(stmt, 3, asg.assignedAt.c_str(), -1, SQLITE_TRANSIENT);
+		if (asg.completedAt.has_value())
+			sqlite3_bind_text(stmt, 4, asg.completedAt->c_str(), -1, SQLITE_TRANSIENT);
+		else
+			sqlite3_bind_null(stmt, 4);
+		if (sqlite3_step(stmt) != SQLITE_DONE) {
+			lastError = sqlite3_errmsg(handle);
+			sqlite3_finalize(stmt);
+			rollbackWrite();
+			return false;
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+	if (!commitWrite()) return false;
+	if (bookingIndex->built && bookingIndex->changeSequence == before) {
+		for (const auto& asg : batch) {
+			if (asg.completedAt) bookingIndex->unassign(asg.appointmentId);
+			else bookingIndex->assign(asg.appointmentId, asg.mechanicId);
+		}
+		bookingIndex->changeSequence = changeSequence();
+	}
+	return true;
+#endif
+}
+
+std::vector<MechanicDayLoad> Database::listOpenAssignmentLoad() {
+	std::vector<MechanicDayLoad> result;
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return result;
+#else
+	const char* sql =
+		"SELECT s.mechanic_id, substr(a.scheduled_at, 1, 10), COUNT(*) FROM assignments s "
+		"JOIN appointments a ON a.id = s.appointment_id "
+		"WHERE s.completed_at IS NULL GROUP BY 1, 2;";
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return result; }
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		MechanicDayLoad l{};
+		l.mechanicId = sqlite3_column_int(stmt, 0);
+		l.day = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+		l.jobs = sqlite3_column_int(stmt, 2);
+		result.push_back(std::move(l));
+	}
+	sqlite3_finalize(stmt);
+	return result;
+#endif
+}
+
+bool Database::recomputeServiceDue(const ServiceDueRules& rules, int threads, ServiceDueStats* stats) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)rules; (void)threads; (void)stats; lastError = "SQLite not available."; return false;
+#else
+	const char* path = handle ? sqlite3_db_filename(handle, "main") : nullptr;
+	if (!path || !*path) { lastError = "Service due prediction needs a file database"; return false; }
+	std::vector<ServiceDuePrediction> predictions;
+	ServiceDueStats local;
+	if (!scanServiceDue(path, rules, threads, predictions, local, lastError)) return false;
+
+	auto started = std::chrono::steady_clock::now();
+	char* errMsg = nullptr;
+	// Full rewrite: empty the table and build the due_date index once at the end from sorted input,
+	// rather than maintaining it row by row
+	if (sqlite3_exec(handle, "BEGIN IMMEDIATE; DROP INDEX IF EXISTS idx_service_due_date; DELETE FROM service_due;",
+		nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "BEGIN failed"; sqlite3_free(errMsg);
+		sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+		return false;
+	}
+	const char* sql = "INSERT INTO service_due (vin, last_service, due_date, visits, basis) VALUES (?1, ?2, ?3, ?4, ?5);";
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+		lastError = sqlite3_errmsg(handle); sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr); return false;
+	}
+	for (const auto& p : predictions) { // VIN order, so the WITHOUT ROWID b-tree only appends
+		sqlite3_bind_text(stmt, 1, p.vin.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 2, p.lastService.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 3, p.dueDate.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_int(stmt, 4, p.visits);
+		sqlite3_bind_text(stmt, 5, dueBasisName(p.basis), -1, SQLITE_STATIC);
+		if (sqlite3_step(stmt) != SQLITE_DONE) {
+			lastError = sqlite3_errmsg(handle);
+			sqlite3_finalize(stmt);
+			sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+			return false;
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+	if (sqlite3_exec(handle, "CREATE INDEX idx_service_due_date ON service_due (due_date); COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "COMMIT failed"; sqlite3_free(errMsg);
+		sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+		return false;
+	}
+	// service_due is WITHOUT ROWID, so the update hook (and with it the change feed) never sees
+	// this rewrite; drop the cached summaries here instead
+	summaryCache->invalidateAll();
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	local.writeMilliseconds = took.count();
+	if (stats) *stats = local;
+	return true;
+#endif
+}
 
-#include <iomanip>
-#include <random>
-#include <windows.h>
-#include <bcrypt.h>
+bool Database::syncBookingIndex() {
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return false;
+#else
+	auto dv = dataVersion();
+	bool stale = !bookingIndex->built || !dv || *dv != bookingIndex->dataVersion;
+	std::vector<CommitChanges> commits;
+	stale |= !changesSince(bookingIndex->changeSequence, commits);
+	for (const auto& c : commits) stale |= c.touches("appointments") || c.touches("assignments");
+	uint64_t seq = changeSequence();
+	if (!stale) { bookingIndex->changeSequence = seq; return true; }
+
+	bookingIndex->clear();
+	const char* sql =
+		"SELECT a.id, a.vin, a.scheduled_at, a.duration_min, s.mechanic_id FROM appointments a "
+		// Only the latest assignment books a mechanic (as in listAppointmentsInRange); a reassigned
+		// appointment's earlier rows stay uncompleted but no longer hold the old mechanic's time
+		"LEFT JOIN assignments s ON s.id = (SELECT MAX(id) FROM assignments WHERE appointment_id = a.id) "
+		"AND s.completed_at IS NULL "
+		"WHERE a.status IN ('scheduled', 'in_progress');";
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		auto start = isoToMinutes(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+		if (!start) continue; // unparseable times cannot conflict with anything
+		int id = sqlite3_column_int(stmt, 0);
+		bookingIndex->addAppointment(id, reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), *start, *start + sqlite3_column_int(stmt, 3));
+		if (sqlite3_column_type(stmt, 4) != SQLITE_NULL) bookingIndex->assign(id, sqlite3_column_int(stmt, 4));
+	}
+	sqlite3_finalize(stmt);
+	bookingIndex->built = true;
+	bookingIndex->dataVersion = dv.value_or(-1);
+	bookingIndex->changeSequence = seq;
+	return true;
+#endif
+}
+
+bool Database::rebuildSketches() {
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return false;
+#else
+	char* errMsg = nullptr;
+	if (sqlite3_exec(handle, "BEGIN IMMEDIATE;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "BEGIN failed"; sqlite3_free(errMsg); return false;
+	}
+	if (!vsrm::rebuildSketches(handle, lastError)) {
+		sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+		return false;
+	}
+	if (sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "COMMIT failed"; sqlite3_free(errMsg);
+		sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+		return false;
+	}
+	return true;
+#endif
+}
+
+bool Database::sketchSummary(const std::string& fromMonth, const std::string& toMonth, SketchSummary& out, size_t topN) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)fromMonth; (void)toMonth; (void)topN; out = SketchSummary{}; lastError = "SQLite not available."; return false;
+#else
+	return readSketchSummary(handle, fromMonth, toMonth, topN, out, lastError);
+#endif
+}
+
+const ServiceColumns* Database::serviceColumns() {
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return nullptr;
+#else
+	if (!columns) columns = std::make_unique<ServiceColumns>();
+	auto dv = dataVersion();
+	bool stale = !columns->built || !dv || *dv != columns->dataVersion;
+	std::vector<CommitChanges> commits;
+	stale |= !changesSince(columns->changeSequence, commits);
+	std::vector<RowChange> rows;
+	for (const auto& c : commits) {
+		if (!c.touches("service_records")) continue;
+		if (c.truncated) { stale = true; break; }
+		for (const auto& r : c.rows) if (r.table == "service_records") rows.push_back(r);
+	}
+	uint64_t seq = changeSequence();
+	std::string err;
+	if (!(stale ? columns->load(handle, err) : columns->apply(handle, rows, err))) {
+		lastError = err;
+		columns.reset();
+		return nullptr;
+	}
+	columns->built = true;
+	columns->dataVersion = dv.value_or(-1);
+	columns->changeSequence = seq;
+	return columns.get();
+#endif
+}
+
+void Database::dropServiceColumns() { columns.reset(); }
+
+std::vector<BookingConflict> Database::findBookingConflicts(const std::string& startsAt, int durationMin,
+	std::optional<int> mechanicId, const std::optional<std::string>& vin, std::optional<int> ignoreAppointmentId) {
+	auto start = isoToMinutes(startsAt);
+	if (!start) { lastError = "Invalid date/time: " + startsAt; return {}; }
+	if (!syncBookingIndex()) return {};
+	return bookingIndex->conflicts(*start, *start + std::max(durationMin, 1), mechanicId, vin, ignoreAppointmentId);
+}
+
+std::vector<TimeSlot> Database::findFreeSlots(int mechanicId, const std::string& from, const std::string& to, int minMinutes) {
+	auto lo = isoToMinutes(from), hi = isoToMinutes(to);
+	if (!lo || !hi) { lastError = "Invalid date/time range"; return {}; }
+	if (!syncBookingIndex()) return {};
+	return bookingIndex->freeSlots(mechanicId, *lo, *hi, minMinutes);
+}
+
+} // namespace vsrm
 
 namespace vsrm {
 
@@ -346,52 +1070,281 @@ static std::string escapeCsv(const std::string& in) {
 	return out;
 }
 
+static void writeCsvRow(std::ofstream& out, const ServiceRecord& r) {
+	out << r.id << ',' << escapeCsv(r.vin) << ',' << escapeCsv(r.customerName) << ',' << escapeCsv(r.serviceDate) << ','
+		<< escapeCsv(r.description) << ',' << escapeCsv(r.mechanic) << "\n";
+}
+
 bool Database::exportServiceHistoryCsv(const std::string& vin, const std::string& outputFilePath) {
 #ifndef VSRM_HAS_SQLITE3
 	(void)vin; (void)outputFilePath; lastError = "SQLite not available."; return false;
 #else
-	std::ofstream out(outputFilePath, std::ios::binary);
+	std::ofstream out(pathFromUtf8(outputFilePath), std::ios::binary);
 	if (!out) { lastError = "Failed to open output file"; return false; }
 	out << "id,vin,customer_name,service_date,description,mechanic\n";
-	const char* sql = "SELECT id, vin, customer_name, service_date, description, mechanic FROM service_records WHERE vin = ?1 ORDER BY service_date, id;";
-	sqlite3_stmt* stmt = nullptr;
-	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
-	sqlite3_bind_text(stmt, 1, vin.c_str(), -1, SQLITE_TRANSIENT);
-	while (sqlite3_step(stmt) == SQLITE_ROW) {
-		std::string id = std::to_string(sqlite3_column_int(stmt, 0));
-		std::string cvin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-		std::string cust = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-		std::string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-		std::string desc = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-		std::string mech = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-		out << id << ',' << escapeCsv(cvin) << ',' << escapeCsv(cust) << ',' << escapeCsv(date) << ',' << escapeCsv(desc) << ',' << escapeCsv(mech) << "\n";
-	}
-	sqlite3_finalize(stmt);
-	return true;
+	return forEachServiceRecord(vin, [&](const ServiceRecord& r) { writeCsvRow(out, r); return true; });
 #endif
 }
 bool Database::exportAllServiceRecordsCsv(const std::string& outputFilePath) {
 #ifndef VSRM_HAS_SQLITE3
     (void)outputFilePath; lastError = "SQLite not available."; return false;
 #else
-    std::ofstream out(outputFilePath, std::ios::binary);
+    std::ofstream out(pathFromUtf8(outputFilePath), std::ios::binary);
     if (!out) { lastError = "Failed to open output file"; return false; }
     out << "id,vin,customer_name,service_date,description,mechanic\n";
-    const char* sql = "SELECT id, vin, customer_name, service_date, description, mechanic FROM service_records ORDER BY service_date, id;";
-    sqlite3_stmt* stmt = nullptr; if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        std::string id = std::to_string(sqlite3_column_int(stmt, 0));
-        std::string cvin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        std::string cust = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        std::string date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        std::string desc = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        std::string mech = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        out << id << ',' << escapeCsv(cvin) << ',' << escapeCsv(cust) << ',' << escapeCsv(date) << ',' << escapeCsv(desc) << ',' << escapeCsv(mech) << "\n";
-    }
-    sqlite3_finalize(stmt); return true;
+    // An empty VIN selects every record
+    return forEachServiceRecord("", [&](const ServiceRecord& r) { writeCsvRow(out, r); return true; });
+#endif
+}
+
+bool Database::forEachServiceRecord(const std::string& vin, const std::function<bool(const ServiceRecord&)>& visit) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)vin; (void)visit; lastError = "SQLite not available."; return false;
+#else
+	// Main and the archive partitions, segment by segment (see Archive.h)
+	ServiceRecord r;
+	return scanServiceRecords(handle, vin, [&](sqlite3_stmt* stmt) {
+		r.id = sqlite3_column_int(stmt, 0);
+		r.vin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+		r.customerName = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+		r.serviceDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+		r.description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+		r.mechanic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+		return visit(r);
+	}, lastError);
+#endif
+}
+
+bool Database::archiveServiceRecords(const std::string& cutoff, ArchiveStats& stats) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)cutoff; stats = {}; lastError = "SQLite not available."; return false;
+#else
+	// Moving rows out is local housekeeping: head office keeps them, so the session must not see the deletes
+	const bool recording = recorder->attached();
+	recorder->detach();
+	bool ok = vsrm::archiveServiceRecords(handle, cutoff, stats, lastError);
+	std::string error;
+	if (recording && !recorder->attach(handle, error)) {
+		lastError = "Archived, but the branch cannot record changes: " + error;
+		ok = false;
+	}
+	dropServiceColumns();
+	return ok;
+#endif
+}
+
+bool Database::listArchivePartitions(std::vector<ArchivePartition>& out) {
+#ifndef VSRM_HAS_SQLITE3
+	out.clear(); lastError = "SQLite not available."; return false;
+#else
+	return vsrm::listArchivePartitions(handle, out, lastError);
+#endif
+}
+
+bool Database::trainDescriptionDictionary(const DictionaryTrainOptions& options, DictionaryTrainStats& stats) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)options; stats = {}; lastError = "SQLite not available."; return false;
+#else
+	// Through the recorder like any write: head office needs the dictionary to read branch rows
+	if (!beginWrite()) return false;
+	if (!vsrm::trainDescriptionDictionary(handle, *descriptions, options, stats, lastError)) { rollbackWrite(); return false; }
+	return commitWrite();
+#endif
+}
+
+bool Database::recompressDescriptions(DescriptionRecompressStats& stats) {
+#ifndef VSRM_HAS_SQLITE3
+	stats = {}; lastError = "SQLite not available."; return false;
+#else
+	// Same text in a new encoding: nothing for head office, which reads either form
+	const bool recording = recorder->attached();
+	recorder->detach();
+	char* errMsg = nullptr;
+	bool ok = sqlite3_exec(handle, "BEGIN IMMEDIATE;", nullptr, nullptr, &errMsg) == SQLITE_OK;
+	if (!ok) { lastError = errMsg ? errMsg : "BEGIN failed"; sqlite3_free(errMsg); }
+	if (ok) {
+		ok = vsrm::recompressDescriptions(handle, *descriptions, stats, lastError);
+		if (ok && sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+			lastError = errMsg ? errMsg : "COMMIT failed"; sqlite3_free(errMsg);
+			ok = false;
+		}
+		if (!ok) sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+	}
+	std::string error;
+	if (recording && !recorder->attach(handle, error)) {
+		lastError = "Recompressed, but the branch cannot record changes: " + error;
+		ok = false;
+	}
+	dropServiceColumns();
+	return ok;
+#endif
+}
+
+bool Database::descriptionStorage(DescriptionStorage& out) {
+#ifndef VSRM_HAS_SQLITE3
+	out = {}; lastError = "SQLite not available."; return false;
+#else
+	return describeDescriptionStorage(handle, *descriptions, out, lastError);
+#endif
+}
+
+bool Database::addAttachment(int64_t serviceRecordId, const std::string& path, const std::string& fileName,
+	AttachmentAddResult& out) {
+	out = {};
+#ifndef VSRM_HAS_SQLITE3
+	(void)serviceRecordId; (void)path; (void)fileName; lastError = "SQLite not available."; return false;
+#else
+	auto started = std::chrono::steady_clock::now();
+	std::string sha256;
+	int64_t size = 0;
+	if (!hashAttachmentFile(path, sha256, size, lastError)) return false;
+	const double hashMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+	// Only an id main lacks sends the lookup to the partitions, which cannot be attached in the transaction
+	std::vector<int64_t> archived;
+	if (!findArchivedRecordIds(handle, {serviceRecordId}, archived, lastError)) return false;
+	if (!beginWrite()) return false;
+	if (!vsrm::addAttachment(handle, serviceRecordId, !archived.empty(), path, fileName, sha256, size, out, lastError)) {
+		rollbackWrite();
+		return false;
+	}
+	out.hashMilliseconds = hashMs;
+	return commitWrite();
+#endif
+}
+
+bool Database::listAttachments(int64_t serviceRecordId, std::vector<AttachmentInfo>& out) {
+	return vsrm::listAttachments(handle, serviceRecordId, out, lastError);
+}
+
+bool Database::readAttachment(int64_t id, AttachmentInfo& info, const std::function<bool(std::string_view)>& sink) {
+	return vsrm::readAttachment(handle, id, info, sink, lastError);
+}
+
+bool Database::removeAttachment(int64_t id, bool& contentFreed) {
+	contentFreed = false;
+#ifndef VSRM_HAS_SQLITE3
+	(void)id; lastError = "SQLite not available."; return false;
+#else
+	if (!beginWrite()) return false;
+	if (!vsrm::removeAttachment(handle, id, contentFreed, lastError)) { rollbackWrite(); contentFreed = false; return false; }
+	return commitWrite();
+#endif
+}
+
+bool Database::pruneOrphanedAttachments(int64_t& removed, int64_t& contentsFreed) {
+	removed = contentsFreed = 0;
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return false;
+#else
+	std::vector<int64_t> orphans;
+	if (!findOrphanedAttachments(handle, orphans, lastError)) return false;
+	if (orphans.empty()) return true;
+	if (!beginWrite()) return false;
+	for (int64_t id : orphans) {
+		bool freed = false;
+		if (!vsrm::removeAttachment(handle, id, freed, lastError)) { rollbackWrite(); removed = contentsFreed = 0; return false; }
+		++removed;
+		if (freed) ++contentsFreed;
+	}
+	return commitWrite();
+#endif
+}
+
+bool Database::attachmentThumbnail(int64_t id, int maxEdge, ThumbnailImage& out, bool& cached) {
+	return vsrm::attachmentThumbnail(handle, id, maxEdge, out, cached, lastError);
+}
+
+bool Database::attachmentStorage(AttachmentStorage& out) {
+	return vsrm::describeAttachmentStorage(handle, out, lastError);
+}
+
+bool Database::vacuum() {
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return false;
+#else
+	char* errMsg = nullptr;
+	if (sqlite3_exec(handle, "VACUUM;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "VACUUM failed"; sqlite3_free(errMsg); return false;
+	}
+	return true;
+#endif
+}
+
+bool Database::optimize() {
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return false;
+#else
+	char* errMsg = nullptr;
+	if (sqlite3_exec(handle, "PRAGMA optimize;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "PRAGMA optimize failed"; sqlite3_free(errMsg); return false;
+	}
+	return true;
+#endif
+}
+
+bool Database::checkpoint() {
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return false;
+#else
+	if (sqlite3_wal_checkpoint_v2(handle, nullptr, SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr) != SQLITE_OK) {
+		lastError = sqlite3_errmsg(handle); return false;
+	}
+	return true;
+#endif
+}
+
+bool Database::integrityCheck(std::vector<std::string>& problems) {
+	problems.clear();
+#ifndef VSRM_HAS_SQLITE3
+	lastError = "SQLite not available."; return false;
+#else
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, "PRAGMA integrity_check;", -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		std::string line = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+		if (line != "ok") problems.push_back(std::move(line));
+	}
+	if (rc != SQLITE_DONE) lastError = sqlite3_errmsg(handle);
+	sqlite3_finalize(stmt);
+	return rc == SQLITE_DONE;
+#endif
+}
+
+bool Database::runIdleMaintenance(MaintenanceReport& report, const std::function<bool()>& yield) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)yield; report = {}; lastError = "SQLite not available."; return false;
+#else
+	// A pass never waits for another writer; it skips the step instead
+	sqlite3_busy_timeout(handle, 0);
+	bool ok = maintenance->tick(handle, report, lastError, yield);
+	sqlite3_busy_timeout(handle, busyWaitMs);
+	return ok;
+#endif
+}
+
+bool Database::runMaintenancePass(MaintenanceReport& report, const std::function<bool()>& yield) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)yield; report = {}; lastError = "SQLite not available."; return false;
+#else
+	sqlite3_busy_timeout(handle, 0);
+	bool ok = maintenance->runPass(handle, report, lastError, yield);
+	sqlite3_busy_timeout(handle, busyWaitMs);
+	return ok;
 #endif
 }
 
+bool Database::importServiceRecordsCsv(const std::string& inputFilePath, ImportConflict policy, ImportStats& stats) {
+#ifndef VSRM_HAS_SQLITE3
+	(void)inputFilePath; (void)policy; (void)stats; lastError = "SQLite not available."; return false;
+#else
+	bool ok = vsrm::importServiceRecordsCsv(handle, inputFilePath, policy, stats, lastError,
+		[this](std::string& error) { return recorder->stage(handle, error); });
+	std::string ignored;
+	if (!ok && recorder->attached()) recorder->attach(handle, ignored); // forget the rolled-back rows
+	return ok;
+#endif
+}
 
 int Database::countServiceRecordsByDateRange(const std::string& startDateInclusive, const std::string& endDateInclusive) {
 #ifndef VSRM_HAS_SQLITE3
@@ -407,42 +1360,14 @@ int Database::countServiceRecordsByDateRange(const std::string& startDateInclusi
 		count = sqlite3_column_int(stmt, 0);
 	}
 	sqlite3_finalize(stmt);
-	return count;
+	int64_t archived = 0;
+	if (!countArchivedRecords(handle, startDateInclusive, endDateInclusive, archived, lastError)) return 0;
+	return count + static_cast<int>(archived);
 #endif
 }
 
 } // namespace vsrm
 
-namespace {
-static std::string toHex(const unsigned char* data, size_t len) {
-	static const char* hex = "0123456789abcdef";
-	std::string out; out.resize(len * 2);
-	for (size_t i = 0; i < len; ++i) { out[i*2] = hex[(data[i] >> 4) & 0xF]; out[i*2+1] = hex[data[i] & 0xF]; }
-	return out;
-}
-static std::string sha256(const std::string& input) {
-    BCRYPT_ALG_HANDLE hAlg = nullptr; BCRYPT_HASH_HANDLE hHash = nullptr;
-    NTSTATUS status = BCryptOpenAlgorithmProvider(&hAlg, BCRYPT_SHA256_ALGORITHM, nullptr, 0);
-    if (status != 0) return {};
-    DWORD hashObjectSize = 0, cb = 0; BCryptGetProperty(hAlg, BCRYPT_OBJECT_LENGTH, (PUCHAR)&hashObjectSize, sizeof(hashObjectSize), &cb, 0);
-    DWORD hashLen = 0; BCryptGetProperty(hAlg, BCRYPT_HASH_LENGTH, (PUCHAR)&hashLen, sizeof(hashLen), &cb, 0);
-    std::vector<UCHAR> hashObject(hashObjectSize);
-    std::vector<UCHAR> hash(hashLen);
-    status = BCryptCreateHash(hAlg, &hHash, hashObject.data(), hashObjectSize, nullptr, 0, 0);
-    if (status != 0) { BCryptCloseAlgorithmProvider(hAlg, 0); return {}; }
-    status = BCryptHashData(hHash, (PUCHAR)input.data(), (ULONG)input.size(), 0);
-    if (status == 0) status = BCryptFinishHash(hHash, hash.data(), hashLen, 0);
-    BCryptDestroyHash(hHash); BCryptCloseAlgorithmProvider(hAlg, 0);
-    if (status != 0) return {};
-    return toHex(hash.data(), hash.size());
-}
-static std::string randomSalt() {
-	std::random_device rd; std::mt19937_64 gen(rd()); std::uniform_int_distribution<unsigned long long> d;
-	unsigned long long v = d(gen);
-	return sha256(std::string(reinterpret_cast<char*>(&v), sizeof(v))).substr(0, 16);
-}
-}
-
 namespace vsrm {
 
 bool Database::ensureDefaultAdmin() {
@@ -462,8 +1387,9 @@ bool Database::createUser(const std::string& username, const std::string& passwo
 #ifndef VSRM_HAS_SQLITE3
 	(void)username; (void)password; lastError = "SQLite not available."; return false;
 #else
-	std::string salt = randomSalt();
-	std::string hash = sha256(password + salt);
+	std::string salt = newPasswordSalt();
+	if (salt.empty()) { lastError = "Could not generate a password salt."; return false; }
+	std::string hash = hashPassword(password, salt, passwordIterations);
 	const char* sql = "INSERT INTO users (username, password_hash, salt) VALUES (?1, ?2, ?3);";
 	sqlite3_stmt* stmt = nullptr; if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return false; }
 	sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
@@ -489,7 +1415,79 @@ bool Database::verifyLogin(const std::string& username, const std::string& passw
 	}
 	sqlite3_finalize(stmt);
 	if (!found) return false;
-	return sha256(password + salt) == dbHash;
+	if (!verifyPassword(password, salt, dbHash)) return false;
+	// The password is known now, so replace legacy or weaker hashes; failure here does not block the login
+	if (passwordNeedsRehash(dbHash, passwordIterations)) {
+		std::string newSalt = newPasswordSalt();
+		if (!newSalt.empty()) {
+			std::string newHash = hashPassword(password, newSalt, passwordIterations);
+			if (sqlite3_prepare_v2(handle, "UPDATE users SET password_hash = ?1, salt = ?2 WHERE username = ?3;", -1, &stmt, nullptr) == SQLITE_OK) {
+				sqlite3_bind_text(stmt, 1, newHash.c_str(), -1, SQLITE_TRANSIENT);
+				sqlite3_bind_text(stmt, 2, newSalt.c_str(), -1, SQLITE_TRANSIENT);
+				sqlite3_bind_text(stmt, 3, username.c_str(), -1, SQLITE_TRANSIENT);
+				sqlite3_step(stmt);
+			}
+			sqlite3_finalize(stmt);
+		}
+	}
+	return true;
+#endif
+}
+
+bool Database::upgradeLegacyPasswords(int threads, size_t* upgraded) {
+	if (upgraded) *upgraded = 0;
+#ifndef VSRM_HAS_SQLITE3
+	(void)threads; lastError = "SQLite not available."; return false;
+#else
+	struct Row { int64_t id; std::string hash, salt; };
+	std::vector<Row> rows;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(handle, "SELECT id, password_hash, salt FROM users WHERE password_hash NOT LIKE 'pbkdf2-sha256%';", -1, &stmt, nullptr) != SQLITE_OK) {
+		lastError = sqlite3_errmsg(handle); return false;
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		rows.push_back(Row{sqlite3_column_int64(stmt, 0), reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+			reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2))});
+	}
+	sqlite3_finalize(stmt);
+	if (rows.empty()) return true;
+
+	std::vector<PasswordHashJob> jobs;
+	jobs.reserve(rows.size());
+	for (const Row& r : rows) jobs.push_back(PasswordHashJob{r.hash, r.salt, true});
+	std::vector<std::string> wrapped(rows.size());
+	hashPasswordsBatch(jobs, passwordIterations, wrapped, threads);
+
+	// Only rows still holding the hash that was read are replaced
+	char* errMsg = nullptr;
+	if (sqlite3_exec(handle, "BEGIN IMMEDIATE;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "BEGIN failed"; sqlite3_free(errMsg); return false;
+	}
+	if (sqlite3_prepare_v2(handle, "UPDATE users SET password_hash = ?1 WHERE id = ?2 AND password_hash = ?3;", -1, &stmt, nullptr) != SQLITE_OK) {
+		lastError = sqlite3_errmsg(handle); sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr); return false;
+	}
+	size_t changed = 0;
+	for (size_t i = 0; i < rows.size(); ++i) {
+		sqlite3_reset(stmt);
+		sqlite3_bind_text(stmt, 1, wrapped[i].c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64(stmt, 2, rows[i].id);
+		sqlite3_bind_text(stmt, 3, rows[i].hash.c_str(), -1, SQLITE_TRANSIENT);
+		if (sqlite3_step(stmt) != SQLITE_DONE) {
+			lastError = sqlite3_errmsg(handle);
+			sqlite3_finalize(stmt);
+			sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+			return false;
+		}
+		changed += static_cast<size_t>(sqlite3_changes(handle));
+	}
+	sqlite3_finalize(stmt);
+	if (sqlite3_exec(handle, "COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		lastError = errMsg ? errMsg : "COMMIT failed"; sqlite3_free(errMsg);
+		sqlite3_exec(handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+		return false;
+	}
+	if (upgraded) *upgraded = changed;
+	return true;
 #endif
 }
 
@@ -510,7 +1508,8 @@ int Database::countDistinctCustomers() {
 #ifndef VSRM_HAS_SQLITE3
     lastError = "SQLite not available."; return 0;
 #else
-    return singleIntQuery(handle, "SELECT COUNT(DISTINCT customer_name) FROM service_records;");
+    // Customers whose visits are all archived are still in archive_rollup
+    return singleIntQuery(handle, "SELECT COUNT(*) FROM (SELECT customer_name FROM service_records UNION SELECT customer_name FROM archive_rollup);");
 #endif
 }
 
@@ -534,7 +1533,9 @@ int Database::countServiceRecords() {
 #ifndef VSRM_HAS_SQLITE3
     lastError = "SQLite not available."; return 0;
 #else
-    return singleIntQuery(handle, "SELECT COUNT(*) FROM service_records;");
+    // Archived partitions are counted from their registry rows; before v10 that query yields 0
+    return singleIntQuery(handle, "SELECT COUNT(*) FROM service_records;") +
+        singleIntQuery(handle, "SELECT COALESCE(SUM(records), 0) FROM archive_partitions;");
 #endif
 }
 
@@ -543,7 +1544,7 @@ std::vector<ServiceRecord> Database::fetchRecentServiceRecords(int limit) {
 #ifndef VSRM_HAS_SQLITE3
     (void)limit; lastError = "SQLite not available."; return result;
 #else
-    const char* sql = "SELECT id, vin, customer_name, service_date, description, mechanic FROM service_records ORDER BY service_date DESC, id DESC LIMIT ?1;";
+    const char* sql = "SELECT id, vin, customer_name, service_date, vsrm_text(description), mechanic FROM service_records ORDER BY service_date DESC, id DESC LIMIT ?1;";
     sqlite3_stmt* stmt = nullptr; if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return result; }
     sqlite3_bind_int(stmt, 1, limit);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
@@ -556,7 +1557,36 @@ std::vector<ServiceRecord> Database::fetchRecentServiceRecords(int limit) {
         r.mechanic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
         result.push_back(std::move(r));
     }
-    sqlite3_finalize(stmt); return result;
+    sqlite3_finalize(stmt);
+
+    // Archived rows are older than the archive's newest date; main answers alone when it has
+    // `limit` rows after that (back-dated entries can sit in main below it)
+    sqlite3_stmt* newest = nullptr;
+    std::string archivedUntil;
+    if (sqlite3_prepare_v2(handle, "SELECT MAX(last_date) FROM archive_partitions WHERE records > 0;", -1, &newest, nullptr) == SQLITE_OK &&
+        sqlite3_step(newest) == SQLITE_ROW && sqlite3_column_type(newest, 0) != SQLITE_NULL)
+        archivedUntil = reinterpret_cast<const char*>(sqlite3_column_text(newest, 0));
+    sqlite3_finalize(newest);
+    const size_t want = static_cast<size_t>(std::max(limit, 0));
+    if (archivedUntil.empty() || want == 0 || (result.size() == want && result.back().serviceDate > archivedUntil)) return result;
+    auto newer = [](const ServiceRecord& a, const ServiceRecord& b) {
+        return a.serviceDate != b.serviceDate ? a.serviceDate > b.serviceDate : a.id > b.id;
+    };
+    bool ok = scanArchivedRecords(handle, "", [&](sqlite3_stmt* s) {
+        ServiceRecord r{};
+        r.id = sqlite3_column_int(s, 0);
+        r.serviceDate = reinterpret_cast<const char*>(sqlite3_column_text(s, 3));
+        if (result.size() == want && !newer(r, result.back())) return true;
+        r.vin = reinterpret_cast<const char*>(sqlite3_column_text(s, 1));
+        r.customerName = reinterpret_cast<const char*>(sqlite3_column_text(s, 2));
+        r.description = reinterpret_cast<const char*>(sqlite3_column_text(s, 4));
+        r.mechanic = reinterpret_cast<const char*>(sqlite3_column_text(s, 5));
+        result.insert(std::upper_bound(result.begin(), result.end(), r, newer), std::move(r));
+        if (result.size() > want) result.pop_back();
+        return true;
+    }, lastError);
+    if (!ok) result.clear();
+    return result;
 #endif
 }
 
@@ -570,30 +1600,94 @@ std::vector<VehicleSummary> Database::listVehicleSummaries(
     const std::optional<std::string>& toDate,
     const std::optional<std::string>& mechanicLike,
     bool dueOnly) {
+    SummaryQuery q = SummaryQuery::normalized(vinLike, fromDate, toDate, mechanicLike, dueOnly);
+    syncSummaryCache();
+    if (auto cached = summaryCache->find(q)) return *cached;
+    auto result = querySummaries(q);
+    if (lastError.empty()) summaryCache->store(q, result);
+    return result;
+}
+
+std::optional<int64_t> Database::dataVersion() {
+#ifndef VSRM_HAS_SQLITE3
+    lastError = "SQLite not available."; return std::nullopt;
+#else
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(handle, "PRAGMA data_version;", -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return std::nullopt; }
+    std::optional<int64_t> v;
+    if (sqlite3_step(stmt) == SQLITE_ROW) v = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return v;
+#endif
+}
+
+std::optional<uint32_t> Database::fileChangeCounter() {
+#ifndef VSRM_HAS_SQLITE3
+    lastError = "SQLite not available."; return std::nullopt;
+#else
+    const char* file = sqlite3_db_filename(handle, "main");
+    if (!file || !*file) return std::nullopt;
+    unsigned char header[100];
+    std::ifstream in(pathFromUtf8(file), std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) return std::nullopt;
+    if (header[18] == 2) return std::nullopt; // WAL: the counter is not updated
+    return (uint32_t(header[24]) << 24) | (uint32_t(header[25]) << 16) | (uint32_t(header[26]) << 8) | uint32_t(header[27]);
+#endif
+}
+
+void Database::syncSummaryCache() {
+    // data_version only moves for commits by *other* connections; our own commits come from the change feed
+    auto dv = dataVersion();
+    if (!dv || *dv != summaryCache->dataVersion) {
+        summaryCache->invalidateAll();
+        summaryCache->dataVersion = dv.value_or(-1);
+    }
+    std::vector<CommitChanges> commits;
+    bool stale = !changesSince(summaryCache->changeSequence, commits);
+    for (const auto& c : commits) stale |= c.touches("service_records") || c.touches("appointments");
+    if (stale) summaryCache->invalidateAll();
+    summaryCache->changeSequence = changeSequence();
+}
+
+void Database::setSummaryCacheBudget(size_t bytes) { summaryCache->setBudget(bytes); }
+
+SummaryCacheStats Database::summaryCacheStats() const { return summaryCache->stats(); }
+
+std::vector<VehicleSummary> Database::querySummaries(const SummaryQuery& q) {
     std::vector<VehicleSummary> result;
+    lastError.clear();
 #ifndef VSRM_HAS_SQLITE3
-    (void)vinLike; (void)fromDate; (void)toDate; (void)mechanicLike; (void)dueOnly; lastError = "SQLite not available."; return result;
+    (void)q; lastError = "SQLite not available."; return result;
 #else
-    // Build SQL to compute last service per VIN and next upcoming appointment (if any)
+    // Build SQL to compute last service per VIN and next upcoming appointment (if any). Archived
+    // years contribute through archive_rollup, which holds their latest visit per VIN and mechanic.
     std::string sql =
         "WITH last AS (\n"
-        "  SELECT vin, MAX(service_date) AS last_date\n"
-        "  FROM service_records\n"
+        "  SELECT vin, MAX(last_date) AS last_date FROM (\n"
+        "    SELECT vin, MAX(service_date) AS last_date FROM service_records GROUP BY vin\n"
+        "    UNION ALL SELECT vin, MAX(last_date) FROM archive_rollup GROUP BY vin)\n"
         "  GROUP BY vin\n"
         ")\n"
-        "SELECT l.vin, '' AS make, '' AS model, l.last_date,\n"
-        "       (SELECT mechanic FROM service_records sr WHERE sr.vin = l.vin AND sr.service_date = l.last_date ORDER BY id DESC LIMIT 1) AS mech,\n"
-        "       (SELECT MIN(scheduled_at) FROM appointments a WHERE a.vin = l.vin AND a.status IN ('scheduled','in_progress')) AS next_service,\n"
-        "       COALESCE((SELECT status FROM appointments a2 WHERE a2.vin = l.vin ORDER BY scheduled_at DESC, id DESC LIMIT 1), 'ok') AS status\n"
-        "FROM last l\n";
+        "SELECT l.vin, l.last_date,\n"
+        "       (SELECT mechanic FROM (SELECT mechanic, id FROM service_records sr WHERE sr.vin = l.vin AND sr.service_date = l.last_date\n"
+        "          UNION ALL SELECT mechanic, last_id FROM archive_rollup ar WHERE ar.vin = l.vin AND ar.last_date = l.last_date)\n"
+        "        ORDER BY id DESC LIMIT 1) AS mech,\n"
+        "       COALESCE((SELECT MIN(scheduled_at) FROM appointments a WHERE a.vin = l.vin AND a.status IN ('scheduled','in_progress')),\n"
+        "                d.due_date) AS next_service,\n"
+        "       COALESCE((SELECT status FROM appointments a2 WHERE a2.vin = l.vin ORDER BY scheduled_at DESC, id DESC LIMIT 1),\n"
+        "                CASE WHEN d.due_date < date('now', 'localtime') THEN 'overdue' ELSE 'ok' END) AS status\n"
+        "FROM last l\n"
+        "LEFT JOIN service_due d ON d.vin = l.vin\n";
 
     // Apply filters
     std::vector<std::string> where;
-    if (!vinLike.empty()) where.push_back("l.vin LIKE ?1");
-    if (fromDate.has_value()) where.push_back("l.last_date >= ?2");
-    if (toDate.has_value()) where.push_back("l.last_date <= ?3");
-    if (mechanicLike.has_value()) where.push_back("EXISTS (SELECT 1 FROM service_records s2 WHERE s2.vin = l.vin AND s2.mechanic LIKE ?4)");
-    if (dueOnly) where.push_back("EXISTS (SELECT 1 FROM appointments a3 WHERE a3.vin = l.vin AND a3.status IN ('scheduled','in_progress'))");
+    if (!q.vinLike.empty()) where.push_back("l.vin LIKE ?1");
+    if (q.fromDate.has_value()) where.push_back("l.last_date >= ?2");
+    if (q.toDate.has_value()) where.push_back("l.last_date <= ?3");
+    if (q.mechanicLike.has_value()) where.push_back("(EXISTS (SELECT 1 FROM service_records s2 WHERE s2.vin = l.vin AND s2.mechanic LIKE ?4)"
+        " OR EXISTS (SELECT 1 FROM archive_rollup a4 WHERE a4.vin = l.vin AND a4.mechanic LIKE ?4))");
+    if (q.dueOnly) where.push_back("(EXISTS (SELECT 1 FROM appointments a3 WHERE a3.vin = l.vin AND a3.status IN ('scheduled','in_progress'))"
+        " OR d.due_date <= date('now', 'localtime', '+" + std::to_string(kDueSoonDays) + " days'))");
     if (!where.empty()) {
         sql += " WHERE ";
         for (size_t i = 0; i < where.size(); ++i) {
@@ -606,21 +1700,23 @@ std::vector<VehicleSummary> Database::listVehicleSummaries(
     sqlite3_stmt* stmt = nullptr;
     if (sqlite3_prepare_v2(handle, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { lastError = sqlite3_errmsg(handle); return result; }
 
-    int bindIndex = 1;
-    if (!vinLike.empty()) { std::string like = "%" + vinLike + "%"; sqlite3_bind_text(stmt, bindIndex++, like.c_str(), -1, SQLITE_TRANSIENT); }
-    if (fromDate.has_value()) sqlite3_bind_text(stmt, bindIndex++, fromDate->c_str(), -1, SQLITE_TRANSIENT);
-    if (toDate.has_value()) sqlite3_bind_text(stmt, bindIndex++, toDate->c_str(), -1, SQLITE_TRANSIENT);
-    if (mechanicLike.has_value()) { std::string likeM = "%" + *mechanicLike + "%"; sqlite3_bind_text(stmt, bindIndex++, likeM.c_str(), -1, SQLITE_TRANSIENT); }
+    // Placeholders are numbered (?1..?4), so bind by number even when earlier filters are absent
+    if (!q.vinLike.empty()) { std::string like = "%" + q.vinLike + "%"; sqlite3_bind_text(stmt, 1, like.c_str(), -1, SQLITE_TRANSIENT); }
+    if (q.fromDate.has_value()) sqlite3_bind_text(stmt, 2, q.fromDate->c_str(), -1, SQLITE_TRANSIENT);
+    if (q.toDate.has_value()) sqlite3_bind_text(stmt, 3, q.toDate->c_str(), -1, SQLITE_TRANSIENT);
+    if (q.mechanicLike.has_value()) { std::string likeM = "%" + *q.mechanicLike + "%"; sqlite3_bind_text(stmt, 4, likeM.c_str(), -1, SQLITE_TRANSIENT); }
 
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         VehicleSummary v{};
         v.vin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        v.make = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        v.model = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        v.lastServiceDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        v.mechanic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        if (sqlite3_column_type(stmt, 5) != SQLITE_NULL) v.nextService = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5))); else v.nextService.reset();
-        v.status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+        // Make and model are decoded from the VIN rather than stored
+        DecodedVin decoded = decodeVin(v.vin);
+        v.make = decoded.make;
+        v.model = decoded.model;
+        v.lastServiceDate = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        v.mechanic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        if (sqlite3_column_type(stmt, 3) != SQLITE_NULL) v.nextService = std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3))); else v.nextService.reset();
+        v.status = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
         result.push_back(std::move(v));
     }
     sqlite3_finalize(stmt);
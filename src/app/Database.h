@@ -1,9 +1,29 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <optional>
 #include <vector>
 
+#include "Archive.h"
+#include "AssignmentDetails.h"
+#include "Attachments.h"
+#include "ChangeFeed.h"
+#include "DescriptionCodec.h"
+#include "IntervalIndex.h"
+#include "Maintenance.h"
+#include "Migrations.h"
+#include "PasswordHash.h"
+#include "Replication.h"
+#include "ServiceColumns.h"
+#include "ServiceDue.h"
+#include "ServiceImport.h"
+#include "Sketches.h"
+#include "SummaryCache.h"
+#include "Timeline.h"
+
 struct sqlite3;
 
 namespace vsrm {
@@ -30,6 +50,25 @@ struct Appointment {
 	std::string customerName;
 	std::string scheduledAt; // ISO 8601
 	std::string status; // scheduled, in_progress, done, cancelled
+	std::optional<std::string> requiredSkill; // matched against Mechanic::skill; empty: any mechanic
+	int durationMin{60};
+};
+
+// Status filter for calendar queries
+enum AppointmentStatusMask : unsigned {
+	kApptScheduled = 1u << 0,
+	kApptInProgress = 1u << 1,
+	kApptDone = 1u << 2,
+	kApptCancelled = 1u << 3,
+	kApptOpen = kApptScheduled | kApptInProgress,
+	kApptAnyStatus = kApptOpen | kApptDone | kApptCancelled,
+};
+
+// Appointment with the mechanic of its most recent assignment, if any
+struct CalendarEntry {
+	Appointment appointment;
+	std::optional<int> mechanicId;
+	std::string mechanicName;
 };
 
 struct Assignment {
@@ -40,10 +79,17 @@ struct Assignment {
 	std::optional<std::string> completedAt; // ISO 8601
 };
 
+// Open (not completed) assignments a mechanic carries on one day (YYYY-MM-DD).
+struct MechanicDayLoad {
+	int mechanicId{};
+	std::string day;
+	int jobs{};
+};
+
 struct VehicleSummary {
     std::string vin;
-    std::string make;        // optional: left blank if unknown
-    std::string model;       // optional: left blank if unknown
+    std::string make;        // decoded from the VIN; blank if unknown
+    std::string model;       // decoded from the VIN; blank if unknown
     std::string lastServiceDate;
     std::string mechanic;
     std::optional<std::string> nextService;
@@ -65,11 +111,23 @@ public:
 
 	bool openOrCreate(const std::string& dbPath);
 	void close();
+	// Switches the file to WAL (persistent) with synchronous=NORMAL, and makes this connection
+	// wait up to busyTimeoutMs for locks. Readers then never block the writer or each other.
+	bool enableWriteAheadLog(int busyTimeoutMs = 5000);
 
-	bool initializeSchema(const std::string& schemaFilePath);
+	// Applies the migrations compiled into the binary (see Migrations.cpp) up to the latest
+	// PRAGMA user_version. A current schema costs one pragma read. Each step runs in its own
+	// transaction; applied steps and their timings are appended to `applied` if given.
+	bool migrateSchema(std::vector<MigrationStep>* applied = nullptr);
+	int schemaVersion();
 
 	// CRUD for service records (minimal for demo)
 	std::optional<int> addServiceRecord(const ServiceRecord& record);
+	// Inserts the batch in one transaction, each record under its own savepoint: a record that
+	// fails (bad VIN, constraint) gets nullopt in ids and its message in errors while the others
+	// commit. False (with lastError, nothing written) only if the transaction itself fails.
+	bool addServiceRecordsBatch(const std::vector<ServiceRecord>& batch, std::vector<std::optional<int>>& ids,
+		std::vector<std::string>& errors);
 	std::vector<ServiceRecord> listServiceRecordsByVin(const std::string& vin);
     bool updateServiceRecord(const ServiceRecord& record);
 
@@ -82,19 +140,53 @@ public:
 	// Appointments
 	std::optional<int> addAppointment(const Appointment& appt);
 	std::vector<Appointment> listAppointmentsByVin(const std::string& vin);
+	// Appointments with from <= scheduled_at < to (ISO 8601 text) whose status is in statusMask,
+	// joined with their assigned mechanic, in time order. One indexed range scan.
+	std::vector<CalendarEntry> listAppointmentsInRange(const std::string& from, const std::string& to,
+		unsigned statusMask = kApptAnyStatus);
+	// Scheduled appointments with no assignment, optionally limited to one day (YYYY-MM-DD).
+	std::vector<Appointment> listUnassignedAppointments(const std::optional<std::string>& day = std::nullopt);
 
 	// Assignments
 	std::optional<int> addAssignment(const Assignment& asg);
+	// Inserts all rows in one transaction with a single prepared statement; all or nothing.
+	bool addAssignmentsBatch(const std::vector<Assignment>& batch);
+	std::vector<MechanicDayLoad> listOpenAssignmentLoad();
+
+	// Booking checks against scheduled/in-progress appointments and their latest assignment while uncompleted,
+	// answered from an in-memory interval index (rebuilt when another connection or a bulk change
+	// touches appointments/assignments, otherwise updated in place by the inserts above).
+	std::vector<BookingConflict> findBookingConflicts(const std::string& startsAt, int durationMin,
+		std::optional<int> mechanicId, const std::optional<std::string>& vin,
+		std::optional<int> ignoreAppointmentId = std::nullopt);
+	std::vector<TimeSlot> findFreeSlots(int mechanicId, const std::string& from, const std::string& to, int minMinutes);
 	std::vector<Assignment> listAssignmentsByMechanic(int mechanicId);
+	// Assignments joined with appointment, vehicle and mechanic in one statement, ordered by
+	// scheduled_at. Replaces out's contents; false (with lastError) on failure.
+	bool listAssignmentDetails(const AssignmentDetailQuery& query, AssignmentDetailBatch& out);
+
+	// History merged from service records, appointments and assignments, newest first, `limit`
+	// events per page (see Timeline.h). Start with no cursor and pass page.nextCursor to continue.
+	bool vehicleTimeline(const std::string& vin, size_t limit, const std::optional<std::string>& cursor, TimelinePage& page);
+	// Same across every vehicle the customer has records or appointments for
+	bool customerTimeline(const std::string& customerName, size_t limit, const std::optional<std::string>& cursor, TimelinePage& page);
+	std::vector<std::string> listCustomerVins(const std::string& customerName);
 
 	// Reports
 	bool exportServiceHistoryCsv(const std::string& vin, const std::string& outputFilePath);
+	// Imports service records from CSV (see ServiceImport.h), recognising rows already stored
+	// by vin, date, description and mechanic instead of inserting them twice.
+	bool importServiceRecordsCsv(const std::string& inputFilePath, ImportConflict policy, ImportStats& stats);
 	int countServiceRecordsByDateRange(const std::string& startDateInclusive, const std::string& endDateInclusive);
 
 	// Users/auth (local)
 	bool ensureDefaultAdmin();
 	bool createUser(const std::string& username, const std::string& password);
 	bool verifyLogin(const std::string& username, const std::string& password);
+	// PBKDF2 cost for new hashes (see PasswordHash.h); a successful login rehashes weaker ones
+	void setPasswordIterations(uint32_t iterations) { passwordIterations = iterations; }
+	// Wraps every old single-SHA-256 hash in PBKDF2, hashing in parallel (threads <= 0: all cores)
+	bool upgradeLegacyPasswords(int threads = 0, size_t* upgraded = nullptr);
 
     // Dashboard metrics
     int countDistinctCustomers();
@@ -103,20 +195,128 @@ public:
     int countServiceRecords();
     std::vector<ServiceRecord> fetchRecentServiceRecords(int limit);
     bool exportAllServiceRecordsCsv(const std::string& outputFilePath);
+    // Calls visit for each record (one VIN's, or all when vin is empty) in service_date, id order
+    // without materialising the table; visit returns false to stop early.
+    bool forEachServiceRecord(const std::string& vin, const std::function<bool(const ServiceRecord&)>& visit);
 
-    // Vehicle summaries for the grid
+    // Maintenance. vacuum() rewrites the whole file and needs that much free disk space (it also
+    // switches older files to incremental auto_vacuum); checkpoint() only does work in WAL mode.
+    bool vacuum();
+    bool optimize();   // PRAGMA optimize: re-analyzes tables whose statistics are stale
+    bool checkpoint(); // PRAGMA wal_checkpoint(TRUNCATE)
+    bool integrityCheck(std::vector<std::string>& problems); // problems is empty when the file is sound
+
+    // Idle-time maintenance (see Maintenance.h). Call runIdleMaintenance() every few seconds from
+    // an event loop: report.ran stays false until nothing has committed for idleAfterMs, then one
+    // pass runs within the lock and pass budgets. runMaintenancePass() runs one at once. yield
+    // ends a pass early, e.g. when a desk's write or user input arrives.
+    void setMaintenanceOptions(const MaintenanceOptions& options) { maintenance->setOptions(options); }
+    bool runIdleMaintenance(MaintenanceReport& report, const std::function<bool()>& yield = {});
+    bool runMaintenancePass(MaintenanceReport& report, const std::function<bool()>& yield = {});
+
+    // Vehicle summaries for the grid. Results are served from an LRU cache keyed by the
+    // normalized filter; it is dropped when this connection commits to service_records or
+    // appointments, or when PRAGMA data_version shows another connection wrote.
     std::vector<VehicleSummary> listVehicleSummaries(
         const std::string& vinLike,
         const std::optional<std::string>& fromDate,
         const std::optional<std::string>& toDate,
         const std::optional<std::string>& mechanicLike,
         bool dueOnly);
+    // Rewrites service_due from service_records (see ServiceDue.h); threads <= 0 uses every core.
+    // The grid shows the predicted date when nothing is booked, and dueOnly includes vehicles
+    // predicted due within kDueSoonDays.
+    bool recomputeServiceDue(const ServiceDueRules& rules, int threads = 0, ServiceDueStats* stats = nullptr);
+    static constexpr int kDueSoonDays = 30;
+    void setSummaryCacheBudget(size_t bytes); // 0 disables caching
+    SummaryCacheStats summaryCacheStats() const;
+    std::optional<int64_t> dataVersion(); // PRAGMA data_version
+    // File change counter from the database header. Unlike data_version it is comparable across
+    // connections and restarts; nullopt for in-memory or WAL databases where it is not maintained.
+    std::optional<uint32_t> fileChangeCounter();
+
+	// Approximate per-month analytics (see Sketches.h): distinct customers/VINs and the most
+	// common mechanics and description keywords over [fromMonth, toMonth] (YYYY-MM), merged
+	// from one fixed-size sketch per month. addServiceRecord keeps them current; edits,
+	// deletes and bulk loads that bypass it need rebuildSketches().
+	bool sketchSummary(const std::string& fromMonth, const std::string& toMonth, SketchSummary& out, size_t topN = 5);
+	bool rebuildSketches();
+
+	// Column-wise in-memory copy of service_records for repeated count/group-by queries
+	// (see ServiceColumns.h). Loaded on first call; later calls apply this connection's
+	// committed changes row by row and reload only when another connection wrote.
+	// nullptr (with lastError) on failure. Valid until the next call or dropServiceColumns().
+	const ServiceColumns* serviceColumns();
+	void dropServiceColumns(); // frees the memory
+
+	// Branch replication (see Replication.h). enableReplication() turns this database into branch
+	// branchNumber; from then on every write commit also queues its changeset for export.
+	// Head office applies the exported files (and then drops the attachments of records they
+	// deleted). migrateSchema() resumes recording on reopen.
+	bool enableReplication(int branchNumber, const std::string& branchName);
+	bool replicationStatus(ReplicationStatus& status);
+	bool exportChangesets(const std::string& path, std::optional<int64_t> fromSeq, ReplicationExport& out);
+	bool applyChangesetFile(const std::string& path, ReplicationConflict policy, ReplicationApplyStats& stats);
+	bool pruneReplicationOutbox(int64_t& removed);
+
+	// Year-partitioned archives (see Archive.h). archiveServiceRecords() moves records dated before
+	// cutoff into per-year files beside the database; listServiceRecordsByVin, forEachServiceRecord,
+	// the CSV exports and the record counts read through to them. Archived rows are not shipped
+	// to head office as deletes, and the sketches keep counting them.
+	bool archiveServiceRecords(const std::string& cutoff, ArchiveStats& stats);
+	bool listArchivePartitions(std::vector<ArchivePartition>& out);
+
+	// Dictionary-compressed descriptions (see DescriptionCodec.h). Writes pack with the newest
+	// trained dictionary and every read returns plain text. Training is a replicated write, so
+	// head office can read what branches pack; recompressing is local like archiving.
+	bool trainDescriptionDictionary(const DictionaryTrainOptions& options, DictionaryTrainStats& stats);
+	bool recompressDescriptions(DescriptionRecompressStats& stats);
+	bool descriptionStorage(DescriptionStorage& out);
+	const DescriptionCodecStats& descriptionCodecStats() const { return descriptions->stats(); }
+
+	// Photos and documents on service records (see Attachments.h). The file is hashed before the
+	// write lock is taken, so only new content is written under it; identical files share storage.
+	// Attachments are local to this database and not sent to head office. Archived records can take
+	// new ones; pruneOrphanedAttachments() removes those whose record is gone everywhere.
+	bool addAttachment(int64_t serviceRecordId, const std::string& path, const std::string& fileName, AttachmentAddResult& out);
+	bool listAttachments(int64_t serviceRecordId, std::vector<AttachmentInfo>& out);
+	bool readAttachment(int64_t id, AttachmentInfo& info, const std::function<bool(std::string_view)>& sink);
+	bool removeAttachment(int64_t id, bool& contentFreed);
+	bool pruneOrphanedAttachments(int64_t& removed, int64_t& contentsFreed);
+	bool attachmentThumbnail(int64_t id, int maxEdge, ThumbnailImage& out, bool& cached);
+	bool attachmentStorage(AttachmentStorage& out);
+
+	// Change notifications for commits made through this connection
+	// (sqlite3_update_hook/commit_hook). Poll with the last sequence seen.
+	uint64_t changeSequence() const;
+	bool changesSince(uint64_t sequence, std::vector<CommitChanges>& out) const;
 
 	std::string getLastError() const { return lastError; }
 
 private:
 	sqlite3* handle;
 	std::string lastError;
+	std::unique_ptr<ChangeFeed> changeFeed; // heap-allocated: its address is registered with SQLite
+	std::unique_ptr<SummaryCache> summaryCache;
+	std::unique_ptr<BookingIndex> bookingIndex;
+	std::unique_ptr<ServiceColumns> columns; // null until serviceColumns() is first used
+	std::unique_ptr<ChangeRecorder> recorder; // heap-allocated: owns a session bound to handle
+	std::unique_ptr<DescriptionCodec> descriptions; // heap-allocated: its address is registered with SQLite
+	std::unique_ptr<MaintenanceScheduler> maintenance;
+	int busyWaitMs{0}; // the busy timeout set by enableWriteAheadLog, restored after maintenance
+	uint32_t passwordIterations{kDefaultPasswordIterations};
+
+	// Write transactions. commitWrite() queues the recorded changeset (on a branch) before COMMIT
+	// and rolls back if either fails; lastError says why.
+	bool beginWrite();
+	bool commitWrite();
+	void rollbackWrite();
+	// version and applicationId as read from the header by migrateSchema
+	bool resumeReplication(int version, int32_t applicationId);
+	bool markLegacyBranch(int32_t& applicationId); // sets kBranchApplicationId on branches enabled before v13
+	void syncSummaryCache();
+	bool syncBookingIndex();
+	std::vector<VehicleSummary> querySummaries(const SummaryQuery& q);
 };
 
 } // namespace vsrm
@@ -0,0 +1,72 @@
+#include "Dates.h"
+
+#include <cstdio>
+
+namespace vsrm {
+
+namespace {
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's days_from_civil)
+int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+	y -= m <= 2;
+	const int64_t era = (y >= 0 ? y : y - 399) / 400;
+	const unsigned yoe = static_cast<unsigned>(y - era * 400);
+	const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+void civilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+	z += 719468;
+	const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+	const unsigned doe = static_cast<unsigned>(z - era * 146097);
+	const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	const unsigned mp = (5 * doy + 2) / 153;
+	d = doy - (153 * mp + 2) / 5 + 1;
+	m = mp < 10 ? mp + 3 : mp - 9;
+	y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+bool digits(std::string_view s, size_t pos, size_t count, unsigned& value) {
+	if (pos + count > s.size()) return false;
+	value = 0;
+	for (size_t i = pos; i < pos + count; ++i) {
+		if (s[i] < '0' || s[i] > '9') return false;
+		value = value * 10 + static_cast<unsigned>(s[i] - '0');
+	}
+	return true;
+}
+
+} // namespace
+
+std::optional<int64_t> isoToMinutes(std::string_view iso) {
+	unsigned y, mo, d, h = 0, mi = 0;
+	if (!digits(iso, 0, 4, y) || iso.size() < 10 || iso[4] != '-' || iso[7] != '-' ||
+		!digits(iso, 5, 2, mo) || !digits(iso, 8, 2, d)) return std::nullopt;
+	if (mo < 1 || mo > 12 || d < 1 || d > 31) return std::nullopt;
+	if (iso.size() > 10) {
+		if ((iso[10] != 'T' && iso[10] != ' ') || iso.size() < 16 || iso[13] != ':' ||
+			!digits(iso, 11, 2, h) || !digits(iso, 14, 2, mi)) return std::nullopt;
+		if (h > 23 || mi > 59) return std::nullopt;
+	}
+	int64_t days = daysFromCivil(y, mo, d);
+	// Reject dates like 02-30 that days_from_civil would silently roll over
+	int64_t ry; unsigned rm, rd;
+	civilFromDays(days, ry, rm, rd);
+	if (rm != mo || rd != d) return std::nullopt;
+	return days * 1440 + h * 60 + mi;
+}
+
+std::string minutesToIso(int64_t minutes) {
+	int64_t days = minutes >= 0 ? minutes / 1440 : -((-minutes + 1439) / 1440);
+	int64_t rest = minutes - days * 1440;
+	int64_t y; unsigned m, d;
+	civilFromDays(days, y, m, d);
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%04lld-%02u-%02uT%02u:%02u:00", static_cast<long long>(y), m, d,
+		static_cast<unsigned>(rest / 60), static_cast<unsigned>(rest % 60));
+	return buf;
+}
+
+} // namespace vsrm
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace vsrm {
+
+// Timestamps are stored as local ISO 8601 text without a zone. These convert
+// to and from minutes since 1970-01-01T00:00 on the same (zone-less) clock so
+// times can be compared and added arithmetically.
+
+// Accepts "YYYY-MM-DD", "YYYY-MM-DDTHH:MM" and "YYYY-MM-DDTHH:MM:SS" ('T' or ' '
+// separator; seconds are dropped). nullopt if malformed or out of range.
+std::optional<int64_t> isoToMinutes(std::string_view iso);
+
+// "YYYY-MM-DDTHH:MM:00"
+std::string minutesToIso(int64_t minutes);
+
+} // namespace vsrm
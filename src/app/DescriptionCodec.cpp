@@ -0,0 +1,531 @@
+#include "DescriptionCodec.h"
+
+#include "FastHash.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+#ifdef VSRM_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace vsrm {
+
+namespace {
+
+constexpr char kPackedTag = 'D';
+constexpr size_t kDeflateWindow = 32768;
+constexpr uint64_t kDictionarySeed = 0xD1C7104A;
+
+uint64_t nanosSince(std::chrono::steady_clock::time_point started) {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+}
+
+void putId(std::string& out, uint32_t id) {
+	for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(id >> (8 * i)));
+}
+
+uint32_t getId(std::string_view in) {
+	uint32_t id = 0;
+	for (int i = 0; i < 4; ++i) id |= uint32_t(static_cast<unsigned char>(in[1 + i])) << (8 * i);
+	return id;
+}
+
+#ifdef VSRM_HAS_ZLIB
+// Raw deflate (no zlib header or checksum: the note is a few dozen bytes) primed with a dictionary
+bool deflateWith(z_stream& z, std::string_view dictionary, uint32_t id, std::string_view text, std::string& out) {
+	if (deflateReset(&z) != Z_OK) return false;
+	if (!dictionary.empty() &&
+		deflateSetDictionary(&z, reinterpret_cast<const Bytef*>(dictionary.data()), static_cast<uInt>(dictionary.size())) != Z_OK)
+		return false;
+	out.clear();
+	out.push_back(kPackedTag);
+	putId(out, id);
+	out.resize(kDescriptionHeaderBytes + deflateBound(&z, static_cast<uLong>(text.size())));
+	z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+	z.avail_in = static_cast<uInt>(text.size());
+	z.next_out = reinterpret_cast<Bytef*>(out.data() + kDescriptionHeaderBytes);
+	z.avail_out = static_cast<uInt>(out.size() - kDescriptionHeaderBytes);
+	if (deflate(&z, Z_FINISH) != Z_STREAM_END) return false;
+	out.resize(kDescriptionHeaderBytes + z.total_out);
+	return true;
+}
+
+bool inflateWith(z_stream& z, std::string_view dictionary, std::string_view packed, std::string& text) {
+	if (inflateReset(&z) != Z_OK ||
+		inflateSetDictionary(&z, reinterpret_cast<const Bytef*>(dictionary.data()), static_cast<uInt>(dictionary.size())) != Z_OK)
+		return false;
+	packed.remove_prefix(kDescriptionHeaderBytes);
+	z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(packed.data()));
+	z.avail_in = static_cast<uInt>(packed.size());
+	text.resize(std::max<size_t>(256, packed.size() * 6));
+	size_t produced = 0;
+	for (;;) {
+		z.next_out = reinterpret_cast<Bytef*>(text.data() + produced);
+		z.avail_out = static_cast<uInt>(text.size() - produced);
+		int rc = inflate(&z, Z_NO_FLUSH);
+		produced = text.size() - z.avail_out;
+		if (rc == Z_STREAM_END) break;
+		if ((rc != Z_OK && rc != Z_BUF_ERROR) || z.avail_out != 0) return false; // corrupt or truncated
+		text.resize(text.size() * 2);
+	}
+	text.resize(produced);
+	return true;
+}
+#endif
+
+} // namespace
+
+std::string trainTextDictionary(const std::vector<std::string>& samples, size_t maxBytes) {
+	maxBytes = std::min(maxBytes, kDeflateWindow);
+	// Candidates run from one word start to a later one (up to 8 words), counted once per sample.
+	// Keys are hashes; the first sample holding a string stands in for its bytes.
+	struct Candidate {
+		uint32_t count{};
+		uint32_t lastSample{};
+		uint32_t sample{};
+		uint32_t offset{};
+		uint32_t length{};
+	};
+	constexpr size_t kMaxWords = 8, kMinLength = 4, kMaxLength = 160;
+	std::unordered_map<uint64_t, Candidate> candidates;
+	std::vector<uint32_t> starts;
+	for (uint32_t s = 0; s < samples.size(); ++s) {
+		std::string_view text = samples[s];
+		starts.clear();
+		for (size_t i = 0; i < text.size(); ++i)
+			if (i == 0 || (text[i - 1] == ' ' && text[i] != ' ')) starts.push_back(static_cast<uint32_t>(i));
+		starts.push_back(static_cast<uint32_t>(text.size()));
+		for (size_t a = 0; a + 1 < starts.size(); ++a) {
+			for (size_t b = a + 1; b < starts.size() && b - a <= kMaxWords; ++b) {
+				size_t length = starts[b] - starts[a];
+				if (length > kMaxLength) break;
+				if (length < kMinLength) continue;
+				std::string_view piece = text.substr(starts[a], length);
+				Candidate& c = candidates[fastHash64(piece, kDictionarySeed)];
+				if (c.count && c.lastSample == s) continue;
+				if (!c.count) { c.sample = s; c.offset = starts[a]; c.length = static_cast<uint32_t>(length); }
+				++c.count;
+				c.lastSample = s;
+			}
+		}
+	}
+
+	// A repeat saves roughly its length minus the ~3 bytes of a back-reference
+	struct Scored {
+		uint64_t score;
+		std::string_view text;
+	};
+	std::vector<Scored> ranked;
+	for (const auto& [hash, c] : candidates) {
+		if (c.count < 2) continue;
+		ranked.push_back({uint64_t(c.count - 1) * (c.length - 3), std::string_view(samples[c.sample]).substr(c.offset, c.length)});
+	}
+	std::sort(ranked.begin(), ranked.end(), [](const Scored& x, const Scored& y) {
+		return x.score != y.score ? x.score > y.score : x.text < y.text;
+	});
+
+	std::vector<std::string_view> chosen;
+	std::string covered;
+	for (const Scored& s : ranked) {
+		if (covered.size() + s.text.size() > maxBytes) {
+			if (maxBytes - covered.size() < kMinLength * 4) break;
+			continue;
+		}
+		if (covered.find(s.text) != std::string::npos) continue;
+		covered += s.text;
+		chosen.push_back(s.text);
+	}
+	// Deflate codes near distances in fewer bits, so the most valuable strings go last
+	std::string dictionary;
+	dictionary.reserve(covered.size());
+	for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) dictionary += *it;
+	return dictionary;
+}
+
+uint32_t textDictionaryId(std::string_view dictionary) {
+	uint64_t h = fastHash64(dictionary, kDictionarySeed);
+	return static_cast<uint32_t>(h ^ (h >> 32)) | 1u; // never 0
+}
+
+std::vector<std::string> makeSyntheticServiceNotes(size_t count, uint32_t seed) {
+	static const char* const kJobs[] = {
+		"Engine oil and filter replaced (5W-30, 4.2 L)", "Oil change, filter replaced", "Front brake pads replaced, discs within limits",
+		"Rear brake shoes adjusted", "Tyre rotation and balance, pressures set to 2.3 bar", "Battery tested, terminals cleaned",
+		"Timing belt and water pump replaced", "Air filter replaced", "Cabin filter replaced", "Coolant flushed and refilled",
+		"Spark plugs replaced", "Wheel alignment done", "Wiper blades replaced", "Transmission fluid changed",
+		"A/C regassed, leak test OK", "Front shock absorbers replaced", "Fuel filter replaced", "Drive belt inspected, tension adjusted",
+		"Brake fluid flushed (DOT 4)", "Diagnostic scan, no stored codes"};
+	static const char* const kComplaints[] = {
+		"noise from front left wheel", "vibration at highway speed", "check engine light on", "hard starting in the morning",
+		"brake squeal when stopping", "A/C not cooling", "vehicle pulling to the right", "oil leak under engine", "rattle from exhaust"};
+	static const char* const kRemarks[] = {
+		"Road tested, OK.", "Advised customer to replace rear tyres soon.", "Washed and vacuumed.",
+		"Customer to return for wheel alignment.", "Warranty claim submitted.", "Old parts returned to customer.",
+		"Recommend brake fluid change at next service."};
+	static const char* const kParts[] = {"90915-YZZD4", "04465-0K090", "17801-0L040", "87139-0K060", "90919-01253", "16100-09490"};
+	std::mt19937 rng(seed);
+	auto pick = [&](const auto& list) { return list[rng() % std::size(list)]; };
+	std::vector<std::string> notes;
+	notes.reserve(count);
+	char buf[96];
+	for (size_t i = 0; i < count; ++i) {
+		std::string note;
+		unsigned km = 10000 * (1 + rng() % 25);
+		if (rng() % 3 == 0) {
+			note = std::string("Customer reports ") + pick(kComplaints) + ". ";
+		} else {
+			std::snprintf(buf, sizeof buf, "%u km service. ", km);
+			note = buf;
+		}
+		for (unsigned j = 0, jobs = 1 + rng() % 3; j < jobs; ++j) {
+			note += pick(kJobs);
+			note += j + 1 < jobs ? "; " : ". ";
+		}
+		if (rng() % 2) {
+			std::snprintf(buf, sizeof buf, "Parts: %s x%u. ", pick(kParts), 1 + static_cast<unsigned>(rng() % 4));
+			note += buf;
+		}
+		if (rng() % 2) { note += pick(kRemarks); note += ' '; }
+		std::snprintf(buf, sizeof buf, "Next service due at %u km.", km + 10000);
+		note += buf;
+		notes.push_back(std::move(note));
+	}
+	return notes;
+}
+
+struct DescriptionCodec::Streams {
+#ifdef VSRM_HAS_ZLIB
+	z_stream deflater{};
+	z_stream inflater{};
+	bool ready{false};
+	Streams() {
+		bool d = deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+		bool i = inflateInit2(&inflater, -15) == Z_OK;
+		ready = d && i;
+	}
+	~Streams() {
+		deflateEnd(&deflater);
+		inflateEnd(&inflater);
+	}
+#endif
+};
+
+DescriptionCodec::DescriptionCodec() : z(std::make_unique<Streams>()) {}
+
+DescriptionCodec::~DescriptionCodec() = default;
+
+void DescriptionCodec::setActive(std::string dictionary) {
+	uint32_t id = textDictionaryId(dictionary);
+	dictionaries[id] = std::move(dictionary);
+	active = id;
+	activeLoaded = true;
+}
+
+std::optional<uint32_t> DescriptionCodec::activeId(sqlite3* db) {
+	loadActive(db);
+	return active;
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+void DescriptionCodec::loadActive(sqlite3* db) {
+	if (!db) return;
+	// Another connection may have trained since; the counter moves with every change to the file
+	unsigned version = 0;
+	bool versioned = sqlite3_file_control(db, "main", SQLITE_FCNTL_DATA_VERSION, &version) == SQLITE_OK;
+	if (activeLoaded && (!versioned || version == dataVersion)) return;
+	activeLoaded = true;
+	dataVersion = version;
+	sqlite3_stmt* stmt = nullptr;
+	// Fails before the text_dictionaries migration: nothing to pack with yet
+	if (sqlite3_prepare_v2(db, "SELECT id, data FROM text_dictionaries ORDER BY trained_at DESC, id DESC LIMIT 1;", -1, &stmt, nullptr) != SQLITE_OK)
+		return;
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		uint32_t id = static_cast<uint32_t>(sqlite3_column_int64(stmt, 0));
+		const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, 1));
+		dictionaries[id].assign(data ? data : "", sqlite3_column_bytes(stmt, 1));
+		active = id;
+	}
+	sqlite3_finalize(stmt);
+}
+
+const std::string* DescriptionCodec::dictionary(sqlite3* db, uint32_t id) {
+	if (auto it = dictionaries.find(id); it != dictionaries.end()) return &it->second;
+	if (!db) return nullptr;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT data FROM text_dictionaries WHERE id = ?1;", -1, &stmt, nullptr) != SQLITE_OK) return nullptr;
+	sqlite3_bind_int64(stmt, 1, id);
+	const std::string* found = nullptr;
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, 0));
+		std::string& slot = dictionaries[id];
+		slot.assign(data ? data : "", sqlite3_column_bytes(stmt, 0));
+		found = &slot;
+	}
+	sqlite3_finalize(stmt);
+	return found;
+}
+
+#else
+
+void DescriptionCodec::loadActive(sqlite3*) { activeLoaded = true; }
+
+const std::string* DescriptionCodec::dictionary(sqlite3*, uint32_t id) {
+	auto it = dictionaries.find(id);
+	return it != dictionaries.end() ? &it->second : nullptr;
+}
+
+#endif
+
+bool DescriptionCodec::pack(sqlite3* db, std::string_view text, std::string& packed) {
+	auto started = std::chrono::steady_clock::now();
+	bool ok = false;
+#ifdef VSRM_HAS_ZLIB
+	if (text.size() >= kMinPackedDescription && z->ready) {
+		loadActive(db);
+		const std::string* dict = active ? dictionary(db, *active) : nullptr;
+		ok = dict && deflateWith(z->deflater, *dict, *active, text, packed) && packed.size() < text.size();
+	}
+#else
+	(void)db; (void)text; (void)packed;
+#endif
+	++(ok ? counters.packed : counters.keptPlain);
+	counters.packNanoseconds += nanosSince(started);
+	return ok;
+}
+
+bool DescriptionCodec::unpack(sqlite3* db, std::string_view packed, std::string& text, std::string& error) {
+	if (packed.size() < kDescriptionHeaderBytes || packed[0] != kPackedTag) { error = "Not a packed description"; return false; }
+#ifndef VSRM_HAS_ZLIB
+	(void)db; (void)text;
+	error = "Built without zlib; compressed descriptions cannot be read";
+	return false;
+#else
+	auto started = std::chrono::steady_clock::now();
+	const uint32_t id = getId(packed);
+	const std::string* dict = dictionary(db, id);
+	if (!dict) { error = "Description dictionary " + std::to_string(id) + " is missing"; return false; }
+	if (!z->ready || !inflateWith(z->inflater, *dict, packed, text)) { error = "Compressed description is damaged"; return false; }
+	++counters.unpacked;
+	counters.unpackNanoseconds += nanosSince(started);
+	return true;
+#endif
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+void textFunction(sqlite3_context* ctx, int, sqlite3_value** argv) {
+	if (sqlite3_value_type(argv[0]) != SQLITE_BLOB) { sqlite3_result_value(ctx, argv[0]); return; }
+	auto* codec = static_cast<DescriptionCodec*>(sqlite3_user_data(ctx));
+	const char* data = static_cast<const char*>(sqlite3_value_blob(argv[0]));
+	std::string_view packed(data ? data : "", static_cast<size_t>(sqlite3_value_bytes(argv[0])));
+	std::string text, error;
+	if (!codec->unpack(sqlite3_context_db_handle(ctx), packed, text, error)) { sqlite3_result_error(ctx, error.c_str(), -1); return; }
+	sqlite3_result_text(ctx, text.data(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+}
+
+void packFunction(sqlite3_context* ctx, int, sqlite3_value** argv) {
+	if (sqlite3_value_type(argv[0]) != SQLITE_TEXT) { sqlite3_result_value(ctx, argv[0]); return; }
+	auto* codec = static_cast<DescriptionCodec*>(sqlite3_user_data(ctx));
+	const char* data = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+	std::string_view text(data ? data : "", static_cast<size_t>(sqlite3_value_bytes(argv[0])));
+	std::string packed;
+	if (codec->pack(sqlite3_context_db_handle(ctx), text, packed))
+		sqlite3_result_blob(ctx, packed.data(), static_cast<int>(packed.size()), SQLITE_TRANSIENT);
+	else
+		sqlite3_result_value(ctx, argv[0]);
+}
+
+std::string idBytes(std::optional<uint32_t> id) {
+	std::string out;
+	if (id) putId(out, *id);
+	return out;
+}
+
+void bindId(sqlite3_stmt* stmt, int index, const std::string& bytes) {
+	if (bytes.empty()) sqlite3_bind_null(stmt, index);
+	else sqlite3_bind_blob(stmt, index, bytes.data(), static_cast<int>(bytes.size()), SQLITE_TRANSIENT);
+}
+
+int64_t storedBytes(sqlite3* db) {
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT COALESCE(SUM(length(CAST(description AS BLOB))), 0) FROM service_records;", -1, &stmt, nullptr) != SQLITE_OK)
+		return 0;
+	int64_t bytes = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+	sqlite3_finalize(stmt);
+	return bytes;
+}
+
+} // namespace
+
+bool registerDescriptionFunctions(sqlite3* db, DescriptionCodec* codec, std::string& error) {
+	// vsrm_pack depends on the newest dictionary, so only vsrm_text is deterministic
+	if (sqlite3_create_function(db, "vsrm_text", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, codec, textFunction, nullptr, nullptr) != SQLITE_OK ||
+		sqlite3_create_function(db, "vsrm_pack", 1, SQLITE_UTF8, codec, packFunction, nullptr, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	return true;
+}
+
+bool trainDescriptionDictionary(sqlite3* db, DescriptionCodec& codec, const DictionaryTrainOptions& options,
+	DictionaryTrainStats& stats, std::string& error) {
+	stats = {};
+#ifndef VSRM_HAS_ZLIB
+	(void)db; (void)codec; (void)options;
+	error = "Built without zlib; descriptions are stored uncompressed";
+	return false;
+#else
+	auto started = std::chrono::steady_clock::now();
+	std::vector<std::string> samples;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT vsrm_text(description) FROM service_records ORDER BY id DESC LIMIT ?1;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(options.maxSamples));
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+		samples.emplace_back(text ? text : "", sqlite3_column_bytes(stmt, 0));
+	}
+	if (rc != SQLITE_DONE) error = sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE) return false;
+
+	std::string dictionary = trainTextDictionary(samples, options.dictionaryBytes);
+	if (dictionary.empty()) { error = "Descriptions do not repeat enough to train a dictionary"; return false; }
+	stats.id = textDictionaryId(dictionary);
+	stats.samples = samples.size();
+	stats.dictionaryBytes = dictionary.size();
+
+	// What the samples would take packed, against raw deflate on its own
+	z_stream z{};
+	if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) { error = "zlib initialisation failed"; return false; }
+	std::string packed;
+	for (const std::string& s : samples) {
+		if (s.size() < kMinPackedDescription) continue;
+		stats.sampleBytes += s.size();
+		stats.packedBytes += deflateWith(z, dictionary, stats.id, s, packed) ? std::min(packed.size(), s.size()) : s.size();
+		stats.plainDeflateBytes += deflateWith(z, {}, 0, s, packed) ? std::min(packed.size(), s.size()) : s.size();
+	}
+	deflateEnd(&z);
+
+	if (sqlite3_prepare_v2(db, "SELECT 1 FROM text_dictionaries WHERE id = ?1;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_bind_int64(stmt, 1, stats.id);
+	stats.alreadyStored = sqlite3_step(stmt) == SQLITE_ROW;
+	sqlite3_finalize(stmt);
+	// Retraining to the same bytes makes that dictionary the newest again
+	if (sqlite3_prepare_v2(db, "INSERT INTO text_dictionaries (id, trained_at, samples, data) "
+			"VALUES (?1, strftime('%Y-%m-%dT%H:%M:%fZ', 'now'), ?2, ?3) "
+			"ON CONFLICT (id) DO UPDATE SET trained_at = excluded.trained_at;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_bind_int64(stmt, 1, stats.id);
+	sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(samples.size()));
+	sqlite3_bind_blob(stmt, 3, dictionary.data(), static_cast<int>(dictionary.size()), SQLITE_STATIC);
+	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+	if (!ok) error = sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	if (!ok) return false;
+	codec.setActive(std::move(dictionary));
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	stats.milliseconds = took.count();
+	return true;
+#endif
+}
+
+bool describeDescriptionStorage(sqlite3* db, DescriptionCodec& codec, DescriptionStorage& out, std::string& error) {
+	out = {};
+	out.activeId = codec.activeId(db);
+	auto started = std::chrono::steady_clock::now();
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT COUNT(*), COALESCE(SUM(typeof(description) = 'blob'), 0), "
+			"COALESCE(SUM(typeof(description) = 'blob' AND substr(description, 2, 4) IS NOT ?1), 0), "
+			"COALESCE(SUM(length(CAST(description AS BLOB))), 0), "
+			"COALESCE(SUM(length(CAST(vsrm_text(description) AS BLOB))), 0) FROM service_records;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	bindId(stmt, 1, idBytes(out.activeId));
+	bool ok = sqlite3_step(stmt) == SQLITE_ROW;
+	if (ok) {
+		out.rows = sqlite3_column_int64(stmt, 0);
+		out.packedRows = sqlite3_column_int64(stmt, 1);
+		out.packedWithOlder = sqlite3_column_int64(stmt, 2);
+		out.storedBytes = sqlite3_column_int64(stmt, 3);
+		out.textBytes = sqlite3_column_int64(stmt, 4);
+	} else {
+		error = sqlite3_errmsg(db);
+	}
+	sqlite3_finalize(stmt);
+	if (!ok) return false;
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	out.readMilliseconds = took.count();
+
+	if (sqlite3_prepare_v2(db, "SELECT COUNT(*), COALESCE(SUM(length(data)), 0) FROM text_dictionaries;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		out.dictionaries = sqlite3_column_int64(stmt, 0);
+		out.dictionaryBytes = sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+	return true;
+}
+
+bool recompressDescriptions(sqlite3* db, DescriptionCodec& codec, DescriptionRecompressStats& stats, std::string& error) {
+	stats = {};
+	auto started = std::chrono::steady_clock::now();
+	std::optional<uint32_t> active = codec.activeId(db);
+	if (!active) { error = "No description dictionary yet; train one first"; return false; }
+	stats.bytesBefore = storedBytes(db);
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "UPDATE service_records SET description = vsrm_pack(vsrm_text(description)) "
+			"WHERE (typeof(description) = 'text' AND length(CAST(description AS BLOB)) >= ?2) "
+			"OR (typeof(description) = 'blob' AND substr(description, 2, 4) IS NOT ?1);", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	bindId(stmt, 1, idBytes(active));
+	sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(kMinPackedDescription));
+	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+	if (ok) stats.rewritten = sqlite3_changes(db);
+	else error = sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	if (!ok) return false;
+	stats.bytesAfter = storedBytes(db);
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	stats.milliseconds = took.count();
+	return true;
+}
+
+#else
+
+bool registerDescriptionFunctions(sqlite3*, DescriptionCodec*, std::string& error) { error = "SQLite not available."; return false; }
+bool trainDescriptionDictionary(sqlite3*, DescriptionCodec&, const DictionaryTrainOptions&, DictionaryTrainStats& stats, std::string& error) {
+	stats = {}; error = "SQLite not available."; return false;
+}
+bool describeDescriptionStorage(sqlite3*, DescriptionCodec&, DescriptionStorage& out, std::string& error) {
+	out = {}; error = "SQLite not available."; return false;
+}
+bool recompressDescriptions(sqlite3*, DescriptionCodec&, DescriptionRecompressStats& stats, std::string& error) {
+	stats = {}; error = "SQLite not available."; return false;
+}
+
+#endif
+
+} // namespace vsrm
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct sqlite3;
+
+namespace vsrm {
+
+// Dictionary compression of service_records.description.
+//
+// Technician notes repeat the same phrases endlessly but are too short for a compressor to find
+// the repeats inside one note. A dictionary trained on stored notes (the phrases that recur most,
+// the most valuable placed last) is fed to raw deflate as its preset window, so a note compresses
+// against every phrase the workshop uses. Dictionaries live in text_dictionaries, keyed by a hash
+// of their bytes, and are never deleted: a stored value names the one it was packed with, so
+// retraining only changes what later writes use.
+//
+// Stored values are plain TEXT (short notes, no dictionary yet, or no saving) or a BLOB:
+// 'D', u32 dictionary id (little-endian), raw deflate. The connection's vsrm_pack(text) picks
+// the form on write and vsrm_text(value) turns either back into text when a row is read, so
+// nothing is decompressed that a query does not return.
+
+constexpr size_t kMinPackedDescription = 24; // bytes; shorter notes are never worth the header
+constexpr size_t kDescriptionHeaderBytes = 5;
+
+// Byte strings that recur across samples, most valuable last, at most maxBytes in all. Empty if
+// nothing repeats. Deflate can reach back 32 KB, so larger dictionaries are truncated to that.
+std::string trainTextDictionary(const std::vector<std::string>& samples, size_t maxBytes);
+
+// Dictionary id as stored in text_dictionaries and in each packed value
+uint32_t textDictionaryId(std::string_view dictionary);
+
+struct DescriptionCodecStats {
+	uint64_t packed{};      // values written compressed
+	uint64_t keptPlain{};   // values written as text (too short, no dictionary, no saving)
+	uint64_t unpacked{};
+	uint64_t packNanoseconds{};
+	uint64_t unpackNanoseconds{};
+};
+
+// One per connection: caches the dictionaries it has used and reuses its zlib streams.
+// Not thread-safe.
+class DescriptionCodec {
+public:
+	DescriptionCodec();
+	~DescriptionCodec();
+	DescriptionCodec(const DescriptionCodec&) = delete;
+	DescriptionCodec& operator=(const DescriptionCodec&) = delete;
+
+	// Compressed form of text with the newest dictionary; false when text should be stored as is
+	bool pack(sqlite3* db, std::string_view text, std::string& packed);
+	// Text of a packed value; loads its dictionary from db on first use
+	bool unpack(sqlite3* db, std::string_view packed, std::string& text, std::string& error);
+	// Packs with this dictionary from now on (after training on this connection)
+	void setActive(std::string dictionary);
+	std::optional<uint32_t> activeId(sqlite3* db);
+	const DescriptionCodecStats& stats() const { return counters; }
+
+private:
+	struct Streams;
+	std::unique_ptr<Streams> z;
+	std::unordered_map<uint32_t, std::string> dictionaries;
+	std::optional<uint32_t> active;
+	bool activeLoaded{false};
+	unsigned dataVersion{}; // of the file when active was loaded
+	DescriptionCodecStats counters;
+
+	const std::string* dictionary(sqlite3* db, uint32_t id);
+	void loadActive(sqlite3* db);
+};
+
+// Registers vsrm_text(value) and vsrm_pack(text) on db, bound to codec
+bool registerDescriptionFunctions(sqlite3* db, DescriptionCodec* codec, std::string& error);
+
+struct DictionaryTrainOptions {
+	size_t maxSamples{20000};    // most recent descriptions
+	size_t dictionaryBytes{8192}; // every pack primes deflate with all of it
+};
+
+struct DictionaryTrainStats {
+	uint32_t id{};
+	bool alreadyStored{false};  // the same dictionary had been trained before
+	size_t samples{};
+	size_t dictionaryBytes{};
+	uint64_t sampleBytes{};     // samples long enough to pack
+	uint64_t packedBytes{};     // the same, packed with the new dictionary (headers included)
+	uint64_t plainDeflateBytes{}; // ... and with raw deflate and no dictionary, for comparison
+	double milliseconds{};
+};
+
+// Trains on the most recent descriptions and stores the dictionary (inside the caller's transaction)
+bool trainDescriptionDictionary(sqlite3* db, DescriptionCodec& codec, const DictionaryTrainOptions& options,
+	DictionaryTrainStats& stats, std::string& error);
+
+struct DescriptionStorage {
+	int64_t rows{};
+	int64_t packedRows{};
+	int64_t packedWithOlder{};  // packed with a dictionary other than the newest
+	int64_t storedBytes{};      // description column as stored
+	int64_t textBytes{};        // the same as text
+	int64_t dictionaries{};
+	int64_t dictionaryBytes{};
+	std::optional<uint32_t> activeId;
+	double readMilliseconds{};  // reading every description back as text
+};
+
+bool describeDescriptionStorage(sqlite3* db, DescriptionCodec& codec, DescriptionStorage& out, std::string& error);
+
+struct DescriptionRecompressStats {
+	int64_t rewritten{};
+	int64_t bytesBefore{};
+	int64_t bytesAfter{};
+	double milliseconds{};
+};
+
+// Rewrites plain descriptions and ones packed with older dictionaries using the newest one
+// (inside the caller's transaction)
+bool recompressDescriptions(sqlite3* db, DescriptionCodec& codec, DescriptionRecompressStats& stats, std::string& error);
+
+// Realistic technician notes for benchmarks: templated jobs, parts, readings and remarks
+std::vector<std::string> makeSyntheticServiceNotes(size_t count, uint32_t seed);
+
+} // namespace vsrm
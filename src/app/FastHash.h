@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace vsrm {
+
+// 64-bit non-cryptographic string hash: multiply/rotate over 8-byte words, then the
+// murmur3 finalizer so every input bit reaches every output bit. Results are persisted
+// (analytics sketches), so the function must never change; words are read little-endian.
+inline uint64_t fastHash64(std::string_view s, uint64_t seed = 0) {
+	constexpr uint64_t kGolden = 0x9E3779B97F4A7C15ull;
+	uint64_t h = seed ^ (static_cast<uint64_t>(s.size()) * kGolden);
+	const char* p = s.data();
+	size_t n = s.size();
+	for (; n >= 8; p += 8, n -= 8) {
+		uint64_t w;
+		std::memcpy(&w, p, 8);
+		h ^= w * 0xBF58476D1CE4E5B9ull;
+		h = (h << 27 | h >> 37) * kGolden;
+	}
+	uint64_t tail = 0;
+	if (n) std::memcpy(&tail, p, n);
+	h ^= tail * 0x94D049BB133111EBull;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+} // namespace vsrm
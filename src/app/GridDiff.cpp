@@ -0,0 +1,62 @@
+#include "GridDiff.h"
+
+#include <string_view>
+#include <unordered_map>
+
+namespace vsrm {
+
+bool sameSummary(const VehicleSummary& a, const VehicleSummary& b) {
+	return a.vin == b.vin && a.make == b.make && a.model == b.model &&
+		a.lastServiceDate == b.lastServiceDate && a.mechanic == b.mechanic &&
+		a.nextService == b.nextService && a.status == b.status;
+}
+
+std::vector<GridOp> diffVehicleSummaries(const std::vector<VehicleSummary>& before,
+                                         const std::vector<VehicleSummary>& after) {
+	std::unordered_map<std::string_view, size_t> oldIndex;
+	oldIndex.reserve(before.size());
+	for (size_t i = 0; i < before.size(); ++i) oldIndex.emplace(before[i].vin, i);
+
+	// For every new row, the old row it corresponds to (or -1)
+	std::vector<ptrdiff_t> match(after.size(), -1);
+	std::vector<char> claimed(before.size(), 0);
+	for (size_t j = 0; j < after.size(); ++j) {
+		auto it = oldIndex.find(after[j].vin);
+		if (it != oldIndex.end() && !claimed[it->second]) {
+			match[j] = static_cast<ptrdiff_t>(it->second);
+			claimed[it->second] = 1;
+		}
+	}
+
+	// Longest increasing subsequence of old indices = rows that can stay put.
+	// tails[k] holds the new-list position ending the best run of length k+1.
+	std::vector<size_t> tails;
+	std::vector<ptrdiff_t> prev(after.size(), -1);
+	for (size_t j = 0; j < after.size(); ++j) {
+		if (match[j] < 0) continue;
+		size_t lo = 0, hi = tails.size();
+		while (lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if (match[tails[mid]] < match[j]) lo = mid + 1; else hi = mid;
+		}
+		if (lo > 0) prev[j] = static_cast<ptrdiff_t>(tails[lo - 1]);
+		if (lo == tails.size()) tails.push_back(j); else tails[lo] = j;
+	}
+	std::vector<char> stayNew(after.size(), 0), stayOld(before.size(), 0);
+	for (ptrdiff_t j = tails.empty() ? -1 : static_cast<ptrdiff_t>(tails.back()); j >= 0; j = prev[j]) {
+		stayNew[j] = 1;
+		stayOld[match[j]] = 1;
+	}
+
+	std::vector<GridOp> ops;
+	for (size_t i = before.size(); i-- > 0;) {
+		if (!stayOld[i]) ops.push_back(GridOp{GridOp::Kind::Remove, static_cast<int>(i), 0});
+	}
+	for (size_t j = 0; j < after.size(); ++j) {
+		if (!stayNew[j]) ops.push_back(GridOp{GridOp::Kind::Insert, static_cast<int>(j), j});
+		else if (!sameSummary(before[match[j]], after[j])) ops.push_back(GridOp{GridOp::Kind::Update, static_cast<int>(j), j});
+	}
+	return ops;
+}
+
+} // namespace vsrm
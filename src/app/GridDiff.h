@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Database.h"
+
+namespace vsrm {
+
+// One edit to turn the displayed rows into the new result set.
+struct GridOp {
+	enum class Kind { Remove, Insert, Update } kind{};
+	int row{};          // Remove: row in the old list; Insert/Update: row in the new list
+	size_t source{};    // Insert/Update: index into the new list
+};
+
+// Diffs two summary lists keyed by VIN. Apply the ops in the order returned:
+// removals come first (highest row first), then inserts and updates in
+// ascending row order. Rows that only moved are emitted as Remove + Insert;
+// the set of rows left in place is the longest run that kept its order, so
+// the number of moves is minimal.
+std::vector<GridOp> diffVehicleSummaries(const std::vector<VehicleSummary>& before,
+                                         const std::vector<VehicleSummary>& after);
+
+bool sameSummary(const VehicleSummary& a, const VehicleSummary& b);
+
+} // namespace vsrm
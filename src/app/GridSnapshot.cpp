@@ -0,0 +1,162 @@
+#include "GridSnapshot.h"
+
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace vsrm {
+
+static_assert(std::endian::native == std::endian::little, "snapshot layout is little-endian");
+
+namespace {
+
+constexpr char kMagic[8] = {'V', 'S', 'R', 'M', 'G', 'R', 'I', 'D'};
+constexpr uint32_t kAbsent = 0xFFFFFFFFu;
+constexpr uint32_t kFlagHasCounter = 1u << 0;
+constexpr uint32_t kFlagDueOnly = 1u << 1;
+constexpr size_t kFilterRefs = 4;
+
+struct Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t rowCount;
+	uint32_t flags;
+	uint32_t dbChangeCounter;
+	uint64_t checksum;     // FNV-1a of everything after the header
+	uint64_t stringBytes;
+};
+
+struct StrRef {
+	uint32_t offset;
+	uint32_t length;
+};
+
+uint64_t fnv1a(const unsigned char* p, size_t n) {
+	uint64_t h = 14695981039346656037ull;
+	for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 1099511628211ull; }
+	return h;
+}
+
+fs::path pathFromUtf8(const std::string& s) {
+	return fs::path(std::u8string(s.begin(), s.end()));
+}
+
+} // namespace
+
+bool GridSnapshotFile::write(const std::string& path, const GridSnapshot& snapshot, std::string& error) {
+	std::vector<StrRef> refs;
+	std::string strings;
+	refs.reserve(kFilterRefs + snapshot.rows.size() * kColumns);
+	auto add = [&](const std::optional<std::string_view>& s) {
+		if (!s) { refs.push_back(StrRef{0, kAbsent}); return; }
+		refs.push_back(StrRef{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(s->size())});
+		strings.append(s->data(), s->size());
+	};
+	auto opt = [](const std::optional<std::string>& s) { return s ? std::optional<std::string_view>(*s) : std::nullopt; };
+	add(std::string_view(snapshot.filter.vinLike));
+	add(opt(snapshot.filter.fromDate));
+	add(opt(snapshot.filter.toDate));
+	add(opt(snapshot.filter.mechanicLike));
+	for (const auto& v : snapshot.rows) {
+		add(std::string_view(v.vin)); add(std::string_view(v.make)); add(std::string_view(v.model));
+		add(std::string_view(v.lastServiceDate)); add(std::string_view(v.mechanic));
+		add(opt(v.nextService)); add(std::string_view(v.status));
+	}
+	if (strings.size() >= kAbsent) { error = "Snapshot too large"; return false; }
+
+	std::vector<unsigned char> body(refs.size() * sizeof(StrRef) + strings.size());
+	if (!refs.empty()) std::memcpy(body.data(), refs.data(), refs.size() * sizeof(StrRef));
+	if (!strings.empty()) std::memcpy(body.data() + refs.size() * sizeof(StrRef), strings.data(), strings.size());
+
+	Header h{};
+	std::memcpy(h.magic, kMagic, sizeof(kMagic));
+	h.version = kVersion;
+	h.rowCount = static_cast<uint32_t>(snapshot.rows.size());
+	h.flags = (snapshot.dbChangeCounter ? kFlagHasCounter : 0) | (snapshot.filter.dueOnly ? kFlagDueOnly : 0);
+	h.dbChangeCounter = snapshot.dbChangeCounter.value_or(0);
+	h.checksum = fnv1a(body.data(), body.size());
+	h.stringBytes = strings.size();
+
+	// Write beside the target and rename, so readers never see a half-written file
+	fs::path target = pathFromUtf8(path);
+	fs::path tmp = target; tmp += ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+		if (!out) { error = "Cannot write snapshot: " + path; return false; }
+		out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+		out.write(reinterpret_cast<const char*>(body.data()), static_cast<std::streamsize>(body.size()));
+		if (!out) { error = "Cannot write snapshot: " + path; return false; }
+	}
+	std::error_code ec;
+	fs::rename(tmp, target, ec);
+	if (ec) { error = "Cannot replace snapshot: " + ec.message(); fs::remove(tmp, ec); return false; }
+	return true;
+}
+
+bool GridSnapshotFile::open(const std::string& path, std::string& error) {
+	rows = 0;
+	if (!map.open(path)) { error = "No snapshot at " + path; return false; }
+	if (map.size() < sizeof(Header)) { error = "Snapshot truncated"; map.close(); return false; }
+	Header h;
+	std::memcpy(&h, map.data(), sizeof(h));
+	uint64_t refBytes = (kFilterRefs + uint64_t(h.rowCount) * kColumns) * sizeof(StrRef);
+	if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion) {
+		error = "Not a version 1 grid snapshot"; map.close(); return false;
+	}
+	if (map.size() != sizeof(Header) + refBytes + h.stringBytes) { error = "Snapshot size mismatch"; map.close(); return false; }
+	if (fnv1a(map.data() + sizeof(Header), map.size() - sizeof(Header)) != h.checksum) {
+		error = "Snapshot checksum mismatch"; map.close(); return false;
+	}
+	rows = h.rowCount;
+	for (size_t i = 0; i < kFilterRefs + size_t(rows) * kColumns; ++i) {
+		StrRef r;
+		std::memcpy(&r, map.data() + sizeof(Header) + i * sizeof(StrRef), sizeof(r));
+		if (r.length != kAbsent && uint64_t(r.offset) + r.length > h.stringBytes) {
+			error = "Snapshot string out of range"; rows = 0; map.close(); return false;
+		}
+	}
+	return true;
+}
+
+std::optional<std::string_view> GridSnapshotFile::ref(size_t refIndex) const {
+	StrRef r;
+	std::memcpy(&r, map.data() + sizeof(Header) + refIndex * sizeof(StrRef), sizeof(r));
+	if (r.length == kAbsent) return std::nullopt;
+	size_t refCount = kFilterRefs + size_t(rows) * kColumns;
+	const char* strings = reinterpret_cast<const char*>(map.data() + sizeof(Header) + refCount * sizeof(StrRef));
+	return std::string_view(strings + r.offset, r.length);
+}
+
+std::optional<std::string_view> GridSnapshotFile::cell(uint32_t row, int column) const {
+	if (row >= rows || column < 0 || column >= kColumns) return std::nullopt;
+	return ref(kFilterRefs + size_t(row) * kColumns + column);
+}
+
+GridSnapshot GridSnapshotFile::load() const {
+	GridSnapshot s;
+	if (!map.data()) return s;
+	Header h;
+	std::memcpy(&h, map.data(), sizeof(h));
+	auto str = [](const std::optional<std::string_view>& v) { return v ? std::string(*v) : std::string(); };
+	auto opt = [](const std::optional<std::string_view>& v) { return v ? std::optional<std::string>(std::string(*v)) : std::nullopt; };
+	s.filter.vinLike = str(ref(0));
+	s.filter.fromDate = opt(ref(1));
+	s.filter.toDate = opt(ref(2));
+	s.filter.mechanicLike = opt(ref(3));
+	s.filter.dueOnly = (h.flags & kFlagDueOnly) != 0;
+	if (h.flags & kFlagHasCounter) s.dbChangeCounter = h.dbChangeCounter;
+	s.rows.reserve(rows);
+	for (uint32_t r = 0; r < rows; ++r) {
+		VehicleSummary v;
+		v.vin = str(cell(r, 0)); v.make = str(cell(r, 1)); v.model = str(cell(r, 2));
+		v.lastServiceDate = str(cell(r, 3)); v.mechanic = str(cell(r, 4));
+		v.nextService = opt(cell(r, 5)); v.status = str(cell(r, 6));
+		s.rows.push_back(std::move(v));
+	}
+	return s;
+}
+
+} // namespace vsrm
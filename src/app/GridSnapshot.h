@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Database.h"
+#include "MappedFile.h"
+
+namespace vsrm {
+
+// Last grid contents persisted on exit so the next launch can show rows
+// immediately and revalidate in the background.
+struct GridSnapshot {
+	SummaryQuery filter;                      // filter as entered (not normalized)
+	std::optional<uint32_t> dbChangeCounter;  // Database::fileChangeCounter() when written
+	std::vector<VehicleSummary> rows;
+};
+
+// File layout (little-endian, version 1), designed to be read in place from a mapping:
+//   Header | filter: 4 StrRef | rows: rowCount x 7 StrRef | string bytes
+// A StrRef is {uint32 offset, uint32 length} into the string area; length
+// 0xFFFFFFFF marks an absent optional. The header carries an FNV-1a checksum
+// of everything after it, so a torn or foreign file is rejected.
+class GridSnapshotFile {
+public:
+	static constexpr uint32_t kVersion = 1;
+	static constexpr int kColumns = 7;  // vin, make, model, last, mechanic, next, status
+
+	static bool write(const std::string& path, const GridSnapshot& snapshot, std::string& error);
+
+	bool open(const std::string& path, std::string& error);
+	uint32_t rowCount() const { return rows; }
+	std::optional<std::string_view> cell(uint32_t row, int column) const;
+	GridSnapshot load() const;
+
+private:
+	std::optional<std::string_view> ref(size_t refIndex) const;
+
+	MappedFile map;
+	uint32_t rows{0};
+};
+
+} // namespace vsrm
@@ -0,0 +1,109 @@
+#include "IntervalIndex.h"
+
+#include <algorithm>
+
+#include "Dates.h"
+
+namespace vsrm {
+
+void IntervalSet::insert(const BookedInterval& interval) {
+	byStart.emplace(interval.start, interval);
+	maxLength = std::max(maxLength, interval.end - interval.start);
+}
+
+void IntervalSet::erase(int64_t start, int appointmentId) {
+	auto [lo, hi] = byStart.equal_range(start);
+	for (auto it = lo; it != hi; ++it) {
+		if (it->second.appointmentId == appointmentId) { byStart.erase(it); return; }
+	}
+}
+
+void IntervalSet::overlapping(int64_t start, int64_t end, std::vector<BookedInterval>& out) const {
+	// Nothing starting before start - maxLength can still be running at start
+	for (auto it = byStart.lower_bound(start - maxLength); it != byStart.end() && it->first < end; ++it) {
+		if (it->second.end > start) out.push_back(it->second);
+	}
+}
+
+void IntervalSet::gaps(int64_t from, int64_t to, int64_t minLength, std::vector<BookedInterval>& out) const {
+	int64_t freeFrom = from;
+	for (auto it = byStart.lower_bound(from - maxLength); it != byStart.end() && it->first < to; ++it) {
+		const BookedInterval& b = it->second;
+		if (b.end <= freeFrom) continue;
+		if (b.start > freeFrom && b.start - freeFrom >= minLength) out.push_back(BookedInterval{freeFrom, b.start, 0});
+		freeFrom = std::max(freeFrom, b.end);
+	}
+	if (to > freeFrom && to - freeFrom >= minLength) out.push_back(BookedInterval{freeFrom, to, 0});
+}
+
+void BookingIndex::clear() {
+	bookings.clear();
+	byMechanic.clear();
+	byVin.clear();
+	built = false;
+}
+
+void BookingIndex::addAppointment(int appointmentId, const std::string& vin, int64_t start, int64_t end) {
+	if (end <= start) end = start + 1; // zero-length bookings still block their start minute
+	if (!bookings.emplace(appointmentId, Booking{vin, start, end, std::nullopt}).second) return;
+	byVin[vin].insert(BookedInterval{start, end, appointmentId});
+}
+
+void BookingIndex::assign(int appointmentId, int mechanicId) {
+	auto it = bookings.find(appointmentId);
+	if (it == bookings.end() || it->second.mechanicId == mechanicId) return;
+	unassign(appointmentId);
+	it->second.mechanicId = mechanicId;
+	byMechanic[mechanicId].insert(BookedInterval{it->second.start, it->second.end, appointmentId});
+}
+
+void BookingIndex::unassign(int appointmentId) {
+	auto it = bookings.find(appointmentId);
+	if (it == bookings.end() || !it->second.mechanicId) return;
+	if (auto m = byMechanic.find(*it->second.mechanicId); m != byMechanic.end()) m->second.erase(it->second.start, appointmentId);
+	it->second.mechanicId.reset();
+}
+
+std::vector<BookingConflict> BookingIndex::conflicts(int64_t start, int64_t end, std::optional<int> mechanicId,
+	const std::optional<std::string>& vin, std::optional<int> ignoreAppointmentId) const {
+	std::vector<BookingConflict> result;
+	std::vector<BookedInterval> hits;
+	auto report = [&](BookingConflict::Kind kind, std::optional<int> mech) {
+		for (const auto& h : hits) {
+			if (ignoreAppointmentId && h.appointmentId == *ignoreAppointmentId) continue;
+			BookingConflict c{};
+			c.kind = kind;
+			c.appointmentId = h.appointmentId;
+			c.vin = bookings.at(h.appointmentId).vin;
+			c.mechanicId = mech;
+			c.startsAt = minutesToIso(h.start);
+			c.endsAt = minutesToIso(h.end);
+			result.push_back(std::move(c));
+		}
+		hits.clear();
+	};
+	if (mechanicId) {
+		if (auto it = byMechanic.find(*mechanicId); it != byMechanic.end()) it->second.overlapping(start, end, hits);
+		report(BookingConflict::Kind::Mechanic, mechanicId);
+	}
+	if (vin) {
+		if (auto it = byVin.find(*vin); it != byVin.end()) it->second.overlapping(start, end, hits);
+		report(BookingConflict::Kind::Vehicle, std::nullopt);
+	}
+	return result;
+}
+
+std::vector<TimeSlot> BookingIndex::freeSlots(int mechanicId, int64_t from, int64_t to, int64_t minLength) const {
+	std::vector<BookedInterval> gaps;
+	if (auto it = byMechanic.find(mechanicId); it != byMechanic.end()) {
+		it->second.gaps(from, to, std::max<int64_t>(minLength, 1), gaps);
+	} else if (to > from && to - from >= minLength) {
+		gaps.push_back(BookedInterval{from, to, 0});
+	}
+	std::vector<TimeSlot> result;
+	result.reserve(gaps.size());
+	for (const auto& g : gaps) result.push_back(TimeSlot{minutesToIso(g.start), minutesToIso(g.end)});
+	return result;
+}
+
+} // namespace vsrm
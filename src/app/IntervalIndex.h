@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vsrm {
+
+// Half-open [start, end) in minutes (see Dates.h)
+struct BookedInterval {
+	int64_t start{};
+	int64_t end{};
+	int appointmentId{};
+};
+
+// Intervals for one mechanic or one vehicle, ordered by start. The longest
+// interval ever inserted bounds how far before a query an overlapping one can
+// begin, so overlap and gap queries cost O(log n + k) for bookings of bounded
+// length (appointments are hours, not weeks).
+class IntervalSet {
+public:
+	void insert(const BookedInterval& interval);
+	void erase(int64_t start, int appointmentId);
+	size_t size() const { return byStart.size(); }
+
+	// Intervals overlapping [start, end), by start
+	void overlapping(int64_t start, int64_t end, std::vector<BookedInterval>& out) const;
+	// Gaps of at least minLength inside [from, to)
+	void gaps(int64_t from, int64_t to, int64_t minLength, std::vector<BookedInterval>& out) const;
+
+private:
+	std::multimap<int64_t, BookedInterval> byStart;
+	int64_t maxLength{0};
+};
+
+struct BookingConflict {
+	enum class Kind { Mechanic, Vehicle };
+	Kind kind{};
+	int appointmentId{};
+	std::string vin;
+	std::optional<int> mechanicId; // set for Kind::Mechanic
+	std::string startsAt;          // ISO 8601
+	std::string endsAt;
+};
+
+struct TimeSlot {
+	std::string startsAt; // ISO 8601
+	std::string endsAt;
+};
+
+// Open bookings (scheduled / in-progress appointments and the mechanic of their
+// latest assignment while it is uncompleted) indexed per mechanic and per VIN. Owned by Database, which
+// builds it on first use and keeps it current on its own inserts.
+class BookingIndex {
+public:
+	void clear();
+	void addAppointment(int appointmentId, const std::string& vin, int64_t start, int64_t end);
+	// Books the appointment on mechanicId, off the mechanic it had; no-op for appointments not indexed
+	void assign(int appointmentId, int mechanicId);
+	void unassign(int appointmentId); // its latest assignment is completed
+	size_t size() const { return bookings.size(); }
+
+	// Bookings overlapping [start, end) for the mechanic and/or the vehicle, excluding ignoreAppointmentId
+	std::vector<BookingConflict> conflicts(int64_t start, int64_t end, std::optional<int> mechanicId,
+		const std::optional<std::string>& vin, std::optional<int> ignoreAppointmentId) const;
+	std::vector<TimeSlot> freeSlots(int mechanicId, int64_t from, int64_t to, int64_t minLength) const;
+
+	// Freshness, maintained by Database (same scheme as SummaryCache)
+	bool built{false};
+	int64_t dataVersion{-1};
+	uint64_t changeSequence{0};
+
+private:
+	struct Booking {
+		std::string vin;
+		int64_t start;
+		int64_t end;
+		std::optional<int> mechanicId;
+	};
+	std::unordered_map<int, Booking> bookings;
+	std::unordered_map<int, IntervalSet> byMechanic;
+	std::unordered_map<std::string, IntervalSet> byVin;
+};
+
+} // namespace vsrm
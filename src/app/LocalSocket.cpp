@@ -0,0 +1,166 @@
+#include "LocalSocket.h"
+
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace vsrm {
+
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+static NativeSocket native(intptr_t fd) { return static_cast<SOCKET>(fd); }
+static void closeNative(intptr_t fd) { closesocket(native(fd)); }
+static std::string lastSocketError() { return "socket error " + std::to_string(WSAGetLastError()); }
+static bool startSockets(std::string& error) {
+	static const int rc = [] { WSADATA data; return WSAStartup(MAKEWORD(2, 2), &data); }();
+	if (rc != 0) error = "WSAStartup failed: " + std::to_string(rc);
+	return rc == 0;
+}
+#else
+using NativeSocket = int;
+static NativeSocket native(intptr_t fd) { return static_cast<int>(fd); }
+static void closeNative(intptr_t fd) { ::close(native(fd)); }
+static std::string lastSocketError() { return std::strerror(errno); }
+static bool startSockets(std::string&) { return true; }
+#endif
+
+static bool makeAddress(const std::string& path, sockaddr_un& addr, std::string& error) {
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+		error = "Socket path must be 1-" + std::to_string(sizeof(addr.sun_path) - 1) + " bytes: " + path;
+		return false;
+	}
+	std::memcpy(addr.sun_path, path.data(), path.size());
+	return true;
+}
+
+static intptr_t openSocket(std::string& error) {
+	if (!startSockets(error)) return -1;
+	NativeSocket s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+#ifdef _WIN32
+	if (s == INVALID_SOCKET) { error = lastSocketError(); return -1; }
+#else
+	if (s < 0) { error = lastSocketError(); return -1; }
+#endif
+	return static_cast<intptr_t>(s);
+}
+
+LocalSocket::~LocalSocket() { close(); }
+
+LocalSocket& LocalSocket::operator=(LocalSocket&& other) noexcept {
+	if (this != &other) {
+		close();
+		fd = other.fd;
+		other.fd = kInvalid;
+	}
+	return *this;
+}
+
+bool LocalSocket::listen(const std::string& path, std::string& error) {
+	close();
+	sockaddr_un addr;
+	if (!makeAddress(path, addr, error)) return false;
+	intptr_t s = openSocket(error);
+	if (s == kInvalid) return false;
+	// A live server answers connect(); only then is the path really in use
+	LocalSocket probe;
+	std::string ignored;
+	if (probe.connect(path, ignored)) {
+		closeNative(s);
+		error = "Another server is listening on " + path;
+		return false;
+	}
+	std::error_code ec;
+	std::filesystem::remove(std::filesystem::path(std::u8string(path.begin(), path.end())), ec);
+	if (::bind(native(s), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(native(s), SOMAXCONN) != 0) {
+		error = "Cannot listen on " + path + ": " + lastSocketError();
+		closeNative(s);
+		return false;
+	}
+	fd = s;
+	return true;
+}
+
+LocalSocket LocalSocket::accept() {
+	for (;;) {
+		NativeSocket c = ::accept(native(fd), nullptr, nullptr);
+#ifdef _WIN32
+		if (c != INVALID_SOCKET) return LocalSocket(static_cast<intptr_t>(c));
+		return LocalSocket();
+#else
+		if (c >= 0) return LocalSocket(c);
+		if (errno == EINTR || errno == ECONNABORTED) continue;
+		return LocalSocket();
+#endif
+	}
+}
+
+bool LocalSocket::connect(const std::string& path, std::string& error) {
+	close();
+	sockaddr_un addr;
+	if (!makeAddress(path, addr, error)) return false;
+	intptr_t s = openSocket(error);
+	if (s == kInvalid) return false;
+	if (::connect(native(s), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+		error = "Cannot connect to " + path + ": " + lastSocketError();
+		closeNative(s);
+		return false;
+	}
+	fd = s;
+	return true;
+}
+
+bool LocalSocket::sendAll(const void* data, size_t size) {
+	const char* p = static_cast<const char*>(data);
+	while (size) {
+#ifdef _WIN32
+		int n = ::send(native(fd), p, static_cast<int>(size < (1u << 30) ? size : (1u << 30)), 0);
+		if (n <= 0) return false;
+#else
+		ssize_t n = ::send(native(fd), p, size, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+#endif
+		p += n;
+		size -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+long LocalSocket::receive(void* data, size_t size) {
+#ifdef _WIN32
+	return ::recv(native(fd), static_cast<char*>(data), static_cast<int>(size < (1u << 30) ? size : (1u << 30)), 0);
+#else
+	for (;;) {
+		ssize_t n = ::recv(native(fd), data, size, 0);
+		if (n < 0 && errno == EINTR) continue;
+		return static_cast<long>(n);
+	}
+#endif
+}
+
+void LocalSocket::shutdown() {
+	if (fd == kInvalid) return;
+#ifdef _WIN32
+	::shutdown(native(fd), SD_BOTH);
+#else
+	::shutdown(native(fd), SHUT_RDWR);
+#endif
+}
+
+void LocalSocket::close() {
+	if (fd != kInvalid) closeNative(fd);
+	fd = kInvalid;
+}
+
+} // namespace vsrm
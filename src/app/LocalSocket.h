@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace vsrm {
+
+// Stream socket on a filesystem path (AF_UNIX; on Windows 10 1803+ through Winsock's
+// afunix.h, so both platforms share one code path). Blocking I/O; one thread may send
+// while another receives.
+class LocalSocket {
+public:
+	LocalSocket() = default;
+	~LocalSocket();
+
+	LocalSocket(const LocalSocket&) = delete;
+	LocalSocket& operator=(const LocalSocket&) = delete;
+	LocalSocket(LocalSocket&& other) noexcept : fd(other.fd) { other.fd = kInvalid; }
+	LocalSocket& operator=(LocalSocket&& other) noexcept;
+
+	// Replaces a stale socket file left by a server that did not shut down cleanly
+	bool listen(const std::string& path, std::string& error);
+	// Blocks until a client connects; invalid on error
+	LocalSocket accept();
+	bool connect(const std::string& path, std::string& error);
+
+	bool sendAll(const void* data, size_t size);
+	// Bytes received, 0 when the peer closed, < 0 on error
+	long receive(void* data, size_t size);
+	// Wakes threads blocked in receive on this socket; close() afterwards
+	void shutdown();
+	void close();
+	bool valid() const { return fd != kInvalid; }
+
+private:
+	static constexpr intptr_t kInvalid = -1;
+	explicit LocalSocket(intptr_t handle) : fd(handle) {}
+	intptr_t fd{kInvalid};
+};
+
+} // namespace vsrm
@@ -0,0 +1,287 @@
+#include "Maintenance.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+
+namespace vsrm {
+
+void MaintenanceScheduler::setOptions(const MaintenanceOptions& options) {
+	opts = options;
+	analysisLimit = options.analysisLimit;
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double msBetween(Clock::time_point from, Clock::time_point to) {
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+std::string kilobytes(int64_t bytes) {
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.1f KB", bytes / 1024.0);
+	return buf;
+}
+
+int64_t queryInt(sqlite3* db, const char* sql, int64_t fallback) {
+	sqlite3_stmt* stmt = nullptr;
+	int64_t value = fallback;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+		value = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	return value;
+}
+
+int onProgress(void* deadline) { return Clock::now() >= *static_cast<const Clock::time_point*>(deadline) ? 1 : 0; }
+
+// Steps the statement to the end, interrupting it (SQLITE_INTERRUPT) at deadline; rows go to onRow
+int runUntil(sqlite3* db, const std::string& sql, Clock::time_point deadline,
+	const std::function<void(sqlite3_stmt*)>& onRow = {}) {
+	sqlite3_stmt* stmt = nullptr;
+	if (int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr); rc != SQLITE_OK) return rc;
+	sqlite3_progress_handler(db, 1000, &onProgress, &deadline);
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+		if (onRow) onRow(stmt);
+	sqlite3_progress_handler(db, 0, nullptr, nullptr);
+	sqlite3_finalize(stmt);
+	return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+struct LockHold {
+	int rc{SQLITE_OK}; // SQLITE_BUSY: another connection is writing; SQLITE_INTERRUPT: stopped at the budget
+	double milliseconds{};
+};
+
+// sql in a write transaction of its own, interrupted early enough that COMMIT still fits in budget
+LockHold underWriteLock(sqlite3* db, const std::string& sql, std::chrono::milliseconds budget, std::string& error) {
+	LockHold hold;
+	if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+		hold.rc = sqlite3_errcode(db);
+		if (hold.rc != SQLITE_BUSY) error = sqlite3_errmsg(db);
+		return hold;
+	}
+	const auto locked = Clock::now();
+	hold.rc = runUntil(db, sql, locked + budget * 3 / 4);
+	if (hold.rc == SQLITE_OK) hold.rc = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+	if (hold.rc != SQLITE_OK) {
+		if (hold.rc != SQLITE_INTERRUPT) error = sqlite3_errmsg(db);
+		sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+	}
+	hold.milliseconds = msBetween(locked, Clock::now());
+	return hold;
+}
+
+std::string quoted(const std::string& name) {
+	std::string out = "\"";
+	for (char c : name) out += c == '"' ? std::string("\"\"") : std::string(1, c);
+	return out + "\"";
+}
+
+} // namespace
+
+bool MaintenanceScheduler::tick(sqlite3* db, MaintenanceReport& report, std::string& error, const std::function<bool()>& yield) {
+	report = {};
+	const auto now = Clock::now();
+	const int64_t changes = sqlite3_total_changes64(db);
+	const int64_t version = queryInt(db, "PRAGMA data_version;", -1);
+	if (changes != seenChanges || version != seenDataVersion || !sqlite3_get_autocommit(db)) {
+		seenChanges = changes;
+		seenDataVersion = version;
+		lastActivity = now;
+		return true;
+	}
+	if (now - lastActivity < std::chrono::milliseconds(opts.idleAfterMs)) return true;
+	if (lastPass && now - *lastPass < std::chrono::milliseconds(opts.intervalMs)) return true;
+	bool ok = runPass(db, report, error, yield);
+	// The pass's own commits are not activity
+	seenChanges = sqlite3_total_changes64(db);
+	seenDataVersion = queryInt(db, "PRAGMA data_version;", -1);
+	return ok;
+}
+
+bool MaintenanceScheduler::runPass(sqlite3* db, MaintenanceReport& report, std::string& error, const std::function<bool()>& yield) {
+	report = {};
+	report.ran = true;
+	const auto started = Clock::now();
+	lastPass = started;
+	if (!sqlite3_get_autocommit(db)) { error = "A transaction is open on this connection"; return false; }
+	const auto passEnd = started + std::chrono::milliseconds(opts.passBudgetMs);
+	const char* names[] = {"optimize", "incremental_vacuum", "checkpoint", "integrity"};
+	bool ok = true;
+	for (int i = 0; i < 4; ++i) {
+		if (yield && yield()) { report.yielded = true; break; }
+		MaintenanceStep step;
+		step.name = names[i];
+		if (Clock::now() >= passEnd) {
+			step.detail = "not started: the pass budget was used up";
+			report.steps.push_back(std::move(step));
+			continue;
+		}
+		const auto stepStarted = Clock::now();
+		std::string stepError;
+		bool stepOk = i == 0 ? optimizeStep(db, step, stepError)
+			: i == 1 ? vacuumStep(db, passEnd, yield, step, stepError)
+			: i == 2 ? checkpointStep(db, step, stepError)
+			: integrityStep(db, passEnd, yield, step, report.problems, stepError);
+		step.milliseconds = msBetween(stepStarted, Clock::now());
+		if (!stepOk) {
+			step.ok = false;
+			step.detail = stepError;
+			if (ok) error = step.name + ": " + stepError;
+			ok = false;
+		}
+		report.longestLockMilliseconds = std::max(report.longestLockMilliseconds, step.lockMilliseconds);
+		report.steps.push_back(std::move(step));
+	}
+	report.milliseconds = msBetween(started, Clock::now());
+	return ok;
+}
+
+bool MaintenanceScheduler::optimizeStep(sqlite3* db, MaintenanceStep& step, std::string& error) {
+	const bool analyzed = queryInt(db, "SELECT COUNT(*) FROM sqlite_schema WHERE name = 'sqlite_stat1';", 0) > 0;
+	const std::string limit = "PRAGMA analysis_limit = " + std::to_string(analysisLimit) + ";";
+	sqlite3_exec(db, limit.c_str(), nullptr, nullptr, nullptr);
+	// 0x10002: every table, not only those this connection has queried (SQLite 3.46+; older
+	// releases ignore the bit)
+	LockHold hold = underWriteLock(db, analyzed ? "PRAGMA optimize = 0x10002;" : "ANALYZE;",
+		std::chrono::milliseconds(opts.lockBudgetMs), error);
+	step.lockMilliseconds = hold.milliseconds;
+	if (hold.rc == SQLITE_BUSY) { step.detail = "skipped: another connection is writing"; return true; }
+	if (hold.rc == SQLITE_INTERRUPT) {
+		analysisLimit = std::max(100, analysisLimit / 2);
+		step.detail = "stopped at the lock budget and rolled back; the next pass samples " + std::to_string(analysisLimit) + " rows per index";
+		return true;
+	}
+	if (hold.rc != SQLITE_OK) return false;
+	step.detail = std::string(analyzed ? "statistics refreshed where stale" : "statistics created (first ANALYZE)") +
+		", sampling " + std::to_string(analysisLimit) + " rows per index";
+	if (hold.milliseconds > opts.lockBudgetMs) {
+		analysisLimit = std::max(100, analysisLimit / 2);
+		step.detail += "; over the lock budget, the next pass samples " + std::to_string(analysisLimit);
+	}
+	return true;
+}
+
+bool MaintenanceScheduler::vacuumStep(sqlite3* db, Clock::time_point passEnd, const std::function<bool()>& yield,
+	MaintenanceStep& step, std::string& error) {
+	if (queryInt(db, "PRAGMA auto_vacuum;", 0) != 2) {
+		step.detail = "skipped: auto_vacuum is not incremental in this file ('maintenance vacuum' switches it on)";
+		return true;
+	}
+	int64_t freePages = queryInt(db, "PRAGMA freelist_count;", 0);
+	if (freePages <= 0) { step.detail = "no free pages"; return true; }
+	const int64_t pageSize = queryInt(db, "PRAGMA page_size;", 4096);
+	const auto budget = std::chrono::milliseconds(opts.lockBudgetMs);
+	int64_t freed = 0;
+	int batches = 0, interrupted = 0;
+	bool busy = false, overran = false;
+	while (freePages > 0 && Clock::now() < passEnd && !(yield && yield())) {
+		const int64_t pages = std::min(vacuumBatch, freePages);
+		LockHold hold = underWriteLock(db, "PRAGMA incremental_vacuum(" + std::to_string(pages) + ");", budget, error);
+		step.lockMilliseconds = std::max(step.lockMilliseconds, hold.milliseconds);
+		if (hold.rc == SQLITE_BUSY) { busy = true; break; }
+		if (hold.rc == SQLITE_INTERRUPT) {
+			++interrupted;
+			vacuumBatch = std::max<int64_t>(16, pages / 2);
+			if (pages <= 16) break;
+			continue;
+		}
+		if (hold.rc != SQLITE_OK) return false;
+		++batches;
+		overran = hold.milliseconds > opts.lockBudgetMs;
+		const int64_t left = queryInt(db, "PRAGMA freelist_count;", 0);
+		freed += freePages - left;
+		freePages = left;
+		// Aim the next batch at half the budget
+		if (hold.milliseconds > 0.0)
+			vacuumBatch = std::clamp<int64_t>(static_cast<int64_t>(pages * (opts.lockBudgetMs / 2.0) / hold.milliseconds), 16, 65536);
+		if (overran) break;
+	}
+	step.detail = "freed " + std::to_string(freed) + " pages (" + kilobytes(freed * pageSize) + ") in " + std::to_string(batches) +
+		" batches, " + std::to_string(freePages) + " left";
+	if (interrupted) step.detail += "; " + std::to_string(interrupted) + " batches stopped at the lock budget";
+	if (busy) step.detail += "; stopped: another connection is writing";
+	if (overran) step.detail += "; stopped: committing alone took longer than the lock budget";
+	return true;
+}
+
+bool MaintenanceScheduler::checkpointStep(sqlite3* db, MaintenanceStep& step, std::string& error) {
+	// PASSIVE copies what it can without blocking anyone; TRUNCATE then only has to reset the file
+	int logFrames = -1, copied = -1;
+	int rc = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_PASSIVE, &logFrames, &copied);
+	if (rc == SQLITE_BUSY) { step.detail = "skipped: another checkpoint is running"; return true; }
+	if (rc != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	if (logFrames < 0) { step.detail = "not in WAL mode"; return true; }
+	if (logFrames == 0) { step.detail = "WAL is empty"; return true; }
+	if (copied < logFrames) {
+		step.detail = "copied " + std::to_string(copied) + " of " + std::to_string(logFrames) + " frames; open readers still need the rest";
+		return true;
+	}
+	const auto locked = Clock::now();
+	rc = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr);
+	step.lockMilliseconds = msBetween(locked, Clock::now());
+	if (rc == SQLITE_BUSY) {
+		step.detail = "copied " + std::to_string(logFrames) + " frames; the WAL is in use and was not truncated";
+		return true;
+	}
+	if (rc != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+	step.detail = "copied " + std::to_string(logFrames) + " frames and truncated the WAL";
+	return true;
+}
+
+bool MaintenanceScheduler::integrityStep(sqlite3* db, Clock::time_point passEnd, const std::function<bool()>& yield,
+	MaintenanceStep& step, std::vector<std::string>& problems, std::string& error) {
+	std::vector<std::string> tables;
+	runUntil(db, "SELECT name FROM sqlite_schema WHERE type = 'table' AND name NOT LIKE 'sqlite_%' ORDER BY name;", Clock::time_point::max(),
+		[&](sqlite3_stmt* stmt) { tables.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))); });
+	if (tables.empty()) { step.detail = "no tables"; return true; }
+
+	// Carry on after the table checked last, round and round
+	const size_t start = static_cast<size_t>(std::upper_bound(tables.begin(), tables.end(), integrityCursor) - tables.begin());
+	std::string checked, tooLarge;
+	size_t checkedCount = 0, found = 0, leftOut = 0;
+	for (size_t k = 0; k < tables.size(); ++k) {
+		if (Clock::now() >= passEnd || (yield && yield())) break;
+		const std::string& table = tables[(start + k) % tables.size()];
+		integrityCursor = table;
+		if (integrityTooLarge.count(table)) { ++leftOut; continue; }
+		int rc = runUntil(db, "PRAGMA integrity_check(" + quoted(table) + ");", passEnd, [&](sqlite3_stmt* stmt) {
+			std::string line = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+			if (line != "ok") { problems.push_back(table + ": " + line); ++found; }
+		});
+		if (rc == SQLITE_INTERRUPT) {
+			integrityTooLarge.insert(table);
+			tooLarge += (tooLarge.empty() ? "" : ", ") + table;
+			break;
+		}
+		if (rc != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+		checked += (checked.empty() ? "" : ", ") + table;
+		++checkedCount;
+	}
+	step.detail = std::to_string(checkedCount) + " tables and their indexes checked" + (checked.empty() ? "" : " (" + checked + ")") +
+		(found ? ", " + std::to_string(found) + " problems" : ", ok");
+	if (!tooLarge.empty()) step.detail += "; " + tooLarge + " did not fit in the pass budget and is left to 'maintenance integrity'";
+	else if (leftOut) step.detail += "; " + std::to_string(leftOut) + " too large for a pass, left to 'maintenance integrity'";
+	return true;
+}
+
+#else
+
+bool MaintenanceScheduler::tick(sqlite3*, MaintenanceReport& report, std::string& error, const std::function<bool()>&) {
+	report = {}; error = "SQLite not available."; return false;
+}
+bool MaintenanceScheduler::runPass(sqlite3*, MaintenanceReport& report, std::string& error, const std::function<bool()>&) {
+	report = {}; error = "SQLite not available."; return false;
+}
+
+#endif
+
+} // namespace vsrm
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+namespace vsrm {
+
+// Idle-time maintenance for a long-running connection (the GUI, the serve writer).
+//
+// tick() is cheap and meant to be called every few seconds. The database counts as idle when
+// neither this connection (sqlite3_total_changes64) nor any other (PRAGMA data_version) has
+// committed for idleAfterMs; then, at most once per intervalMs, a pass runs these steps in order,
+// each only if it has work:
+//   optimize            ANALYZE on first use, PRAGMA optimize afterwards (bounded by analysis_limit)
+//   incremental_vacuum  returns free pages to the OS in batches sized to the lock budget
+//   checkpoint          PASSIVE copy of the WAL, then TRUNCATE once nothing is left in it
+//   integrity           PRAGMA integrity_check(table) on the next tables in rotation (with their indexes)
+// Every write-lock hold is its own BEGIN IMMEDIATE ... COMMIT with a progress handler that
+// interrupts (and rolls back) the statement at 3/4 of lockBudgetMs; the next pass then asks for
+// less. A COMMIT's own sync cannot be interrupted, so a step whose hold still overran stops
+// there (with a rollback journal the sync alone can take a few ms; WAL commits are cheaper).
+// The busy timeout is 0 throughout, so a pass never queues behind a writer. Reads are not seen
+// as activity: in WAL mode none of the steps blocks a reader.
+
+struct MaintenanceOptions {
+	int idleAfterMs{30000};  // no commit on any connection for this long
+	int intervalMs{600000};  // between the starts of two passes
+	int lockBudgetMs{50};    // longest a step may hold the write lock
+	int passBudgetMs{500};   // no step starts after this much of a pass
+	int analysisLimit{1000}; // PRAGMA analysis_limit: rows sampled per index
+};
+
+struct MaintenanceStep {
+	std::string name;
+	std::string detail;        // what it did, or why it did nothing
+	double milliseconds{};
+	double lockMilliseconds{}; // longest single hold of the write lock
+	bool ok{true};
+};
+
+struct MaintenanceReport {
+	bool ran{false};    // false: not idle yet, or the last pass was too recent
+	bool yielded{false}; // stopped early because yield() asked for the connection
+	std::vector<MaintenanceStep> steps;
+	std::vector<std::string> problems; // integrity_check findings
+	double milliseconds{};
+	double longestLockMilliseconds{};
+};
+
+class MaintenanceScheduler {
+public:
+	explicit MaintenanceScheduler(const MaintenanceOptions& options = {}) : opts(options), analysisLimit(options.analysisLimit) {}
+
+	void setOptions(const MaintenanceOptions& options);
+	const MaintenanceOptions& options() const { return opts; }
+
+	// Runs a pass if the database has been idle long enough. yield is polled between pieces of
+	// work; returning true ends the pass there. false only if a step failed (error says why).
+	bool tick(sqlite3* db, MaintenanceReport& report, std::string& error, const std::function<bool()>& yield = {});
+	// A pass now, whatever the activity
+	bool runPass(sqlite3* db, MaintenanceReport& report, std::string& error, const std::function<bool()>& yield = {});
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	MaintenanceOptions opts;
+	int analysisLimit;          // lowered when ANALYZE runs into the lock budget
+	int64_t vacuumBatch{256};   // pages per incremental_vacuum, adapted to the lock budget
+	int64_t seenChanges{-1};
+	int64_t seenDataVersion{-1};
+	Clock::time_point lastActivity{};
+	std::optional<Clock::time_point> lastPass;
+	std::string integrityCursor;          // last table checked
+	std::set<std::string> integrityTooLarge; // did not finish within a pass; left to 'maintenance integrity'
+
+	bool optimizeStep(sqlite3* db, MaintenanceStep& step, std::string& error);
+	bool vacuumStep(sqlite3* db, Clock::time_point passEnd, const std::function<bool()>& yield, MaintenanceStep& step,
+		std::string& error);
+	bool checkpointStep(sqlite3* db, MaintenanceStep& step, std::string& error);
+	bool integrityStep(sqlite3* db, Clock::time_point passEnd, const std::function<bool()>& yield, MaintenanceStep& step,
+		std::vector<std::string>& problems, std::string& error);
+};
+
+} // namespace vsrm
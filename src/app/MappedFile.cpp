@@ -0,0 +1,68 @@
+#include "MappedFile.h"
+
+#include "Utf.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vsrm {
+
+MappedFile::~MappedFile() { close(); }
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	std::u16string wpath = toUtf16(path);
+	HANDLE f = CreateFileW(reinterpret_cast<const wchar_t*>(wpath.c_str()), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (f == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER sz{};
+	if (!GetFileSizeEx(f, &sz) || sz.QuadPart == 0) { CloseHandle(f); return false; }
+	HANDLE m = CreateFileMappingW(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m) { CloseHandle(f); return false; }
+	void* view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if (!view) { CloseHandle(m); CloseHandle(f); return false; }
+	file = f; mapping = m;
+	bytes = static_cast<const unsigned char*>(view);
+	length = static_cast<size_t>(sz.QuadPart);
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mapping) CloseHandle(static_cast<HANDLE>(mapping));
+	if (file) CloseHandle(static_cast<HANDLE>(file));
+	bytes = nullptr; mapping = nullptr; file = nullptr; length = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st{};
+	if (fstat(fd, &st) != 0 || st.st_size == 0) { ::close(fd); return false; }
+	void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping keeps the file referenced
+	if (view == MAP_FAILED) return false;
+	bytes = static_cast<const unsigned char*>(view);
+	length = static_cast<size_t>(st.st_size);
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes) munmap(const_cast<unsigned char*>(bytes), length);
+	bytes = nullptr; length = 0;
+}
+
+#endif
+
+} // namespace vsrm
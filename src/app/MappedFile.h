@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace vsrm {
+
+// Read-only memory mapping of a whole file (MapViewOfFile / mmap).
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Path is UTF-8. Empty files cannot be mapped and fail to open.
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes{nullptr};
+	size_t length{0};
+#ifdef _WIN32
+	void* file{nullptr};
+	void* mapping{nullptr};
+#endif
+};
+
+} // namespace vsrm
@@ -0,0 +1,248 @@
+#include "Migrations.h"
+
+#include <iterator>
+
+namespace vsrm {
+
+namespace {
+
+// v1: the original schema.sql. Uses IF NOT EXISTS so databases created before
+// versioning (user_version 0, tables present) adopt it without changes.
+constexpr const char* kBaseline = R"sql(
+CREATE TABLE IF NOT EXISTS service_records (
+	id INTEGER PRIMARY KEY AUTOINCREMENT,
+	vin TEXT NOT NULL,
+	customer_name TEXT NOT NULL,
+	service_date TEXT NOT NULL,
+	description TEXT NOT NULL,
+	mechanic TEXT NOT NULL
+);
+
+CREATE INDEX IF NOT EXISTS idx_service_records_vin_date
+ON service_records (vin, service_date DESC);
+
+-- Mechanics roster
+CREATE TABLE IF NOT EXISTS mechanics (
+	id INTEGER PRIMARY KEY AUTOINCREMENT,
+	name TEXT NOT NULL,
+	skill TEXT NOT NULL,
+	active INTEGER NOT NULL DEFAULT 1
+);
+
+-- Appointments (local-only scheduling)
+CREATE TABLE IF NOT EXISTS appointments (
+	id INTEGER PRIMARY KEY AUTOINCREMENT,
+	vin TEXT NOT NULL,
+	customer_name TEXT NOT NULL,
+	scheduled_at TEXT NOT NULL, -- ISO 8601
+	status TEXT NOT NULL -- e.g., scheduled, in_progress, done, cancelled
+);
+
+-- Job assignments linking appointments to mechanics
+CREATE TABLE IF NOT EXISTS assignments (
+	id INTEGER PRIMARY KEY AUTOINCREMENT,
+	appointment_id INTEGER NOT NULL,
+	mechanic_id INTEGER NOT NULL,
+	assigned_at TEXT NOT NULL,
+	completed_at TEXT,
+	FOREIGN KEY (appointment_id) REFERENCES appointments(id) ON DELETE CASCADE,
+	FOREIGN KEY (mechanic_id) REFERENCES mechanics(id) ON DELETE RESTRICT
+);
+
+CREATE INDEX IF NOT EXISTS idx_appointments_vin_date ON appointments (vin, scheduled_at DESC);
+CREATE INDEX IF NOT EXISTS idx_assignments_mechanic ON assignments (mechanic_id);
+
+-- Users for local authentication (simple, single-machine)
+CREATE TABLE IF NOT EXISTS users (
+	id INTEGER PRIMARY KEY AUTOINCREMENT,
+	username TEXT NOT NULL UNIQUE,
+	password_hash TEXT NOT NULL,
+	salt TEXT NOT NULL
+);
+)sql";
+
+// v2: skill an appointment needs (NULL: any mechanic), and the index the scheduler
+// uses to find appointments that have no assignment yet.
+constexpr const char* kAppointmentSkill = R"sql(
+ALTER TABLE appointments ADD COLUMN required_skill TEXT;
+CREATE INDEX IF NOT EXISTS idx_assignments_appointment ON assignments (appointment_id);
+)sql";
+
+// v3: appointment length, so overlapping bookings can be detected
+constexpr const char* kAppointmentDuration = R"sql(
+ALTER TABLE appointments ADD COLUMN duration_min INTEGER NOT NULL DEFAULT 60;
+)sql";
+
+// v4: calendar (day/week) views range over scheduled_at across all vehicles
+constexpr const char* kAppointmentCalendarIndex = R"sql(
+CREATE INDEX IF NOT EXISTS idx_appointments_scheduled_at ON appointments (scheduled_at);
+)sql";
+
+// v5: predicted next service per vehicle, rewritten by Database::recomputeServiceDue
+constexpr const char* kServiceDue = R"sql(
+CREATE TABLE IF NOT EXISTS service_due (
+	vin TEXT PRIMARY KEY,
+	last_service TEXT NOT NULL,
+	due_date TEXT NOT NULL,
+	visits INTEGER NOT NULL,
+	basis TEXT NOT NULL -- cadence, rule, default
+) WITHOUT ROWID;
+CREATE INDEX IF NOT EXISTS idx_service_due_date ON service_due (due_date);
+)sql";
+
+// v6: customer timelines look up a customer's vehicles by name
+constexpr const char* kCustomerIndexes = R"sql(
+CREATE INDEX IF NOT EXISTS idx_service_records_customer ON service_records (customer_name, vin);
+CREATE INDEX IF NOT EXISTS idx_appointments_customer ON appointments (customer_name, vin);
+)sql";
+
+// v7: mergeable per-month sketches (see Sketches.h), updated by Database::addServiceRecord
+// and backfilled by migrateSchema when this step runs
+constexpr const char* kAnalyticsSketches = R"sql(
+CREATE TABLE IF NOT EXISTS analytics_sketches (
+	period TEXT NOT NULL, -- YYYY-MM
+	kind TEXT NOT NULL,   -- customers, vins, mechanics, keywords
+	data BLOB NOT NULL,
+	PRIMARY KEY (period, kind)
+) WITHOUT ROWID;
+)sql";
+
+// v8: dedup key for imports (see ServiceImport.h); NULL until the next import fills it in
+constexpr const char* kServiceFingerprint = R"sql(
+ALTER TABLE service_records ADD COLUMN fingerprint INTEGER;
+CREATE INDEX IF NOT EXISTS idx_service_records_fingerprint ON service_records (fingerprint);
+)sql";
+
+// v9: change-set replication between branch databases and head office (see Replication.h)
+constexpr const char* kReplication = R"sql(
+CREATE TABLE IF NOT EXISTS replication_state (
+	key TEXT PRIMARY KEY, -- branch_number, branch_name, shipped_seq
+	value TEXT NOT NULL
+) WITHOUT ROWID;
+-- One changeset per local commit, written in the commit's own transaction
+CREATE TABLE IF NOT EXISTS replication_outbox (
+	seq INTEGER PRIMARY KEY AUTOINCREMENT,
+	committed_at TEXT NOT NULL,
+	changeset BLOB NOT NULL
+);
+-- Head office: the last sequence number applied from each branch
+CREATE TABLE IF NOT EXISTS replication_applied (
+	branch_number INTEGER PRIMARY KEY,
+	branch_name TEXT NOT NULL,
+	last_seq INTEGER NOT NULL,
+	applied_at TEXT NOT NULL
+);
+)sql";
+
+// v10: year-partitioned archive files (see Archive.h), and the date index that lets reads walk
+// main in service_date order one range at a time
+constexpr const char* kArchivePartitions = R"sql(
+CREATE TABLE IF NOT EXISTS archive_partitions (
+	year INTEGER PRIMARY KEY,
+	file TEXT NOT NULL, -- relative to the database's directory
+	records INTEGER NOT NULL,
+	first_date TEXT NOT NULL,
+	last_date TEXT NOT NULL,
+	vin_filter BLOB NOT NULL, -- serialized BloomFilter of fastHash64(vin)
+	archived_at TEXT NOT NULL
+);
+CREATE INDEX IF NOT EXISTS idx_service_records_date ON service_records (service_date);
+)sql";
+
+// v11: compression dictionaries for service_records.description (see DescriptionCodec.h); the
+// newest one packs new writes, older ones stay for the values packed with them
+constexpr const char* kTextDictionaries = R"sql(
+CREATE TABLE IF NOT EXISTS text_dictionaries (
+	id INTEGER PRIMARY KEY, -- textDictionaryId(data)
+	trained_at TEXT NOT NULL,
+	samples INTEGER NOT NULL,
+	data BLOB NOT NULL
+);
+)sql";
+
+// v12: service record attachments (see Attachments.h). Content is stored once per hash; the
+// thumbnail cache keeps an empty media_type for content that has none.
+constexpr const char* kAttachments = R"sql(
+CREATE TABLE IF NOT EXISTS attachment_blobs (
+	id INTEGER PRIMARY KEY,
+	sha256 TEXT NOT NULL UNIQUE,
+	size INTEGER NOT NULL,
+	data BLOB NOT NULL
+);
+CREATE TABLE IF NOT EXISTS attachments (
+	id INTEGER PRIMARY KEY AUTOINCREMENT,
+	service_record_id INTEGER NOT NULL,
+	blob_id INTEGER NOT NULL REFERENCES attachment_blobs(id),
+	file_name TEXT NOT NULL,
+	media_type TEXT NOT NULL,
+	size INTEGER NOT NULL,
+	sha256 TEXT NOT NULL,
+	added_at TEXT NOT NULL
+);
+CREATE INDEX IF NOT EXISTS idx_attachments_record ON attachments (service_record_id);
+CREATE INDEX IF NOT EXISTS idx_attachments_blob ON attachments (blob_id);
+CREATE TABLE IF NOT EXISTS attachment_thumbnails (
+	blob_id INTEGER NOT NULL,
+	max_edge INTEGER NOT NULL,
+	media_type TEXT NOT NULL,
+	width INTEGER NOT NULL,
+	height INTEGER NOT NULL,
+	data BLOB NOT NULL,
+	PRIMARY KEY (blob_id, max_edge)
+);
+)sql";
+
+// v13: no table changes. From here on a branch database has PRAGMA application_id set (see
+// Replication.h), so opening any other file skips the replication_state lookup;
+// Database::migrateSchema stamps branches that were enabled before.
+constexpr const char* kBranchMarker = R"sql(
+-- header only
+)sql";
+
+// v14: per (vin, customer, mechanic) the latest archived visit, written by the archive move and
+// never moved itself, so summaries and customer look-ups cover archived years without opening
+// them (see Archive.h)
+constexpr const char* kArchiveRollup = R"sql(
+CREATE TABLE IF NOT EXISTS archive_rollup (
+	vin TEXT NOT NULL,
+	customer_name TEXT NOT NULL,
+	mechanic TEXT NOT NULL,
+	last_date TEXT NOT NULL,
+	last_id INTEGER NOT NULL,
+	PRIMARY KEY (vin, customer_name, mechanic)
+) WITHOUT ROWID;
+CREATE INDEX IF NOT EXISTS idx_archive_rollup_customer ON archive_rollup (customer_name);
+)sql";
+
+constexpr Migration kMigrations[] = {
+	{1, "baseline", kBaseline},
+	{2, "appointment_skill", kAppointmentSkill},
+	{3, "appointment_duration", kAppointmentDuration},
+	{4, "appointment_calendar_index", kAppointmentCalendarIndex},
+	{5, "service_due", kServiceDue},
+	{6, "customer_indexes", kCustomerIndexes},
+	{7, "analytics_sketches", kAnalyticsSketches},
+	{8, "service_fingerprint", kServiceFingerprint},
+	{9, "replication", kReplication},
+	{10, "archive_partitions", kArchivePartitions},
+	{11, "text_dictionaries", kTextDictionaries},
+	{12, "attachments", kAttachments},
+	{13, "branch_marker", kBranchMarker},
+	{14, "archive_rollup", kArchiveRollup},
+};
+
+constexpr bool ascendingFromOne() {
+	for (size_t i = 0; i < std::size(kMigrations); ++i) {
+		if (kMigrations[i].version != static_cast<int>(i) + 1) return false;
+	}
+	return true;
+}
+static_assert(ascendingFromOne(), "migration versions must be 1, 2, 3, ... in order");
+
+} // namespace
+
+std::span<const Migration> schemaMigrations() { return kMigrations; }
+
+int latestSchemaVersion() { return kMigrations[std::size(kMigrations) - 1].version; }
+
+} // namespace vsrm
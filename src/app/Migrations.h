@@ -0,0 +1,38 @@
+#pragma once
+
+#include <span>
+#include <string>
+
+namespace vsrm {
+
+// One schema step. `version` is the PRAGMA user_version after it ran.
+struct Migration {
+	int version;
+	const char* name;
+	const char* sql;
+};
+
+// Outcome of one applied migration, for startup logging.
+struct MigrationStep {
+	int version{};
+	std::string name;
+	double milliseconds{};
+};
+
+// All migrations compiled into the binary, in ascending version order.
+// Append new ones at the end; never edit one that has shipped.
+std::span<const Migration> schemaMigrations();
+int latestSchemaVersion();
+
+// First version with analytics_sketches; migrating across it backfills the sketches
+constexpr int kSketchSchemaVersion = 7;
+// First version with the replication tables
+constexpr int kReplicationSchemaVersion = 9;
+// First version with archive_partitions
+constexpr int kArchiveSchemaVersion = 10;
+// First version where branches carry kBranchApplicationId; migrating across it stamps existing ones
+constexpr int kBranchMarkerSchemaVersion = 13;
+// First version with archive_rollup; migrating across it fills it from existing partitions
+constexpr int kArchiveRollupSchemaVersion = 14;
+
+} // namespace vsrm
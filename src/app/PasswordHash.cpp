@@ -0,0 +1,131 @@
+#include "PasswordHash.h"
+
+#include "Sha256.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#else
+#include <cerrno>
+#include <sys/random.h>
+#endif
+
+namespace vsrm {
+
+namespace {
+
+constexpr std::string_view kPbkdf2Prefix = "pbkdf2-sha256$";
+constexpr std::string_view kLegacyPrefix = "pbkdf2-sha256-legacy$";
+
+bool randomBytes(uint8_t* out, size_t size) {
+#ifdef _WIN32
+	return BCryptGenRandom(nullptr, out, static_cast<ULONG>(size), BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#else
+	while (size) {
+		ssize_t n = getrandom(out, size, 0);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		out += n; size -= static_cast<size_t>(n);
+	}
+	return true;
+#endif
+}
+
+std::string encode(std::string_view prefix, uint32_t iterations, const Sha256Digest& key) {
+	return std::string(prefix) + std::to_string(iterations) + "$" + toHex(key.data(), key.size());
+}
+
+std::string legacyHash(std::string_view password, std::string_view salt) {
+	Sha256 h;
+	h.update(password);
+	h.update(salt);
+	Sha256Digest d = h.finish();
+	return toHex(d.data(), d.size());
+}
+
+// Splits "<prefix><iterations>$<hex>"; false if `stored` has another prefix or is malformed
+bool parse(std::string_view stored, std::string_view prefix, uint32_t& iterations, std::string_view& hex) {
+	if (stored.substr(0, prefix.size()) != prefix) return false;
+	stored.remove_prefix(prefix.size());
+	size_t dollar = stored.find('$');
+	if (dollar == std::string_view::npos) return false;
+	auto [end, ec] = std::from_chars(stored.data(), stored.data() + dollar, iterations);
+	if (ec != std::errc() || end != stored.data() + dollar || iterations == 0) return false;
+	hex = stored.substr(dollar + 1);
+	return true;
+}
+
+bool equalConstantTime(std::string_view a, std::string_view b) {
+	if (a.size() != b.size()) return false;
+	unsigned char diff = 0;
+	for (size_t i = 0; i < a.size(); ++i) diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+	return diff == 0;
+}
+
+} // namespace
+
+std::string newPasswordSalt() {
+	uint8_t bytes[16];
+	if (!randomBytes(bytes, sizeof(bytes))) return {};
+	return toHex(bytes, sizeof(bytes));
+}
+
+std::string hashPassword(std::string_view password, std::string_view salt, uint32_t iterations) {
+	return encode(kPbkdf2Prefix, iterations, pbkdf2Sha256(password, salt, iterations));
+}
+
+std::string wrapLegacyPasswordHash(std::string_view legacy, std::string_view salt, uint32_t iterations) {
+	return encode(kLegacyPrefix, iterations, pbkdf2Sha256(legacy, salt, iterations));
+}
+
+bool verifyPassword(std::string_view password, std::string_view salt, std::string_view stored) {
+	uint32_t iterations = 0;
+	std::string_view hex;
+	if (parse(stored, kPbkdf2Prefix, iterations, hex)) {
+		Sha256Digest d = pbkdf2Sha256(password, salt, iterations);
+		return equalConstantTime(toHex(d.data(), d.size()), hex);
+	}
+	std::string old = legacyHash(password, salt);
+	if (parse(stored, kLegacyPrefix, iterations, hex)) {
+		Sha256Digest d = pbkdf2Sha256(old, salt, iterations);
+		return equalConstantTime(toHex(d.data(), d.size()), hex);
+	}
+	return equalConstantTime(old, stored);
+}
+
+bool passwordNeedsRehash(std::string_view stored, uint32_t iterations) {
+	uint32_t have = 0;
+	std::string_view hex;
+	return !parse(stored, kPbkdf2Prefix, have, hex) || have < iterations;
+}
+
+void hashPasswordsBatch(std::span<const PasswordHashJob> jobs, uint32_t iterations, std::span<std::string> out,
+	int threads) {
+	const size_t n = std::min(jobs.size(), out.size());
+	if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	threads = static_cast<int>(std::min<size_t>(static_cast<size_t>(threads), std::max<size_t>(n, 1)));
+	// Jobs cost the same, but a shared counter keeps every core busy to the end
+	std::atomic<size_t> next{0};
+	auto work = [&] {
+		for (size_t i; (i = next.fetch_add(1)) < n;) {
+			const PasswordHashJob& job = jobs[i];
+			out[i] = job.legacy ? wrapLegacyPasswordHash(job.secret, job.salt, iterations)
+				: hashPassword(job.secret, job.salt, iterations);
+		}
+	};
+	std::vector<std::thread> workers;
+	workers.reserve(static_cast<size_t>(threads - 1));
+	for (int t = 1; t < threads; ++t) workers.emplace_back(work);
+	work();
+	for (auto& t : workers) t.join();
+}
+
+} // namespace vsrm
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace vsrm {
+
+// Stored password formats (users.password_hash; users.salt is the hex salt):
+//   "pbkdf2-sha256$<iterations>$<hex>"        PBKDF2-HMAC-SHA256 of the password
+//   "pbkdf2-sha256-legacy$<iterations>$<hex>" PBKDF2 of an old hex SHA-256(password + salt)
+//   64 hex digits                             the old single SHA-256(password + salt)
+// OWASP's 2023 guidance for PBKDF2-HMAC-SHA256; a login costs ~0.15 s with SHA-NI.
+constexpr uint32_t kDefaultPasswordIterations = 600000;
+
+// 16 bytes from the OS generator (BCryptGenRandom / getrandom), as 32 hex digits; "" on failure
+std::string newPasswordSalt();
+
+std::string hashPassword(std::string_view password, std::string_view salt, uint32_t iterations);
+// Constant-time comparison against any of the formats above
+bool verifyPassword(std::string_view password, std::string_view salt, std::string_view stored);
+// True for the legacy formats and for fewer iterations than asked for
+bool passwordNeedsRehash(std::string_view stored, uint32_t iterations);
+
+// Strengthens an old SHA-256 hash without knowing the password; the next successful
+// login replaces the result with a plain hashPassword().
+std::string wrapLegacyPasswordHash(std::string_view legacyHash, std::string_view salt, uint32_t iterations);
+
+struct PasswordHashJob {
+	std::string_view secret; // password, or the legacy hash when legacy is set
+	std::string_view salt;
+	bool legacy{false};
+};
+
+// Runs hashPassword / wrapLegacyPasswordHash for every job across threads (<= 0: all cores).
+// out must have jobs.size() elements.
+void hashPasswordsBatch(std::span<const PasswordHashJob> jobs, uint32_t iterations, std::span<std::string> out,
+	int threads = 0);
+
+} // namespace vsrm
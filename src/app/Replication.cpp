@@ -0,0 +1,666 @@
+#include "Replication.h"
+
+#include "DescriptionCodec.h"
+#include "FastHash.h"
+#include "ServiceProtocol.h"
+#include "Sketches.h"
+
+#if defined(VSRM_HAS_SQLITE3) && defined(VSRM_HAS_SQLITE_SESSION)
+// The session API is only declared when these are set; the library must have been built with them
+#ifndef SQLITE_ENABLE_SESSION
+#define SQLITE_ENABLE_SESSION 1
+#endif
+#ifndef SQLITE_ENABLE_PREUPDATE_HOOK
+#define SQLITE_ENABLE_PREUPDATE_HOOK 1
+#endif
+#include <sqlite3.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace vsrm {
+
+#if defined(VSRM_HAS_SQLITE3) && defined(VSRM_HAS_SQLITE_SESSION)
+
+namespace {
+
+// File: magic, u32 branch number, str branch name, i64 first/last seq, u32 commits,
+// str changeset, then u64 fastHash64 of everything before it
+constexpr std::string_view kFileMagic = "VSRMREP1";
+constexpr uint64_t kChecksumSeed = 0x5E55104E;
+
+fs::path pathFromUtf8(const std::string& s) { return fs::path(std::u8string(s.begin(), s.end())); }
+
+bool exec(sqlite3* db, const char* sql, std::string& error) {
+	char* errMsg = nullptr;
+	if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) == SQLITE_OK) return true;
+	error = errMsg ? errMsg : sqlite3_errmsg(db);
+	sqlite3_free(errMsg);
+	return false;
+}
+
+std::optional<std::string> stateValue(sqlite3* db, const char* key) {
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT value FROM replication_state WHERE key = ?1;", -1, &stmt, nullptr) != SQLITE_OK) return std::nullopt;
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+	std::optional<std::string> value;
+	if (sqlite3_step(stmt) == SQLITE_ROW) value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+	sqlite3_finalize(stmt);
+	return value;
+}
+
+bool setStateValue(sqlite3* db, const char* key, const std::string& value, std::string& error) {
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO replication_state (key, value) VALUES (?1, ?2);", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, value.c_str(), -1, SQLITE_TRANSIENT);
+	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+	if (!ok) error = sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	return ok;
+}
+
+int64_t queryInt(sqlite3* db, const char* sql, int64_t fallback = 0) {
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return fallback;
+	int64_t v = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL ? sqlite3_column_int64(stmt, 0) : fallback;
+	sqlite3_finalize(stmt);
+	return v;
+}
+
+std::vector<const char*> recordedTables() {
+	std::vector<const char*> tables(std::begin(kReplicatedTables), std::end(kReplicatedTables));
+	tables.insert(tables.end(), std::begin(kReplicatedSharedTables), std::end(kReplicatedSharedTables));
+	return tables;
+}
+
+bool createSession(sqlite3* db, sqlite3_session*& session, std::string& error) {
+	if (sqlite3session_create(db, "main", &session) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		session = nullptr;
+		return false;
+	}
+	for (const char* table : recordedTables()) {
+		if (sqlite3session_attach(session, table) != SQLITE_OK) {
+			error = std::string("Cannot record changes to ") + table;
+			sqlite3session_delete(session);
+			session = nullptr;
+			return false;
+		}
+	}
+	return true;
+}
+
+// An empty copy of each replicated table in an attached in-memory database, so that
+// sqlite3session_diff() can record every existing row as an insert
+bool attachEmptyTables(sqlite3* db, std::string& error) {
+	if (!exec(db, "ATTACH DATABASE ':memory:' AS vsrm_empty;", error)) return false;
+	for (const char* table : recordedTables()) {
+		sqlite3_stmt* stmt = nullptr;
+		if (sqlite3_prepare_v2(db, "SELECT sql FROM main.sqlite_master WHERE type = 'table' AND name = ?1;", -1, &stmt, nullptr) != SQLITE_OK) {
+			error = sqlite3_errmsg(db);
+			return false;
+		}
+		sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+		std::string sql = sqlite3_step(stmt) == SQLITE_ROW ? reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) : "";
+		sqlite3_finalize(stmt);
+		// sqlite_master keeps "CREATE TABLE name (...)" with IF NOT EXISTS dropped
+		size_t at = sql.find(table);
+		if (at == std::string::npos) { error = std::string("Table ") + table + " is missing"; return false; }
+		sql.insert(at, "vsrm_empty.");
+		if (!exec(db, sql.c_str(), error)) return false;
+	}
+	return true;
+}
+
+bool readFile(const std::string& path, std::string& out, std::string& error) {
+	std::ifstream in(pathFromUtf8(path), std::ios::binary);
+	if (!in) { error = "Cannot open " + path; return false; }
+	out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	if (in.bad()) { error = "Cannot read " + path; return false; }
+	return true;
+}
+
+bool sameValue(sqlite3_value* a, sqlite3_value* b) {
+	if (!a || !b) return a == b;
+	int type = sqlite3_value_type(a);
+	if (type != sqlite3_value_type(b)) return false;
+	switch (type) {
+	case SQLITE_NULL: return true;
+	case SQLITE_INTEGER: return sqlite3_value_int64(a) == sqlite3_value_int64(b);
+	case SQLITE_FLOAT: return sqlite3_value_double(a) == sqlite3_value_double(b);
+	default: {
+		int n = sqlite3_value_bytes(a);
+		if (n != sqlite3_value_bytes(b)) return false;
+		const void* pa = type == SQLITE_TEXT ? static_cast<const void*>(sqlite3_value_text(a)) : sqlite3_value_blob(a);
+		const void* pb = type == SQLITE_TEXT ? static_cast<const void*>(sqlite3_value_text(b)) : sqlite3_value_blob(b);
+		return n == 0 || std::memcmp(pa, pb, static_cast<size_t>(n)) == 0;
+	}
+	}
+}
+
+std::string valueText(sqlite3_value* v) {
+	const unsigned char* t = v ? sqlite3_value_text(v) : nullptr;
+	return t ? reinterpret_cast<const char*>(t) : "";
+}
+
+struct ApplyContext {
+	ReplicationConflict policy;
+	ReplicationApplyStats* stats;
+	std::unordered_set<int64_t> droppedRecords; // service_records inserts that did not land
+	std::string error;
+	DescriptionCodec* codec{};
+	sqlite3* db{};
+};
+
+// service_records.description may be packed differently on each side (recompressed locally,
+// or not at all); it is the same value if the text is
+bool sameColumn(ApplyContext& c, const char* table, int column, sqlite3_value* a, sqlite3_value* b) {
+	if (sameValue(a, b)) return true;
+	if (!a || !b || column != 4 || std::strcmp(table, "service_records") != 0) return false;
+	std::string text[2], error;
+	sqlite3_value* v[2] = {a, b};
+	for (int i = 0; i < 2; ++i) {
+		if (sqlite3_value_type(v[i]) != SQLITE_BLOB) { text[i] = valueText(v[i]); continue; }
+		const char* data = static_cast<const char*>(sqlite3_value_blob(v[i]));
+		std::string_view packed(data ? data : "", static_cast<size_t>(sqlite3_value_bytes(v[i])));
+		if (!c.codec->unpack(c.db, packed, text[i], error)) return false;
+	}
+	return text[0] == text[1];
+}
+
+int onConflict(void* ctx, int type, sqlite3_changeset_iter* it) {
+	auto& c = *static_cast<ApplyContext*>(ctx);
+	const char* table = nullptr;
+	int columns = 0, op = 0, indirect = 0;
+	sqlite3changeset_op(it, &table, &columns, &op, &indirect);
+	auto dropRecord = [&] {
+		sqlite3_value* id = nullptr;
+		if (op == SQLITE_INSERT && std::strcmp(table, "service_records") == 0 && sqlite3changeset_new(it, 0, &id) == SQLITE_OK && id)
+			c.droppedRecords.insert(sqlite3_value_int64(id));
+	};
+	switch (type) {
+	case SQLITE_CHANGESET_CONFLICT: { // insert of an id head office already has
+		bool same = true;
+		for (int i = 0; i < columns && same; ++i) {
+			sqlite3_value* incoming = nullptr;
+			sqlite3_value* present = nullptr;
+			sqlite3changeset_new(it, i, &incoming);
+			sqlite3changeset_conflict(it, i, &present);
+			same = sameColumn(c, table, i, incoming, present);
+		}
+		dropRecord(); // either identical already, or replaced / kept below; not a new visit
+		if (same) { ++c.stats->duplicates; return SQLITE_CHANGESET_OMIT; }
+		++c.stats->conflicts;
+		return c.policy == ReplicationConflict::BranchWins ? SQLITE_CHANGESET_REPLACE : SQLITE_CHANGESET_OMIT;
+	}
+	case SQLITE_CHANGESET_DATA: { // update/delete whose old values differ from head office's row
+		bool same = true;
+		for (int i = 0; i < columns && same; ++i) {
+			sqlite3_value* expected = nullptr;
+			sqlite3_value* present = nullptr;
+			// Old values are only recorded for the primary key and the columns an update changed
+			if (sqlite3changeset_old(it, i, &expected) != SQLITE_OK || !expected) continue;
+			sqlite3changeset_conflict(it, i, &present);
+			same = sameColumn(c, table, i, expected, present);
+		}
+		if (same) return SQLITE_CHANGESET_REPLACE; // only the encoding differed
+		++c.stats->conflicts;
+		return c.policy == ReplicationConflict::BranchWins ? SQLITE_CHANGESET_REPLACE : SQLITE_CHANGESET_OMIT;
+	}
+	case SQLITE_CHANGESET_NOTFOUND:
+	case SQLITE_CHANGESET_CONSTRAINT:
+		++c.stats->skipped;
+		dropRecord();
+		return SQLITE_CHANGESET_OMIT;
+	case SQLITE_CHANGESET_FOREIGN_KEY: {
+		int n = 0;
+		sqlite3changeset_fk_conflicts(it, &n);
+		c.error = "Changeset leaves " + std::to_string(n) + " rows referring to missing mechanics or appointments";
+		return SQLITE_CHANGESET_ABORT;
+	}
+	}
+	return SQLITE_CHANGESET_ABORT;
+}
+
+// Columns of service_records in table order: id, vin, customer_name, service_date, description, mechanic, ...
+struct InsertedRecord {
+	int64_t id;
+	std::string vin, customer, date, description, mechanic;
+	bool packed; // description holds DescriptionCodec bytes
+};
+
+} // namespace
+
+ChangeRecorder::~ChangeRecorder() { detach(); }
+
+bool ChangeRecorder::attach(sqlite3* db, std::string& error) {
+	detach();
+	return createSession(db, session, error);
+}
+
+void ChangeRecorder::detach() {
+	if (session) sqlite3session_delete(session);
+	session = nullptr;
+}
+
+bool ChangeRecorder::stage(sqlite3* db, std::string& error) {
+	if (!session || sqlite3session_isempty(session)) return true;
+	int size = 0;
+	void* changeset = nullptr;
+	if (int rc = sqlite3session_changeset(session, &size, &changeset); rc != SQLITE_OK) {
+		error = std::string("Cannot record the changeset: ") + sqlite3_errstr(rc);
+		return false;
+	}
+	bool ok = true;
+	// Rows inserted and deleted again in the same commit leave an empty changeset
+	if (size > 0) {
+		sqlite3_stmt* stmt = nullptr;
+		ok = sqlite3_prepare_v2(db, "INSERT INTO replication_outbox (committed_at, changeset) "
+			"VALUES (strftime('%Y-%m-%dT%H:%M:%SZ', 'now'), ?1);", -1, &stmt, nullptr) == SQLITE_OK;
+		if (ok) {
+			sqlite3_bind_blob(stmt, 1, changeset, size, SQLITE_STATIC);
+			ok = sqlite3_step(stmt) == SQLITE_DONE;
+		}
+		if (!ok) error = sqlite3_errmsg(db);
+		sqlite3_finalize(stmt);
+	}
+	sqlite3_free(changeset);
+	if (!ok) return false;
+	// Sessions cannot be reset; a fresh one records the next commit
+	sqlite3session_delete(session);
+	session = nullptr;
+	return createSession(db, session, error);
+}
+
+bool replicationAvailable() { return true; }
+
+bool enableReplication(sqlite3* db, int branchNumber, const std::string& branchName, ChangeRecorder& recorder,
+	std::string& error) {
+	if (branchNumber < 1 || branchNumber > kMaxBranchNumber) {
+		error = "Branch number must be 1-" + std::to_string(kMaxBranchNumber);
+		return false;
+	}
+	if (!sqlite3_get_autocommit(db)) { error = "Cannot enable replication inside a transaction"; return false; }
+	if (auto current = stateValue(db, "branch_number")) {
+		if (*current != std::to_string(branchNumber)) {
+			error = "This database is already branch " + *current;
+			return false;
+		}
+		return recorder.attached() || recorder.attach(db, error);
+	}
+	if (queryInt(db, "SELECT COUNT(*) FROM replication_applied;") > 0) {
+		error = "This database applies branch changesets (head office) and cannot record its own";
+		return false;
+	}
+
+	recorder.detach();
+	const int64_t base = branchIdBase(branchNumber);
+	std::string b = std::to_string(base), span = std::to_string(kBranchIdSpan);
+	// Foreign keys cannot be switched inside a transaction; parents and children move together
+	// below and foreign_key_check confirms nothing was left dangling
+	if (!exec(db, "PRAGMA foreign_keys = OFF;", error)) return false;
+	if (!attachEmptyTables(db, error)) {
+		exec(db, "DETACH DATABASE vsrm_empty;", error);
+		exec(db, "PRAGMA foreign_keys = ON;", error);
+		return false;
+	}
+	auto finish = [&](bool ok) {
+		std::string ignored;
+		if (!ok) exec(db, "ROLLBACK;", ignored);
+		exec(db, "DETACH DATABASE vsrm_empty;", ignored);
+		exec(db, "PRAGMA foreign_keys = ON;", ignored);
+		if (!ok) recorder.detach();
+		return ok;
+	};
+	if (!exec(db, "BEGIN IMMEDIATE;", error)) return finish(false);
+
+	std::string move =
+		"UPDATE assignments SET appointment_id = appointment_id + " + b + " WHERE appointment_id < " + span + ";"
+		"UPDATE assignments SET mechanic_id = mechanic_id + " + b + " WHERE mechanic_id < " + span + ";"
+		// local, but they follow their records; archived records keep their ids, and so do their attachments
+		"UPDATE attachments SET service_record_id = service_record_id + " + b + " WHERE service_record_id < " + span +
+		" AND service_record_id IN (SELECT id FROM service_records);";
+	for (const char* table : kReplicatedTables)
+		move += std::string("UPDATE ") + table + " SET id = id + " + b + " WHERE id < " + span + ";";
+	// AUTOINCREMENT continues from max(sqlite_sequence, max id), so the next local insert lands in range
+	for (const char* table : kReplicatedTables) {
+		std::string t = table;
+		move += "DELETE FROM sqlite_sequence WHERE name = '" + t + "';"
+			"INSERT INTO sqlite_sequence (name, seq) VALUES ('" + t + "', max(" + b + ", (SELECT ifnull(max(id), 0) FROM " + t + ")));";
+	}
+	if (!exec(db, move.c_str(), error)) return finish(false);
+	if (queryInt(db, "SELECT COUNT(*) FROM pragma_foreign_key_check;") > 0) {
+		error = "Existing rows refer to missing mechanics or appointments; fix them before enabling replication";
+		return finish(false);
+	}
+
+	// The baseline: every row now in the tables, as seen from an empty database
+	if (!recorder.attach(db, error)) return finish(false);
+	sqlite3_session* baseline = nullptr;
+	if (!createSession(db, baseline, error)) return finish(false);
+	bool ok = true;
+	for (const char* table : recordedTables()) {
+		char* errMsg = nullptr;
+		if (sqlite3session_diff(baseline, "vsrm_empty", table, &errMsg) != SQLITE_OK) {
+			error = errMsg ? errMsg : "sqlite3session_diff failed";
+			sqlite3_free(errMsg);
+			ok = false;
+			break;
+		}
+	}
+	int size = 0;
+	void* changeset = nullptr;
+	if (ok && sqlite3session_changeset(baseline, &size, &changeset) != SQLITE_OK) { error = "Cannot record the baseline"; ok = false; }
+	sqlite3session_delete(baseline);
+	if (ok && size > 0) {
+		sqlite3_stmt* stmt = nullptr;
+		ok = sqlite3_prepare_v2(db, "INSERT INTO replication_outbox (committed_at, changeset) "
+			"VALUES (strftime('%Y-%m-%dT%H:%M:%SZ', 'now'), ?1);", -1, &stmt, nullptr) == SQLITE_OK;
+		if (ok) {
+			sqlite3_bind_blob(stmt, 1, changeset, size, SQLITE_STATIC);
+			ok = sqlite3_step(stmt) == SQLITE_DONE;
+		}
+		if (!ok) error = sqlite3_errmsg(db);
+		sqlite3_finalize(stmt);
+	}
+	sqlite3_free(changeset);
+	ok = ok && setStateValue(db, "branch_number", std::to_string(branchNumber), error) &&
+		setStateValue(db, "branch_name", branchName, error) &&
+		setStateValue(db, "shipped_seq", "0", error) &&
+		exec(db, ("PRAGMA application_id = " + std::to_string(kBranchApplicationId) + ";").c_str(), error) &&
+		recorder.stage(db, error) && // the state rows above are not replicated; this keeps the session clean
+		exec(db, "COMMIT;", error);
+	return finish(ok);
+}
+
+bool readReplicationStatus(sqlite3* db, ReplicationStatus& status, std::string& error) {
+	status = ReplicationStatus{};
+	sqlite3_stmt* probe = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT 1 FROM replication_state LIMIT 1;", -1, &probe, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_finalize(probe);
+	if (auto number = stateValue(db, "branch_number")) {
+		status.recording = true;
+		status.branchNumber = std::stoi(*number);
+		status.branchName = stateValue(db, "branch_name").value_or("");
+		status.shippedSeq = std::stoll(stateValue(db, "shipped_seq").value_or("0"));
+	}
+	status.lastSeq = queryInt(db, "SELECT seq FROM sqlite_sequence WHERE name = 'replication_outbox';");
+	status.outboxCommits = queryInt(db, "SELECT COUNT(*) FROM replication_outbox;");
+	status.appliedBranches = static_cast<int>(queryInt(db, "SELECT COUNT(*) FROM replication_applied;"));
+	return true;
+}
+
+bool exportChangesets(sqlite3* db, const std::string& path, std::optional<int64_t> fromSeq, ReplicationExport& out,
+	std::string& error) {
+	out = ReplicationExport{};
+	ReplicationStatus status;
+	if (!readReplicationStatus(db, status, error)) return false;
+	if (!status.recording) { error = "Replication is not enabled on this database"; return false; }
+	int64_t first = fromSeq.value_or(status.shippedSeq + 1);
+
+	// Read under one snapshot so the range and the file agree
+	if (!exec(db, "BEGIN;", error)) return false;
+	sqlite3_stmt* stmt = nullptr;
+	sqlite3_changegroup* group = nullptr;
+	auto fail = [&](const std::string& message) {
+		error = message;
+		if (stmt) sqlite3_finalize(stmt);
+		if (group) sqlite3changegroup_delete(group);
+		std::string ignored;
+		exec(db, "ROLLBACK;", ignored);
+		return false;
+	};
+	if (sqlite3_prepare_v2(db, "SELECT seq, changeset FROM replication_outbox WHERE seq >= ?1 ORDER BY seq;", -1, &stmt, nullptr) != SQLITE_OK)
+		return fail(sqlite3_errmsg(db));
+	sqlite3_bind_int64(stmt, 1, first);
+	if (sqlite3changegroup_new(&group) != SQLITE_OK) return fail("Out of memory");
+	// Merging nets out rows changed several times (an insert then updates becomes one insert)
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		int64_t seq = sqlite3_column_int64(stmt, 0);
+		if (out.commits == 0) {
+			if (seq != first && fromSeq) return fail("Commits before " + std::to_string(seq) + " were pruned from the outbox");
+			out.firstSeq = seq;
+		}
+		out.lastSeq = seq;
+		++out.commits;
+		if (sqlite3changegroup_add(group, sqlite3_column_bytes(stmt, 1), const_cast<void*>(sqlite3_column_blob(stmt, 1))) != SQLITE_OK)
+			return fail("Outbox entry " + std::to_string(seq) + " is not a valid changeset");
+	}
+	if (rc != SQLITE_DONE) return fail(sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	stmt = nullptr;
+	if (out.commits == 0) {
+		sqlite3changegroup_delete(group);
+		exec(db, "COMMIT;", error);
+		return true;
+	}
+	int size = 0;
+	void* merged = nullptr;
+	if (sqlite3changegroup_output(group, &size, &merged) != SQLITE_OK) return fail("Cannot merge the outbox changesets");
+	sqlite3changegroup_delete(group);
+	group = nullptr;
+	exec(db, "COMMIT;", error);
+
+	WireWriter w;
+	w.out.append(kFileMagic);
+	w.u32(static_cast<uint32_t>(status.branchNumber));
+	w.str(status.branchName);
+	w.i64(out.firstSeq);
+	w.i64(out.lastSeq);
+	w.u32(static_cast<uint32_t>(out.commits));
+	w.str(std::string_view(static_cast<const char*>(merged), static_cast<size_t>(size)));
+	sqlite3_free(merged);
+	w.i64(static_cast<int64_t>(fastHash64(w.out, kChecksumSeed)));
+	out.changesetBytes = static_cast<size_t>(size);
+	out.fileBytes = w.out.size();
+
+	// Written beside the target and renamed, so a reader never sees half a file
+	fs::path target = pathFromUtf8(path), temp = target;
+	temp += ".part";
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file.write(w.out.data(), static_cast<std::streamsize>(w.out.size())) || !file.flush()) {
+			error = "Cannot write " + path;
+			return false;
+		}
+	}
+	std::error_code ec;
+	fs::rename(temp, target, ec);
+	if (ec) { error = "Cannot write " + path + ": " + ec.message(); return false; }
+	out.empty = false;
+	if (out.lastSeq > status.shippedSeq && !setStateValue(db, "shipped_seq", std::to_string(out.lastSeq), error)) return false;
+	return true;
+}
+
+bool applyChangesetFile(sqlite3* db, const std::string& path, ReplicationConflict policy, ReplicationApplyStats& stats,
+	std::string& error) {
+	stats = ReplicationApplyStats{};
+	auto started = std::chrono::steady_clock::now();
+	std::string bytes;
+	if (!readFile(path, bytes, error)) return false;
+	if (bytes.size() < kFileMagic.size() + 8 || std::string_view(bytes).substr(0, kFileMagic.size()) != kFileMagic) {
+		error = path + " is not a VSRM changeset file";
+		return false;
+	}
+	std::string_view body = std::string_view(bytes).substr(0, bytes.size() - 8);
+	WireReader tail(std::string_view(bytes).substr(bytes.size() - 8));
+	if (static_cast<uint64_t>(tail.i64()) != fastHash64(body, kChecksumSeed)) {
+		error = path + " is damaged (checksum mismatch)";
+		return false;
+	}
+	WireReader r(body.substr(kFileMagic.size()));
+	stats.branchNumber = static_cast<int>(r.u32());
+	stats.branchName = r.str();
+	stats.firstSeq = r.i64();
+	stats.lastSeq = r.i64();
+	r.u32(); // commits merged into the changeset
+	std::string changeset = r.str();
+	if (!r.ok() || !r.atEnd() || stats.branchNumber < 1 || stats.branchNumber > kMaxBranchNumber || stats.firstSeq > stats.lastSeq) {
+		error = path + " has a malformed header";
+		return false;
+	}
+	if (stateValue(db, "branch_number")) {
+		error = "A branch database cannot apply changesets; apply them to head office";
+		return false;
+	}
+
+	std::string ignored;
+	if (!exec(db, "BEGIN IMMEDIATE;", error)) return false;
+	auto fail = [&](const std::string& message) {
+		error = message;
+		exec(db, "ROLLBACK;", ignored);
+		return false;
+	};
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT last_seq FROM replication_applied WHERE branch_number = ?1;", -1, &stmt, nullptr) != SQLITE_OK)
+		return fail(sqlite3_errmsg(db));
+	sqlite3_bind_int(stmt, 1, stats.branchNumber);
+	int64_t applied = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+	sqlite3_finalize(stmt);
+	if (stats.lastSeq <= applied) {
+		stats.alreadyApplied = true;
+		exec(db, "COMMIT;", ignored);
+		return true;
+	}
+	if (stats.firstSeq > applied + 1) {
+		return fail("Branch " + std::to_string(stats.branchNumber) + " commits " + std::to_string(applied + 1) + "-" +
+			std::to_string(stats.firstSeq - 1) + " have not been applied; export them from the branch first");
+	}
+
+	// Tally the operations and keep the service records inserted, for the sketches
+	std::vector<InsertedRecord> inserted;
+	sqlite3_changeset_iter* it = nullptr;
+	int size = static_cast<int>(changeset.size());
+	void* data = changeset.data();
+	if (sqlite3changeset_start(&it, size, data) != SQLITE_OK) return fail(path + " holds an invalid changeset");
+	while (sqlite3changeset_next(it) == SQLITE_ROW) {
+		const char* table = nullptr;
+		int columns = 0, op = 0, indirect = 0;
+		sqlite3changeset_op(it, &table, &columns, &op, &indirect);
+		if (op == SQLITE_INSERT) ++stats.inserts;
+		else if (op == SQLITE_UPDATE) ++stats.updates;
+		else ++stats.deletes;
+		if (op == SQLITE_INSERT && std::strcmp(table, "service_records") == 0 && columns >= 6) {
+			sqlite3_value* v[6] = {};
+			for (int i = 0; i < 6; ++i) sqlite3changeset_new(it, i, &v[i]);
+			bool packed = v[4] && sqlite3_value_type(v[4]) == SQLITE_BLOB && sqlite3_value_bytes(v[4]) > 0;
+			std::string description = packed
+				? std::string(static_cast<const char*>(sqlite3_value_blob(v[4])), static_cast<size_t>(sqlite3_value_bytes(v[4])))
+				: valueText(v[4]);
+			inserted.push_back({v[0] ? sqlite3_value_int64(v[0]) : 0, valueText(v[1]), valueText(v[2]), valueText(v[3]),
+				std::move(description), valueText(v[5]), packed});
+		}
+	}
+	if (sqlite3changeset_finalize(it) != SQLITE_OK) return fail(path + " holds an invalid changeset");
+
+	DescriptionCodec codec;
+	ApplyContext ctx{policy, &stats, {}, {}, &codec, db};
+	if (int rc = sqlite3changeset_apply(db, size, data, nullptr, onConflict, &ctx); rc != SQLITE_OK)
+		return fail(!ctx.error.empty() ? ctx.error : std::string("Applying the changeset failed: ") + sqlite3_errmsg(db));
+
+	// Packed descriptions are read once their dictionary, possibly in this changeset, is in place
+	SketchWriter sketches;
+	std::string text;
+	for (const auto& rec : inserted) {
+		if (ctx.droppedRecords.count(rec.id)) continue;
+		if (rec.packed && !codec.unpack(db, rec.description, text, error)) return fail(error);
+		if (!sketches.add(db, rec.date, rec.customer, rec.vin, rec.mechanic, rec.packed ? text : rec.description, error))
+			return fail(error);
+	}
+	if (!sketches.flush(db, error)) return fail(error);
+
+	if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO replication_applied (branch_number, branch_name, last_seq, applied_at) "
+		"VALUES (?1, ?2, ?3, strftime('%Y-%m-%dT%H:%M:%SZ', 'now'));", -1, &stmt, nullptr) != SQLITE_OK)
+		return fail(sqlite3_errmsg(db));
+	sqlite3_bind_int(stmt, 1, stats.branchNumber);
+	sqlite3_bind_text(stmt, 2, stats.branchName.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64(stmt, 3, stats.lastSeq);
+	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+	sqlite3_finalize(stmt);
+	if (!ok) return fail(sqlite3_errmsg(db));
+	if (!exec(db, "COMMIT;", error)) return fail(error);
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	stats.milliseconds = took.count();
+	return true;
+}
+
+bool pruneReplicationOutbox(sqlite3* db, int64_t& removed, std::string& error) {
+	removed = 0;
+	ReplicationStatus status;
+	if (!readReplicationStatus(db, status, error)) return false;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "DELETE FROM replication_outbox WHERE seq <= ?1;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_bind_int64(stmt, 1, status.shippedSeq);
+	bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+	if (ok) removed = sqlite3_changes64(db);
+	else error = sqlite3_errmsg(db);
+	sqlite3_finalize(stmt);
+	return ok;
+}
+
+#else
+
+namespace {
+constexpr const char* kUnavailable =
+#ifdef VSRM_HAS_SQLITE3
+	"SQLite was built without the session extension; replication is unavailable.";
+#else
+	"SQLite not available.";
+#endif
+}
+
+ChangeRecorder::~ChangeRecorder() = default;
+bool ChangeRecorder::attach(sqlite3*, std::string& error) { error = kUnavailable; return false; }
+void ChangeRecorder::detach() {}
+bool ChangeRecorder::stage(sqlite3*, std::string&) { return true; }
+
+bool replicationAvailable() { return false; }
+
+bool enableReplication(sqlite3*, int, const std::string&, ChangeRecorder&, std::string& error) { error = kUnavailable; return false; }
+
+bool readReplicationStatus(sqlite3*, ReplicationStatus& status, std::string& error) {
+	status = ReplicationStatus{};
+	error = kUnavailable;
+	return false;
+}
+
+bool exportChangesets(sqlite3*, const std::string&, std::optional<int64_t>, ReplicationExport& out, std::string& error) {
+	out = ReplicationExport{};
+	error = kUnavailable;
+	return false;
+}
+
+bool applyChangesetFile(sqlite3*, const std::string&, ReplicationConflict, ReplicationApplyStats& stats, std::string& error) {
+	stats = ReplicationApplyStats{};
+	error = kUnavailable;
+	return false;
+}
+
+bool pruneReplicationOutbox(sqlite3*, int64_t& removed, std::string& error) {
+	removed = 0;
+	error = kUnavailable;
+	return false;
+}
+
+#endif
+
+} // namespace vsrm
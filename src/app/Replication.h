@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+struct sqlite3;
+struct sqlite3_session;
+
+namespace vsrm {
+
+// Branch-to-head-office replication on the SQLite session extension.
+//
+// A branch records: every commit that touches a replicated table also writes the commit's
+// changeset to replication_outbox, in the same transaction. exportChangesets() merges the
+// commits since the last export into one changeset file; head office applies files with
+// applyChangesetFile(), which remembers the last sequence number per branch so replaying a
+// file is a no-op. Both sides cost O(changes since the last sync).
+//
+// Row ids are partitioned so branches never collide: branch N (1..kMaxBranchNumber)
+// allocates ids from branchIdBase(N), and enabling replication moves existing rows there.
+// Head office only applies; it never records, so its tables hold every branch's ranges.
+// users stays local, and service_due / analytics_sketches are derived where rows land.
+
+inline constexpr const char* kReplicatedTables[] = {"service_records", "mechanics", "appointments", "assignments"};
+// Recorded too but keyed by content, not by an allocated id, so never moved: the description
+// dictionaries have to travel with the rows packed with them
+inline constexpr const char* kReplicatedSharedTables[] = {"text_dictionaries"};
+// PRAGMA application_id of a branch database ("VSRB"), set by enableReplication. Lets an open
+// tell from the file header alone whether replication_state needs reading.
+constexpr int32_t kBranchApplicationId = 0x56535242;
+constexpr int kMaxBranchNumber = 127;
+constexpr int64_t kBranchIdSpan = int64_t(1) << 24;
+constexpr int64_t branchIdBase(int branchNumber) { return kBranchIdSpan * branchNumber; }
+
+enum class ReplicationConflict {
+	BranchWins,     // an update or insert that meets different data at head office overwrites it
+	HeadOfficeWins, // ... or is dropped
+};
+
+struct ReplicationStatus {
+	bool recording{false};  // this database is a branch
+	int branchNumber{};
+	std::string branchName;
+	int64_t lastSeq{};      // newest commit in the outbox
+	int64_t shippedSeq{};   // newest commit exported
+	int64_t outboxCommits{}; // commits still kept in the outbox
+	int appliedBranches{};  // head office: branches with applied changesets
+};
+
+struct ReplicationExport {
+	bool empty{true};       // nothing committed since the last export; no file written
+	int64_t firstSeq{};
+	int64_t lastSeq{};
+	size_t commits{};
+	size_t changesetBytes{}; // after merging the commits
+	size_t fileBytes{};
+};
+
+struct ReplicationApplyStats {
+	int branchNumber{};
+	std::string branchName;
+	int64_t firstSeq{};
+	int64_t lastSeq{};
+	bool alreadyApplied{false}; // the whole file had been applied before; nothing changed
+	size_t inserts{};
+	size_t updates{};
+	size_t deletes{};
+	size_t duplicates{};  // inserts of rows already present with the same values
+	size_t conflicts{};   // rows that differed at head office, resolved by the policy
+	size_t skipped{};     // updates/deletes of rows head office no longer has, constraint failures
+	double milliseconds{};
+};
+
+// Owns the session recording a branch connection's changes
+class ChangeRecorder {
+public:
+	ChangeRecorder() = default;
+	~ChangeRecorder();
+	ChangeRecorder(const ChangeRecorder&) = delete;
+	ChangeRecorder& operator=(const ChangeRecorder&) = delete;
+
+	bool attach(sqlite3* db, std::string& error);
+	void detach();
+	// Inside the write transaction, before COMMIT: moves what was recorded since the last call
+	// into replication_outbox and starts over
+	bool stage(sqlite3* db, std::string& error);
+	bool attached() const { return session != nullptr; }
+
+private:
+	sqlite3_session* session{nullptr};
+};
+
+// True when the SQLite library was built with the session extension
+bool replicationAvailable();
+
+// Makes db branch `branchNumber`: existing rows of the replicated tables move into the branch's
+// id range, and the first outbox entry holds all of them so head office gets a full baseline.
+// Runs outside any transaction (foreign keys are switched off while ids move). Calling it
+// again with the same number only re-attaches the recorder.
+bool enableReplication(sqlite3* db, int branchNumber, const std::string& branchName, ChangeRecorder& recorder,
+	std::string& error);
+// Reads replication_state; recording is false for head office and unconfigured databases
+bool readReplicationStatus(sqlite3* db, ReplicationStatus& status, std::string& error);
+
+// Writes the commits after the last export (or from fromSeq, to resend) as one file
+bool exportChangesets(sqlite3* db, const std::string& path, std::optional<int64_t> fromSeq, ReplicationExport& out,
+	std::string& error);
+// Applies a file in one transaction; a gap in a branch's sequence numbers is an error
+bool applyChangesetFile(sqlite3* db, const std::string& path, ReplicationConflict policy, ReplicationApplyStats& stats,
+	std::string& error);
+// Deletes exported commits from the outbox
+bool pruneReplicationOutbox(sqlite3* db, int64_t& removed, std::string& error);
+
+} // namespace vsrm
@@ -0,0 +1,190 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <random>
+#include <string_view>
+#include <unordered_map>
+
+namespace vsrm {
+
+namespace {
+
+std::string foldSkill(std::string_view s) {
+	while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+	while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+	std::string out(s);
+	for (char& c : out) if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+	return out;
+}
+
+std::string localTimestamp() {
+	std::time_t t = std::time(nullptr);
+	std::tm local{};
+#ifdef _WIN32
+	localtime_s(&local, &t);
+#else
+	localtime_r(&t, &local);
+#endif
+	char buf[32];
+	std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &local);
+	return buf;
+}
+
+struct Job {
+	int appointmentId;
+	int day;                           // index into the planned days
+	const std::vector<int>* candidates; // mechanic slots
+	const std::string* scheduledAt;
+};
+
+} // namespace
+
+SchedulePlan balanceWorkload(
+	const std::vector<Appointment>& pending,
+	const std::vector<Mechanic>& mechanics,
+	const std::vector<MechanicDayLoad>& openLoad,
+	const SchedulerOptions& options) {
+	auto started = std::chrono::steady_clock::now();
+	SchedulePlan plan;
+
+	// Active mechanics get dense slots; candidates are lists of slots per skill
+	std::vector<int> ids;
+	std::vector<int> everyone;
+	std::unordered_map<int, int> slotOf;
+	std::unordered_map<std::string, std::vector<int>> bySkill;
+	for (const auto& m : mechanics) {
+		if (!m.active) continue;
+		int slot = static_cast<int>(ids.size());
+		ids.push_back(m.id);
+		slotOf.emplace(m.id, slot);
+		everyone.push_back(slot);
+		bySkill[foldSkill(m.skill)].push_back(slot);
+	}
+
+	std::unordered_map<std::string, int> dayOf;
+	std::vector<Job> jobs;
+	jobs.reserve(pending.size());
+	for (const auto& a : pending) {
+		const std::vector<int>* candidates = &everyone;
+		if (a.requiredSkill && !foldSkill(*a.requiredSkill).empty()) {
+			auto it = bySkill.find(foldSkill(*a.requiredSkill));
+			candidates = it == bySkill.end() ? nullptr : &it->second;
+		}
+		if (!candidates || candidates->empty()) { plan.unassigned.push_back(a.id); continue; }
+		int day = dayOf.try_emplace(a.scheduledAt.substr(0, 10), static_cast<int>(dayOf.size())).first->second;
+		jobs.push_back(Job{a.id, day, candidates, &a.scheduledAt});
+	}
+
+	const size_t slots = ids.size();
+	std::vector<int> dayLoad(dayOf.size() * slots, 0); // [day * slots + slot]
+	std::vector<int> totalLoad(slots, 0);
+	for (const auto& l : openLoad) {
+		auto m = slotOf.find(l.mechanicId);
+		auto d = dayOf.find(l.day);
+		if (m == slotOf.end() || d == dayOf.end()) continue; // days we are not planning don't matter
+		dayLoad[d->second * slots + m->second] += l.jobs;
+		totalLoad[m->second] += l.jobs;
+	}
+
+	// Most constrained first, so narrow skills are not crowded out by jobs anyone can take
+	std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+		if (a.day != b.day) return a.day < b.day;
+		if (a.candidates->size() != b.candidates->size()) return a.candidates->size() < b.candidates->size();
+		if (*a.scheduledAt != *b.scheduledAt) return *a.scheduledAt < *b.scheduledAt;
+		return a.appointmentId < b.appointmentId;
+	});
+
+	const int cap = options.maxJobsPerDay;
+	plan.assignments.reserve(jobs.size());
+	for (const auto& job : jobs) {
+		int* load = dayLoad.data() + job.day * slots;
+		int best = -1;
+		for (int c : *job.candidates) {
+			if (cap > 0 && load[c] >= cap) continue;
+			if (best < 0 || load[c] < load[best] ||
+				(load[c] == load[best] && (totalLoad[c] < totalLoad[best] ||
+					(totalLoad[c] == totalLoad[best] && ids[c] < ids[best])))) {
+				best = c;
+			}
+		}
+		if (best < 0) { plan.unassigned.push_back(job.appointmentId); continue; }
+		++load[best];
+		++totalLoad[best];
+		plan.assignments.push_back(PlannedAssignment{job.appointmentId, ids[best]});
+	}
+
+	if (!dayLoad.empty()) {
+		auto [lo, hi] = std::minmax_element(dayLoad.begin(), dayLoad.end());
+		plan.minDayLoad = *lo;
+		plan.maxDayLoad = *hi;
+	}
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	plan.milliseconds = took.count();
+	return plan;
+}
+
+bool assignPendingAppointments(Database& db, const SchedulerOptions& options, SchedulePlan& plan, std::string& error) {
+	plan = balanceWorkload(db.listUnassignedAppointments(), db.listMechanics(true), db.listOpenAssignmentLoad(), options);
+	std::vector<Assignment> batch;
+	batch.reserve(plan.assignments.size());
+	std::string stamp = localTimestamp();
+	for (const auto& p : plan.assignments) {
+		Assignment asg{};
+		asg.appointmentId = p.appointmentId;
+		asg.mechanicId = p.mechanicId;
+		asg.assignedAt = stamp;
+		batch.push_back(std::move(asg));
+	}
+	if (!db.addAssignmentsBatch(batch)) { error = db.getLastError(); return false; }
+	return true;
+}
+
+SyntheticWorkload makeSyntheticWorkload(int appointments, int mechanics, int days, uint32_t seed) {
+	static const char* const kSkills[] = {"Engine", "Electrical", "Body", "Transmission", "General"};
+	constexpr int kSkillCount = static_cast<int>(sizeof(kSkills) / sizeof(kSkills[0]));
+	SyntheticWorkload w;
+	std::mt19937 rng(seed);
+	days = std::max(days, 1);
+	auto dayString = [](int d) {
+		char buf[16];
+		std::snprintf(buf, sizeof(buf), "2025-%02d-%02d", 1 + (d / 28) % 12, 1 + d % 28);
+		return std::string(buf);
+	};
+
+	w.mechanics.reserve(mechanics);
+	for (int i = 0; i < mechanics; ++i) {
+		Mechanic m{};
+		m.id = i + 1;
+		m.name = "Mechanic " + std::to_string(i + 1);
+		m.skill = kSkills[i % kSkillCount];
+		m.active = rng() % 10 != 0;
+		w.mechanics.push_back(std::move(m));
+	}
+
+	w.pending.reserve(appointments);
+	for (int i = 0; i < appointments; ++i) {
+		Appointment a{};
+		a.id = i + 1;
+		a.vin = "JTSYNTH" + std::to_string(100000000 + i);
+		a.customerName = "Customer " + std::to_string(i % 997);
+		char time[16];
+		std::snprintf(time, sizeof(time), "T%02u:%02u:00", static_cast<unsigned>(8 + rng() % 9), static_cast<unsigned>((rng() % 4) * 15));
+		a.scheduledAt = dayString(static_cast<int>(rng() % days)) + time;
+		a.status = "scheduled";
+		if (rng() % 5 < 2) a.requiredSkill = std::string(kSkills[rng() % (kSkillCount - 1)]);
+		w.pending.push_back(std::move(a));
+	}
+
+	for (int d = 0; d < days; ++d) {
+		for (const auto& m : w.mechanics) {
+			int jobs = static_cast<int>(rng() % 3);
+			if (jobs) w.openLoad.push_back(MechanicDayLoad{m.id, dayString(d), jobs});
+		}
+	}
+	return w;
+}
+
+} // namespace vsrm
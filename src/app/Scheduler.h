@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Database.h"
+
+namespace vsrm {
+
+struct SchedulerOptions {
+	int maxJobsPerDay{8}; // per mechanic, counting assignments already open that day; 0: no limit
+};
+
+struct PlannedAssignment {
+	int appointmentId{};
+	int mechanicId{};
+};
+
+struct SchedulePlan {
+	std::vector<PlannedAssignment> assignments;
+	std::vector<int> unassigned; // appointment ids with no mechanic of the skill, or none with capacity left
+	int minDayLoad{};            // lowest / highest jobs per (mechanic, day) over the planned days
+	int maxDayLoad{};
+	double milliseconds{};
+};
+
+// Assigns each pending appointment to an active mechanic whose skill matches
+// (case-insensitive; an empty requiredSkill accepts anyone) without exceeding
+// maxJobsPerDay. Appointments are planned one day at a time, most constrained
+// first, each going to the least-loaded eligible mechanic that day (ties: least
+// loaded over all planned days, then lowest id). Deterministic for equal input.
+SchedulePlan balanceWorkload(
+	const std::vector<Appointment>& pending,
+	const std::vector<Mechanic>& mechanics,
+	const std::vector<MechanicDayLoad>& openLoad,
+	const SchedulerOptions& options = {});
+
+// Loads unassigned appointments, plans them and writes the result with
+// Database::addAssignmentsBatch, stamping assignedAt with the current local time.
+bool assignPendingAppointments(Database& db, const SchedulerOptions& options, SchedulePlan& plan, std::string& error);
+
+// Reproducible synthetic intake for benchmarking balanceWorkload.
+struct SyntheticWorkload {
+	std::vector<Appointment> pending;
+	std::vector<Mechanic> mechanics;
+	std::vector<MechanicDayLoad> openLoad;
+};
+SyntheticWorkload makeSyntheticWorkload(int appointments, int mechanics, int days, uint32_t seed = 1);
+
+} // namespace vsrm
@@ -0,0 +1,132 @@
+#include "ServiceClient.h"
+
+#include "Database.h"
+
+namespace vsrm {
+
+std::string ServiceResponse::error() const {
+	if (status == Status::Ok) return {};
+	WireReader r(body);
+	std::string message = r.str();
+	return r.ok() && !message.empty() ? message : "Request failed";
+}
+
+bool ServiceClient::connect(const std::string& socketPath) {
+	incoming.clear();
+	incomingStart = 0;
+	outgoing.out.clear();
+	pending = 0;
+	if (!socket.connect(socketPath, lastError)) return false;
+	WireWriter hello;
+	hello.u32(kProtocolVersion);
+	ServiceResponse response;
+	if (!roundTrip(Op::Hello, hello.out, response)) { socket.close(); return false; }
+	return true;
+}
+
+uint32_t ServiceClient::request(Op op, const std::string& body) {
+	uint32_t id = nextId++;
+	outgoing.begin(id, static_cast<uint8_t>(op));
+	outgoing.out += body;
+	outgoing.end();
+	++pending;
+	return id;
+}
+
+bool ServiceClient::flush() {
+	if (outgoing.out.empty()) return true;
+	bool ok = socket.sendAll(outgoing.out.data(), outgoing.out.size());
+	outgoing.out.clear();
+	if (!ok) lastError = "Connection to the server was lost";
+	return ok;
+}
+
+bool ServiceClient::receive(ServiceResponse& response) {
+	char chunk[64 * 1024];
+	for (;;) {
+		size_t consumed = 0;
+		bool tooLarge = false;
+		if (auto payload = nextFrame(std::string_view(incoming).substr(incomingStart), consumed, tooLarge)) {
+			WireReader r(*payload);
+			response.requestId = r.u32();
+			response.status = static_cast<Status>(r.u8());
+			response.body.assign(payload->substr(payload->size() < 5 ? payload->size() : 5));
+			incomingStart += consumed;
+			if (incomingStart == incoming.size()) { incoming.clear(); incomingStart = 0; }
+			if (pending) --pending;
+			if (!r.ok()) { lastError = "Malformed response"; return false; }
+			return true;
+		}
+		if (tooLarge) { lastError = "Response exceeds the frame limit"; return false; }
+		if (incomingStart > incoming.size() / 2) { incoming.erase(0, incomingStart); incomingStart = 0; }
+		long n = socket.receive(chunk, sizeof(chunk));
+		if (n <= 0) { lastError = "Connection to the server was lost"; return false; }
+		incoming.append(chunk, static_cast<size_t>(n));
+	}
+}
+
+bool ServiceClient::roundTrip(Op op, const std::string& body, ServiceResponse& response) {
+	if (pending) { lastError = "Pipelined requests are still in flight"; return false; }
+	uint32_t id = request(op, body);
+	if (!flush() || !receive(response)) return false;
+	if (response.requestId != id) { lastError = "Response does not match the request"; return false; }
+	if (response.status != Status::Ok) { lastError = response.error(); return false; }
+	return true;
+}
+
+std::optional<int> ServiceClient::addServiceRecord(const ServiceRecord& record) {
+	WireWriter body;
+	writeServiceRecord(body, record);
+	ServiceResponse response;
+	if (!roundTrip(Op::AddServiceRecord, body.out, response)) return std::nullopt;
+	WireReader r(response.body);
+	return static_cast<int>(r.i64());
+}
+
+std::optional<int> ServiceClient::addAppointment(const Appointment& appt) {
+	WireWriter body;
+	writeAppointment(body, appt);
+	ServiceResponse response;
+	if (!roundTrip(Op::AddAppointment, body.out, response)) return std::nullopt;
+	WireReader r(response.body);
+	return static_cast<int>(r.i64());
+}
+
+bool ServiceClient::listServiceRecordsByVin(const std::string& vin, std::vector<ServiceRecord>& out) {
+	out.clear();
+	WireWriter body;
+	body.str(vin);
+	ServiceResponse response;
+	if (!roundTrip(Op::ListServiceRecordsByVin, body.out, response)) return false;
+	WireReader r(response.body);
+	for (uint32_t n = r.u32(); n && r.ok(); --n) out.push_back(readServiceRecord(r));
+	if (!r.ok()) { lastError = "Malformed response"; return false; }
+	return true;
+}
+
+bool ServiceClient::listVehicleSummaries(const std::string& vinLike, const std::optional<std::string>& fromDate,
+	const std::optional<std::string>& toDate, const std::optional<std::string>& mechanicLike, bool dueOnly,
+	std::vector<VehicleSummary>& out) {
+	out.clear();
+	WireWriter body;
+	body.str(vinLike);
+	body.optStr(fromDate);
+	body.optStr(toDate);
+	body.optStr(mechanicLike);
+	body.u8(dueOnly ? 1 : 0);
+	ServiceResponse response;
+	if (!roundTrip(Op::ListVehicleSummaries, body.out, response)) return false;
+	WireReader r(response.body);
+	for (uint32_t n = r.u32(); n && r.ok(); --n) out.push_back(readVehicleSummary(r));
+	if (!r.ok()) { lastError = "Malformed response"; return false; }
+	return true;
+}
+
+std::optional<int64_t> ServiceClient::countServiceRecords() {
+	ServiceResponse response;
+	if (!roundTrip(Op::CountServiceRecords, {}, response)) return std::nullopt;
+	WireReader r(response.body);
+	return r.i64();
+}
+
+} // namespace vsrm
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "LocalSocket.h"
+#include "ServiceProtocol.h"
+
+namespace vsrm {
+
+struct ServiceRecord;
+struct Appointment;
+struct VehicleSummary;
+
+struct ServiceResponse {
+	uint32_t requestId{};
+	Status status{};
+	std::string body; // result (Ok) or the error message as a protocol string
+	std::string error() const;
+};
+
+// Connection to a ServiceServer. Requests can be pipelined: queue any number with
+// request(), flush() once, then receive() the answers as they complete (not necessarily in
+// request order). The typed calls below do one round trip each. Not thread-safe; give each
+// thread its own client.
+class ServiceClient {
+public:
+	// Connects and checks the protocol version
+	bool connect(const std::string& socketPath);
+	void close() { socket.close(); }
+
+	// Queues a request whose body was encoded with a WireWriter; returns its id
+	uint32_t request(Op op, const std::string& body = {});
+	bool flush();
+	bool receive(ServiceResponse& response);
+	size_t inFlight() const { return pending; }
+
+	std::optional<int> addServiceRecord(const ServiceRecord& record);
+	std::optional<int> addAppointment(const Appointment& appt);
+	bool listServiceRecordsByVin(const std::string& vin, std::vector<ServiceRecord>& out);
+	bool listVehicleSummaries(const std::string& vinLike, const std::optional<std::string>& fromDate,
+		const std::optional<std::string>& toDate, const std::optional<std::string>& mechanicLike, bool dueOnly,
+		std::vector<VehicleSummary>& out);
+	std::optional<int64_t> countServiceRecords();
+
+	std::string getLastError() const { return lastError; }
+
+private:
+	LocalSocket socket;
+	WireWriter outgoing;
+	std::string incoming;
+	size_t incomingStart{0};
+	uint32_t nextId{1};
+	size_t pending{0};
+	std::string lastError;
+
+	// One request in flight: sends it and waits for its answer; false (with lastError) unless Ok
+	bool roundTrip(Op op, const std::string& body, ServiceResponse& response);
+};
+
+} // namespace vsrm
@@ -0,0 +1,457 @@
+#include "ServiceColumns.h"
+
+#include "Archive.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define VSRM_COLUMNS_SSE2 1
+#endif
+
+namespace vsrm {
+
+size_t StringDictionary::probe(std::string_view s, uint32_t hash) const {
+	const size_t mask = slots.size() - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		uint64_t slot = slots[i];
+		if (slot == 0) return i;
+		if (static_cast<uint32_t>(slot >> 32) == hash && values[static_cast<uint32_t>(slot) - 1] == s) return i;
+	}
+}
+
+void StringDictionary::grow() {
+	std::vector<uint64_t> old(std::max<size_t>(slots.size() * 2, 1024), 0);
+	old.swap(slots);
+	const size_t mask = slots.size() - 1;
+	for (uint64_t slot : old) {
+		if (slot == 0) continue;
+		size_t i = static_cast<uint32_t>(slot >> 32) & mask;
+		while (slots[i] != 0) i = (i + 1) & mask;
+		slots[i] = slot;
+	}
+}
+
+uint32_t StringDictionary::intern(std::string_view s) {
+	if ((values.size() + 1) * 2 > slots.size()) grow(); // load factor <= 1/2
+	const uint32_t hash = static_cast<uint32_t>(std::hash<std::string_view>{}(s));
+	size_t i = probe(s, hash);
+	if (slots[i] != 0) return static_cast<uint32_t>(slots[i]) - 1;
+	uint32_t id = static_cast<uint32_t>(values.size());
+	values.emplace_back(s);
+	slots[i] = uint64_t(hash) << 32 | (id + 1);
+	return id;
+}
+
+std::optional<uint32_t> StringDictionary::find(std::string_view s) const {
+	if (slots.empty()) return std::nullopt;
+	size_t i = probe(s, static_cast<uint32_t>(std::hash<std::string_view>{}(s)));
+	if (slots[i] == 0) return std::nullopt;
+	return static_cast<uint32_t>(slots[i]) - 1;
+}
+
+void StringDictionary::clear() {
+	values.clear();
+	slots.clear();
+}
+
+namespace {
+
+constexpr int32_t kMaxDate = 99991231;
+
+// Matches per 4 rows: dates in [lo, hi], and of `mechanic` when kByMechanic.
+// The count kernel sums lane masks (-1 per match); the group kernel visits set lanes.
+template <bool kByMechanic>
+int64_t countKernel(const int32_t* dates, const uint32_t* mechanics, size_t n, int32_t lo, int32_t hi, uint32_t mechanic) {
+	int64_t total = 0;
+	size_t i = 0;
+#ifdef VSRM_COLUMNS_SSE2
+	const __m128i below = _mm_set1_epi32(lo - 1), above = _mm_set1_epi32(hi + 1);
+	const __m128i who = _mm_set1_epi32(static_cast<int32_t>(mechanic));
+	constexpr size_t kBlock = size_t(1) << 24; // flush lanes long before 32 bits could overflow
+	while (n - i >= 4) {
+		const size_t end = i + std::min((n - i) & ~size_t(3), kBlock);
+		__m128i acc = _mm_setzero_si128();
+		for (; i < end; i += 4) {
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dates + i));
+			__m128i hit = _mm_and_si128(_mm_cmpgt_epi32(d, below), _mm_cmplt_epi32(d, above));
+			if constexpr (kByMechanic)
+				hit = _mm_and_si128(hit, _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mechanics + i)), who));
+			acc = _mm_sub_epi32(acc, hit);
+		}
+		alignas(16) int32_t lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+		total += int64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+	}
+#endif
+	for (; i < n; ++i) total += (dates[i] >= lo) & (dates[i] <= hi) & (!kByMechanic || mechanics[i] == mechanic);
+	return total;
+}
+
+template <bool kByMechanic, class Slot>
+void groupKernel(const int32_t* dates, const uint32_t* mechanics, size_t n, int32_t lo, int32_t hi, uint32_t mechanic,
+	int64_t* counts, Slot slot) {
+	size_t i = 0;
+#ifdef VSRM_COLUMNS_SSE2
+	const __m128i below = _mm_set1_epi32(lo - 1), above = _mm_set1_epi32(hi + 1);
+	const __m128i who = _mm_set1_epi32(static_cast<int32_t>(mechanic));
+	for (; i + 4 <= n; i += 4) {
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dates + i));
+		__m128i hit = _mm_and_si128(_mm_cmpgt_epi32(d, below), _mm_cmplt_epi32(d, above));
+		if constexpr (kByMechanic)
+			hit = _mm_and_si128(hit, _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mechanics + i)), who));
+		int bits = _mm_movemask_ps(_mm_castsi128_ps(hit));
+		if (bits == 0) continue;
+		if (bits == 0xF) {
+			++counts[slot(i)]; ++counts[slot(i + 1)]; ++counts[slot(i + 2)]; ++counts[slot(i + 3)];
+			continue;
+		}
+		for (int b = 0; b < 4; ++b) if (bits >> b & 1) ++counts[slot(i + b)];
+	}
+#endif
+	for (; i < n; ++i) {
+		if (dates[i] >= lo && dates[i] <= hi && (!kByMechanic || mechanics[i] == mechanic)) ++counts[slot(i)];
+	}
+}
+
+template <class Slot>
+void groupBy(const int32_t* dates, const uint32_t* mechanics, size_t n, int32_t lo, int32_t hi,
+	const std::optional<uint32_t>& mechanic, int64_t* counts, Slot slot) {
+	if (mechanic) groupKernel<true>(dates, mechanics, n, lo, hi, *mechanic, counts, slot);
+	else groupKernel<false>(dates, mechanics, n, lo, hi, 0, counts, slot);
+}
+
+} // namespace
+
+std::optional<int32_t> ServiceColumns::parseDate(std::string_view iso) {
+	if (iso.size() < 10 || iso[4] != '-' || iso[7] != '-') return std::nullopt;
+	int32_t v[3] = {0, 0, 0};
+	const int start[3] = {0, 5, 8}, len[3] = {4, 2, 2};
+	for (int f = 0; f < 3; ++f) {
+		for (int k = 0; k < len[f]; ++k) {
+			char c = iso[start[f] + k];
+			if (c < '0' || c > '9') return std::nullopt;
+			v[f] = v[f] * 10 + (c - '0');
+		}
+	}
+	if (v[1] < 1 || v[1] > 12 || v[2] < 1 || v[2] > 31) return std::nullopt;
+	return v[0] * 10000 + v[1] * 100 + v[2];
+}
+
+void ServiceColumns::clear() {
+	rowids.clear();
+	dates.clear();
+	vinIds.clear();
+	mechanicIds.clear();
+	customerIds.clear();
+	descOffsets.clear();
+	descLengths.clear();
+	descBlob.clear();
+	vinDict.clear();
+	mechanicDict.clear();
+	customerDict.clear();
+	deletedRows = 0;
+	deadDescBytes = 0;
+	minYear = 0;
+	maxYear = -1;
+	built = false;
+}
+
+size_t ServiceColumns::memoryBytes() const {
+	return rowids.capacity() * sizeof(int64_t) + dates.capacity() * sizeof(int32_t) +
+		(vinIds.capacity() + mechanicIds.capacity() + customerIds.capacity() + descLengths.capacity()) * sizeof(uint32_t) +
+		descOffsets.capacity() * sizeof(uint64_t) + descBlob.capacity();
+}
+
+void ServiceColumns::upsert(int64_t rowid, std::string_view vin, std::string_view customer, std::string_view date,
+	std::string_view description, std::string_view mechanic) {
+	size_t row = rowids.size();
+	bool exists = false;
+	if (!rowids.empty() && rowid <= rowids.back()) {
+		row = static_cast<size_t>(std::lower_bound(rowids.begin(), rowids.end(), rowid) - rowids.begin());
+		exists = rowids[row] == rowid;
+	}
+	if (!exists) {
+		// Appends in the common case; a reused lower rowid shifts the tail
+		rowids.insert(rowids.begin() + row, rowid);
+		dates.insert(dates.begin() + row, kDeleted);
+		vinIds.insert(vinIds.begin() + row, 0);
+		mechanicIds.insert(mechanicIds.begin() + row, 0);
+		customerIds.insert(customerIds.begin() + row, 0);
+		descOffsets.insert(descOffsets.begin() + row, 0);
+		descLengths.insert(descLengths.begin() + row, 0);
+		++deletedRows;
+	}
+	assign(row, vin, customer, date, description, mechanic);
+}
+
+void ServiceColumns::append(int64_t rowid, std::string_view vin, std::string_view customer, std::string_view date,
+	std::string_view description, std::string_view mechanic) {
+	rowids.push_back(rowid);
+	dates.push_back(kDeleted);
+	vinIds.push_back(0);
+	mechanicIds.push_back(0);
+	customerIds.push_back(0);
+	descOffsets.push_back(0);
+	descLengths.push_back(0);
+	++deletedRows;
+	assign(rowids.size() - 1, vin, customer, date, description, mechanic);
+}
+
+void ServiceColumns::assign(size_t row, std::string_view vin, std::string_view customer, std::string_view date,
+	std::string_view description, std::string_view mechanic) {
+	if (dates[row] == kDeleted) --deletedRows;
+	else deadDescBytes += descLengths[row];
+
+	int32_t d = parseDate(date).value_or(kNoDate);
+	if (d != kNoDate) {
+		if (maxYear < minYear) minYear = maxYear = d / 10000;
+		minYear = std::min(minYear, d / 10000);
+		maxYear = std::max(maxYear, d / 10000);
+	}
+	dates[row] = d;
+	vinIds[row] = vinDict.intern(vin);
+	mechanicIds[row] = mechanicDict.intern(mechanic);
+	customerIds[row] = customerDict.intern(customer);
+	descOffsets[row] = descBlob.size();
+	descLengths[row] = static_cast<uint32_t>(description.size());
+	descBlob.append(description);
+}
+
+void ServiceColumns::erase(int64_t rowid) {
+	auto it = std::lower_bound(rowids.begin(), rowids.end(), rowid);
+	if (it == rowids.end() || *it != rowid) return;
+	size_t row = static_cast<size_t>(it - rowids.begin());
+	if (dates[row] == kDeleted) return;
+	dates[row] = kDeleted;
+	deadDescBytes += descLengths[row];
+	++deletedRows;
+}
+
+// Drops tombstones and unreferenced description text. Dictionaries keep stale
+// entries; they only cost an empty group slot.
+void ServiceColumns::compact() {
+	std::string blob;
+	blob.reserve(descBlob.size() - deadDescBytes);
+	size_t out = 0;
+	for (size_t i = 0; i < rowids.size(); ++i) {
+		if (dates[i] == kDeleted) continue;
+		rowids[out] = rowids[i];
+		dates[out] = dates[i];
+		vinIds[out] = vinIds[i];
+		mechanicIds[out] = mechanicIds[i];
+		customerIds[out] = customerIds[i];
+		descLengths[out] = descLengths[i];
+		descOffsets[out] = blob.size();
+		blob.append(descBlob, descOffsets[i], descLengths[i]);
+		++out;
+	}
+	rowids.resize(out);
+	dates.resize(out);
+	vinIds.resize(out);
+	mechanicIds.resize(out);
+	customerIds.resize(out);
+	descOffsets.resize(out);
+	descLengths.resize(out);
+	descBlob.swap(blob);
+	deletedRows = 0;
+	deadDescBytes = 0;
+}
+
+// Restores ascending rowids after append(). The sort is stable, so of two rows with one id
+// (a record both in main and, after an interrupted archive run, in a partition) the one
+// loaded first wins and the other's text becomes dead bytes.
+void ServiceColumns::sortByRowid() {
+	if (std::is_sorted(rowids.begin(), rowids.end())) return;
+	std::vector<size_t> order(rowids.size());
+	for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return rowids[a] < rowids[b]; });
+	size_t kept = 0;
+	for (size_t i = 0; i < order.size(); ++i) {
+		if (kept > 0 && rowids[order[kept - 1]] == rowids[order[i]]) {
+			if (dates[order[i]] == kDeleted) --deletedRows;
+			else deadDescBytes += descLengths[order[i]];
+			continue;
+		}
+		order[kept++] = order[i];
+	}
+	order.resize(kept);
+	auto permute = [&order](auto& column) {
+		std::remove_reference_t<decltype(column)> sorted;
+		sorted.reserve(order.size());
+		for (size_t i : order) sorted.push_back(column[i]);
+		column.swap(sorted);
+	};
+	permute(rowids);
+	permute(dates);
+	permute(vinIds);
+	permute(mechanicIds);
+	permute(customerIds);
+	permute(descOffsets);
+	permute(descLengths);
+}
+
+std::optional<std::string_view> ServiceColumns::description(int64_t rowid) const {
+	auto it = std::lower_bound(rowids.begin(), rowids.end(), rowid);
+	if (it == rowids.end() || *it != rowid) return std::nullopt;
+	size_t row = static_cast<size_t>(it - rowids.begin());
+	if (dates[row] == kDeleted) return std::nullopt;
+	return std::string_view(descBlob).substr(descOffsets[row], descLengths[row]);
+}
+
+int64_t ServiceColumns::count(const ColumnFilter& filter) const {
+	int32_t lo = std::max<int32_t>(filter.fromDate, 0), hi = std::min(filter.toDate, kMaxDate);
+	if (lo > hi) return 0;
+	if (filter.mechanic) return countKernel<true>(dates.data(), mechanicIds.data(), dates.size(), lo, hi, *filter.mechanic);
+	return countKernel<false>(dates.data(), mechanicIds.data(), dates.size(), lo, hi, 0);
+}
+
+std::vector<GroupCount> ServiceColumns::countBy(ServiceGroup group, const ColumnFilter& filter) const {
+	std::vector<GroupCount> out;
+	int32_t lo = std::max<int32_t>(filter.fromDate, 0), hi = std::min(filter.toDate, kMaxDate);
+	if (group == ServiceGroup::Month) lo = std::max<int32_t>(lo, 1); // undated rows have no month
+	if (lo > hi) return out;
+
+	const size_t n = dates.size();
+	const int32_t* d = dates.data();
+	std::vector<int64_t> counts;
+	switch (group) {
+	case ServiceGroup::Month: {
+		if (maxYear < minYear) return out;
+		counts.assign(static_cast<size_t>(maxYear - minYear + 1) * 12, 0);
+		const int32_t base = minYear;
+		groupBy(d, mechanicIds.data(), n, lo, hi, filter.mechanic, counts.data(),
+			[d, base](size_t i) { return static_cast<size_t>((d[i] / 10000 - base) * 12 + d[i] / 100 % 100 - 1); });
+		char key[16];
+		for (size_t m = 0; m < counts.size(); ++m) {
+			if (!counts[m]) continue;
+			std::snprintf(key, sizeof(key), "%04d-%02d", base + static_cast<int>(m / 12), static_cast<int>(m % 12) + 1);
+			out.push_back(GroupCount{key, counts[m]});
+		}
+		return out;
+	}
+	case ServiceGroup::Mechanic:
+	case ServiceGroup::Customer:
+	case ServiceGroup::Vin: {
+		const StringDictionary& dict = group == ServiceGroup::Mechanic ? mechanicDict : group == ServiceGroup::Customer ? customerDict : vinDict;
+		const uint32_t* ids = group == ServiceGroup::Mechanic ? mechanicIds.data() : group == ServiceGroup::Customer ? customerIds.data() : vinIds.data();
+		counts.assign(dict.size(), 0);
+		groupBy(d, mechanicIds.data(), n, lo, hi, filter.mechanic, counts.data(), [ids](size_t i) { return ids[i]; });
+		for (uint32_t id = 0; id < counts.size(); ++id) {
+			if (counts[id]) out.push_back(GroupCount{dict.value(id), counts[id]});
+		}
+		std::sort(out.begin(), out.end(), [](const GroupCount& a, const GroupCount& b) {
+			return a.count != b.count ? a.count > b.count : a.key < b.key;
+		});
+		return out;
+	}
+	}
+	return out;
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+std::string_view columnView(sqlite3_stmt* stmt, int col) {
+	const unsigned char* t = sqlite3_column_text(stmt, col);
+	return t ? std::string_view(reinterpret_cast<const char*>(t), static_cast<size_t>(sqlite3_column_bytes(stmt, col))) : std::string_view();
+}
+
+} // namespace
+
+bool ServiceColumns::load(sqlite3* db, std::string& error) {
+	clear();
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT MAX(rowid) - MIN(rowid) + 1 FROM service_records;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	if (sqlite3_step(stmt) == SQLITE_ROW) {
+		size_t rows = static_cast<size_t>(std::max<sqlite3_int64>(0, sqlite3_column_int64(stmt, 0)));
+		rowids.reserve(rows); dates.reserve(rows); vinIds.reserve(rows); mechanicIds.reserve(rows);
+		customerIds.reserve(rows); descOffsets.reserve(rows); descLengths.reserve(rows);
+	}
+	sqlite3_finalize(stmt);
+
+	const char* sql = "SELECT rowid, vin, customer_name, service_date, vsrm_text(description), mechanic FROM service_records ORDER BY rowid;";
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		upsert(sqlite3_column_int64(stmt, 0), columnView(stmt, 1), columnView(stmt, 2), columnView(stmt, 3),
+			columnView(stmt, 4), columnView(stmt, 5));
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE) {
+		error = sqlite3_errmsg(db);
+		clear();
+		return false;
+	}
+
+	// Archived years are read once here and never change afterwards (the archive run drops
+	// the columns), so apply() only ever sees main's rows
+	bool archived = scanArchivedRecords(db, "", [this](sqlite3_stmt* row) {
+		append(sqlite3_column_int64(row, 0), columnView(row, 1), columnView(row, 2), columnView(row, 3),
+			columnView(row, 4), columnView(row, 5));
+		return true;
+	}, error);
+	if (!archived) {
+		clear();
+		return false;
+	}
+	sortByRowid();
+	return true;
+}
+
+bool ServiceColumns::apply(sqlite3* db, const std::vector<RowChange>& changes, std::string& error) {
+	if (changes.empty()) return true;
+	sqlite3_stmt* stmt = nullptr;
+	const char* sql = "SELECT vin, customer_name, service_date, vsrm_text(description), mechanic FROM service_records WHERE rowid = ?1;";
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	for (const auto& c : changes) {
+		if (c.op == RowOp::Delete) { erase(c.rowid); continue; }
+		// Reads the row as it is now, so repeated or superseded changes settle on the final state
+		sqlite3_bind_int64(stmt, 1, c.rowid);
+		int rc = sqlite3_step(stmt);
+		if (rc == SQLITE_ROW) upsert(c.rowid, columnView(stmt, 0), columnView(stmt, 1), columnView(stmt, 2), columnView(stmt, 3), columnView(stmt, 4));
+		else if (rc == SQLITE_DONE) erase(c.rowid);
+		sqlite3_reset(stmt);
+		if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+			error = sqlite3_errmsg(db);
+			sqlite3_finalize(stmt);
+			return false;
+		}
+	}
+	sqlite3_finalize(stmt);
+	if (deletedRows > rowids.size() / 4 || deadDescBytes > descBlob.size() / 2) compact();
+	return true;
+}
+
+#else
+
+bool ServiceColumns::load(sqlite3*, std::string& error) {
+	error = "SQLite not available.";
+	return false;
+}
+
+bool ServiceColumns::apply(sqlite3*, const std::vector<RowChange>&, std::string& error) {
+	error = "SQLite not available.";
+	return false;
+}
+
+#endif
+
+} // namespace vsrm
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ChangeFeed.h"
+
+struct sqlite3;
+
+namespace vsrm {
+
+// Interns strings as dense ids (0, 1, 2, ...) in first-seen order. Open addressing over
+// (hash, id) slots: a lookup usually touches one slot and, on a hash match, the string.
+class StringDictionary {
+public:
+	uint32_t intern(std::string_view s);
+	std::optional<uint32_t> find(std::string_view s) const;
+	const std::string& value(uint32_t id) const { return values[id]; }
+	size_t size() const { return values.size(); }
+	void clear();
+
+private:
+	std::vector<std::string> values;
+	std::vector<uint64_t> slots; // high 32 bits: hash, low 32 bits: id + 1 (0 = empty)
+
+	size_t probe(std::string_view s, uint32_t hash) const; // slot holding s, or the empty slot where it goes
+	void grow();
+};
+
+// Dates are stored as yyyymmdd integers: ordered like the ISO text and the month is date / 100.
+struct ColumnFilter {
+	int32_t fromDate{0};          // inclusive; 0 also admits records with an unparseable date
+	int32_t toDate{99991231};     // inclusive
+	std::optional<uint32_t> mechanic; // StringDictionary id from ServiceColumns::mechanics()
+};
+
+enum class ServiceGroup { Month, Mechanic, Customer, Vin };
+
+struct GroupCount {
+	std::string key; // YYYY-MM, mechanic, customer or VIN
+	int64_t count{};
+};
+
+// Column-wise copy of service_records, archived years included: one array per column, names dictionary-encoded,
+// descriptions in one blob. Count and group-by filters run as SIMD kernels over the
+// date/id arrays without touching SQLite. Owned by Database, which loads it on first
+// use and keeps it current from its change feed (see Database::serviceColumns).
+class ServiceColumns {
+public:
+	static constexpr int32_t kNoDate = 0;    // service_date did not parse
+	static constexpr int32_t kDeleted = -1;  // tombstone; never matches a filter
+
+	// "YYYY-MM-DD[...]" -> yyyymmdd
+	static std::optional<int32_t> parseDate(std::string_view iso);
+
+	bool load(sqlite3* db, std::string& error);
+	// Re-reads inserted/updated rows and drops deleted ones
+	bool apply(sqlite3* db, const std::vector<RowChange>& changes, std::string& error);
+	void clear();
+
+	size_t size() const { return rowids.size() - deletedRows; }
+	size_t memoryBytes() const;
+
+	int64_t count(const ColumnFilter& filter) const;
+	// Non-empty groups: months ascending, everything else by count descending
+	std::vector<GroupCount> countBy(ServiceGroup group, const ColumnFilter& filter) const;
+
+	std::optional<std::string_view> description(int64_t rowid) const;
+
+	const StringDictionary& mechanics() const { return mechanicDict; }
+	const StringDictionary& customers() const { return customerDict; }
+	const StringDictionary& vins() const { return vinDict; }
+
+	// Freshness, maintained by Database (same scheme as BookingIndex)
+	bool built{false};
+	int64_t dataVersion{-1};
+	uint64_t changeSequence{0};
+
+private:
+	std::vector<int64_t> rowids; // ascending
+	std::vector<int32_t> dates;
+	std::vector<uint32_t> vinIds;
+	std::vector<uint32_t> mechanicIds;
+	std::vector<uint32_t> customerIds;
+	std::vector<uint64_t> descOffsets; // into descBlob; an update appends and repoints
+	std::vector<uint32_t> descLengths;
+	std::string descBlob;
+	StringDictionary vinDict;
+	StringDictionary mechanicDict;
+	StringDictionary customerDict;
+	size_t deletedRows{0};
+	uint64_t deadDescBytes{0}; // blob text no row points to any more
+	int32_t minYear{0};
+	int32_t maxYear{-1};
+
+	void upsert(int64_t rowid, std::string_view vin, std::string_view customer, std::string_view date,
+		std::string_view description, std::string_view mechanic);
+	// Unordered; load() calls sortByRowid() once afterwards
+	void append(int64_t rowid, std::string_view vin, std::string_view customer, std::string_view date,
+		std::string_view description, std::string_view mechanic);
+	void assign(size_t row, std::string_view vin, std::string_view customer, std::string_view date,
+		std::string_view description, std::string_view mechanic);
+	void sortByRowid();
+	void erase(int64_t rowid);
+	void compact();
+};
+
+} // namespace vsrm
@@ -0,0 +1,248 @@
+#include "ServiceDue.h"
+
+#include "Archive.h"
+#include "Dates.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <string_view>
+#include <thread>
+
+namespace vsrm {
+
+const char* dueBasisName(DueBasis basis) {
+	switch (basis) {
+	case DueBasis::Cadence: return "cadence";
+	case DueBasis::Rule: return "rule";
+	default: return "default";
+	}
+}
+
+ServiceDueRules workshopDueRules() {
+	ServiceDueRules rules;
+	rules.rules.push_back({"JHH", 90});
+	return rules;
+}
+
+static std::string dayString(int64_t day) { return minutesToIso(day * 1440).substr(0, 10); }
+
+ServiceDuePrediction predictServiceDue(const std::string& vin, const std::vector<int64_t>& serviceDays, const ServiceDueRules& rules) {
+	const ServiceIntervalRule* rule = nullptr;
+	for (const auto& r : rules.rules) {
+		if (vin.compare(0, r.vinPrefix.size(), r.vinPrefix) == 0 && (!rule || r.vinPrefix.size() > rule->vinPrefix.size())) rule = &r;
+	}
+
+	ServiceDuePrediction p;
+	p.vin = vin;
+	p.visits = static_cast<int>(serviceDays.size());
+	int64_t last = serviceDays.empty() ? 0 : serviceDays.back();
+	p.lastService = dayString(last);
+
+	int64_t interval = rule ? rule->intervalDays : rules.defaultIntervalDays;
+	p.basis = rule ? DueBasis::Rule : DueBasis::Default;
+	if (p.visits >= std::max(rules.minVisitsForCadence, 2)) {
+		// Median gap: one unusually late visit should not push every later prediction out
+		std::vector<int64_t> gaps;
+		gaps.reserve(serviceDays.size() - 1);
+		for (size_t i = 1; i < serviceDays.size(); ++i) {
+			if (serviceDays[i] > serviceDays[i - 1]) gaps.push_back(serviceDays[i] - serviceDays[i - 1]);
+		}
+		if (!gaps.empty()) {
+			std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+			int64_t cadence = std::clamp<int64_t>(gaps[gaps.size() / 2], rules.minIntervalDays, rules.maxIntervalDays);
+			if (rule) cadence = std::min<int64_t>(cadence, rule->intervalDays);
+			interval = cadence;
+			p.basis = DueBasis::Cadence;
+		}
+	}
+	p.dueDate = dayString(last + interval);
+	return p;
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+// Boundaries splitting the VIN key space into `parts` ranges of similar row counts,
+// from VINs at random rowids (cheap primary-key probes instead of a counting scan).
+std::vector<std::string> vinBoundaries(sqlite3* db, int parts) {
+	std::vector<std::string> bounds;
+	if (parts <= 1) return bounds;
+	sqlite3_int64 lo = 0, hi = 0;
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT MIN(rowid), MAX(rowid) FROM service_records;", -1, &stmt, nullptr) != SQLITE_OK) return bounds;
+	if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+		lo = sqlite3_column_int64(stmt, 0);
+		hi = sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+	if (hi <= lo) return bounds;
+
+	std::vector<std::string> sample;
+	std::mt19937_64 rng(static_cast<uint64_t>(hi) * 31 + static_cast<uint64_t>(lo));
+	std::uniform_int_distribution<sqlite3_int64> pick(lo, hi);
+	if (sqlite3_prepare_v2(db, "SELECT vin FROM service_records WHERE rowid >= ?1 ORDER BY rowid LIMIT 1;", -1, &stmt, nullptr) != SQLITE_OK) return bounds;
+	for (int i = 0; i < parts * 64; ++i) {
+		sqlite3_bind_int64(stmt, 1, pick(rng));
+		if (sqlite3_step(stmt) == SQLITE_ROW) sample.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+	std::sort(sample.begin(), sample.end());
+	for (int i = 1; i < parts && !sample.empty(); ++i) {
+		const std::string& b = sample[sample.size() * i / parts];
+		if (bounds.empty() || b > bounds.back()) bounds.push_back(b);
+	}
+	return bounds;
+}
+
+// One file's rows of [lower, upper) in (vin, service_date DESC) order, which the (vin,
+// service_date DESC) index delivers without sorting
+struct Source {
+	sqlite3* db{nullptr};
+	sqlite3_stmt* stmt{nullptr};
+	bool more{false};
+
+	~Source() {
+		sqlite3_finalize(stmt);
+		sqlite3_close(db);
+	}
+
+	bool open(const std::string& path, const std::string& lower, const std::string* upper, std::string& error) {
+		if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+			error = db ? sqlite3_errmsg(db) : "Cannot open database";
+			return false;
+		}
+		std::string sql = "SELECT vin, service_date FROM service_records WHERE vin >= ?1";
+		if (upper) sql += " AND vin < ?2";
+		sql += " ORDER BY vin, service_date DESC;";
+		if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) { error = sqlite3_errmsg(db); return false; }
+		sqlite3_bind_text(stmt, 1, lower.c_str(), -1, SQLITE_TRANSIENT);
+		if (upper) sqlite3_bind_text(stmt, 2, upper->c_str(), -1, SQLITE_TRANSIENT);
+		return step(error);
+	}
+
+	bool step(std::string& error) {
+		int rc = sqlite3_step(stmt);
+		more = rc == SQLITE_ROW;
+		if (rc != SQLITE_ROW && rc != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+		return true;
+	}
+
+	std::string_view vin() const {
+		return std::string_view(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), static_cast<size_t>(sqlite3_column_bytes(stmt, 0)));
+	}
+};
+
+// Streams [lower, upper) of main and every archive partition (each on its own read-only
+// connection, so there is no ATTACH limit), emitting one prediction per VIN as soon as no file
+// has rows of it left.
+bool scanRange(const std::string& dbPath, const std::vector<std::string>& archives, const std::string& lower,
+	const std::string* upper, const ServiceDueRules& rules, std::vector<ServiceDuePrediction>& out, size_t& records,
+	std::string& error) {
+	std::vector<Source> sources(archives.size() + 1);
+	for (size_t i = 0; i < sources.size(); ++i) {
+		if (!sources[i].open(i == 0 ? dbPath : archives[i - 1], lower, upper, error)) return false;
+	}
+
+	std::string vin;
+	std::vector<int64_t> days;
+	for (;;) {
+		// Next VIN: the smallest any file is at
+		const Source* first = nullptr;
+		for (const auto& s : sources) {
+			if (s.more && (!first || s.vin() < first->vin())) first = &s;
+		}
+		if (!first) break;
+		vin.assign(first->vin());
+		days.clear();
+		for (auto& s : sources) {
+			while (s.more && s.vin() == vin) {
+				++records;
+				const char* date = reinterpret_cast<const char*>(sqlite3_column_text(s.stmt, 1));
+				if (auto m = isoToMinutes(date ? date : "")) days.push_back(*m / 1440);
+				if (!s.step(error)) return false;
+			}
+		}
+		if (days.empty()) continue;
+		std::sort(days.begin(), days.end());
+		out.push_back(predictServiceDue(vin, days, rules));
+	}
+	return true;
+}
+
+} // namespace
+
+bool scanServiceDue(const std::string& dbPath, const ServiceDueRules& rules, int threads,
+	std::vector<ServiceDuePrediction>& out, ServiceDueStats& stats, std::string& error) {
+	auto started = std::chrono::steady_clock::now();
+	if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+	std::vector<std::string> bounds;
+	std::vector<std::string> archives; // partition files, scanned alongside main
+	{
+		sqlite3* db = nullptr;
+		if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+			error = db ? sqlite3_errmsg(db) : "Cannot open database";
+			sqlite3_close(db);
+			return false;
+		}
+		bounds = vinBoundaries(db, threads);
+		std::vector<ArchivePartition> partitions;
+		bool listed = listArchivePartitions(db, partitions, error);
+		for (const auto& p : partitions) {
+			if (p.records > 0) archives.push_back(archivePartitionPath(db, p));
+		}
+		sqlite3_close(db);
+		if (!listed) return false;
+	}
+
+	const size_t parts = bounds.size() + 1;
+	std::vector<std::vector<ServiceDuePrediction>> results(parts);
+	std::vector<size_t> records(parts, 0);
+	std::vector<std::string> errors(parts);
+	std::vector<char> ok(parts, 0);
+	std::vector<std::thread> workers;
+	workers.reserve(parts);
+	for (size_t i = 0; i < parts; ++i) {
+		workers.emplace_back([&, i] {
+			const std::string lower = i == 0 ? std::string() : bounds[i - 1];
+			const std::string* upper = i < bounds.size() ? &bounds[i] : nullptr;
+			ok[i] = scanRange(dbPath, archives, lower, upper, rules, results[i], records[i], errors[i]);
+		});
+	}
+	for (auto& t : workers) t.join();
+
+	out.clear();
+	size_t total = 0;
+	for (const auto& r : results) total += r.size();
+	out.reserve(total);
+	stats = ServiceDueStats{};
+	stats.partitions = static_cast<int>(parts);
+	for (size_t i = 0; i < parts; ++i) {
+		if (!ok[i]) { error = errors[i]; out.clear(); return false; }
+		stats.records += records[i];
+		std::move(results[i].begin(), results[i].end(), std::back_inserter(out));
+	}
+	stats.vehicles = out.size();
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	stats.scanMilliseconds = took.count();
+	return true;
+}
+
+#else
+
+bool scanServiceDue(const std::string&, const ServiceDueRules&, int, std::vector<ServiceDuePrediction>&, ServiceDueStats&, std::string& error) {
+	error = "SQLite not available.";
+	return false;
+}
+
+#endif
+
+} // namespace vsrm
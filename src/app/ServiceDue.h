@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vsrm {
+
+// Overrides the interval for VINs starting with vinPrefix (e.g. a WMI such as "JHH" for Hino trucks).
+struct ServiceIntervalRule {
+	std::string vinPrefix;
+	int intervalDays{};
+};
+
+struct ServiceDueRules {
+	int defaultIntervalDays{180};
+	int minIntervalDays{30};   // cadence is clamped to [min, max]
+	int maxIntervalDays{365};
+	int minVisitsForCadence{3}; // fewer visits: use the matching rule or the default
+	std::vector<ServiceIntervalRule> rules; // longest matching prefix wins and also caps the cadence
+};
+
+enum class DueBasis { Cadence, Rule, Default };
+
+struct ServiceDuePrediction {
+	std::string vin;
+	std::string lastService; // YYYY-MM-DD
+	std::string dueDate;     // YYYY-MM-DD
+	int visits{};
+	DueBasis basis{};
+};
+
+struct ServiceDueStats {
+	size_t vehicles{};
+	size_t records{};
+	int partitions{};
+	double scanMilliseconds{};
+	double writeMilliseconds{};
+};
+
+const char* dueBasisName(DueBasis basis);
+
+// The workshop's interval rules, shared by the GUI and vsrm-cli: Hino trucks (WMI JHH) are serviced quarterly
+ServiceDueRules workshopDueRules();
+
+// Next due date for one vehicle from its service days (days since 1970-01-01, ascending):
+// last visit + median gap between visits, or the rule/default interval when there is too little history.
+ServiceDuePrediction predictServiceDue(const std::string& vin, const std::vector<int64_t>& serviceDays, const ServiceDueRules& rules);
+
+// One streaming pass over service_records (vin, service_date) split into VIN ranges of roughly
+// equal size, each scanned on its own thread with read-only connections to main and every
+// archive partition, merged by VIN. Results are in VIN order.
+bool scanServiceDue(const std::string& dbPath, const ServiceDueRules& rules, int threads,
+	std::vector<ServiceDuePrediction>& out, ServiceDueStats& stats, std::string& error);
+
+} // namespace vsrm
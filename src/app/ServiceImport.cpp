@@ -0,0 +1,404 @@
+#include "ServiceImport.h"
+
+#include "Archive.h"
+#include "Dates.h"
+#include "FastHash.h"
+#include "MappedFile.h"
+#include "Sketches.h"
+#include "VinDecoder.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace vsrm {
+
+uint64_t serviceFingerprint(std::string_view vin, std::string_view serviceDate, std::string_view description,
+	std::string_view mechanic) {
+	// Chained seeds keep field boundaries significant ("ab"+"c" differs from "a"+"bc")
+	uint64_t h = fastHash64(vin, 0x5EC0F1A7u);
+	h = fastHash64(serviceDate, h);
+	h = fastHash64(description, h);
+	return fastHash64(mechanic, h);
+}
+
+BloomFilter::BloomFilter(size_t expected, double falsePositiveRate) {
+	const double n = static_cast<double>(std::max<size_t>(expected, 1));
+	const double ln2 = std::log(2.0);
+	double m = std::ceil(-n * std::log(falsePositiveRate) / (ln2 * ln2));
+	bits.assign(std::max<size_t>(1, static_cast<size_t>((m + 63) / 64)), 0);
+	bitCount = bits.size() * 64;
+	hashes = std::clamp(static_cast<int>(std::lround(double(bitCount) / n * ln2)), 1, 16);
+}
+
+// Double hashing: probe i is h1 + i * h2, with both halves taken from the one 64-bit key
+void BloomFilter::add(uint64_t hash) {
+	uint64_t h2 = (hash >> 32 | hash << 32) | 1;
+	for (int i = 0; i < hashes; ++i, hash += h2) {
+		uint64_t bit = hash % bitCount;
+		bits[bit >> 6] |= uint64_t(1) << (bit & 63);
+	}
+}
+
+bool BloomFilter::mayContain(uint64_t hash) const {
+	uint64_t h2 = (hash >> 32 | hash << 32) | 1;
+	for (int i = 0; i < hashes; ++i, hash += h2) {
+		uint64_t bit = hash % bitCount;
+		if (!(bits[bit >> 6] & (uint64_t(1) << (bit & 63)))) return false;
+	}
+	return true;
+}
+
+std::string BloomFilter::serialize() const {
+	std::string out;
+	out.reserve(2 + memoryBytes());
+	out.push_back('B');
+	out.push_back(static_cast<char>(hashes));
+	out.append(reinterpret_cast<const char*>(bits.data()), memoryBytes());
+	return out;
+}
+
+bool BloomFilter::deserialize(std::string_view data) {
+	if (data.size() < 2 + sizeof(uint64_t) || data[0] != 'B' || (data.size() - 2) % sizeof(uint64_t) != 0) return false;
+	if (data[1] < 1 || data[1] > 16) return false;
+	hashes = data[1];
+	bits.assign((data.size() - 2) / sizeof(uint64_t), 0);
+	std::memcpy(bits.data(), data.data() + 2, data.size() - 2);
+	bitCount = bits.size() * 64;
+	return true;
+}
+
+bool parseCsv(std::string_view text, std::vector<std::vector<std::string>>& rows, std::vector<size_t>& lines) {
+	rows.clear();
+	lines.clear();
+	if (text.size() >= 3 && text.substr(0, 3) == "\xEF\xBB\xBF") text.remove_prefix(3); // UTF-8 BOM
+	std::vector<std::string> row;
+	std::string field;
+	size_t line = 1, rowLine = 1;
+	bool quoted = false, fieldStarted = false;
+	auto endRow = [&] {
+		row.push_back(std::move(field));
+		field.clear();
+		// Blank lines are not rows
+		if (row.size() > 1 || !row[0].empty() || fieldStarted) { rows.push_back(std::move(row)); lines.push_back(rowLine); }
+		row.clear();
+		fieldStarted = false;
+	};
+	for (size_t i = 0; i < text.size(); ++i) {
+		char c = text[i];
+		if (quoted) {
+			if (c == '"') {
+				if (i + 1 < text.size() && text[i + 1] == '"') { field.push_back('"'); ++i; }
+				else quoted = false;
+			} else {
+				if (c == '\n') ++line;
+				field.push_back(c);
+			}
+			continue;
+		}
+		switch (c) {
+		case '"': quoted = true; fieldStarted = true; break;
+		case ',': row.push_back(std::move(field)); field.clear(); fieldStarted = true; break;
+		case '\r': break;
+		case '\n': endRow(); rowLine = ++line; break;
+		default: field.push_back(c); break;
+		}
+	}
+	if (quoted) return false;
+	if (!field.empty() || !row.empty() || fieldStarted) endRow();
+	return true;
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+std::string_view trim(std::string_view s) {
+	while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+	while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+	return s;
+}
+
+std::string_view columnView(sqlite3_stmt* stmt, int col) {
+	const char* p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+	return p ? std::string_view(p, static_cast<size_t>(sqlite3_column_bytes(stmt, col))) : std::string_view();
+}
+
+std::string_view argView(sqlite3_value* v) {
+	const char* p = reinterpret_cast<const char*>(sqlite3_value_text(v));
+	return p ? std::string_view(p, static_cast<size_t>(sqlite3_value_bytes(v))) : std::string_view();
+}
+
+void fingerprintFunction(sqlite3_context* ctx, int, sqlite3_value** argv) {
+	uint64_t fp = serviceFingerprint(argView(argv[0]), argView(argv[1]), argView(argv[2]), argView(argv[3]));
+	sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(fp));
+}
+
+void bindView(sqlite3_stmt* stmt, int index, std::string_view s) {
+	sqlite3_bind_text(stmt, index, s.data(), static_cast<int>(s.size()), SQLITE_TRANSIENT);
+}
+
+struct Statements {
+	sqlite3_stmt* probe{};
+	sqlite3_stmt* insert{};
+	sqlite3_stmt* merge{};
+	~Statements() { sqlite3_finalize(probe); sqlite3_finalize(insert); sqlite3_finalize(merge); }
+};
+
+// The archive partitions, each on its own read-only connection: the import's write transaction
+// on main rules out ATTACH. Stored descriptions may be packed with main's dictionaries, so
+// candidates are decoded through main's vsrm_text before comparing.
+struct ArchiveProbes {
+	struct File {
+		sqlite3* db{};
+		sqlite3_stmt* probe{};
+	};
+	std::vector<File> files;
+	sqlite3_stmt* decode{};
+	int64_t records{};
+
+	~ArchiveProbes() {
+		for (auto& f : files) { sqlite3_finalize(f.probe); sqlite3_close(f.db); }
+		sqlite3_finalize(decode);
+	}
+
+	bool open(sqlite3* main, std::string& error) {
+		std::vector<ArchivePartition> partitions;
+		if (!listArchivePartitions(main, partitions, error)) return false;
+		for (const auto& p : partitions) {
+			if (p.records == 0) continue;
+			const std::string path = archivePartitionPath(main, p);
+			File& f = files.emplace_back();
+			if (sqlite3_open_v2(path.c_str(), &f.db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+				error = "Cannot open archive " + path + ": " + (f.db ? sqlite3_errmsg(f.db) : "out of memory");
+				return false;
+			}
+			if (sqlite3_prepare_v2(f.db, "SELECT description FROM service_records WHERE fingerprint = ?1 AND vin = ?2 "
+					"AND service_date = ?3 AND mechanic = ?4;", -1, &f.probe, nullptr) != SQLITE_OK) {
+				error = sqlite3_errmsg(f.db);
+				return false;
+			}
+			records += p.records;
+		}
+		if (!files.empty() && sqlite3_prepare_v2(main, "SELECT vsrm_text(?1);", -1, &decode, nullptr) != SQLITE_OK) {
+			error = sqlite3_errmsg(main);
+			return false;
+		}
+		return true;
+	}
+
+	// Every stored fingerprint (a covering scan of each partition's index)
+	bool seed(BloomFilter& filter, std::string& error) {
+		for (auto& f : files) {
+			sqlite3_stmt* stmt = nullptr;
+			if (sqlite3_prepare_v2(f.db, "SELECT fingerprint FROM service_records WHERE fingerprint IS NOT NULL;", -1, &stmt, nullptr) != SQLITE_OK) {
+				error = sqlite3_errmsg(f.db);
+				return false;
+			}
+			while (sqlite3_step(stmt) == SQLITE_ROW) filter.add(static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)));
+			sqlite3_finalize(stmt);
+		}
+		return true;
+	}
+
+	bool contains(uint64_t fp, std::string_view vin, std::string_view date, std::string_view description,
+		std::string_view mechanic, bool& found, std::string& error) {
+		found = false;
+		for (auto& f : files) {
+			sqlite3_reset(f.probe);
+			sqlite3_bind_int64(f.probe, 1, static_cast<sqlite3_int64>(fp));
+			bindView(f.probe, 2, vin);
+			bindView(f.probe, 3, date);
+			bindView(f.probe, 4, mechanic);
+			int rc;
+			while (!found && (rc = sqlite3_step(f.probe)) == SQLITE_ROW) {
+				if (sqlite3_column_type(f.probe, 0) != SQLITE_BLOB) { found = columnView(f.probe, 0) == description; continue; }
+				sqlite3_reset(decode);
+				sqlite3_bind_value(decode, 1, sqlite3_column_value(f.probe, 0));
+				if (sqlite3_step(decode) != SQLITE_ROW) { error = sqlite3_errmsg(sqlite3_db_handle(decode)); return false; }
+				found = columnView(decode, 0) == description;
+			}
+			sqlite3_reset(f.probe);
+			if (found) return true;
+			if (rc != SQLITE_DONE) { error = sqlite3_errmsg(f.db); return false; }
+		}
+		return true;
+	}
+};
+
+} // namespace
+
+bool fillMissingFingerprints(sqlite3* db, std::string& error) {
+	if (sqlite3_create_function(db, "vsrm_fingerprint", 4, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+			fingerprintFunction, nullptr, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	char* errMsg = nullptr;
+	if (sqlite3_exec(db, "UPDATE service_records SET fingerprint = vsrm_fingerprint(vin, service_date, vsrm_text(description), mechanic) "
+			"WHERE fingerprint IS NULL;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		error = errMsg ? errMsg : "Fingerprint backfill failed";
+		sqlite3_free(errMsg);
+		return false;
+	}
+	return true;
+}
+
+bool importServiceRecordsCsv(sqlite3* db, const std::string& path, ImportConflict policy, ImportStats& stats,
+	std::string& error, const std::function<bool(std::string&)>& beforeCommit) {
+	auto started = std::chrono::steady_clock::now();
+	stats = ImportStats{};
+	MappedFile file;
+	if (!file.open(path)) { error = "Failed to open " + path; return false; }
+	std::vector<std::vector<std::string>> rows;
+	std::vector<size_t> lines;
+	if (!parseCsv(std::string_view(reinterpret_cast<const char*>(file.data()), file.size()), rows, lines)) {
+		error = "Unterminated quoted field in " + path;
+		return false;
+	}
+	file.close();
+	if (rows.empty()) { error = "No header row in " + path; return false; }
+
+	// Column positions by header name
+	enum { kVin, kCustomer, kDate, kDescription, kMechanic, kFields };
+	const char* names[kFields] = {"vin", "customer_name", "service_date", "description", "mechanic"};
+	int column[kFields] = {-1, -1, -1, -1, -1};
+	for (size_t c = 0; c < rows[0].size(); ++c) {
+		std::string name(trim(rows[0][c]));
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+		for (int f = 0; f < kFields; ++f) if (name == names[f]) column[f] = static_cast<int>(c);
+	}
+	for (int f : {kVin, kDate, kDescription, kMechanic}) {
+		if (column[f] < 0) { error = std::string("Missing column '") + names[f] + "' in " + path; return false; }
+	}
+
+	char* errMsg = nullptr;
+	if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		error = errMsg ? errMsg : "BEGIN failed"; sqlite3_free(errMsg); return false;
+	}
+	auto fail = [&](const std::string& message) {
+		error = message;
+		sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+		return false;
+	};
+	if (!fillMissingFingerprints(db, error)) return fail(error);
+
+	ArchiveProbes archives;
+	if (!archives.open(db, error)) return fail(error);
+
+	// Seed the filter with every stored fingerprint, archived ones included (a covering scan of the index)
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM service_records;", -1, &stmt, nullptr) != SQLITE_OK) return fail(sqlite3_errmsg(db));
+	size_t existing = sqlite3_step(stmt) == SQLITE_ROW ? static_cast<size_t>(sqlite3_column_int64(stmt, 0)) : 0;
+	sqlite3_finalize(stmt);
+	BloomFilter seen(existing + static_cast<size_t>(archives.records) + rows.size());
+	if (sqlite3_prepare_v2(db, "SELECT fingerprint FROM service_records INDEXED BY idx_service_records_fingerprint;", -1, &stmt, nullptr) != SQLITE_OK)
+		return fail(sqlite3_errmsg(db));
+	while (sqlite3_step(stmt) == SQLITE_ROW) seen.add(static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)));
+	sqlite3_finalize(stmt);
+	if (!archives.seed(seen, error)) return fail(error);
+
+	Statements s;
+	if (sqlite3_prepare_v2(db,
+			"SELECT id, customer_name FROM service_records WHERE fingerprint = ?1 AND vin = ?2 AND service_date = ?3 "
+			"AND vsrm_text(description) = ?4 AND mechanic = ?5 ORDER BY id LIMIT 1;", -1, &s.probe, nullptr) != SQLITE_OK ||
+		sqlite3_prepare_v2(db,
+			"INSERT INTO service_records (vin, customer_name, service_date, description, mechanic, fingerprint) "
+			"VALUES (?1, ?2, ?3, vsrm_pack(?4), ?5, ?6);", -1, &s.insert, nullptr) != SQLITE_OK ||
+		sqlite3_prepare_v2(db, "UPDATE service_records SET customer_name = ?1 WHERE id = ?2;", -1, &s.merge, nullptr) != SQLITE_OK)
+		return fail(sqlite3_errmsg(db));
+
+	SketchWriter sketches;
+	auto reject = [&](size_t line, const std::string& why) {
+		++stats.rejected;
+		if (stats.errors.size() < 20) stats.errors.push_back("Line " + std::to_string(line) + ": " + why);
+	};
+	std::string vinError;
+	for (size_t r = 1; r < rows.size(); ++r) {
+		const auto& row = rows[r];
+		++stats.rows;
+		auto field = [&](int f) { return column[f] >= 0 && static_cast<size_t>(column[f]) < row.size() ? trim(row[column[f]]) : std::string_view(); };
+		std::string_view vin = field(kVin), customer = field(kCustomer), date = field(kDate),
+			description = field(kDescription), mechanic = field(kMechanic);
+		if (vin.empty()) { reject(lines[r], "missing VIN"); continue; }
+		if (!isoToMinutes(date)) { reject(lines[r], "invalid service date '" + std::string(date) + "'"); continue; }
+		if (!validateVinForInsert(vin, vinError)) { reject(lines[r], vinError); continue; }
+
+		uint64_t fp = serviceFingerprint(vin, date, description, mechanic);
+		if (seen.mayContain(fp)) {
+			++stats.probes;
+			sqlite3_reset(s.probe);
+			sqlite3_bind_int64(s.probe, 1, static_cast<sqlite3_int64>(fp));
+			bindView(s.probe, 2, vin);
+			bindView(s.probe, 3, date);
+			bindView(s.probe, 4, description);
+			bindView(s.probe, 5, mechanic);
+			int rc = sqlite3_step(s.probe);
+			if (rc == SQLITE_ROW) {
+				if (policy == ImportConflict::Merge && !customer.empty() && customer != columnView(s.probe, 1)) {
+					sqlite3_reset(s.merge);
+					bindView(s.merge, 1, customer);
+					sqlite3_bind_int64(s.merge, 2, sqlite3_column_int64(s.probe, 0));
+					if (sqlite3_step(s.merge) != SQLITE_DONE) return fail(sqlite3_errmsg(db));
+					++stats.merged;
+				} else {
+					++stats.skipped;
+				}
+				continue;
+			}
+			if (rc != SQLITE_DONE) return fail(sqlite3_errmsg(db));
+			// Archived years are not rewritten, so an archived match is skipped under either policy
+			bool archived = false;
+			if (!archives.contains(fp, vin, date, description, mechanic, archived, error)) return fail(error);
+			if (archived) { ++stats.skipped; continue; }
+			++stats.falsePositives;
+		} else {
+			++stats.probesAvoided;
+		}
+
+		sqlite3_reset(s.insert);
+		bindView(s.insert, 1, vin);
+		bindView(s.insert, 2, customer);
+		bindView(s.insert, 3, date);
+		bindView(s.insert, 4, description);
+		bindView(s.insert, 5, mechanic);
+		sqlite3_bind_int64(s.insert, 6, static_cast<sqlite3_int64>(fp));
+		if (sqlite3_step(s.insert) != SQLITE_DONE) return fail(sqlite3_errmsg(db));
+		seen.add(fp); // later rows of the same file deduplicate against this one
+		if (!sketches.add(db, date, customer, vin, mechanic, description, error)) return fail(error);
+		++stats.inserted;
+	}
+	if (!sketches.flush(db, error)) return fail(error);
+	if (beforeCommit && !beforeCommit(error)) return fail(error);
+	if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+		std::string message = errMsg ? errMsg : "COMMIT failed";
+		sqlite3_free(errMsg);
+		return fail(message);
+	}
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+	stats.milliseconds = took.count();
+	return true;
+}
+
+#else
+
+bool fillMissingFingerprints(sqlite3*, std::string& error) {
+	error = "SQLite not available.";
+	return false;
+}
+
+bool importServiceRecordsCsv(sqlite3*, const std::string&, ImportConflict, ImportStats&, std::string& error,
+	const std::function<bool(std::string&)>&) {
+	error = "SQLite not available.";
+	return false;
+}
+
+#endif
+
+} // namespace vsrm
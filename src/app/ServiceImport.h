@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct sqlite3;
+
+namespace vsrm {
+
+// Identity of a service record for deduplication: FastHash over vin, service_date,
+// description and mechanic (customer_name is left out so spelling fixes still match).
+// Stored in service_records.fingerprint, so the function must never change.
+uint64_t serviceFingerprint(std::string_view vin, std::string_view serviceDate, std::string_view description,
+	std::string_view mechanic);
+
+// Set membership with no false negatives. Sized for `expected` keys at the given
+// false-positive rate; keys are already well-mixed 64-bit hashes.
+class BloomFilter {
+public:
+	explicit BloomFilter(size_t expected, double falsePositiveRate = 0.01);
+
+	void add(uint64_t hash);
+	bool mayContain(uint64_t hash) const;
+	size_t memoryBytes() const { return bits.size() * sizeof(uint64_t); }
+
+	std::string serialize() const;
+	bool deserialize(std::string_view data);
+
+private:
+	std::vector<uint64_t> bits;
+	uint64_t bitCount{};
+	int hashes{};
+};
+
+// What to do when an imported row matches an existing record
+enum class ImportConflict {
+	Skip,  // keep the existing record untouched
+	Merge, // keep it, but take the imported customer name when it is non-empty and differs
+};
+
+struct ImportStats {
+	size_t rows{};          // data rows read
+	size_t inserted{};
+	size_t skipped{};       // duplicates left as they were
+	size_t merged{};        // duplicates whose customer name was updated
+	size_t rejected{};      // malformed rows or invalid VINs; see errors
+	size_t probes{};        // fingerprint lookups in the database
+	size_t probesAvoided{}; // rows the Bloom filter proved new
+	size_t falsePositives{}; // probes that found nothing
+	double milliseconds{};
+	std::vector<std::string> errors; // first few rejections, with line numbers
+};
+
+// Splits RFC 4180 CSV text (quoted fields, doubled quotes, CRLF or LF) into rows.
+// Returns false on an unterminated quote; `lines` gets each row's starting line number.
+bool parseCsv(std::string_view text, std::vector<std::vector<std::string>>& rows, std::vector<size_t>& lines);
+
+// Fills service_records.fingerprint where it is NULL (rows written by older builds or bulk loaders)
+bool fillMissingFingerprints(sqlite3* db, std::string& error);
+
+// Imports a CSV with a header naming vin, service_date, description, mechanic and optionally
+// customer_name (any other column, such as id, is ignored). Runs in one transaction: a
+// database error rolls the whole file back, bad rows are only counted as rejected. Rows
+// matching an archived record are skipped (archive partitions are probed on their own
+// read-only connections).
+// beforeCommit, if given, runs inside that transaction just before COMMIT; false rolls back.
+bool importServiceRecordsCsv(sqlite3* db, const std::string& path, ImportConflict policy, ImportStats& stats,
+	std::string& error, const std::function<bool(std::string&)>& beforeCommit = {});
+
+} // namespace vsrm
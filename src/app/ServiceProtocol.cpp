@@ -0,0 +1,162 @@
+#include "ServiceProtocol.h"
+
+#include "Database.h"
+
+namespace vsrm {
+
+const char* opName(Op op) {
+	switch (op) {
+	case Op::Hello: return "hello";
+	case Op::AddServiceRecord: return "add_service_record";
+	case Op::AddAppointment: return "add_appointment";
+	case Op::ListServiceRecordsByVin: return "list_service_records";
+	case Op::ListVehicleSummaries: return "list_vehicle_summaries";
+	case Op::CountServiceRecords: return "count_service_records";
+	case Op::ListAppointmentsByVin: return "list_appointments";
+	}
+	return "unknown";
+}
+
+void WireWriter::u32(uint32_t v) {
+	char b[4] = {static_cast<char>(v), static_cast<char>(v >> 8), static_cast<char>(v >> 16), static_cast<char>(v >> 24)};
+	out.append(b, 4);
+}
+
+void WireWriter::i64(int64_t v) {
+	uint64_t u = static_cast<uint64_t>(v);
+	u32(static_cast<uint32_t>(u));
+	u32(static_cast<uint32_t>(u >> 32));
+}
+
+void WireWriter::str(std::string_view s) {
+	u32(static_cast<uint32_t>(s.size()));
+	out.append(s);
+}
+
+void WireWriter::optStr(const std::optional<std::string>& s) {
+	u8(s ? 1 : 0);
+	if (s) str(*s);
+}
+
+void WireWriter::begin(uint32_t requestId, uint8_t code) {
+	frameStart = out.size();
+	u32(0);
+	u32(requestId);
+	u8(code);
+}
+
+void WireWriter::end() {
+	uint32_t len = static_cast<uint32_t>(out.size() - frameStart - 4);
+	for (int i = 0; i < 4; ++i) out[frameStart + i] = static_cast<char>(len >> (8 * i));
+}
+
+uint8_t WireReader::u8() {
+	if (in.empty()) { failed = true; return 0; }
+	uint8_t v = static_cast<uint8_t>(in[0]);
+	in.remove_prefix(1);
+	return v;
+}
+
+uint32_t WireReader::u32() {
+	if (in.size() < 4) { failed = true; in = {}; return 0; }
+	const auto* p = reinterpret_cast<const unsigned char*>(in.data());
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	in.remove_prefix(4);
+	return v;
+}
+
+int64_t WireReader::i64() {
+	uint64_t lo = u32();
+	uint64_t hi = u32();
+	return static_cast<int64_t>(lo | (hi << 32));
+}
+
+std::string WireReader::str() {
+	uint32_t n = u32();
+	if (n > in.size()) { failed = true; in = {}; return {}; }
+	std::string s(in.substr(0, n));
+	in.remove_prefix(n);
+	return s;
+}
+
+std::optional<std::string> WireReader::optStr() {
+	if (!u8()) return std::nullopt;
+	return str();
+}
+
+void writeServiceRecord(WireWriter& w, const ServiceRecord& r) {
+	w.i64(r.id);
+	w.str(r.vin);
+	w.str(r.customerName);
+	w.str(r.serviceDate);
+	w.str(r.description);
+	w.str(r.mechanic);
+}
+
+ServiceRecord readServiceRecord(WireReader& r) {
+	ServiceRecord rec;
+	rec.id = static_cast<int>(r.i64());
+	rec.vin = r.str();
+	rec.customerName = r.str();
+	rec.serviceDate = r.str();
+	rec.description = r.str();
+	rec.mechanic = r.str();
+	return rec;
+}
+
+void writeAppointment(WireWriter& w, const Appointment& a) {
+	w.i64(a.id);
+	w.str(a.vin);
+	w.str(a.customerName);
+	w.str(a.scheduledAt);
+	w.str(a.status);
+	w.optStr(a.requiredSkill);
+	w.u32(static_cast<uint32_t>(a.durationMin));
+}
+
+Appointment readAppointment(WireReader& r) {
+	Appointment a;
+	a.id = static_cast<int>(r.i64());
+	a.vin = r.str();
+	a.customerName = r.str();
+	a.scheduledAt = r.str();
+	a.status = r.str();
+	a.requiredSkill = r.optStr();
+	a.durationMin = static_cast<int>(r.u32());
+	return a;
+}
+
+void writeVehicleSummary(WireWriter& w, const VehicleSummary& s) {
+	w.str(s.vin);
+	w.str(s.make);
+	w.str(s.model);
+	w.str(s.lastServiceDate);
+	w.str(s.mechanic);
+	w.optStr(s.nextService);
+	w.str(s.status);
+}
+
+VehicleSummary readVehicleSummary(WireReader& r) {
+	VehicleSummary s;
+	s.vin = r.str();
+	s.make = r.str();
+	s.model = r.str();
+	s.lastServiceDate = r.str();
+	s.mechanic = r.str();
+	s.nextService = r.optStr();
+	s.status = r.str();
+	return s;
+}
+
+std::optional<std::string_view> nextFrame(std::string_view buffer, size_t& consumed, bool& tooLarge) {
+	tooLarge = false;
+	if (buffer.size() < 4) return std::nullopt;
+	WireReader header(buffer.substr(0, 4));
+	uint32_t len = header.u32();
+	if (len > kMaxFrameBytes) { tooLarge = true; return std::nullopt; }
+	if (buffer.size() - 4 < len) return std::nullopt;
+	consumed = 4 + static_cast<size_t>(len);
+	return buffer.substr(4, len);
+}
+
+} // namespace vsrm
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vsrm {
+
+struct ServiceRecord;
+struct Appointment;
+struct VehicleSummary;
+
+// Binary protocol between vsrm-cli serve and its clients over a local socket.
+//
+// Every message is a frame: u32 payload length, then the payload. Integers are little-endian,
+// strings are u32 length + UTF-8 bytes, optional strings a u8 presence flag first.
+//   request:  u32 requestId, u8 opcode, body
+//   response: u32 requestId, u8 status, body (status Ok) or error string
+// A client may send any number of requests before reading responses (pipelining). Responses
+// carry the request's id and can arrive out of order: reads run in parallel, writes in
+// batches.
+constexpr uint32_t kProtocolVersion = 1;
+constexpr uint32_t kMaxFrameBytes = 16u << 20;
+
+enum class Op : uint8_t {
+	Hello = 1,                   // u32 version -> u32 version
+	// Writes (one writer thread, consecutive record inserts share a transaction)
+	AddServiceRecord = 2,        // record -> i64 id
+	AddAppointment = 3,          // appointment -> i64 id
+	// Reads (connection pool)
+	ListServiceRecordsByVin = 16, // str vin -> u32 n, n records
+	ListVehicleSummaries = 17,   // str vinLike, opt from, opt to, opt mechanicLike, u8 dueOnly -> u32 n, n summaries
+	CountServiceRecords = 18,    // -> i64 count
+	ListAppointmentsByVin = 19,  // str vin -> u32 n, n appointments
+};
+
+enum class Status : uint8_t { Ok = 0, Failed = 1, BadRequest = 2, ShuttingDown = 3 };
+
+inline bool isWriteOp(Op op) { return op == Op::AddServiceRecord || op == Op::AddAppointment; }
+const char* opName(Op op);
+
+class WireWriter {
+public:
+	void u8(uint8_t v) { out.push_back(static_cast<char>(v)); }
+	void u32(uint32_t v);
+	void i64(int64_t v);
+	void str(std::string_view s);
+	void optStr(const std::optional<std::string>& s);
+
+	// Starts a frame: reserves the length prefix and writes the id and opcode/status
+	void begin(uint32_t requestId, uint8_t code);
+	// Fills in the length prefix of the frame started last
+	void end();
+
+	std::string out;
+
+private:
+	size_t frameStart{};
+};
+
+// Reads a payload in place; any overrun sets failed and yields zeros/empty strings
+class WireReader {
+public:
+	explicit WireReader(std::string_view payload) : in(payload) {}
+	uint8_t u8();
+	uint32_t u32();
+	int64_t i64();
+	std::string str();
+	std::optional<std::string> optStr();
+	bool ok() const { return !failed; }
+	bool atEnd() const { return in.empty(); }
+
+private:
+	std::string_view in;
+	bool failed{false};
+};
+
+void writeServiceRecord(WireWriter& w, const ServiceRecord& r);
+ServiceRecord readServiceRecord(WireReader& r);
+void writeAppointment(WireWriter& w, const Appointment& a);
+Appointment readAppointment(WireReader& r);
+void writeVehicleSummary(WireWriter& w, const VehicleSummary& s);
+VehicleSummary readVehicleSummary(WireReader& r);
+
+// Splits complete frames off the front of a receive buffer. Returns the payload and sets
+// consumed, or nullopt while the frame is incomplete. tooLarge is set for a length over
+// kMaxFrameBytes; the connection should be dropped.
+std::optional<std::string_view> nextFrame(std::string_view buffer, size_t& consumed, bool& tooLarge);
+
+} // namespace vsrm
@@ -0,0 +1,406 @@
+#include "ServiceServer.h"
+
+#include "Database.h"
+#include "LocalSocket.h"
+#include "ServiceProtocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vsrm {
+
+namespace {
+
+struct Connection {
+	LocalSocket socket;
+	std::mutex sendMutex; // responses come from the reader pool and the writer
+	std::atomic<bool> done{false};
+
+	void send(const std::string& frames) {
+		std::lock_guard lock(sendMutex);
+		if (!socket.sendAll(frames.data(), frames.size())) socket.shutdown(); // the client's read loop ends
+	}
+};
+
+struct Job {
+	std::shared_ptr<Connection> connection;
+	uint32_t requestId{};
+	Op op{};
+	std::string body;
+};
+
+class JobQueue {
+public:
+	void push(Job job) {
+		{
+			std::lock_guard lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		ready.notify_one();
+	}
+
+	// Blocks for at least one job, then takes up to max; false once closed and empty
+	bool popMany(std::vector<Job>& out, size_t max) {
+		std::unique_lock lock(mutex);
+		ready.wait(lock, [&] { return closed || !jobs.empty(); });
+		if (jobs.empty()) return false;
+		out.clear();
+		while (!jobs.empty() && out.size() < max) {
+			out.push_back(std::move(jobs.front()));
+			jobs.pop_front();
+		}
+		return true;
+	}
+
+	// popMany() that gives up after timeout: true with out empty when nothing came
+	bool popMany(std::vector<Job>& out, size_t max, std::chrono::milliseconds timeout) {
+		std::unique_lock lock(mutex);
+		out.clear();
+		if (!ready.wait_for(lock, timeout, [&] { return closed || !jobs.empty(); })) return true;
+		if (jobs.empty()) return false;
+		while (!jobs.empty() && out.size() < max) {
+			out.push_back(std::move(jobs.front()));
+			jobs.pop_front();
+		}
+		return true;
+	}
+
+	bool waiting() {
+		std::lock_guard lock(mutex);
+		return !jobs.empty();
+	}
+
+	void close() {
+		{
+			std::lock_guard lock(mutex);
+			closed = true;
+		}
+		ready.notify_all();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<Job> jobs;
+	bool closed{false};
+};
+
+void reply(const Job& job, Status status, const WireWriter& body) {
+	WireWriter w;
+	w.begin(job.requestId, static_cast<uint8_t>(status));
+	w.out += body.out;
+	w.end();
+	job.connection->send(w.out);
+}
+
+void replyError(const Job& job, Status status, const std::string& message) {
+	WireWriter body;
+	body.str(message);
+	reply(job, status, body);
+}
+
+} // namespace
+
+struct ServiceServer::State {
+	ServerOptions options;
+	LocalSocket listener;
+	std::thread acceptThread;
+	std::mutex clientsMutex;
+	std::vector<std::pair<std::shared_ptr<Connection>, std::thread>> clients;
+	JobQueue readQueue;
+	JobQueue writeQueue;
+	std::vector<std::thread> readers;
+	std::thread writer;
+	std::atomic<bool> stopping{false};
+
+	std::atomic<uint64_t> connections{0}, requests{0}, reads{0}, writes{0}, writeBatches{0}, largestBatch{0}, failed{0};
+	std::atomic<uint64_t> maintenancePasses{0}, maintenanceMicros{0}, longestMaintenanceLockMicros{0};
+
+	void acceptLoop();
+	void clientLoop(const std::shared_ptr<Connection>& connection);
+	void readLoop(Database db);
+	void writeLoop(Database db);
+	bool execute(Database& db, const Job& job); // reads and single writes; false if answered with an error
+};
+
+void ServiceServer::State::acceptLoop() {
+	for (;;) {
+		LocalSocket socket = listener.accept();
+		if (stopping || !socket.valid()) return;
+		auto connection = std::make_shared<Connection>();
+		connection->socket = std::move(socket);
+		++connections;
+		std::lock_guard lock(clientsMutex);
+		// Reap desks that disconnected so a long-running server does not accumulate threads
+		std::erase_if(clients, [](auto& c) {
+			if (!c.first->done) return false;
+			c.second.join();
+			return true;
+		});
+		clients.emplace_back(connection, std::thread([this, connection] { clientLoop(connection); }));
+	}
+}
+
+void ServiceServer::State::clientLoop(const std::shared_ptr<Connection>& connection) {
+	std::string buffer;
+	size_t start = 0;
+	char chunk[64 * 1024];
+	for (;;) {
+		long n = connection->socket.receive(chunk, sizeof(chunk));
+		if (n <= 0) break;
+		buffer.append(chunk, static_cast<size_t>(n));
+		// Every complete frame is dispatched at once; the client need not wait for answers
+		size_t consumed = 0;
+		bool tooLarge = false;
+		while (auto payload = nextFrame(std::string_view(buffer).substr(start), consumed, tooLarge)) {
+			start += consumed;
+			WireReader r(*payload);
+			Job job{connection, r.u32(), static_cast<Op>(r.u8()), {}};
+			job.body.assign(payload->substr(5 < payload->size() ? 5 : payload->size()));
+			++requests;
+			if (!r.ok()) { ++failed; replyError(job, Status::BadRequest, "Truncated request header"); continue; }
+			if (job.op == Op::Hello) {
+				WireReader body(job.body);
+				uint32_t version = body.u32();
+				WireWriter w;
+				w.u32(kProtocolVersion);
+				if (!body.ok() || version != kProtocolVersion) {
+					++failed;
+					replyError(job, Status::BadRequest, "Protocol version " + std::to_string(version) + " not supported (server speaks " +
+						std::to_string(kProtocolVersion) + ")");
+				} else {
+					reply(job, Status::Ok, w);
+				}
+			} else if (isWriteOp(job.op)) {
+				writeQueue.push(std::move(job));
+			} else {
+				readQueue.push(std::move(job));
+			}
+		}
+		if (tooLarge) break;
+		if (start == buffer.size()) { buffer.clear(); start = 0; }
+		else if (start > buffer.size() / 2) { buffer.erase(0, start); start = 0; }
+	}
+	connection->socket.shutdown();
+	connection->done = true;
+}
+
+bool ServiceServer::State::execute(Database& db, const Job& job) {
+	WireReader r(job.body);
+	WireWriter out;
+	switch (job.op) {
+	case Op::AddServiceRecord: {
+		ServiceRecord rec = readServiceRecord(r);
+		if (!r.ok() || !r.atEnd()) break;
+		auto id = db.addServiceRecord(rec);
+		if (!id) { replyError(job, Status::Failed, db.getLastError()); return false; }
+		out.i64(*id);
+		reply(job, Status::Ok, out);
+		return true;
+	}
+	case Op::AddAppointment: {
+		Appointment appt = readAppointment(r);
+		if (!r.ok() || !r.atEnd()) break;
+		auto id = db.addAppointment(appt);
+		if (!id) { replyError(job, Status::Failed, db.getLastError()); return false; }
+		out.i64(*id);
+		reply(job, Status::Ok, out);
+		return true;
+	}
+	case Op::ListServiceRecordsByVin: {
+		std::string vin = r.str();
+		if (!r.ok() || !r.atEnd()) break;
+		auto records = db.listServiceRecordsByVin(vin);
+		out.u32(static_cast<uint32_t>(records.size()));
+		for (const auto& rec : records) writeServiceRecord(out, rec);
+		reply(job, Status::Ok, out);
+		return true;
+	}
+	case Op::ListVehicleSummaries: {
+		std::string vinLike = r.str();
+		auto from = r.optStr();
+		auto to = r.optStr();
+		auto mechanicLike = r.optStr();
+		bool dueOnly = r.u8() != 0;
+		if (!r.ok() || !r.atEnd()) break;
+		auto rows = db.listVehicleSummaries(vinLike, from, to, mechanicLike, dueOnly);
+		out.u32(static_cast<uint32_t>(rows.size()));
+		for (const auto& row : rows) writeVehicleSummary(out, row);
+		reply(job, Status::Ok, out);
+		return true;
+	}
+	case Op::CountServiceRecords:
+		if (!r.atEnd()) break;
+		out.i64(db.countServiceRecords());
+		reply(job, Status::Ok, out);
+		return true;
+	case Op::ListAppointmentsByVin: {
+		std::string vin = r.str();
+		if (!r.ok() || !r.atEnd()) break;
+		auto appts = db.listAppointmentsByVin(vin);
+		out.u32(static_cast<uint32_t>(appts.size()));
+		for (const auto& a : appts) writeAppointment(out, a);
+		reply(job, Status::Ok, out);
+		return true;
+	}
+	case Op::Hello:
+		break;
+	}
+	replyError(job, Status::BadRequest, std::string("Malformed or unknown request (") + opName(job.op) + ")");
+	return false;
+}
+
+void ServiceServer::State::readLoop(Database db) {
+	std::vector<Job> jobs;
+	while (readQueue.popMany(jobs, 1)) {
+		for (const Job& job : jobs) {
+			++reads;
+			if (!execute(db, job)) ++failed;
+		}
+	}
+}
+
+void ServiceServer::State::writeLoop(Database db) {
+	std::vector<Job> jobs;
+	std::vector<ServiceRecord> records;
+	std::vector<size_t> recordJobs;
+	std::vector<std::optional<int>> ids;
+	std::vector<std::string> errors;
+	// Everything queued while the previous commit ran goes into the next one. With idle maintenance
+	// the wait times out once a second so the scheduler can tick; a pass gives way to new writes.
+	const auto tickEvery = std::chrono::milliseconds(1000);
+	while (options.idleMaintenance ? writeQueue.popMany(jobs, options.maxWriteBatch, tickEvery)
+			: writeQueue.popMany(jobs, options.maxWriteBatch)) {
+		if (jobs.empty()) {
+			MaintenanceReport report;
+			db.runIdleMaintenance(report, [this] { return stopping || writeQueue.waiting(); });
+			if (report.ran) {
+				++maintenancePasses;
+				maintenanceMicros += static_cast<uint64_t>(report.milliseconds * 1000.0);
+				uint64_t lock = static_cast<uint64_t>(report.longestLockMilliseconds * 1000.0), seen = longestMaintenanceLockMicros;
+				while (lock > seen && !longestMaintenanceLockMicros.compare_exchange_weak(seen, lock)) {}
+			}
+			continue;
+		}
+		writes += jobs.size();
+		records.clear();
+		recordJobs.clear();
+		for (size_t i = 0; i < jobs.size(); ++i) {
+			if (jobs[i].op != Op::AddServiceRecord) continue;
+			WireReader r(jobs[i].body);
+			ServiceRecord rec = readServiceRecord(r);
+			if (!r.ok() || !r.atEnd()) continue; // execute() reports it
+			records.push_back(std::move(rec));
+			recordJobs.push_back(i);
+		}
+		if (!records.empty()) {
+			++writeBatches;
+			uint64_t seen = largestBatch;
+			while (records.size() > seen && !largestBatch.compare_exchange_weak(seen, records.size())) {}
+			bool ok = db.addServiceRecordsBatch(records, ids, errors);
+			for (size_t k = 0; k < records.size(); ++k) {
+				const Job& job = jobs[recordJobs[k]];
+				if (!ok || !ids[k]) {
+					++failed;
+					replyError(job, Status::Failed, ok ? errors[k] : db.getLastError());
+					continue;
+				}
+				WireWriter out;
+				out.i64(*ids[k]);
+				reply(job, Status::Ok, out);
+			}
+		}
+		// Appointments and malformed inserts, one transaction each, in arrival order
+		for (size_t i = 0, k = 0; i < jobs.size(); ++i) {
+			if (k < recordJobs.size() && recordJobs[k] == i) { ++k; continue; }
+			if (jobs[i].op != Op::AddServiceRecord) ++writeBatches;
+			if (!execute(db, jobs[i])) ++failed;
+		}
+	}
+}
+
+ServiceServer::ServiceServer() = default;
+
+ServiceServer::~ServiceServer() { stop(); }
+
+bool ServiceServer::start(const ServerOptions& options, std::string& error) {
+	stop();
+	auto s = std::make_unique<State>();
+	s->options = options;
+	if (s->options.maxWriteBatch == 0) s->options.maxWriteBatch = 1;
+
+	Database writerDb;
+	if (!writerDb.openOrCreate(options.dbPath) || !writerDb.migrateSchema() || !writerDb.enableWriteAheadLog()) {
+		error = options.dbPath + ": " + writerDb.getLastError();
+		return false;
+	}
+	writerDb.setMaintenanceOptions(options.maintenance);
+	int readerCount = options.readers > 0 ? options.readers : static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+	std::vector<Database> readerDbs(static_cast<size_t>(readerCount));
+	for (Database& db : readerDbs) {
+		if (!db.openOrCreate(options.dbPath) || !db.enableWriteAheadLog()) {
+			error = options.dbPath + ": " + db.getLastError();
+			return false;
+		}
+	}
+	if (!s->listener.listen(options.socketPath, error)) return false;
+
+	State* st = s.get();
+	for (Database& db : readerDbs) st->readers.emplace_back([st, db = std::move(db)]() mutable { st->readLoop(std::move(db)); });
+	st->writer = std::thread([st, db = std::move(writerDb)]() mutable { st->writeLoop(std::move(db)); });
+	st->acceptThread = std::thread([st] { st->acceptLoop(); });
+	state = std::move(s);
+	return true;
+}
+
+void ServiceServer::stop() {
+	if (!state) return;
+	State& s = *state;
+	// A connection of our own wakes accept(); shutting a listener down does not on every platform
+	s.stopping = true;
+	LocalSocket wake;
+	std::string ignored;
+	if (wake.connect(s.options.socketPath, ignored)) s.acceptThread.join();
+	else { s.listener.shutdown(); s.acceptThread.join(); }
+	wake.close();
+	s.listener.close();
+	{
+		std::lock_guard lock(s.clientsMutex);
+		for (auto& c : s.clients) c.first->socket.shutdown();
+		for (auto& c : s.clients) c.second.join();
+	}
+	s.readQueue.close();
+	s.writeQueue.close();
+	for (auto& t : s.readers) t.join();
+	s.writer.join();
+	s.clients.clear();
+	std::error_code ec;
+	const std::string& path = s.options.socketPath;
+	std::filesystem::remove(std::filesystem::path(std::u8string(path.begin(), path.end())), ec);
+	state.reset();
+}
+
+ServerStats ServiceServer::stats() const {
+	ServerStats out;
+	if (!state) return out;
+	out.connections = state->connections;
+	out.requests = state->requests;
+	out.reads = state->reads;
+	out.writes = state->writes;
+	out.writeBatches = state->writeBatches;
+	out.largestBatch = state->largestBatch;
+	out.failed = state->failed;
+	out.maintenancePasses = state->maintenancePasses;
+	out.maintenanceMilliseconds = state->maintenanceMicros / 1000.0;
+	out.longestMaintenanceLock = state->longestMaintenanceLockMicros / 1000.0;
+	return out;
+}
+
+} // namespace vsrm
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Maintenance.h"
+
+namespace vsrm {
+
+struct ServerOptions {
+	std::string dbPath;
+	std::string socketPath;
+	int readers{0};            // read connections in the pool; <= 0: one per core, at least 2
+	size_t maxWriteBatch{256}; // queued record inserts committed in one transaction
+	bool idleMaintenance{true}; // the writer runs maintenance passes while no writes arrive
+	MaintenanceOptions maintenance;
+};
+
+struct ServerStats {
+	uint64_t connections{};    // accepted so far
+	uint64_t requests{};
+	uint64_t reads{};
+	uint64_t writes{};
+	uint64_t writeBatches{};   // transactions the writer committed
+	uint64_t largestBatch{};
+	uint64_t failed{};         // requests answered with an error status
+	uint64_t maintenancePasses{};
+	double maintenanceMilliseconds{};  // all passes together
+	double longestMaintenanceLock{};   // ms
+};
+
+// Owns the database for every desk on the machine: clients speak ServiceProtocol.h over a
+// LocalSocket. One thread per client decodes frames; reads go to a pool of connections,
+// writes to a single writer that drains its queue and commits consecutive record inserts
+// as one transaction (each under its own savepoint). The file is switched to WAL so
+// readers never wait for the writer. While its queue stays empty the writer ticks a
+// MaintenanceScheduler, and a pass gives way as soon as a write is queued.
+class ServiceServer {
+public:
+	ServiceServer();
+	~ServiceServer(); // stops
+
+	ServiceServer(const ServiceServer&) = delete;
+	ServiceServer& operator=(const ServiceServer&) = delete;
+
+	// Opens and migrates the database, then listens; false with error if either fails
+	bool start(const ServerOptions& options, std::string& error);
+	// Disconnects every client, finishes the writes already queued and removes the socket file
+	void stop();
+	ServerStats stats() const;
+
+private:
+	struct State;
+	std::unique_ptr<State> state;
+};
+
+} // namespace vsrm
@@ -0,0 +1,263 @@
+#include "Sha256.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define VSRM_SHA_TARGET
+#else
+#include <cpuid.h>
+#define VSRM_SHA_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+#define VSRM_SHA_NI 1
+#endif
+
+namespace vsrm {
+
+namespace {
+
+constexpr std::array<uint32_t, 8> kInitial = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+alignas(16) constexpr uint32_t kRound[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t rotr(uint32_t x, int n) { return x >> n | x << (32 - n); }
+
+inline uint32_t loadBig(const uint8_t* p) {
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+inline void storeBig(uint8_t* p, uint32_t v) {
+	p[0] = uint8_t(v >> 24); p[1] = uint8_t(v >> 16); p[2] = uint8_t(v >> 8); p[3] = uint8_t(v);
+}
+
+void compressPortable(uint32_t* state, const uint8_t* data, size_t blocks) {
+	for (; blocks; --blocks, data += 64) {
+		uint32_t w[64];
+		for (int i = 0; i < 16; ++i) w[i] = loadBig(data + 4 * i);
+		for (int i = 16; i < 64; ++i) {
+			uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+		for (int i = 0; i < 64; ++i) {
+			uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + kRound[i] + w[i];
+			uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
+
+#ifdef VSRM_SHA_NI
+// Four rounds per step with SHA256RNDS2; the state lives in ABEF/CDGH order meanwhile
+VSRM_SHA_TARGET void compressShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+	const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	for (; blocks; --blocks, data += 64) {
+		const __m128i abef = state0, cdgh = state1;
+		__m128i w[4];
+#ifdef __GNUC__
+#pragma GCC unroll 16 // keeps w[] in registers
+#endif
+		for (int i = 0; i < 16; ++i) {
+			__m128i& wi = w[i & 3];
+			if (i < 4) {
+				wi = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), byteSwap);
+			} else {
+				// W[i..i+3] from W[i-4..i-1]: msg1 adds sigma0, alignr supplies W[i-7..i-4], msg2 adds sigma1
+				__m128i x = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+				x = _mm_add_epi32(x, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+				wi = _mm_sha256msg2_epu32(x, w[(i + 3) & 3]);
+			}
+			__m128i msg = _mm_add_epi32(wi, _mm_load_si128(reinterpret_cast<const __m128i*>(kRound + 4 * i)));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+		}
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+bool cpuHasShaNi() {
+#ifdef _MSC_VER
+	int r[4];
+	__cpuid(r, 0);
+	if (r[0] < 7) return false;
+	__cpuid(r, 1);
+	bool sse41 = (r[2] >> 19) & 1, ssse3 = (r[2] >> 9) & 1;
+	__cpuidex(r, 7, 0);
+	return sse41 && ssse3 && ((r[1] >> 29) & 1);
+#else
+	unsigned a, b, c, d;
+	if (!__get_cpuid(1, &a, &b, &c, &d)) return false;
+	bool sse41 = (c >> 19) & 1, ssse3 = (c >> 9) & 1;
+	if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return false;
+	return sse41 && ssse3 && ((b >> 29) & 1);
+#endif
+}
+#endif
+
+using CompressFn = void (*)(uint32_t*, const uint8_t*, size_t);
+
+struct Backend {
+	CompressFn compress;
+	const char* name;
+};
+
+const Backend& backend() {
+	static const Backend chosen = [] {
+#ifdef VSRM_SHA_NI
+		if (cpuHasShaNi()) return Backend{compressShaNi, "sha-ni"};
+#endif
+		return Backend{compressPortable, "portable"};
+	}();
+	return chosen;
+}
+
+// Digest of a 32-byte message continuing from `midstate` (one block already absorbed)
+void finishShortBlock(const uint32_t* midstate, const uint8_t* message32, uint32_t* out, CompressFn compress) {
+	uint8_t block[64] = {};
+	std::memcpy(block, message32, 32);
+	block[32] = 0x80;
+	block[62] = 0x03; // (64 + 32) * 8 = 768 bits
+	std::memcpy(out, midstate, 32);
+	compress(out, block, 1);
+}
+
+void stateToBytes(const uint32_t* state, uint8_t* out) {
+	for (int i = 0; i < 8; ++i) storeBig(out + 4 * i, state[i]);
+}
+
+} // namespace
+
+void Sha256::reset() {
+	state = kInitial;
+	buffered = 0;
+	length = 0;
+}
+
+void Sha256::update(const void* data, size_t size) {
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	length += size;
+	if (buffered) {
+		size_t take = std::min(size, kBlockSize - buffered);
+		std::memcpy(buffer.data() + buffered, p, take);
+		buffered += take; p += take; size -= take;
+		if (buffered < kBlockSize) return;
+		backend().compress(state.data(), buffer.data(), 1);
+		buffered = 0;
+	}
+	if (size >= kBlockSize) {
+		size_t blocks = size / kBlockSize;
+		backend().compress(state.data(), p, blocks);
+		p += blocks * kBlockSize; size -= blocks * kBlockSize;
+	}
+	std::memcpy(buffer.data(), p, size);
+	buffered = size;
+}
+
+Sha256Digest Sha256::finish() {
+	const uint64_t bits = length * 8;
+	uint8_t pad[kBlockSize + 8] = {0x80};
+	size_t padLength = (buffered < 56 ? 56 : 120) - buffered;
+	for (int i = 0; i < 8; ++i) pad[padLength + i] = uint8_t(bits >> (56 - 8 * i));
+	update(pad, padLength + 8);
+	Sha256Digest out;
+	stateToBytes(state.data(), out.data());
+	reset();
+	return out;
+}
+
+Sha256Digest Sha256::hash(std::string_view data) {
+	Sha256 h;
+	h.update(data);
+	return h.finish();
+}
+
+const char* Sha256::implementation() { return backend().name; }
+
+HmacSha256::HmacSha256(std::string_view key) {
+	uint8_t block[Sha256::kBlockSize] = {};
+	if (key.size() > Sha256::kBlockSize) {
+		Sha256Digest d = Sha256::hash(key);
+		std::memcpy(block, d.data(), d.size());
+	} else {
+		std::memcpy(block, key.data(), key.size());
+	}
+	uint8_t pad[Sha256::kBlockSize];
+	CompressFn compress = backend().compress;
+	for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = block[i] ^ 0x36;
+	inner = kInitial;
+	compress(inner.data(), pad, 1);
+	for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = block[i] ^ 0x5c;
+	outer = kInitial;
+	compress(outer.data(), pad, 1);
+}
+
+Sha256Digest HmacSha256::mac(std::string_view message) const {
+	// Resume from the pad midstates; the length counts the pad block already absorbed
+	Sha256 h;
+	h.state = inner;
+	h.length = Sha256::kBlockSize;
+	h.update(message);
+	Sha256Digest innerDigest = h.finish();
+	uint32_t s[8];
+	finishShortBlock(outer.data(), innerDigest.data(), s, backend().compress);
+	Sha256Digest out;
+	stateToBytes(s, out.data());
+	return out;
+}
+
+Sha256Digest pbkdf2Sha256(std::string_view password, std::string_view salt, uint32_t iterations) {
+	HmacSha256 prf(password);
+	std::string first(salt);
+	first.append("\0\0\0\1", 4); // block index 1, big-endian
+	Sha256Digest u = prf.mac(first);
+	Sha256Digest result = u;
+	CompressFn compress = backend().compress;
+	uint32_t s[8];
+	for (uint32_t i = 1; i < iterations; ++i) {
+		finishShortBlock(prf.inner.data(), u.data(), s, compress);
+		stateToBytes(s, u.data());
+		finishShortBlock(prf.outer.data(), u.data(), s, compress);
+		stateToBytes(s, u.data());
+		for (size_t k = 0; k < u.size(); ++k) result[k] ^= u[k];
+	}
+	return result;
+}
+
+std::string toHex(const uint8_t* data, size_t size) {
+	static const char* hex = "0123456789abcdef";
+	std::string out(size * 2, '\0');
+	for (size_t i = 0; i < size; ++i) { out[i * 2] = hex[data[i] >> 4]; out[i * 2 + 1] = hex[data[i] & 0xF]; }
+	return out;
+}
+
+} // namespace vsrm
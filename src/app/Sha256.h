@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace vsrm {
+
+using Sha256Digest = std::array<uint8_t, 32>;
+
+// SHA-256 (FIPS 180-4). The block function is chosen once per process: the x86 SHA
+// extensions when the CPU has them, portable code otherwise. A context is reusable
+// after finish() and holds no OS resources.
+class Sha256 {
+public:
+	static constexpr size_t kBlockSize = 64;
+
+	Sha256() { reset(); }
+	void reset();
+	void update(const void* data, size_t size);
+	void update(std::string_view s) { update(s.data(), s.size()); }
+	Sha256Digest finish(); // also resets
+
+	static Sha256Digest hash(std::string_view data);
+	static const char* implementation(); // "sha-ni" or "portable"
+
+private:
+	friend class HmacSha256;
+	std::array<uint32_t, 8> state;
+	std::array<uint8_t, kBlockSize> buffer;
+	size_t buffered;
+	uint64_t length;
+};
+
+// HMAC-SHA256 keyed once: the inner and outer pad blocks are hashed in the constructor,
+// so each mac() costs the message plus two blocks.
+class HmacSha256 {
+public:
+	explicit HmacSha256(std::string_view key);
+	Sha256Digest mac(std::string_view message) const;
+
+private:
+	friend Sha256Digest pbkdf2Sha256(std::string_view, std::string_view, uint32_t);
+	std::array<uint32_t, 8> inner;
+	std::array<uint32_t, 8> outer;
+};
+
+// PBKDF2-HMAC-SHA256 (RFC 8018), one 32-byte output block. Each iteration is exactly
+// two block compressions.
+Sha256Digest pbkdf2Sha256(std::string_view password, std::string_view salt, uint32_t iterations);
+
+std::string toHex(const uint8_t* data, size_t size);
+
+} // namespace vsrm
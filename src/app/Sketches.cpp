@@ -0,0 +1,462 @@
+#include "Sketches.h"
+
+#include "Archive.h"
+#include "FastHash.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace vsrm {
+
+namespace {
+
+// Serialized layout: tag byte, then fixed-size little-endian fields
+template <class T>
+void put(std::string& out, T v) {
+	out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <class T>
+bool get(std::string_view& in, T& v) {
+	if (in.size() < sizeof(v)) return false;
+	std::memcpy(&v, in.data(), sizeof(v));
+	in.remove_prefix(sizeof(v));
+	return true;
+}
+
+} // namespace
+
+double HyperLogLog::relativeError() { return 1.04 / std::sqrt(double(kRegisters)); }
+
+void HyperLogLog::add(uint64_t hash) {
+	size_t index = static_cast<size_t>(hash >> (64 - kPrecision));
+	uint64_t rest = hash << kPrecision | (uint64_t(1) << (kPrecision - 1)); // sentinel bounds the run length
+	uint8_t rank = static_cast<uint8_t>(std::countl_zero(rest) + 1);
+	if (rank > registers[index]) registers[index] = rank;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+	for (size_t i = 0; i < kRegisters; ++i) registers[i] = std::max(registers[i], other.registers[i]);
+}
+
+double HyperLogLog::estimate() const {
+	const double m = double(kRegisters);
+	double sum = 0;
+	size_t zeros = 0;
+	for (uint8_t r : registers) {
+		sum += std::ldexp(1.0, -int(r));
+		zeros += r == 0;
+	}
+	double e = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+	if (e <= 2.5 * m && zeros) e = m * std::log(m / double(zeros)); // linear counting for small sets
+	return e;
+}
+
+std::string HyperLogLog::serialize() const {
+	std::string out;
+	out.reserve(2 + kRegisters);
+	out.push_back('H');
+	out.push_back(static_cast<char>(kPrecision));
+	out.append(reinterpret_cast<const char*>(registers.data()), kRegisters);
+	return out;
+}
+
+bool HyperLogLog::deserialize(std::string_view data) {
+	if (data.size() != 2 + kRegisters || data[0] != 'H' || data[1] != kPrecision) return false;
+	std::memcpy(registers.data(), data.data() + 2, kRegisters);
+	return true;
+}
+
+double CountMinSketch::errorFactor() { return std::exp(1.0) / kWidth; }
+double CountMinSketch::confidence() { return 1.0 - std::exp(-double(kDepth)); }
+
+// Row i uses h1 + i * h2 (double hashing): one 64-bit hash serves every row
+uint64_t CountMinSketch::add(uint64_t hash, uint32_t count) {
+	const uint32_t h1 = static_cast<uint32_t>(hash), h2 = static_cast<uint32_t>(hash >> 32) | 1;
+	uint64_t est = UINT64_MAX;
+	for (uint32_t i = 0; i < kDepth; ++i) {
+		uint32_t& c = counters[size_t(i) * kWidth + (h1 + i * h2) % kWidth];
+		c = c > UINT32_MAX - count ? UINT32_MAX : c + count;
+		est = std::min<uint64_t>(est, c);
+	}
+	totalCount += count;
+	return est;
+}
+
+uint64_t CountMinSketch::estimate(uint64_t hash) const {
+	const uint32_t h1 = static_cast<uint32_t>(hash), h2 = static_cast<uint32_t>(hash >> 32) | 1;
+	uint64_t est = UINT64_MAX;
+	for (uint32_t i = 0; i < kDepth; ++i) est = std::min<uint64_t>(est, counters[size_t(i) * kWidth + (h1 + i * h2) % kWidth]);
+	return est;
+}
+
+void CountMinSketch::merge(const CountMinSketch& other) {
+	for (size_t i = 0; i < counters.size(); ++i) {
+		uint64_t sum = uint64_t(counters[i]) + other.counters[i];
+		counters[i] = static_cast<uint32_t>(std::min<uint64_t>(sum, UINT32_MAX));
+	}
+	totalCount += other.totalCount;
+}
+
+std::string CountMinSketch::serialize() const {
+	std::string out;
+	out.reserve(1 + 16 + counters.size() * sizeof(uint32_t));
+	out.push_back('C');
+	put(out, kWidth);
+	put(out, kDepth);
+	put(out, totalCount);
+	out.append(reinterpret_cast<const char*>(counters.data()), counters.size() * sizeof(uint32_t));
+	return out;
+}
+
+bool CountMinSketch::deserialize(std::string_view data) {
+	uint32_t width = 0, depth = 0;
+	if (data.empty() || data[0] != 'C') return false;
+	data.remove_prefix(1);
+	if (!get(data, width) || !get(data, depth) || width != kWidth || depth != kDepth || !get(data, totalCount)) return false;
+	if (data.size() < counters.size() * sizeof(uint32_t)) return false;
+	std::memcpy(counters.data(), data.data(), counters.size() * sizeof(uint32_t));
+	return true;
+}
+
+void HeavyHitters::offer(std::string_view key, uint64_t estimate) {
+	for (auto& c : candidates) {
+		if (c.key == key) { c.estimate = estimate; return; }
+	}
+	if (candidates.size() < kCandidates) { candidates.push_back(SketchCount{std::string(key), estimate}); return; }
+	auto low = std::min_element(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.estimate < b.estimate; });
+	if (estimate > low->estimate) *low = SketchCount{std::string(key), estimate};
+}
+
+void HeavyHitters::add(std::string_view key) { offer(key, sketch.add(fastHash64(key))); }
+
+void HeavyHitters::merge(const HeavyHitters& other) {
+	sketch.merge(other.sketch);
+	std::vector<SketchCount> pool = std::move(candidates);
+	pool.insert(pool.end(), other.candidates.begin(), other.candidates.end());
+	candidates.clear();
+	for (const auto& c : pool) offer(c.key, sketch.estimate(fastHash64(c.key)));
+}
+
+std::vector<SketchCount> HeavyHitters::top(size_t n) const {
+	std::vector<SketchCount> out = candidates;
+	std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.estimate != b.estimate ? a.estimate > b.estimate : a.key < b.key; });
+	if (out.size() > n) out.resize(n);
+	return out;
+}
+
+std::string HeavyHitters::serialize() const {
+	std::string out = sketch.serialize();
+	put(out, static_cast<uint16_t>(candidates.size()));
+	for (const auto& c : candidates) {
+		put(out, static_cast<uint16_t>(std::min<size_t>(c.key.size(), UINT16_MAX)));
+		out.append(c.key, 0, UINT16_MAX);
+		put(out, c.estimate);
+	}
+	return out;
+}
+
+bool HeavyHitters::deserialize(std::string_view data) {
+	const size_t sketchBytes = 1 + 16 + size_t(CountMinSketch::kWidth) * CountMinSketch::kDepth * sizeof(uint32_t);
+	if (data.size() < sketchBytes || !sketch.deserialize(data.substr(0, sketchBytes))) return false;
+	data.remove_prefix(sketchBytes);
+	uint16_t n = 0;
+	if (!get(data, n)) return false;
+	candidates.clear();
+	for (uint16_t i = 0; i < n; ++i) {
+		uint16_t len = 0;
+		SketchCount c;
+		if (!get(data, len) || data.size() < len) return false;
+		c.key.assign(data.data(), len);
+		data.remove_prefix(len);
+		if (!get(data, c.estimate)) return false;
+		candidates.push_back(std::move(c));
+	}
+	return true;
+}
+
+std::vector<std::string> descriptionKeywords(std::string_view description) {
+	static constexpr std::string_view kFiller[] = {"and", "the", "for", "with", "from", "per", "all", "new"};
+	std::vector<std::string> words;
+	std::string word;
+	auto finish = [&] {
+		if (word.size() >= 3 && std::find(std::begin(kFiller), std::end(kFiller), word) == std::end(kFiller) &&
+			std::find(words.begin(), words.end(), word) == words.end()) words.push_back(word);
+		word.clear();
+	};
+	for (char ch : description) {
+		unsigned char c = static_cast<unsigned char>(ch);
+		if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) word.push_back(ch); // UTF-8 bytes kept as-is
+		else if (c >= 'A' && c <= 'Z') word.push_back(static_cast<char>(c - 'A' + 'a'));
+		else finish();
+	}
+	finish();
+	return words;
+}
+
+void MonthSketches::add(std::string_view customer, std::string_view vin, std::string_view mechanic, std::string_view description) {
+	customers.add(fastHash64(customer));
+	vins.add(fastHash64(vin));
+	mechanics.add(mechanic);
+	for (const auto& w : descriptionKeywords(description)) keywords.add(w);
+}
+
+void MonthSketches::merge(const MonthSketches& other) {
+	customers.merge(other.customers);
+	vins.merge(other.vins);
+	mechanics.merge(other.mechanics);
+	keywords.merge(other.keywords);
+}
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+constexpr const char* kKinds[] = {"customers", "vins", "mechanics", "keywords"};
+
+std::string_view columnView(sqlite3_stmt* stmt, int col) {
+	const unsigned char* t = sqlite3_column_text(stmt, col);
+	return t ? std::string_view(reinterpret_cast<const char*>(t), static_cast<size_t>(sqlite3_column_bytes(stmt, col))) : std::string_view();
+}
+
+// "YYYY-MM" of an ISO date, or empty if it does not start like one
+std::string_view monthOf(std::string_view date) {
+	if (date.size() < 7 || date[4] != '-') return {};
+	for (int i : {0, 1, 2, 3, 5, 6}) if (date[i] < '0' || date[i] > '9') return {};
+	return date.substr(0, 7);
+}
+
+bool decode(MonthSketches& s, std::string_view kind, std::string_view data) {
+	if (kind == kKinds[0]) return s.customers.deserialize(data);
+	if (kind == kKinds[1]) return s.vins.deserialize(data);
+	if (kind == kKinds[2]) return s.mechanics.deserialize(data);
+	if (kind == kKinds[3]) return s.keywords.deserialize(data);
+	return true; // unknown kinds (newer builds) are ignored
+}
+
+bool loadMonth(sqlite3* db, std::string_view month, MonthSketches& out, std::string& error) {
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT kind, data FROM analytics_sketches WHERE period = ?1;", -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_bind_text(stmt, 1, month.data(), static_cast<int>(month.size()), SQLITE_STATIC);
+	int rc;
+	bool ok = true;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		std::string_view data(static_cast<const char*>(sqlite3_column_blob(stmt, 1)), static_cast<size_t>(sqlite3_column_bytes(stmt, 1)));
+		if (!decode(out, columnView(stmt, 0), data)) { ok = false; error = "Corrupt analytics sketch for " + std::string(month); break; }
+	}
+	if (ok && rc != SQLITE_DONE) { ok = false; error = sqlite3_errmsg(db); }
+	sqlite3_finalize(stmt);
+	return ok;
+}
+
+bool saveMonths(sqlite3* db, const std::map<std::string, MonthSketches, std::less<>>& months, std::string& error) {
+	sqlite3_stmt* stmt = nullptr;
+	const char* sql = "INSERT INTO analytics_sketches (period, kind, data) VALUES (?1, ?2, ?3) "
+		"ON CONFLICT (period, kind) DO UPDATE SET data = excluded.data;";
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	for (const auto& [month, s] : months) {
+		const std::string blobs[] = {s.customers.serialize(), s.vins.serialize(), s.mechanics.serialize(), s.keywords.serialize()};
+		for (int k = 0; k < 4; ++k) {
+			sqlite3_bind_text(stmt, 1, month.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(stmt, 2, kKinds[k], -1, SQLITE_STATIC);
+			sqlite3_bind_blob(stmt, 3, blobs[k].data(), static_cast<int>(blobs[k].size()), SQLITE_STATIC);
+			int rc = sqlite3_step(stmt);
+			sqlite3_reset(stmt);
+			if (rc != SQLITE_DONE) {
+				error = sqlite3_errmsg(db);
+				sqlite3_finalize(stmt);
+				return false;
+			}
+		}
+	}
+	sqlite3_finalize(stmt);
+	return true;
+}
+
+MonthSketches& monthSketches(std::map<std::string, MonthSketches, std::less<>>& months, std::string_view month) {
+	auto it = months.find(month);
+	if (it == months.end()) it = months.emplace(std::string(month), MonthSketches{}).first;
+	return it->second;
+}
+
+// One archive partition's rows, read on its own connection (the caller's transaction rules out ATTACH); decode is
+// main's SELECT vsrm_text(?1), since packed descriptions refer to main's dictionaries
+bool addArchived(const std::string& path, sqlite3_stmt* decode, std::map<std::string, MonthSketches, std::less<>>& months,
+	std::string& error) {
+	sqlite3* part = nullptr;
+	if (sqlite3_open_v2(path.c_str(), &part, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+		error = "Cannot open archive " + path + ": " + (part ? sqlite3_errmsg(part) : "out of memory");
+		sqlite3_close(part);
+		return false;
+	}
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v2(part, "SELECT service_date, customer_name, vin, mechanic, description FROM service_records;",
+			-1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(part);
+		sqlite3_close(part);
+		return false;
+	}
+	int rc;
+	bool ok = true;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		std::string_view month = monthOf(columnView(stmt, 0));
+		if (month.empty()) continue;
+		sqlite3_reset(decode);
+		sqlite3_bind_value(decode, 1, sqlite3_column_value(stmt, 4));
+		if (sqlite3_step(decode) != SQLITE_ROW) { ok = false; error = sqlite3_errmsg(sqlite3_db_handle(decode)); break; }
+		monthSketches(months, month).add(columnView(stmt, 1), columnView(stmt, 2), columnView(stmt, 3), columnView(decode, 0));
+	}
+	if (ok && rc != SQLITE_DONE) { ok = false; error = sqlite3_errmsg(part); }
+	sqlite3_reset(decode);
+	sqlite3_finalize(stmt);
+	sqlite3_close(part);
+	return ok;
+}
+
+} // namespace
+
+bool SketchWriter::add(sqlite3* db, std::string_view serviceDate, std::string_view customer, std::string_view vin,
+	std::string_view mechanic, std::string_view description, std::string& error) {
+	std::string_view month = monthOf(serviceDate);
+	if (month.empty()) return true; // undated records are not bucketed
+	auto it = months.find(month);
+	if (it == months.end()) {
+		it = months.emplace(std::string(month), MonthSketches{}).first;
+		if (!loadMonth(db, month, it->second, error)) { months.erase(it); return false; }
+	}
+	it->second.add(customer, vin, mechanic, description);
+	return true;
+}
+
+bool SketchWriter::flush(sqlite3* db, std::string& error) {
+	bool ok = saveMonths(db, months, error);
+	months.clear();
+	return ok;
+}
+
+bool rebuildSketches(sqlite3* db, std::string& error) {
+	std::map<std::string, MonthSketches, std::less<>> months;
+	sqlite3_stmt* stmt = nullptr;
+	const char* sql = "SELECT service_date, customer_name, vin, mechanic, vsrm_text(description) FROM service_records;";
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		std::string_view month = monthOf(columnView(stmt, 0));
+		if (month.empty()) continue;
+		monthSketches(months, month).add(columnView(stmt, 1), columnView(stmt, 2), columnView(stmt, 3), columnView(stmt, 4));
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+
+	// Archived months keep counting, as they do between rebuilds
+	std::vector<ArchivePartition> partitions;
+	if (!listArchivePartitions(db, partitions, error)) return false;
+	sqlite3_stmt* decode = nullptr;
+	for (const auto& p : partitions) {
+		if (p.records == 0) continue;
+		if (!decode && sqlite3_prepare_v2(db, "SELECT vsrm_text(?1);", -1, &decode, nullptr) != SQLITE_OK) {
+			error = sqlite3_errmsg(db);
+			return false;
+		}
+		if (!addArchived(archivePartitionPath(db, p), decode, months, error)) {
+			sqlite3_finalize(decode);
+			return false;
+		}
+	}
+	sqlite3_finalize(decode);
+
+	if (sqlite3_exec(db, "DELETE FROM analytics_sketches;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	return saveMonths(db, months, error);
+}
+
+bool readSketchSummary(sqlite3* db, const std::string& fromMonth, const std::string& toMonth, size_t topN,
+	SketchSummary& out, std::string& error) {
+	out = SketchSummary{};
+	out.fromMonth = fromMonth;
+	out.toMonth = toMonth;
+	sqlite3_stmt* stmt = nullptr;
+	const char* sql = "SELECT period, kind, data FROM analytics_sketches WHERE period BETWEEN ?1 AND ?2 ORDER BY period;";
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	sqlite3_bind_text(stmt, 1, fromMonth.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, toMonth.c_str(), -1, SQLITE_STATIC);
+	MonthSketches total, month;
+	std::string period;
+	auto fold = [&] {
+		if (period.empty()) return;
+		total.merge(month);
+		month = MonthSketches{};
+		++out.months;
+	};
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		std::string_view p = columnView(stmt, 0);
+		if (p != period) { fold(); period.assign(p); }
+		std::string_view data(static_cast<const char*>(sqlite3_column_blob(stmt, 2)), static_cast<size_t>(sqlite3_column_bytes(stmt, 2)));
+		if (!decode(month, columnView(stmt, 1), data)) {
+			error = "Corrupt analytics sketch for " + period;
+			sqlite3_finalize(stmt);
+			return false;
+		}
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE) { error = sqlite3_errmsg(db); return false; }
+	fold();
+
+	out.records = total.mechanics.counts().total();
+	out.distinctCustomers = out.records ? total.customers.estimate() : 0.0;
+	out.distinctVins = out.records ? total.vins.estimate() : 0.0;
+	out.distinctRelativeError = HyperLogLog::relativeError();
+	out.topMechanics = total.mechanics.top(topN);
+	out.topKeywords = total.keywords.top(topN);
+	out.countErrorBound = static_cast<uint64_t>(std::ceil(CountMinSketch::errorFactor() * double(std::max(out.records, total.keywords.counts().total()))));
+	out.countConfidence = CountMinSketch::confidence();
+	return true;
+}
+
+#else
+
+bool SketchWriter::add(sqlite3*, std::string_view, std::string_view, std::string_view, std::string_view, std::string_view, std::string& error) {
+	error = "SQLite not available.";
+	return false;
+}
+
+bool SketchWriter::flush(sqlite3*, std::string& error) {
+	error = "SQLite not available.";
+	return false;
+}
+
+bool rebuildSketches(sqlite3*, std::string& error) {
+	error = "SQLite not available.";
+	return false;
+}
+
+bool readSketchSummary(sqlite3*, const std::string&, const std::string&, size_t, SketchSummary& out, std::string& error) {
+	out = SketchSummary{};
+	error = "SQLite not available.";
+	return false;
+}
+
+#endif
+
+} // namespace vsrm
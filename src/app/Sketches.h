@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct sqlite3;
+
+namespace vsrm {
+
+// Distinct-count estimate in 2^12 one-byte registers (4 KiB). Standard error
+// 1.04 / sqrt(4096) ~ 1.6%; merging (register max) is lossless, so months combine.
+class HyperLogLog {
+public:
+	static constexpr int kPrecision = 12;
+	static constexpr size_t kRegisters = size_t(1) << kPrecision;
+	static double relativeError(); // one standard error
+
+	void add(uint64_t hash);
+	void merge(const HyperLogLog& other);
+	double estimate() const;
+
+	std::string serialize() const;
+	bool deserialize(std::string_view data);
+
+private:
+	std::array<uint8_t, kRegisters> registers{};
+};
+
+// Frequency estimates that never undercount. With width w and depth d an estimate
+// exceeds the true count by more than (e / w) * total with probability <= e^-d.
+class CountMinSketch {
+public:
+	static constexpr uint32_t kWidth = 1024;
+	static constexpr uint32_t kDepth = 4;
+	static double errorFactor();  // e / width
+	static double confidence();   // 1 - e^-depth
+
+	uint64_t add(uint64_t hash, uint32_t count = 1); // returns the new estimate
+	uint64_t estimate(uint64_t hash) const;
+	void merge(const CountMinSketch& other);
+	uint64_t total() const { return totalCount; }
+
+	std::string serialize() const;
+	bool deserialize(std::string_view data);
+
+private:
+	std::vector<uint32_t> counters = std::vector<uint32_t>(size_t(kWidth) * kDepth, 0);
+	uint64_t totalCount{0};
+};
+
+struct SketchCount {
+	std::string key;
+	uint64_t estimate{};
+};
+
+// Count-min sketch plus the keys with the highest estimates seen so far.
+class HeavyHitters {
+public:
+	static constexpr size_t kCandidates = 32;
+
+	void add(std::string_view key);
+	void merge(const HeavyHitters& other);
+	std::vector<SketchCount> top(size_t n) const; // highest estimates first
+	const CountMinSketch& counts() const { return sketch; }
+
+	std::string serialize() const;
+	bool deserialize(std::string_view data);
+
+private:
+	CountMinSketch sketch;
+	std::vector<SketchCount> candidates;
+
+	void offer(std::string_view key, uint64_t estimate);
+};
+
+// Everything kept per month (YYYY-MM) in analytics_sketches.
+struct MonthSketches {
+	HyperLogLog customers;
+	HyperLogLog vins;
+	HeavyHitters mechanics;   // total() is the month's record count
+	HeavyHitters keywords;    // description words, once per record
+
+	void add(std::string_view customer, std::string_view vin, std::string_view mechanic, std::string_view description);
+	void merge(const MonthSketches& other);
+};
+
+// Lower-cased words of three or more letters/digits, minus a few filler words, deduplicated
+std::vector<std::string> descriptionKeywords(std::string_view description);
+
+struct SketchSummary {
+	std::string fromMonth;
+	std::string toMonth;
+	int months{};                 // months with data in the range
+	uint64_t records{};           // exact
+	double distinctCustomers{};
+	double distinctVins{};
+	double distinctRelativeError{};  // one standard error of the two estimates above
+	std::vector<SketchCount> topMechanics;
+	std::vector<SketchCount> topKeywords;
+	uint64_t countErrorBound{};      // top-N estimates overcount by at most this...
+	double countConfidence{};        // ...with this probability
+};
+
+// Buffers sketch updates for the months a batch of inserts touches; flush() writes
+// them back. Both steps belong inside the caller's write transaction.
+class SketchWriter {
+public:
+	bool add(sqlite3* db, std::string_view serviceDate, std::string_view customer, std::string_view vin,
+		std::string_view mechanic, std::string_view description, std::string& error);
+	bool flush(sqlite3* db, std::string& error);
+
+private:
+	std::map<std::string, MonthSketches, std::less<>> months;
+};
+
+// Recomputes every month from service_records and the archive partitions (replaces analytics_sketches'
+// contents); partitions are read on their own connections, so this may run inside a write transaction
+bool rebuildSketches(sqlite3* db, std::string& error);
+// Merges the months in [fromMonth, toMonth] (YYYY-MM); cost depends on the number of months only
+bool readSketchSummary(sqlite3* db, const std::string& fromMonth, const std::string& toMonth, size_t topN,
+	SketchSummary& out, std::string& error);
+
+} // namespace vsrm
@@ -0,0 +1,143 @@
+#include "SummaryCache.h"
+
+#include "Database.h"
+
+#include <cctype>
+#include <ctime>
+
+namespace vsrm {
+
+namespace {
+
+std::string trimmed(const std::string& s) {
+	size_t b = 0, e = s.size();
+	while (b < e && std::isspace(static_cast<unsigned char>(s[b]))) ++b;
+	while (e > b && std::isspace(static_cast<unsigned char>(s[e - 1]))) --e;
+	return s.substr(b, e - b);
+}
+
+std::optional<std::string> trimmedOpt(const std::optional<std::string>& s) {
+	if (!s) return std::nullopt;
+	std::string t = trimmed(*s);
+	if (t.empty()) return std::nullopt;
+	return t;
+}
+
+// Same day as SQLite's date('now', 'localtime')
+std::string localDate() {
+	std::time_t t = std::time(nullptr);
+	std::tm local{};
+#ifdef _WIN32
+	localtime_s(&local, &t);
+#else
+	localtime_r(&t, &local);
+#endif
+	char buf[16];
+	std::strftime(buf, sizeof(buf), "%Y-%m-%d", &local);
+	return buf;
+}
+
+size_t heapBytes(const std::string& s) {
+	return s.capacity() > 15 ? s.capacity() + 1 : 0; // beyond the small-string buffer
+}
+
+constexpr size_t kEntryOverhead = 128; // list node, map node, shared_ptr control block
+
+size_t estimateBytes(const std::string& key, const std::vector<VehicleSummary>& rows) {
+	size_t bytes = kEntryOverhead + 2 * key.size() + rows.capacity() * sizeof(VehicleSummary);
+	for (const auto& v : rows) {
+		bytes += heapBytes(v.vin) + heapBytes(v.make) + heapBytes(v.model) + heapBytes(v.lastServiceDate) +
+			heapBytes(v.mechanic) + heapBytes(v.status) + (v.nextService ? heapBytes(*v.nextService) : 0);
+	}
+	return bytes;
+}
+
+} // namespace
+
+SummaryQuery SummaryQuery::normalized(const std::string& vinLike,
+                                      const std::optional<std::string>& fromDate,
+                                      const std::optional<std::string>& toDate,
+                                      const std::optional<std::string>& mechanicLike,
+                                      bool dueOnly) {
+	SummaryQuery q;
+	q.vinLike = trimmed(vinLike);
+	for (char& c : q.vinLike) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+	q.fromDate = trimmedOpt(fromDate);
+	q.toDate = trimmedOpt(toDate);
+	q.mechanicLike = trimmedOpt(mechanicLike);
+	if (q.mechanicLike) {
+		for (char& c : *q.mechanicLike) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	q.dueOnly = dueOnly;
+	q.today = localDate();
+	return q;
+}
+
+std::string SummaryQuery::key() const {
+	// Unit separator between fields; a leading marker tells "absent" from "empty"
+	std::string k = vinLike;
+	for (const auto* part : {&fromDate, &toDate, &mechanicLike}) {
+		k += '\x1f';
+		if (*part) { k += '+'; k += **part; } else { k += '-'; }
+	}
+	k += dueOnly ? "\x1f" "1" : "\x1f" "0";
+	k += '\x1f';
+	k += today;
+	return k;
+}
+
+SummaryCache::SummaryCache(size_t budgetBytes) {
+	counters.budgetBytes = budgetBytes;
+}
+
+std::shared_ptr<const std::vector<VehicleSummary>> SummaryCache::find(const SummaryQuery& query) {
+	auto it = index.find(query.key());
+	if (it == index.end()) { ++counters.misses; return nullptr; }
+	lru.splice(lru.begin(), lru, it->second);
+	++counters.hits;
+	return it->second->rows;
+}
+
+void SummaryCache::store(const SummaryQuery& query, std::vector<VehicleSummary> rows) {
+	std::string key = query.key();
+	size_t bytes = estimateBytes(key, rows);
+	if (auto it = index.find(key); it != index.end()) {
+		counters.bytes -= it->second->bytes;
+		lru.erase(it->second);
+		index.erase(it);
+	}
+	if (bytes > counters.budgetBytes) return; // would evict everything else; don't cache
+	lru.push_front(Entry{key, std::make_shared<const std::vector<VehicleSummary>>(std::move(rows)), bytes});
+	index.emplace(std::move(key), lru.begin());
+	counters.bytes += bytes;
+	evictToBudget();
+}
+
+void SummaryCache::invalidateAll() {
+	if (!lru.empty()) ++counters.invalidations;
+	lru.clear();
+	index.clear();
+	counters.bytes = 0;
+}
+
+void SummaryCache::setBudget(size_t bytes) {
+	counters.budgetBytes = bytes;
+	evictToBudget();
+}
+
+SummaryCacheStats SummaryCache::stats() const {
+	SummaryCacheStats s = counters;
+	s.entries = lru.size();
+	return s;
+}
+
+void SummaryCache::evictToBudget() {
+	while (counters.bytes > counters.budgetBytes && !lru.empty()) {
+		counters.bytes -= lru.back().bytes;
+		index.erase(lru.back().key);
+		lru.pop_back();
+		++counters.evictions;
+	}
+}
+
+} // namespace vsrm
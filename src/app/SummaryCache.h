@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vsrm {
+
+struct VehicleSummary;
+
+// Filter tuple of listVehicleSummaries after normalization (trimmed, empty
+// strings dropped, VIN upper-cased, mechanic lower-cased). LIKE is ASCII
+// case-insensitive, so normalization never changes the result set. The local
+// date is part of the key, so entries from before midnight are not reused.
+struct SummaryQuery {
+	std::string vinLike;
+	std::optional<std::string> fromDate;
+	std::optional<std::string> toDate;
+	std::optional<std::string> mechanicLike;
+	bool dueOnly{false};
+	std::string today; // local date; overdue and due-soon status are relative to it
+
+	static SummaryQuery normalized(const std::string& vinLike,
+	                               const std::optional<std::string>& fromDate,
+	                               const std::optional<std::string>& toDate,
+	                               const std::optional<std::string>& mechanicLike,
+	                               bool dueOnly);
+	std::string key() const;
+};
+
+struct SummaryCacheStats {
+	uint64_t hits{};
+	uint64_t misses{};
+	uint64_t evictions{};
+	uint64_t invalidations{};
+	size_t entries{};
+	size_t bytes{};
+	size_t budgetBytes{};
+
+	double hitRate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+};
+
+// LRU cache of vehicle summary result sets bounded by an approximate byte
+// budget. The owner decides when the underlying data changed and calls
+// invalidateAll(); see Database::listVehicleSummaries.
+class SummaryCache {
+public:
+	explicit SummaryCache(size_t budgetBytes = 8u << 20);
+
+	std::shared_ptr<const std::vector<VehicleSummary>> find(const SummaryQuery& query);
+	void store(const SummaryQuery& query, std::vector<VehicleSummary> rows);
+	void invalidateAll();
+
+	void setBudget(size_t bytes);
+	SummaryCacheStats stats() const;
+
+	// Generation the cached entries belong to (PRAGMA data_version + local change sequence)
+	int64_t dataVersion{-1};
+	uint64_t changeSequence{0};
+
+private:
+	struct Entry {
+		std::string key;
+		std::shared_ptr<const std::vector<VehicleSummary>> rows;
+		size_t bytes{};
+	};
+	void evictToBudget();
+
+	std::list<Entry> lru; // front = most recently used
+	std::unordered_map<std::string, std::list<Entry>::iterator> index;
+	SummaryCacheStats counters;
+};
+
+} // namespace vsrm
@@ -0,0 +1,313 @@
+#include "Thumbnail.h"
+
+#ifdef VSRM_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace vsrm {
+
+namespace {
+
+uint8_t byteAt(std::string_view s, size_t i) { return static_cast<uint8_t>(s[i]); }
+
+uint32_t be16(std::string_view s, size_t i) { return uint32_t(byteAt(s, i)) << 8 | byteAt(s, i + 1); }
+
+uint32_t be32(std::string_view s, size_t i) { return be16(s, i) << 16 | be16(s, i + 2); }
+
+// Bounds-checked reads in the TIFF structure of an EXIF block; ok turns false on overrun
+struct TiffReader {
+	std::string_view data;
+	bool little{};
+	bool ok{true};
+
+	uint32_t u16(size_t at) {
+		if (at + 2 > data.size()) { ok = false; return 0; }
+		return little ? uint32_t(byteAt(data, at)) | uint32_t(byteAt(data, at + 1)) << 8 : be16(data, at);
+	}
+	uint32_t u32(size_t at) {
+		if (at + 4 > data.size()) { ok = false; return 0; }
+		return little ? u16(at) | u16(at + 2) << 16 : be32(data, at);
+	}
+};
+
+// Frame size from the first SOF marker
+void jpegSize(std::string_view jpeg, int& width, int& height) {
+	size_t pos = 2;
+	while (pos + 9 <= jpeg.size() && byteAt(jpeg, pos) == 0xFF) {
+		uint8_t marker = byteAt(jpeg, pos + 1);
+		if (marker == 0xFF) { ++pos; continue; }
+		bool frame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+		if (frame) {
+			height = static_cast<int>(be16(jpeg, pos + 5));
+			width = static_cast<int>(be16(jpeg, pos + 7));
+			return;
+		}
+		if (marker == 0xDA) return;
+		pos += 2 + be16(jpeg, pos + 2);
+	}
+}
+
+// IFD1 of an EXIF TIFF block: JPEGInterchangeFormat (0x201) and its length (0x202)
+bool previewFromTiff(std::string_view tiff, ThumbnailImage& out) {
+	if (tiff.size() < 8) return false;
+	TiffReader r{tiff, tiff.substr(0, 2) == "II"};
+	if (!r.little && tiff.substr(0, 2) != "MM") return false;
+	uint32_t ifd0 = r.u32(4);
+	uint32_t ifd1 = r.u32(ifd0 + 2 + 12 * size_t(r.u16(ifd0)));
+	if (!r.ok || ifd1 == 0) return false;
+	uint32_t offset = 0, length = 0;
+	for (uint32_t i = 0, n = r.u16(ifd1); i < n && r.ok; ++i) {
+		size_t entry = ifd1 + 2 + 12 * size_t(i);
+		uint32_t tag = r.u16(entry), type = r.u16(entry + 2);
+		uint32_t value = type == 3 ? r.u16(entry + 8) : r.u32(entry + 8);
+		if (tag == 0x201) offset = value;
+		if (tag == 0x202) length = value;
+	}
+	if (!r.ok || !offset || length < 4 || size_t(offset) + length > tiff.size()) return false;
+	std::string_view preview = tiff.substr(offset, length);
+	if (byteAt(preview, 0) != 0xFF || byteAt(preview, 1) != 0xD8) return false;
+	out.mediaType = "image/jpeg";
+	out.data.assign(preview);
+	jpegSize(preview, out.width, out.height);
+	return true;
+}
+
+#ifdef VSRM_HAS_ZLIB
+
+struct PngHeader {
+	uint32_t width{}, height{};
+	int depth{}, colorType{}, interlace{};
+	int channels() const { return colorType == 2 ? 3 : colorType == 4 ? 2 : colorType == 6 ? 4 : 1; }
+};
+
+bool validHeader(const PngHeader& h) {
+	if (h.width == 0 || h.height == 0 || h.width > (1u << 20) || h.height > (1u << 20) || uint64_t(h.width) * h.height > 100000000)
+		return false;
+	switch (h.colorType) {
+	case 0: return h.depth == 1 || h.depth == 2 || h.depth == 4 || h.depth == 8 || h.depth == 16;
+	case 3: return h.depth == 1 || h.depth == 2 || h.depth == 4 || h.depth == 8;
+	case 2: case 4: case 6: return h.depth == 8 || h.depth == 16;
+	}
+	return false;
+}
+
+uint8_t paeth(int a, int b, int c) {
+	int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+	return static_cast<uint8_t>(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+bool unfilter(uint8_t type, uint8_t* row, const uint8_t* prev, size_t stride, size_t bpp) {
+	switch (type) {
+	case 0: return true;
+	case 1: for (size_t i = bpp; i < stride; ++i) row[i] = uint8_t(row[i] + row[i - bpp]); return true;
+	case 2: for (size_t i = 0; i < stride; ++i) row[i] = uint8_t(row[i] + prev[i]); return true;
+	case 3:
+		for (size_t i = 0; i < stride; ++i) row[i] = uint8_t(row[i] + ((i >= bpp ? row[i - bpp] : 0) + prev[i]) / 2);
+		return true;
+	case 4:
+		for (size_t i = 0; i < stride; ++i)
+			row[i] = uint8_t(row[i] + paeth(i >= bpp ? row[i - bpp] : 0, prev[i], i >= bpp ? prev[i - bpp] : 0));
+		return true;
+	}
+	return false;
+}
+
+// One unfiltered row to RGBA8 (16-bit samples keep their high byte; tRNS only for palettes)
+void expandRow(const PngHeader& h, const uint8_t* row, const std::string& palette, const std::string& alpha, uint8_t* rgba) {
+	const int channels = h.channels();
+	const uint32_t mask = (1u << std::min(h.depth, 8)) - 1;
+	auto sample = [&](uint32_t x, int c) -> uint32_t {
+		size_t index = size_t(x) * channels + c;
+		if (h.depth == 8) return row[index];
+		if (h.depth == 16) return row[index * 2];
+		size_t bit = index * h.depth;
+		return (row[bit / 8] >> (8 - h.depth - bit % 8)) & mask;
+	};
+	for (uint32_t x = 0; x < h.width; ++x, rgba += 4) {
+		switch (h.colorType) {
+		case 0: case 4: {
+			uint8_t g = static_cast<uint8_t>(sample(x, 0) * 255 / mask);
+			rgba[0] = rgba[1] = rgba[2] = g;
+			rgba[3] = h.colorType == 4 ? static_cast<uint8_t>(sample(x, 1)) : 255;
+			break;
+		}
+		case 3: {
+			uint32_t i = sample(x, 0);
+			bool known = 3 * i + 2 < palette.size();
+			for (int c = 0; c < 3; ++c) rgba[c] = known ? static_cast<uint8_t>(palette[3 * i + c]) : 0;
+			rgba[3] = i < alpha.size() ? static_cast<uint8_t>(alpha[i]) : 255;
+			break;
+		}
+		default:
+			for (int c = 0; c < 3; ++c) rgba[c] = static_cast<uint8_t>(sample(x, c));
+			rgba[3] = h.colorType == 6 ? static_cast<uint8_t>(sample(x, 3)) : 255;
+		}
+	}
+}
+
+void putBe32(std::string& out, uint32_t v) {
+	for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<char>(v >> shift));
+}
+
+void putChunk(std::string& out, const char* type, std::string_view data) {
+	putBe32(out, static_cast<uint32_t>(data.size()));
+	size_t start = out.size();
+	out.append(type, 4);
+	out.append(data);
+	uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(out.data() + start), static_cast<uInt>(out.size() - start));
+	putBe32(out, static_cast<uint32_t>(crc));
+}
+
+bool encodePng(uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba, std::string& out) {
+	std::string raw;
+	raw.reserve(size_t(height) * (width * 4 + 1));
+	for (uint32_t y = 0; y < height; ++y) {
+		raw.push_back(0); // filter: none
+		raw.append(reinterpret_cast<const char*>(rgba.data()) + size_t(y) * width * 4, size_t(width) * 4);
+	}
+	std::string packed(compressBound(static_cast<uLong>(raw.size())), '\0');
+	uLongf packedSize = static_cast<uLongf>(packed.size());
+	if (compress2(reinterpret_cast<Bytef*>(packed.data()), &packedSize, reinterpret_cast<const Bytef*>(raw.data()),
+			static_cast<uLong>(raw.size()), Z_BEST_COMPRESSION) != Z_OK)
+		return false;
+	packed.resize(packedSize);
+	std::string ihdr;
+	putBe32(ihdr, width);
+	putBe32(ihdr, height);
+	ihdr += std::string("\x08\x06\x00\x00\x00", 5); // 8-bit RGBA, deflate, adaptive filters, not interlaced
+	out.assign("\x89PNG\r\n\x1a\n", 8);
+	putChunk(out, "IHDR", ihdr);
+	putChunk(out, "IDAT", packed);
+	putChunk(out, "IEND", {});
+	return true;
+}
+
+#endif
+
+} // namespace
+
+std::string sniffMediaType(std::string_view head) {
+	auto starts = [&](std::string_view magic, size_t at = 0) { return head.size() >= at + magic.size() && head.substr(at, magic.size()) == magic; };
+	if (starts("\x89PNG\r\n\x1a\n")) return "image/png";
+	if (starts("\xFF\xD8\xFF")) return "image/jpeg";
+	if (starts("%PDF-")) return "application/pdf";
+	if (starts("GIF87a") || starts("GIF89a")) return "image/gif";
+	if (starts("RIFF") && starts("WEBP", 8)) return "image/webp";
+	if (starts(std::string_view("II*\0", 4)) || starts(std::string_view("MM\0*", 4))) return "image/tiff";
+	if (starts("ftypheic", 4) || starts("ftypheix", 4) || starts("ftypmif1", 4)) return "image/heic";
+	return "application/octet-stream";
+}
+
+bool exifThumbnail(std::string_view jpeg, ThumbnailImage& out) {
+	out = {};
+	if (jpeg.size() < 4 || byteAt(jpeg, 0) != 0xFF || byteAt(jpeg, 1) != 0xD8) return false;
+	size_t pos = 2;
+	while (pos + 4 <= jpeg.size()) {
+		if (byteAt(jpeg, pos) != 0xFF) return false;
+		uint8_t marker = byteAt(jpeg, pos + 1);
+		if (marker == 0xFF) { ++pos; continue; } // fill byte
+		if (marker == 0xDA || marker == 0xD9) return false; // image data: EXIF comes before it
+		size_t length = be16(jpeg, pos + 2);
+		if (length < 2) return false;
+		if (marker == 0xE1 && length >= 8 && jpeg.substr(pos + 4, 6) == std::string_view("Exif\0\0", 6)) {
+			size_t start = pos + 10, end = std::min(jpeg.size(), pos + 2 + length);
+			if (start < end && previewFromTiff(jpeg.substr(start, end - start), out)) return true;
+		}
+		pos += 2 + length;
+	}
+	return false;
+}
+
+bool pngThumbnail(std::string_view png, int maxEdge, ThumbnailImage& out) {
+	out = {};
+#ifndef VSRM_HAS_ZLIB
+	(void)png; (void)maxEdge;
+	return false;
+#else
+	if (maxEdge <= 0 || png.size() < 8 || png.substr(0, 8) != std::string_view("\x89PNG\r\n\x1a\n", 8)) return false;
+	PngHeader h;
+	std::string palette, alpha;
+	std::vector<std::string_view> idat;
+	for (size_t pos = 8; pos + 12 <= png.size();) {
+		uint32_t length = be32(png, pos);
+		if (length > png.size() - pos - 12) return false;
+		std::string_view type = png.substr(pos + 4, 4), data = png.substr(pos + 8, length);
+		if (type == "IHDR" && length >= 13) {
+			h.width = be32(data, 0);
+			h.height = be32(data, 4);
+			h.depth = byteAt(data, 8);
+			h.colorType = byteAt(data, 9);
+			h.interlace = byteAt(data, 12);
+		} else if (type == "PLTE") {
+			palette.assign(data);
+		} else if (type == "tRNS") {
+			alpha.assign(data);
+		} else if (type == "IDAT") {
+			idat.push_back(data);
+		} else if (type == "IEND") {
+			break;
+		}
+		pos += 12 + length;
+	}
+	if (!validHeader(h) || h.interlace != 0 || idat.empty()) return false;
+
+	const size_t bitsPerPixel = size_t(h.channels()) * h.depth;
+	const size_t stride = (size_t(h.width) * bitsPerPixel + 7) / 8, bpp = std::max<size_t>(1, bitsPerPixel / 8);
+	const uint32_t longest = std::max(h.width, h.height), edge = static_cast<uint32_t>(maxEdge);
+	const uint32_t dstW = longest <= edge ? h.width : std::max<uint32_t>(1, uint32_t(uint64_t(h.width) * edge / longest));
+	const uint32_t dstH = longest <= edge ? h.height : std::max<uint32_t>(1, uint32_t(uint64_t(h.height) * edge / longest));
+	std::vector<uint64_t> sums(size_t(dstW) * dstH * 4), counts(size_t(dstW) * dstH);
+	std::vector<uint8_t> row(stride + 1), prev(stride + 1), rgba(size_t(h.width) * 4);
+	std::vector<uint32_t> column(h.width);
+	for (uint32_t x = 0; x < h.width; ++x) column[x] = uint32_t(uint64_t(x) * dstW / h.width);
+
+	// Inflate a row at a time across the IDAT chunks, so a large scan is never held decoded
+	z_stream z{};
+	if (inflateInit(&z) != Z_OK) return false;
+	size_t nextChunk = 0;
+	bool ok = true;
+	for (uint32_t y = 0; y < h.height && ok; ++y) {
+		z.next_out = row.data();
+		z.avail_out = static_cast<uInt>(row.size());
+		while (z.avail_out > 0 && ok) {
+			if (z.avail_in == 0) {
+				if (nextChunk == idat.size()) { ok = false; break; }
+				z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(idat[nextChunk].data()));
+				z.avail_in = static_cast<uInt>(idat[nextChunk].size());
+				++nextChunk;
+			}
+			int rc = inflate(&z, Z_NO_FLUSH);
+			if (rc == Z_STREAM_END) { ok = z.avail_out == 0; break; }
+			if (rc != Z_OK && rc != Z_BUF_ERROR) ok = false;
+		}
+		ok = ok && unfilter(row[0], row.data() + 1, prev.data() + 1, stride, bpp);
+		if (!ok) break;
+		expandRow(h, row.data() + 1, palette, alpha, rgba.data());
+		const size_t dy = size_t(uint64_t(y) * dstH / h.height) * dstW;
+		for (uint32_t x = 0; x < h.width; ++x) {
+			size_t cell = dy + column[x];
+			for (int c = 0; c < 4; ++c) sums[cell * 4 + c] += rgba[size_t(x) * 4 + c];
+			++counts[cell];
+		}
+		row.swap(prev);
+	}
+	inflateEnd(&z);
+	if (!ok) return false;
+
+	std::vector<uint8_t> scaled(sums.size());
+	for (size_t cell = 0; cell < counts.size(); ++cell)
+		for (int c = 0; c < 4; ++c) scaled[cell * 4 + c] = counts[cell] ? uint8_t(sums[cell * 4 + c] / counts[cell]) : 0;
+	if (!encodePng(dstW, dstH, scaled, out.data)) return false;
+	out.mediaType = "image/png";
+	out.width = static_cast<int>(dstW);
+	out.height = static_cast<int>(dstH);
+	return true;
+#endif
+}
+
+} // namespace vsrm
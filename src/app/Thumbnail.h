@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace vsrm {
+
+// Thumbnails without an image library.
+//
+// Phone and camera JPEGs carry a small JPEG preview in their EXIF block (IFD1); it is returned
+// as is, whatever its size, so only the first kJpegPreviewScan bytes of a photo are ever read.
+// PNG scans and screenshots are decoded row by row (bit depths 1-16, every colour type, not
+// interlaced), box-filtered to fit maxEdge and re-encoded as RGBA PNG. Anything else has none.
+
+constexpr size_t kJpegPreviewScan = 128 * 1024; // SOI, APP0 and a 64 KB APP1 fit easily
+constexpr size_t kMaxPngThumbnailSource = 64u << 20;
+
+struct ThumbnailImage {
+	std::string mediaType; // "image/jpeg" or "image/png"; empty when there is no thumbnail
+	std::string data;
+	int width{};
+	int height{};
+};
+
+// Media type from a file's first bytes (16 are enough); "application/octet-stream" if unknown
+std::string sniffMediaType(std::string_view head);
+
+// The EXIF preview of a JPEG, given at least its first kJpegPreviewScan bytes
+bool exifThumbnail(std::string_view jpegPrefix, ThumbnailImage& out);
+
+// A PNG scaled to fit maxEdge (never enlarged). False if undecodable or built without zlib.
+bool pngThumbnail(std::string_view png, int maxEdge, ThumbnailImage& out);
+
+} // namespace vsrm
@@ -0,0 +1,205 @@
+#include "Timeline.h"
+
+#include "Archive.h"
+
+#ifdef VSRM_HAS_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <queue>
+
+namespace vsrm {
+
+#ifdef VSRM_HAS_SQLITE3
+
+namespace {
+
+// ?1 vin, ?2/?3 resume point (at, id bound), ?4 limit
+const char* const kSourceSql[] = {
+	"SELECT id, service_date, vsrm_text(description), mechanic FROM service_records "
+	"WHERE vin = ?1 AND (service_date < ?2 OR (service_date = ?2 AND id < ?3)) "
+	"ORDER BY service_date DESC, id DESC LIMIT ?4;",
+	"SELECT id, scheduled_at, status, customer_name FROM appointments "
+	"WHERE vin = ?1 AND (scheduled_at < ?2 OR (scheduled_at = ?2 AND id < ?3)) "
+	"ORDER BY scheduled_at DESC, id DESC LIMIT ?4;",
+	"SELECT s.id, s.assigned_at, m.name, s.completed_at FROM appointments a "
+	"JOIN assignments s ON s.appointment_id = a.id LEFT JOIN mechanics m ON m.id = s.mechanic_id "
+	"WHERE a.vin = ?1 AND (s.assigned_at < ?2 OR (s.assigned_at = ?2 AND s.id < ?3)) "
+	"ORDER BY s.assigned_at DESC, s.id DESC LIMIT ?4;",
+};
+
+struct Cursor {
+	std::string at{"~"}; // sorts after any ISO timestamp, so the first page starts at the newest event
+	int kind{-1};
+	int64_t id{0};
+};
+
+std::optional<Cursor> parseCursor(const std::string& text) {
+	size_t a = text.find('|');
+	if (a == std::string::npos) return std::nullopt;
+	size_t b = text.find('|', a + 1);
+	if (b == std::string::npos) return std::nullopt;
+	Cursor c;
+	c.at = text.substr(0, a);
+	try {
+		c.kind = std::stoi(text.substr(a + 1, b - a - 1));
+		c.id = std::stoll(text.substr(b + 1));
+	} catch (...) {
+		return std::nullopt;
+	}
+	if (c.kind < 0 || c.kind > 2) return std::nullopt;
+	return c;
+}
+
+std::string makeCursor(const TimelineEvent& e) {
+	return e.at + '|' + std::to_string(static_cast<int>(e.kind)) + '|' + std::to_string(e.id);
+}
+
+std::string text(sqlite3_stmt* stmt, int col) {
+	const unsigned char* t = sqlite3_column_text(stmt, col);
+	return t ? reinterpret_cast<const char*>(t) : std::string();
+}
+
+struct Stream {
+	sqlite3_stmt* stmt{nullptr};
+	TimelineKind kind{};
+	const std::string* vin{nullptr};
+	TimelineEvent head;
+	std::vector<TimelineEvent> buffered; // read up front instead of by stmt, newest first
+	size_t nextBuffered{0};
+
+	bool next() {
+		if (!stmt) {
+			if (nextBuffered == buffered.size()) return false;
+			head = std::move(buffered[nextBuffered++]);
+			return true;
+		}
+		if (sqlite3_step(stmt) != SQLITE_ROW) return false;
+		head.kind = kind;
+		head.vin = *vin;
+		head.id = sqlite3_column_int(stmt, 0);
+		head.at = text(stmt, 1);
+		switch (kind) {
+		case TimelineKind::Service:
+			head.title = text(stmt, 2);
+			head.detail = text(stmt, 3);
+			break;
+		case TimelineKind::Appointment:
+			head.title = "Appointment (" + text(stmt, 2) + ")";
+			head.detail = text(stmt, 3);
+			break;
+		case TimelineKind::Assignment:
+			head.title = "Assigned to " + (sqlite3_column_type(stmt, 2) == SQLITE_NULL ? std::string("unknown mechanic") : text(stmt, 2));
+			head.detail = sqlite3_column_type(stmt, 3) == SQLITE_NULL ? std::string("open") : "completed " + text(stmt, 3);
+			break;
+		}
+		return true;
+	}
+};
+
+// True if a comes after b in timeline order (at DESC, kind ASC, id DESC)
+bool later(const TimelineEvent& a, const TimelineEvent& b) {
+	if (a.at != b.at) return a.at < b.at;
+	if (a.kind != b.kind) return a.kind > b.kind;
+	return a.id < b.id;
+}
+
+// The VIN's archived service records past the resume point, newest first, at most limit. A
+// partition is attached for one statement at a time, so this runs before any stream is open.
+bool readArchivedServices(sqlite3* db, const std::string& vin, const std::string& at, int64_t idBound, size_t limit,
+	std::vector<TimelineEvent>& out, std::string& error) {
+	out.clear();
+	bool ok = scanArchivedRecords(db, vin, [&](sqlite3_stmt* stmt) {
+		TimelineEvent e;
+		e.at = text(stmt, 3);
+		e.id = sqlite3_column_int(stmt, 0);
+		if (e.at > at || (e.at == at && e.id >= idBound)) return true;
+		e.kind = TimelineKind::Service;
+		e.vin = vin;
+		e.title = text(stmt, 4);
+		e.detail = text(stmt, 5);
+		out.push_back(std::move(e));
+		return true;
+	}, error);
+	if (!ok) return false;
+	std::sort(out.begin(), out.end(), [](const TimelineEvent& a, const TimelineEvent& b) { return later(b, a); });
+	if (out.size() > limit) out.resize(limit);
+	return true;
+}
+
+} // namespace
+
+bool readTimeline(sqlite3* db, const std::vector<std::string>& vins, size_t limit,
+	const std::optional<std::string>& cursor, TimelinePage& page, std::string& error) {
+	page = TimelinePage{};
+	Cursor from;
+	if (cursor) {
+		auto parsed = parseCursor(*cursor);
+		if (!parsed) { error = "Invalid timeline cursor"; return false; }
+		from = *parsed;
+	}
+	if (limit == 0 || vins.empty()) return true;
+
+	std::vector<Stream> streams;
+	streams.reserve(vins.size() * 4);
+	for (const auto& vin : vins) {
+		Stream s;
+		s.kind = TimelineKind::Service;
+		s.vin = &vin;
+		int64_t idBound = from.kind > 0 ? std::numeric_limits<int64_t>::min() : from.kind < 0 ? std::numeric_limits<int64_t>::max() : from.id;
+		if (!readArchivedServices(db, vin, from.at, idBound, limit + 1, s.buffered, error)) return false;
+		if (!s.buffered.empty()) streams.push_back(std::move(s));
+	}
+	auto finalizeAll = [&] { for (auto& s : streams) sqlite3_finalize(s.stmt); };
+	for (const auto& vin : vins) {
+		for (int k = 0; k < 3; ++k) {
+			Stream s;
+			s.kind = static_cast<TimelineKind>(k);
+			s.vin = &vin;
+			if (sqlite3_prepare_v2(db, kSourceSql[k], -1, &s.stmt, nullptr) != SQLITE_OK) {
+				error = sqlite3_errmsg(db);
+				finalizeAll();
+				return false;
+			}
+			// Resume strictly after the cursor: a kind sorting after the cursor's may repeat its
+			// timestamp with any id, one sorting before it may not repeat it at all
+			int64_t idBound = k > from.kind ? std::numeric_limits<int64_t>::max()
+				: k < from.kind ? std::numeric_limits<int64_t>::min() : from.id;
+			sqlite3_bind_text(s.stmt, 1, vin.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(s.stmt, 2, from.at.c_str(), -1, SQLITE_TRANSIENT);
+			sqlite3_bind_int64(s.stmt, 3, idBound);
+			sqlite3_bind_int64(s.stmt, 4, static_cast<sqlite3_int64>(limit) + 1); // +1: tells whether another page exists
+			streams.push_back(std::move(s));
+		}
+	}
+
+	auto cmp = [&](size_t a, size_t b) { return later(streams[a].head, streams[b].head); };
+	std::priority_queue<size_t, std::vector<size_t>, decltype(cmp)> heap(cmp);
+	for (size_t i = 0; i < streams.size(); ++i) if (streams[i].next()) heap.push(i);
+
+	page.events.reserve(limit);
+	while (!heap.empty() && page.events.size() < limit) {
+		size_t i = heap.top();
+		heap.pop();
+		page.events.push_back(streams[i].head);
+		if (streams[i].next()) heap.push(i);
+	}
+	if (!heap.empty() && !page.events.empty()) page.nextCursor = makeCursor(page.events.back());
+	finalizeAll();
+	return true;
+}
+
+#else
+
+bool readTimeline(sqlite3*, const std::vector<std::string>&, size_t, const std::optional<std::string>&, TimelinePage& page, std::string& error) {
+	page = TimelinePage{};
+	error = "SQLite not available.";
+	return false;
+}
+
+#endif
+
+} // namespace vsrm
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+namespace vsrm {
+
+// Order among events with the same timestamp
+enum class TimelineKind { Service = 0, Appointment = 1, Assignment = 2 };
+
+struct TimelineEvent {
+	TimelineKind kind{};
+	int id{};            // row id in the kind's table
+	std::string vin;
+	std::string at;      // service_date / scheduled_at / assigned_at
+	std::string title;   // description, "Appointment (status)", "Assigned to <mechanic>"
+	std::string detail;  // mechanic, customer, completion
+};
+
+struct TimelinePage {
+	std::vector<TimelineEvent> events; // newest first
+	std::optional<std::string> nextCursor; // pass back for the following page; nullopt at the end
+};
+
+// Merges service records, appointments and assignments of the given VINs newest-first.
+// Each (VIN, source) pair is one statement already ordered by its index, read only as far
+// as the page needs; a heap interleaves them, so nothing is loaded in full or re-sorted. A
+// VIN's archived service records (see Archive.h) are the exception: read up front from the
+// partitions its filter admits and sorted, which is cheap for one vehicle's history.
+// Events are ordered by (at DESC, kind, id DESC); the cursor encodes the last one returned.
+bool readTimeline(sqlite3* db, const std::vector<std::string>& vins, size_t limit,
+	const std::optional<std::string>& cursor, TimelinePage& page, std::string& error);
+
+} // namespace vsrm
@@ -0,0 +1,173 @@
+#include "Utf.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VSRM_UTF_SSE2 1
+#endif
+
+namespace vsrm {
+
+namespace {
+
+constexpr char16_t kReplacement = 0xFFFD;
+constexpr uint64_t kHighBits = 0x8080808080808080ull;
+
+// Copies the leading ASCII run of src into dst and returns its length.
+size_t widenAscii(const unsigned char* src, size_t len, char16_t* dst) {
+	size_t i = 0;
+#ifdef VSRM_UTF_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	while (i + 16 <= len) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		if (_mm_movemask_epi8(v) != 0) break;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+		i += 16;
+	}
+#endif
+	while (i + 8 <= len) {
+		uint64_t word;
+		std::memcpy(&word, src + i, sizeof(word));
+		if (word & kHighBits) break;
+		for (size_t k = 0; k < 8; ++k) dst[i + k] = src[i + k];
+		i += 8;
+	}
+	while (i < len && src[i] < 0x80) { dst[i] = src[i]; ++i; }
+	return i;
+}
+
+// Narrows the leading ASCII run of src into dst and returns its length.
+size_t narrowAscii(const char16_t* src, size_t len, char* dst) {
+	size_t i = 0;
+#ifdef VSRM_UTF_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+	while (i + 16 <= len) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+		__m128i high = _mm_and_si128(_mm_or_si128(a, b), nonAscii);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF) break;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+		i += 16;
+	}
+#endif
+	while (i < len && src[i] < 0x80) { dst[i] = static_cast<char>(src[i]); ++i; }
+	return i;
+}
+
+} // namespace
+
+size_t utf8ToUtf16(const char* src, size_t len, char16_t* dst) {
+	const auto* s = reinterpret_cast<const unsigned char*>(src);
+	size_t i = 0, o = 0;
+	while (i < len) {
+		size_t run = widenAscii(s + i, len - i, dst + o);
+		i += run; o += run;
+		if (i >= len) break;
+
+		unsigned char c = s[i];
+		uint32_t cp = 0;
+		size_t need = 0;
+		unsigned char lo = 0x80, hi = 0xBF; // valid range of the first continuation byte
+		if (c >= 0xC2 && c <= 0xDF) { need = 1; cp = c & 0x1F; }
+		else if (c >= 0xE0 && c <= 0xEF) {
+			need = 2; cp = c & 0x0F;
+			if (c == 0xE0) lo = 0xA0;       // overlong
+			else if (c == 0xED) hi = 0x9F;  // surrogate range
+		}
+		else if (c >= 0xF0 && c <= 0xF4) {
+			need = 3; cp = c & 0x07;
+			if (c == 0xF0) lo = 0x90;       // overlong
+			else if (c == 0xF4) hi = 0x8F;  // above U+10FFFF
+		}
+		else { dst[o++] = kReplacement; ++i; continue; }
+
+		bool ok = len - i > need;
+		for (size_t k = 1; ok && k <= need; ++k) {
+			unsigned char b = s[i + k];
+			if (k == 1 ? (b < lo || b > hi) : (b & 0xC0) != 0x80) ok = false;
+			else cp = (cp << 6) | (b & 0x3F);
+		}
+		if (!ok) { dst[o++] = kReplacement; ++i; continue; }
+
+		if (cp >= 0x10000) {
+			cp -= 0x10000;
+			dst[o++] = static_cast<char16_t>(0xD800 + (cp >> 10));
+			dst[o++] = static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+		} else {
+			dst[o++] = static_cast<char16_t>(cp);
+		}
+		i += need + 1;
+	}
+	return o;
+}
+
+size_t utf16ToUtf8(const char16_t* src, size_t len, char* dst) {
+	size_t i = 0, o = 0;
+	while (i < len) {
+		size_t run = narrowAscii(src + i, len - i, dst + o);
+		i += run; o += run;
+		if (i >= len) break;
+
+		uint32_t cp = src[i++];
+		if (cp >= 0xD800 && cp <= 0xDFFF) {
+			if (cp <= 0xDBFF && i < len && src[i] >= 0xDC00 && src[i] <= 0xDFFF) {
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (src[i++] - 0xDC00);
+			} else {
+				cp = kReplacement; // unpaired surrogate
+			}
+		}
+		if (cp < 0x80) {
+			dst[o++] = static_cast<char>(cp);
+		} else if (cp < 0x800) {
+			dst[o++] = static_cast<char>(0xC0 | (cp >> 6));
+			dst[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+		} else if (cp < 0x10000) {
+			dst[o++] = static_cast<char>(0xE0 | (cp >> 12));
+			dst[o++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			dst[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+		} else {
+			dst[o++] = static_cast<char>(0xF0 | (cp >> 18));
+			dst[o++] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			dst[o++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			dst[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+		}
+	}
+	return o;
+}
+
+std::u16string toUtf16(std::string_view in) {
+	std::u16string out(in.size(), u'\0');
+	out.resize(utf8ToUtf16(in.data(), in.size(), out.data()));
+	return out;
+}
+
+std::string toUtf8(std::u16string_view in) {
+	std::string out(in.size() * 3, '\0');
+	out.resize(utf16ToUtf8(in.data(), in.size(), out.data()));
+	return out;
+}
+
+void Utf16Arena::clear() {
+	offsets.clear();
+	used = 0;
+}
+
+void Utf16Arena::reserve(size_t codeUnits, size_t strings) {
+	if (buffer.size() < codeUnits) buffer.resize(codeUnits);
+	offsets.reserve(strings);
+}
+
+size_t Utf16Arena::add(std::string_view utf8) {
+	size_t needed = used + utf8.size() + 1;
+	if (buffer.size() < needed) buffer.resize(needed > buffer.size() * 2 ? needed : buffer.size() * 2);
+	offsets.push_back(used);
+	used += utf8ToUtf16(utf8.data(), utf8.size(), buffer.data() + used);
+	buffer[used++] = u'\0';
+	return offsets.size() - 1;
+}
+
+} // namespace vsrm
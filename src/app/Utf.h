@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vsrm {
+
+// UTF-8 <-> UTF-16 transcoding for the UI boundary. Malformed input is replaced
+// with U+FFFD instead of being rejected, so one bad byte never blanks a cell.
+// ASCII runs take a SIMD (SSE2) or 8-byte SWAR fast path.
+
+// Writes the UTF-16 form of [src, src+len) to dst and returns the number of
+// code units written. dst must hold at least `len` units (never exceeded).
+size_t utf8ToUtf16(const char* src, size_t len, char16_t* dst);
+
+// Writes the UTF-8 form of [src, src+len) to dst and returns the number of
+// bytes written. dst must hold at least `3 * len` bytes.
+size_t utf16ToUtf8(const char16_t* src, size_t len, char* dst);
+
+std::u16string toUtf16(std::string_view in);
+std::string toUtf8(std::u16string_view in);
+
+// Packs many UTF-8 strings into one contiguous, NUL-separated UTF-16 buffer so
+// a whole result set is converted with a single allocation. Pointers returned
+// by at() stay valid until the next add()/clear().
+class Utf16Arena {
+public:
+	void clear();
+	void reserve(size_t codeUnits, size_t strings);
+
+	// Appends one string and returns its index.
+	size_t add(std::string_view utf8);
+
+	const char16_t* at(size_t index) const { return buffer.data() + offsets[index]; }
+	size_t size() const { return offsets.size(); }
+	size_t codeUnits() const { return used; }
+
+private:
+	std::u16string buffer;
+	std::vector<size_t> offsets;
+	size_t used{0};
+};
+
+} // namespace vsrm
@@ -0,0 +1,214 @@
+#include "VinDecoder.h"
+
+#include "Dates.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace vsrm {
+
+namespace {
+
+// World manufacturer identifiers (VIN positions 1-3)
+struct WmiEntry {
+	std::string_view code;
+	std::string_view make;
+	std::string_view country;
+};
+
+constexpr WmiEntry kWmis[] = {
+	{"JT2", "Toyota", "Japan"}, {"JT3", "Toyota", "Japan"}, {"JT4", "Toyota", "Japan"}, {"JT5", "Toyota", "Japan"},
+	{"JTD", "Toyota", "Japan"}, {"JTE", "Toyota", "Japan"}, {"JTK", "Scion", "Japan"}, {"JTL", "Scion", "Japan"},
+	{"JTM", "Toyota", "Japan"}, {"JTN", "Toyota", "Japan"},
+	{"JT6", "Lexus", "Japan"}, {"JT8", "Lexus", "Japan"}, {"JTH", "Lexus", "Japan"}, {"JTJ", "Lexus", "Japan"},
+	{"1NX", "Toyota", "United States"}, {"4T1", "Toyota", "United States"}, {"4T3", "Toyota", "United States"},
+	{"4T4", "Toyota", "United States"}, {"5TB", "Toyota", "United States"}, {"5TD", "Toyota", "United States"},
+	{"5TE", "Toyota", "United States"}, {"5TF", "Toyota", "United States"}, {"5YF", "Toyota", "United States"},
+	{"58A", "Lexus", "United States"},
+	{"2T1", "Toyota", "Canada"}, {"2T3", "Toyota", "Canada"}, {"2T2", "Lexus", "Canada"},
+	{"3TM", "Toyota", "Mexico"}, {"3TY", "Toyota", "Mexico"},
+	{"AHT", "Toyota", "South Africa"}, {"6T1", "Toyota", "Australia"}, {"MR0", "Toyota", "Thailand"},
+	{"MR1", "Toyota", "Thailand"}, {"MR2", "Toyota", "Thailand"}, {"NMT", "Toyota", "Turkey"},
+	{"SB1", "Toyota", "United Kingdom"}, {"VNK", "Toyota", "France"},
+	{"JHH", "Hino", "Japan"}, {"JHF", "Hino", "Japan"}, {"5PV", "Hino", "United States"}, {"2AY", "Hino", "Canada"},
+};
+
+// Model by WMI + the first two VDS characters (positions 1-5)
+struct ModelEntry {
+	std::string_view code;
+	std::string_view model;
+};
+
+constexpr ModelEntry kModels[] = {
+	{"4T1BF", "Camry"}, {"4T1B1", "Camry"}, {"4T1BD", "Camry Hybrid"}, {"4T1G1", "Camry"}, {"4T1C1", "Camry"},
+	{"4T1BK", "Avalon"}, {"4T1BZ", "Avalon"},
+	{"2T1BU", "Corolla"}, {"2T1BR", "Corolla"}, {"2T1KR", "Matrix"}, {"5YFBU", "Corolla"}, {"5YFBR", "Corolla"},
+	{"5YFEP", "Corolla"}, {"JTDEP", "Corolla Hatchback"}, {"JTDKB", "Prius"}, {"JTDKN", "Prius"},
+	{"JTDKA", "Prius"}, {"JTDKD", "Prius c"}, {"JTDZN", "Prius v"}, {"JTDBT", "Yaris"}, {"JTDKT", "Yaris"},
+	{"2T3ZF", "RAV4"}, {"2T3BF", "RAV4"}, {"2T3WF", "RAV4"}, {"2T3W1", "RAV4"}, {"2T3P1", "RAV4"},
+	{"2T3RF", "RAV4"}, {"JTMBF", "RAV4"}, {"JTMZF", "RAV4"}, {"JTMRF", "RAV4 Hybrid"}, {"JTMW1", "RAV4"},
+	{"5TDZA", "Highlander"}, {"5TDBZ", "Highlander"}, {"5TDJZ", "Highlander"}, {"5TDGZ", "Highlander"},
+	{"5TDKK", "Sienna"}, {"5TDYK", "Sienna"}, {"5TDZK", "Sienna"}, {"5TDJK", "Sienna"},
+	{"5TFDW", "Tundra"}, {"5TFUY", "Tundra"}, {"5TFEY", "Tundra"}, {"5TFBW", "Tundra"}, {"5TFDY", "Tundra"},
+	{"5TFAX", "Tacoma"}, {"5TFCZ", "Tacoma"}, {"5TENX", "Tacoma"}, {"5TETX", "Tacoma"}, {"3TMCZ", "Tacoma"},
+	{"3TMAZ", "Tacoma"}, {"JTEBU", "4Runner"}, {"JTEZU", "4Runner"}, {"JTMHV", "Land Cruiser"},
+	{"JTJBM", "RX"}, {"JTJZK", "RX"}, {"2T2BZ", "RX"}, {"2T2ZZ", "RX"}, {"JTJBA", "NX"}, {"JTJYA", "NX"},
+	{"JTJHY", "LX"}, {"JTHBK", "ES"}, {"58ABZ", "ES"}, {"58ADZ", "ES"}, {"JTHBF", "IS"}, {"JTHBA", "IS"},
+	{"JTHCE", "GS"}, {"JTHBE", "GS"},
+};
+
+// Perfect hashing built at compile time: tries seeds until every key lands in its
+// own slot, so a lookup is one multiply, one slot read and one key compare.
+constexpr uint64_t packKey(std::string_view code) {
+	uint64_t k = 0;
+	for (char c : code) k = k << 8 | static_cast<unsigned char>(c);
+	return k;
+}
+
+constexpr uint32_t slotOf(uint64_t key, uint64_t seed, uint32_t mask) {
+	uint64_t x = (key ^ seed) * 0x9E3779B97F4A7C15ull;
+	return static_cast<uint32_t>(x >> 40) & mask;
+}
+
+template <size_t Size>
+struct PerfectTable {
+	uint64_t seed{0};
+	std::array<int16_t, Size> slots{};
+};
+
+template <size_t Size, class Entry, size_t N>
+constexpr PerfectTable<Size> buildTable(const Entry (&entries)[N]) {
+	static_assert((Size & (Size - 1)) == 0 && Size >= 2 * N);
+	PerfectTable<Size> t;
+	for (uint64_t seed = 1; seed < 100000; ++seed) {
+		for (auto& s : t.slots) s = -1;
+		bool ok = true;
+		for (size_t i = 0; i < N && ok; ++i) {
+			int16_t& s = t.slots[slotOf(packKey(entries[i].code), seed, Size - 1)];
+			if (s >= 0) ok = false;
+			else s = static_cast<int16_t>(i);
+		}
+		if (ok) { t.seed = seed; return t; }
+	}
+	return t;
+}
+
+constexpr auto kWmiTable = buildTable<256>(kWmis);
+constexpr auto kModelTable = buildTable<512>(kModels);
+static_assert(kWmiTable.seed != 0, "no perfect hash seed for the WMI table");
+static_assert(kModelTable.seed != 0, "no perfect hash seed for the model table");
+
+template <size_t Size, class Entry, size_t N>
+const Entry* lookup(const PerfectTable<Size>& table, const Entry (&entries)[N], std::string_view code) {
+	int16_t s = table.slots[slotOf(packKey(code), table.seed, Size - 1)];
+	return s >= 0 && entries[s].code == code ? &entries[s] : nullptr;
+}
+
+// Transliteration (ISO 3779): digit and letter values; -1 for I, O, Q, lower case and punctuation
+constexpr std::array<int8_t, 128> kValues = [] {
+	std::array<int8_t, 128> v{};
+	for (auto& x : v) x = -1;
+	for (char c = '0'; c <= '9'; ++c) v[c] = static_cast<int8_t>(c - '0');
+	const char* letters = "ABCDEFGHJKLMNPRSTUVWXYZ";
+	const int8_t values[] = {1, 2, 3, 4, 5, 6, 7, 8, 1, 2, 3, 4, 5, 7, 9, 2, 3, 4, 5, 6, 7, 8, 9};
+	for (int i = 0; letters[i]; ++i) v[static_cast<unsigned char>(letters[i])] = values[i];
+	return v;
+}();
+constexpr int kWeights[17] = {8, 7, 6, 5, 4, 3, 2, 10, 0, 9, 8, 7, 6, 5, 4, 3, 2};
+
+int valueOf(char c) {
+	unsigned char u = static_cast<unsigned char>(c);
+	return u < 128 ? kValues[u] : -1;
+}
+
+std::string_view regionOf(char c) {
+	if (c >= '1' && c <= '5') return "North America";
+	if (c >= '6' && c <= '7') return "Oceania";
+	if (c >= '8' && c <= '9') return "South America";
+	if (c >= 'A' && c <= 'H') return "Africa";
+	if (c >= 'J' && c <= 'R') return "Asia";
+	if (c >= 'S' && c <= 'Z') return "Europe";
+	return "";
+}
+
+// Position 10 cycles every 30 years (A = 1980/2010, ..., Y = 2000/2030, 1-9 = 2001-2009/2031-2039)
+int baseYear(char c) {
+	constexpr std::string_view kCodes = "ABCDEFGHJKLMNPRSTVWXY123456789";
+	size_t i = kCodes.find(c);
+	return i == std::string_view::npos ? 0 : 1980 + static_cast<int>(i);
+}
+
+int currentYear() {
+	static const int year = [] {
+		auto days = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now()).time_since_epoch().count();
+		return std::stoi(minutesToIso(static_cast<int64_t>(days) * 1440).substr(0, 4));
+	}();
+	return year;
+}
+
+} // namespace
+
+char vinCheckDigit(std::string_view vin) {
+	if (vin.size() != 17) return '\0';
+	int sum = 0;
+	for (size_t i = 0; i < 17; ++i) {
+		int v = valueOf(vin[i]);
+		if (v < 0) return '\0';
+		sum += v * kWeights[i];
+	}
+	int r = sum % 11;
+	return r == 10 ? 'X' : static_cast<char>('0' + r);
+}
+
+DecodedVin decodeVin(std::string_view vin) {
+	DecodedVin d;
+	// Make and model come from the prefix alone, so short pre-1981 or mistyped VINs still get them
+	if (vin.size() >= 3) {
+		if (const WmiEntry* w = lookup(kWmiTable, kWmis, vin.substr(0, 3))) {
+			d.make = w->make;
+			d.country = w->country;
+			if (vin.size() >= 5)
+				if (const ModelEntry* m = lookup(kModelTable, kModels, vin.substr(0, 5))) d.model = m->model;
+		} else {
+			d.country = regionOf(vin[0]);
+		}
+	}
+	if (vin.size() != 17) return d;
+	for (char c : vin) {
+		if (valueOf(c) < 0) { d.status = VinStatus::BadCharacter; return d; }
+	}
+	d.status = VinStatus::Valid;
+	d.checkDigitRequired = vin[0] >= '1' && vin[0] <= '5';
+	d.checkDigitMatches = vinCheckDigit(vin) == vin[8];
+	if (d.checkDigitRequired && !d.checkDigitMatches) d.status = VinStatus::BadCheckDigit;
+
+	if (int base = baseYear(vin[9])) {
+		// North American passenger VINs mark the later cycle with a letter in position 7;
+		// elsewhere take the latest year that is not in the future
+		bool later = d.checkDigitRequired ? (vin[6] >= 'A' && vin[6] <= 'Z') : base + 30 <= currentYear() + 1;
+		d.modelYear = later ? base + 30 : base;
+	}
+	return d;
+}
+
+void decodeVins(std::span<const std::string_view> vins, std::span<DecodedVin> out) {
+	const size_t n = vins.size() < out.size() ? vins.size() : out.size();
+	for (size_t i = 0; i < n; ++i) out[i] = decodeVin(vins[i]);
+}
+
+bool validateVinForInsert(std::string_view vin, std::string& error) {
+	if (vin.size() != 17 || vin[0] < '1' || vin[0] > '5') return true;
+	char expected = vinCheckDigit(vin);
+	if (expected == '\0') {
+		error = "VIN " + std::string(vin) + " contains characters not allowed in a VIN (I, O, Q or punctuation).";
+		return false;
+	}
+	if (expected != vin[8]) {
+		error = "VIN " + std::string(vin) + " fails the check digit (position 9 should be " + expected + ").";
+		return false;
+	}
+	return true;
+}
+
+} // namespace vsrm
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace vsrm {
+
+enum class VinStatus : unsigned char {
+	Valid,         // 17 legal characters; check digit correct where it is mandatory
+	BadLength,
+	BadCharacter,  // outside 0-9 / A-Z, or one of I, O, Q
+	BadCheckDigit, // North American VIN whose position 9 does not match
+};
+
+// All text views point into static tables, so decoding never allocates.
+struct DecodedVin {
+	VinStatus status{VinStatus::BadLength};
+	std::string_view make;      // "" for manufacturers not in the table
+	std::string_view model;     // "" when the VDS is not in the table
+	std::string_view country;   // from the WMI, else the region of position 1
+	int modelYear{0};           // 0 when position 10 is not a year code
+	bool checkDigitRequired{false}; // North America (position 1 is 1-5)
+	bool checkDigitMatches{false};
+};
+
+// Position-9 check digit ('0'-'9' or 'X') of a 17-character VIN; '\0' if a character is not legal
+char vinCheckDigit(std::string_view vin);
+
+DecodedVin decodeVin(std::string_view vin);
+// Decodes vins[i] into out[i] for i < min(vins.size(), out.size())
+void decodeVins(std::span<const std::string_view> vins, std::span<DecodedVin> out);
+
+// Insert-time rule: only a 17-character North American VIN with a wrong check digit
+// is rejected. Pre-1981 and foreign identifiers vary too much to refuse.
+bool validateVinForInsert(std::string_view vin, std::string& error);
+
+} // namespace vsrm
@@ -0,0 +1,1595 @@
+// vsrm-cli: the data layer without the GUI, for scripts, nightly jobs and servers
+// working on a copy of vsrm.db. Results go to stdout, diagnostics to stderr.
+
+#include "../app/Analytics.h"
+#include "../app/Backup.h"
+#include "../app/Database.h"
+#include "../app/Dates.h"
+#include "../app/PasswordHash.h"
+#include "../app/Scheduler.h"
+#include "../app/ServiceClient.h"
+#include "../app/ServiceServer.h"
+#include "../app/Sha256.h"
+#include "../app/Utf.h"
+#include "../app/VinDecoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum ExitCode {
+	kOk = 0,
+	kFailed = 1,  // nothing or only part of the work was done; see stderr
+	kUsage = 2,
+	kPartial = 3, // finished, but rows were rejected, integrity_check found problems or requests failed
+};
+
+constexpr const char* kUsageText = R"(Usage: vsrm-cli [--db PATH] COMMAND [options]
+
+Commands:
+  import FILE.csv [--merge]
+      Add service records from CSV; rows already stored are skipped (--merge: take the
+      imported customer name instead)
+  export [--format csv|tsv|jsonl] [--vin VIN] [--output FILE]
+      Write service records to stdout or FILE
+  report NAME... [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--jobs N] [--threads N]
+      Run reports concurrently (--jobs, default one per core) and print them in order.
+      NAME: counts, analytics, sketches, mechanics, due, summaries, all
+  maintenance [TASK...] [--lock-budget 50] [--pass-budget 500]
+      TASK: optimize, checkpoint, integrity, vacuum, sketches, service-due, passwords, pass
+      (default: optimize checkpoint integrity). pass: one budgeted idle-time pass (optimize,
+      incremental vacuum, checkpoint, integrity spot checks) that never holds the write lock
+      longer than --lock-budget ms, with the time of each step
+  migrate
+      Create the database or bring its schema up to date
+  bench NAME... [--rows N] [--threads N]
+      NAME: vin, hash, scheduler, analytics, descriptions, utf, calendar, columns
+  serve [--socket PATH] [--readers N] [--batch N] [--idle-after 30] [--lock-budget 50] [--no-maintenance]
+      Own the database and answer desks over a local socket until Ctrl+C; after --idle-after
+      seconds without writes it runs a maintenance pass (at most every 10 minutes)
+  loadtest [--socket PATH] [--desks 50] [--seconds 10] [--pipeline 4] [--writes 20] [--start-server]
+      Simulate desks against a server (--writes: percent of requests that insert records;
+      --start-server: run one in this process on --db)
+  replicate enable NUMBER NAME | status | export FILE [--from SEQ] | prune
+  replicate apply FILE... [--head-office-wins]
+      Branch databases record every change; export writes what changed since the last
+      export to FILE, and head office applies such files in order (replays are no-ops).
+      Conflicting rows take the branch's values unless --head-office-wins.
+  backup [--dir DIR] [--keep 7] [--pages 64] [--pause MS] [--no-compress] [--no-verify] [--measure]
+      Copy the live database a few pages at a time into DIR (default: backups/ beside it),
+      verify and gzip the copy, keep the newest --keep (--measure: report desk query latency
+      before and during the copy)
+  backup list [--dir DIR] | backup verify FILE
+  archive [--keep-years 2 | --before YYYY-MM-DD] | archive list
+      Move older service records into one file per year beside the database (default: keep
+      this year and last); queries and exports still include them
+  descriptions [status] | train [--samples 20000] [--size 8192] | recompress
+      Compress service descriptions with a dictionary trained on the stored ones; new records
+      use the newest dictionary, recompress rewrites the existing ones
+  attachments add RECORD_ID FILE [--name NAME] | list RECORD_ID | remove ID | prune | status
+  attachments get ID --output FILE | thumbnail ID --output FILE [--edge 160]
+      Photos and documents on service records, archived ones too; identical files are stored
+      once. Thumbnails come from a JPEG's EXIF preview or a scaled-down PNG and are cached.
+      prune removes attachments whose record was deleted
+
+Options:
+  --db PATH       Database file (default: $VSRM_DB, else ./vsrm.db)
+  --socket PATH   Server socket (default: the database path + ".sock")
+
+Exit codes: 0 success, 1 failure, 2 usage error, 3 finished with rejected rows, integrity problems,
+failed load-test requests or skipped replicated rows
+)";
+
+struct Args {
+	std::string db;
+	std::string command;
+	std::vector<std::string> positional;
+	std::map<std::string, std::string, std::less<>> options; // "--merge" style flags map to ""
+};
+
+bool takesValue(std::string_view name) {
+	for (std::string_view v : {"db", "format", "vin", "output", "from", "to", "jobs", "threads", "rows", "socket", "readers", "batch",
+		"desks", "seconds", "pipeline", "writes",
+		"dir", "keep", "pages", "pause", "keep-years", "before", "samples", "size", "name", "edge",
+		"lock-budget", "pass-budget", "idle-after"})
+		if (name == v) return true;
+	return false;
+}
+
+std::optional<Args> parseArgs(const std::vector<std::string>& argv) {
+	Args a;
+	if (const char* env = std::getenv("VSRM_DB")) a.db = env;
+	for (size_t i = 0; i < argv.size(); ++i) {
+		std::string_view arg = argv[i];
+		if (arg.size() > 2 && arg.substr(0, 2) == "--") {
+			std::string name(arg.substr(2)), value;
+			if (size_t eq = name.find('='); eq != std::string::npos) {
+				value = name.substr(eq + 1);
+				name.resize(eq);
+			} else if (takesValue(name)) {
+				if (i + 1 >= argv.size()) { std::cerr << "vsrm-cli: --" << name << " needs a value\n"; return std::nullopt; }
+				value = argv[++i];
+			}
+			if (name == "db") a.db = value;
+			else a.options[name] = value;
+		} else if (a.command.empty()) {
+			a.command = arg;
+		} else {
+			a.positional.emplace_back(arg);
+		}
+	}
+	if (a.db.empty()) a.db = "vsrm.db";
+	return a;
+}
+
+std::optional<std::string> option(const Args& a, std::string_view name) {
+	auto it = a.options.find(name);
+	if (it == a.options.end()) return std::nullopt;
+	return it->second;
+}
+
+std::optional<long long> intOption(const Args& a, std::string_view name, long long fallback) {
+	auto v = option(a, name);
+	if (!v) return fallback;
+	char* end = nullptr;
+	long long n = std::strtoll(v->c_str(), &end, 10);
+	if (v->empty() || *end) { std::cerr << "vsrm-cli: --" << name << " expects a number, got '" << *v << "'\n"; return std::nullopt; }
+	return n;
+}
+
+bool checkDate(const std::optional<std::string>& d, const char* flag) {
+	if (!d || vsrm::isoToMinutes(*d)) return true;
+	std::cerr << "vsrm-cli: " << flag << " expects YYYY-MM-DD, got '" << *d << "'\n";
+	return false;
+}
+
+// Every command works on an up-to-date schema, exactly like the GUI after startup
+bool openDatabase(vsrm::Database& db, const std::string& path, bool create = false) {
+	std::error_code ec;
+	if (!create && !fs::exists(fs::u8path(path), ec)) {
+		std::cerr << "vsrm-cli: database not found: " << path << " (run 'vsrm-cli migrate' to create one)\n";
+		return false;
+	}
+	if (!db.openOrCreate(path) || !db.migrateSchema()) {
+		std::cerr << "vsrm-cli: " << path << ": " << db.getLastError() << "\n";
+		return false;
+	}
+	return true;
+}
+
+double msSince(std::chrono::steady_clock::time_point started) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
+
+std::string sformat(const char* fmt, auto... args) {
+	char buf[512];
+	std::snprintf(buf, sizeof(buf), fmt, args...);
+	return buf;
+}
+
+// ---- import ----
+
+int runImport(const Args& a) {
+	if (a.positional.size() != 1) { std::cerr << kUsageText; return kUsage; }
+	vsrm::Database db;
+	if (!openDatabase(db, a.db)) return kFailed;
+	auto policy = option(a, "merge") ? vsrm::ImportConflict::Merge : vsrm::ImportConflict::Skip;
+	vsrm::ImportStats st;
+	if (!db.importServiceRecordsCsv(a.positional[0], policy, st)) {
+		std::cerr << "vsrm-cli: import failed: " << db.getLastError() << "\n";
+		return kFailed;
+	}
+	std::cout << sformat("%zu rows: %zu inserted, %zu skipped, %zu merged, %zu rejected (%.0f ms)\n",
+		st.rows, st.inserted, st.skipped, st.merged, st.rejected, st.milliseconds);
+	std::cout << sformat("bloom filter: %zu rows known new without a lookup, %zu lookups, %zu false positives\n",
+		st.probesAvoided, st.probes, st.falsePositives);
+	for (const auto& e : st.errors) std::cerr << e << "\n";
+	return st.rejected ? kPartial : kOk;
+}
+
+// ---- export ----
+
+std::string csvField(const std::string& in) {
+	if (in.find_first_of(",\n\r\"") == std::string::npos) return in;
+	std::string out = "\"";
+	for (char c : in) {
+		if (c == '"') out.push_back('"');
+		out.push_back(c);
+	}
+	out.push_back('"');
+	return out;
+}
+
+// PostgreSQL text-format escapes, so a field never contains a raw tab or newline
+std::string tsvField(const std::string& in) {
+	std::string out;
+	out.reserve(in.size());
+	for (char c : in) {
+		switch (c) {
+		case '\t': out += "\\t"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\\': out += "\\\\"; break;
+		default: out.push_back(c);
+		}
+	}
+	return out;
+}
+
+std::string jsonString(const std::string& in) {
+	std::string out = "\"";
+	for (unsigned char c : in) {
+		switch (c) {
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (c < 0x20) out += sformat("\\u%04x", c);
+			else out.push_back(static_cast<char>(c));
+		}
+	}
+	out.push_back('"');
+	return out;
+}
+
+int runExport(const Args& a) {
+	if (!a.positional.empty()) { std::cerr << kUsageText; return kUsage; }
+	std::string fmt = option(a, "format").value_or("csv");
+	if (fmt != "csv" && fmt != "tsv" && fmt != "jsonl") { std::cerr << "vsrm-cli: unknown format '" << fmt << "'\n"; return kUsage; }
+	vsrm::Database db;
+	if (!openDatabase(db, a.db)) return kFailed;
+
+	std::ofstream file;
+	if (auto path = option(a, "output")) {
+		file.open(fs::u8path(*path), std::ios::binary);
+		if (!file) { std::cerr << "vsrm-cli: cannot write " << *path << "\n"; return kFailed; }
+	}
+	std::ostream& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+	if (fmt == "csv") out << "id,vin,customer_name,service_date,description,mechanic\n";
+	if (fmt == "tsv") out << "id\tvin\tcustomer_name\tservice_date\tdescription\tmechanic\n";
+
+	size_t rows = 0;
+	bool ok = db.forEachServiceRecord(option(a, "vin").value_or(""), [&](const vsrm::ServiceRecord& r) {
+		if (fmt == "csv") {
+			out << r.id << ',' << csvField(r.vin) << ',' << csvField(r.customerName) << ',' << csvField(r.serviceDate) << ','
+				<< csvField(r.description) << ',' << csvField(r.mechanic) << '\n';
+		} else if (fmt == "tsv") {
+			out << r.id << '\t' << tsvField(r.vin) << '\t' << tsvField(r.customerName) << '\t' << tsvField(r.serviceDate) << '\t'
+				<< tsvField(r.description) << '\t' << tsvField(r.mechanic) << '\n';
+		} else {
+			out << "{\"id\":" << r.id << ",\"vin\":" << jsonString(r.vin) << ",\"customer_name\":" << jsonString(r.customerName)
+				<< ",\"service_date\":" << jsonString(r.serviceDate) << ",\"description\":" << jsonString(r.description)
+				<< ",\"mechanic\":" << jsonString(r.mechanic) << "}\n";
+		}
+		++rows;
+		return static_cast<bool>(out); // stop when the reader goes away
+	});
+	out.flush();
+	if (!ok) { std::cerr << "vsrm-cli: export failed: " << db.getLastError() << "\n"; return kFailed; }
+	if (!out) { std::cerr << "vsrm-cli: export stopped after " << rows << " rows: write failed\n"; return kFailed; }
+	std::cerr << rows << " records exported\n";
+	return kOk;
+}
+
+// ---- report ----
+
+struct ReportContext {
+	std::string dbPath;
+	std::optional<std::string> from, to;
+	int threads{0};
+};
+
+using ReportFn = bool (*)(const ReportContext&, std::string& out, std::string& error);
+
+bool openForReport(vsrm::Database& db, const ReportContext& ctx, std::string& error) {
+	if (db.openOrCreate(ctx.dbPath)) return true;
+	error = db.getLastError();
+	return false;
+}
+
+std::string currentMonth() {
+	auto days = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now()).time_since_epoch().count();
+	return vsrm::minutesToIso(static_cast<int64_t>(days) * 1440).substr(0, 7);
+}
+
+std::string monthsBefore(const std::string& month, int n) {
+	int y = std::stoi(month.substr(0, 4)), m = std::stoi(month.substr(5, 2)) - n;
+	while (m < 1) { m += 12; --y; }
+	return sformat("%04d-%02d", y, m);
+}
+
+bool reportCounts(const ReportContext& ctx, std::string& out, std::string& error) {
+	vsrm::Database db;
+	if (!openForReport(db, ctx, error)) return false;
+	out += sformat("service records     %d\n", db.countServiceRecords());
+	out += sformat("customers           %d\n", db.countDistinctCustomers());
+	out += sformat("active mechanics    %d\n", db.countActiveMechanics());
+	out += sformat("appointments        %d\n", db.countAppointments());
+	if (ctx.from || ctx.to) {
+		out += sformat("records in range    %d\n",
+			db.countServiceRecordsByDateRange(ctx.from.value_or("0000-01-01"), ctx.to.value_or("9999-12-31")));
+	}
+	return true;
+}
+
+bool reportAnalytics(const ReportContext& ctx, std::string& out, std::string& error) {
+	vsrm::AnalyticsOptions opts;
+	opts.threads = ctx.threads;
+	opts.fromDate = ctx.from;
+	opts.toDate = ctx.to;
+	vsrm::AnalyticsReport r;
+	if (!vsrm::runAnalytics(ctx.dbPath, opts, r, error)) return false;
+	out += sformat("%lld records, %d threads, %d partitions, %.0f ms\n", (long long)r.records, r.threads, r.partitions, r.milliseconds);
+	out += sformat("vehicles %lld (repeat %.1f%%), customers %lld (repeat %.1f%%)\n",
+		(long long)r.vehicles, r.vehicleRepeatRate() * 100.0, (long long)r.customers, r.customerRepeatRate() * 100.0);
+	out += "visits per month:\n";
+	for (const auto& b : r.byMonth) out += sformat("  %s\t%lld\n", b.key.c_str(), (long long)b.visits);
+	out += "mechanic throughput:\n";
+	for (const auto& b : r.byMechanic) out += sformat("  %s\t%lld\n", b.key.c_str(), (long long)b.visits);
+	out += "top customers:\n";
+	for (size_t i = 0; i < r.byCustomer.size() && i < 10; ++i) {
+		const auto& b = r.byCustomer[i];
+		out += sformat("  %s\t%lld visits\t%lld vehicles\n", b.key.c_str(), (long long)b.visits, (long long)b.vehicles);
+	}
+	return true;
+}
+
+bool reportSketches(const ReportContext& ctx, std::string& out, std::string& error) {
+	vsrm::Database db;
+	if (!openForReport(db, ctx, error)) return false;
+	std::string to = ctx.to ? ctx.to->substr(0, 7) : currentMonth();
+	std::string from = ctx.from ? ctx.from->substr(0, 7) : monthsBefore(to, 11);
+	vsrm::SketchSummary s;
+	if (!db.sketchSummary(from, to, s, 10)) { error = db.getLastError(); return false; }
+	out += sformat("%s to %s: %llu records in %d months\n", s.fromMonth.c_str(), s.toMonth.c_str(), (unsigned long long)s.records, s.months);
+	out += sformat("distinct customers ~%.0f, vehicles ~%.0f (+/- %.1f%%)\n",
+		s.distinctCustomers, s.distinctVins, s.distinctRelativeError * 100.0);
+	out += sformat("top mechanics (overcount <= %llu at %.0f%% confidence):\n", (unsigned long long)s.countErrorBound, s.countConfidence * 100.0);
+	for (const auto& m : s.topMechanics) out += sformat("  %s\t~%llu\n", m.key.c_str(), (unsigned long long)m.estimate);
+	out += "top description keywords:\n";
+	for (const auto& k : s.topKeywords) out += sformat("  %s\t~%llu\n", k.key.c_str(), (unsigned long long)k.estimate);
+	return true;
+}
+
+bool reportMechanics(const ReportContext& ctx, std::string& out, std::string& error) {
+	vsrm::Database db;
+	if (!openForReport(db, ctx, error)) return false;
+	const vsrm::ServiceColumns* cols = db.serviceColumns();
+	if (!cols) { error = db.getLastError(); return false; }
+	vsrm::ColumnFilter filter;
+	if (ctx.from) filter.fromDate = vsrm::ServiceColumns::parseDate(*ctx.from).value_or(filter.fromDate);
+	if (ctx.to) filter.toDate = vsrm::ServiceColumns::parseDate(*ctx.to).value_or(filter.toDate);
+	out += sformat("%lld records\n", (long long)cols->count(filter));
+	for (const auto& g : cols->countBy(vsrm::ServiceGroup::Mechanic, filter)) out += sformat("  %s\t%lld\n", g.key.c_str(), (long long)g.count);
+	return true;
+}
+
+bool vehicleRows(const ReportContext& ctx, bool dueOnly, std::string& out, std::string& error) {
+	vsrm::Database db;
+	if (!openForReport(db, ctx, error)) return false;
+	auto rows = db.listVehicleSummaries("", ctx.from, ctx.to, std::nullopt, dueOnly);
+	if (!db.getLastError().empty()) { error = db.getLastError(); return false; }
+	out += "vin\tmake\tmodel\tlast_service\tmechanic\tnext_service\tstatus\n";
+	for (const auto& v : rows) {
+		out += v.vin + '\t' + v.make + '\t' + v.model + '\t' + v.lastServiceDate + '\t' + v.mechanic + '\t' +
+			v.nextService.value_or("") + '\t' + v.status + '\n';
+	}
+	return true;
+}
+
+bool reportDue(const ReportContext& ctx, std::string& out, std::string& error) { return vehicleRows(ctx, true, out, error); }
+bool reportSummaries(const ReportContext& ctx, std::string& out, std::string& error) { return vehicleRows(ctx, false, out, error); }
+
+struct ReportDef {
+	const char* name;
+	ReportFn run;
+};
+
+constexpr ReportDef kReports[] = {
+	{"counts", reportCounts},
+	{"analytics", reportAnalytics},
+	{"sketches", reportSketches},
+	{"mechanics", reportMechanics},
+	{"due", reportDue},
+	{"summaries", reportSummaries},
+};
+
+struct ReportResult {
+	bool ok{false};
+	std::string out;
+	std::string error;
+	double milliseconds{};
+};
+
+int runReports(const Args& a) {
+	std::vector<const ReportDef*> chosen;
+	for (const std::string& name : a.positional) {
+		if (name == "all") { for (const auto& r : kReports) chosen.push_back(&r); continue; }
+		const ReportDef* found = nullptr;
+		for (const auto& r : kReports) if (name == r.name) found = &r;
+		if (!found) { std::cerr << "vsrm-cli: unknown report '" << name << "'\n"; return kUsage; }
+		chosen.push_back(found);
+	}
+	if (chosen.empty()) { std::cerr << kUsageText; return kUsage; }
+	ReportContext ctx;
+	ctx.dbPath = a.db;
+	ctx.from = option(a, "from");
+	ctx.to = option(a, "to");
+	if (!checkDate(ctx.from, "--from") || !checkDate(ctx.to, "--to")) return kUsage;
+	auto threads = intOption(a, "threads", 0), jobs = intOption(a, "jobs", 0);
+	if (!threads || !jobs) return kUsage;
+	ctx.threads = static_cast<int>(*threads);
+	{
+		vsrm::Database db; // migrate once up front rather than racing inside the workers
+		if (!openDatabase(db, a.db)) return kFailed;
+	}
+
+	// Workers take reports in order, each on its own connection; results print in request order
+	// as soon as every earlier one is done
+	size_t workers = *jobs > 0 ? static_cast<size_t>(*jobs) : std::max(1u, std::thread::hardware_concurrency());
+	workers = std::min(workers, chosen.size());
+	std::vector<std::promise<ReportResult>> promises(chosen.size());
+	std::vector<std::future<ReportResult>> results;
+	for (auto& p : promises) results.push_back(p.get_future());
+	std::atomic<size_t> next{0};
+	std::vector<std::thread> pool;
+	for (size_t w = 0; w < workers; ++w) {
+		pool.emplace_back([&] {
+			for (size_t i; (i = next.fetch_add(1)) < chosen.size();) {
+				ReportResult r;
+				auto started = std::chrono::steady_clock::now();
+				r.ok = chosen[i]->run(ctx, r.out, r.error);
+				r.milliseconds = msSince(started);
+				promises[i].set_value(std::move(r));
+			}
+		});
+	}
+	int code = kOk;
+	for (size_t i = 0; i < chosen.size(); ++i) {
+		ReportResult r = results[i].get();
+		std::cout << "== " << chosen[i]->name << sformat(" (%.0f ms)", r.milliseconds) << " ==\n" << r.out;
+		if (!r.ok) { std::cerr << "vsrm-cli: report " << chosen[i]->name << " failed: " << r.error << "\n"; code = kFailed; }
+		std::cout.flush();
+	}
+	for (auto& t : pool) t.join();
+	return code;
+}
+
+// ---- maintenance ----
+
+int runMaintenance(const Args& a) {
+	std::vector<std::string> tasks = a.positional;
+	if (tasks.empty()) tasks = {"optimize", "checkpoint", "integrity"};
+	vsrm::Database db;
+	if (!openDatabase(db, a.db)) return kFailed;
+	int code = kOk;
+	for (const std::string& task : tasks) {
+		auto started = std::chrono::steady_clock::now();
+		bool ok = true;
+		std::string detail;
+		if (task == "optimize") ok = db.optimize();
+		else if (task == "checkpoint") ok = db.checkpoint();
+		else if (task == "vacuum") ok = db.vacuum();
+		else if (task == "sketches") ok = db.rebuildSketches();
+		else if (task == "integrity") {
+			std::vector<std::string> problems;
+			ok = db.integrityCheck(problems);
+			for (const auto& p : problems) std::cerr << "integrity: " << p << "\n";
+			if (!problems.empty()) { code = kPartial; detail = sformat(", %zu problems", problems.size()); }
+		} else if (task == "service-due") {
+			vsrm::ServiceDueStats st;
+			ok = db.recomputeServiceDue(vsrm::workshopDueRules(), 0, &st);
+			detail = sformat(", %zu vehicles", st.vehicles);
+		} else if (task == "passwords") {
+			size_t upgraded = 0;
+			ok = db.upgradeLegacyPasswords(0, &upgraded);
+			detail = sformat(", %zu upgraded", upgraded);
+		} else if (task == "pass") {
+			auto lockBudget = intOption(a, "lock-budget", 50), passBudget = intOption(a, "pass-budget", 500);
+			if (!lockBudget || !passBudget || *lockBudget <= 0 || *passBudget <= 0) return kUsage;
+			vsrm::MaintenanceOptions opts;
+			opts.lockBudgetMs = static_cast<int>(*lockBudget);
+			opts.passBudgetMs = static_cast<int>(*passBudget);
+			db.setMaintenanceOptions(opts);
+			vsrm::MaintenanceReport report;
+			ok = db.runMaintenancePass(report);
+			for (const auto& step : report.steps)
+				std::cout << sformat("  %-18s %7.1f ms  write lock %6.1f ms  %s%s\n", step.name.c_str(), step.milliseconds,
+					step.lockMilliseconds, step.ok ? "" : "FAILED: ", step.detail.c_str());
+			for (const auto& p : report.problems) std::cerr << "integrity: " << p << "\n";
+			if (!report.problems.empty()) code = kPartial;
+			detail = sformat(", longest write lock %.1f ms of %lld allowed", report.longestLockMilliseconds, *lockBudget);
+		} else {
+			std::cerr << "vsrm-cli: unknown maintenance task '" << task << "'\n";
+			return kUsage;
+		}
+		if (!ok) { std::cerr << "vsrm-cli: " << task << " failed: " << db.getLastError() << "\n"; return kFailed; }
+		std::cout << task << sformat(": ok (%.0f ms%s)\n", msSince(started), detail.c_str());
+	}
+	return code;
+}
+
+// ---- migrate ----
+
+int runMigrate(const Args& a) {
+	vsrm::Database db;
+	std::vector<vsrm::MigrationStep> steps;
+	if (!db.openOrCreate(a.db) || !db.migrateSchema(&steps)) {
+		std::cerr << "vsrm-cli: " << a.db << ": " << db.getLastError() << "\n";
+		return kFailed;
+	}
+	for (const auto& s : steps) std::cout << sformat("applied %d %s (%.1f ms)\n", s.version, s.name.c_str(), s.milliseconds);
+	std::cout << "schema version " << db.schemaVersion() << "\n";
+	return kOk;
+}
+
+// ---- bench ----
+
+bool benchVin(const Args&) {
+	const char* prefixes[] = {"4T1BF1FK", "2T3ZF4DV", "5TDKK3DC", "JTDKB20U", "JTHBK1GG", "5TFDW5F1", "JHHZCL2H", "WVWZZZ1J"};
+	const char years[] = "ABCDEFGHJKLMNPRSTVWXY123456789";
+	constexpr size_t kVins = 1000000;
+	std::vector<std::string> vins(kVins);
+	for (size_t i = 0; i < kVins; ++i) {
+		char buf[18];
+		std::snprintf(buf, sizeof(buf), "%s0%c%07u", prefixes[i % 8], years[i % 30], static_cast<unsigned>(i % 10000000));
+		buf[8] = vsrm::vinCheckDigit(buf);
+		vins[i] = buf;
+	}
+	std::vector<std::string_view> views(vins.begin(), vins.end());
+	std::vector<vsrm::DecodedVin> decoded(kVins);
+	double best = 0;
+	for (int run = 0; run < 5; ++run) {
+		auto started = std::chrono::steady_clock::now();
+		vsrm::decodeVins(views, decoded);
+		double ms = msSince(started);
+		if (run == 0 || ms < best) best = ms;
+	}
+	std::cout << sformat("vin: %zu VINs in %.1f ms (%.1f M VINs/s)\n", kVins, best, kVins / best / 1000.0);
+	return true;
+}
+
+bool benchHash(const Args& a) {
+	std::string block(64 << 20, 'x');
+	auto started = std::chrono::steady_clock::now();
+	vsrm::Sha256Digest d = vsrm::Sha256::hash(block);
+	double bulk = msSince(started);
+	std::string message(64, 'm');
+	vsrm::Sha256 ctx;
+	started = std::chrono::steady_clock::now();
+	for (int i = 0; i < 1000000; ++i) { message[0] = static_cast<char>(i); ctx.update(message); d = ctx.finish(); }
+	double small = msSince(started);
+	std::cout << sformat("hash: sha-256 (%s) %.0f MB/s bulk, %.2f M hashes/s of 64 bytes [%02x]\n",
+		vsrm::Sha256::implementation(), 64.0 / (bulk / 1000.0), 1.0 / (small / 1000.0), d[0]);
+
+	std::string salt = vsrm::newPasswordSalt();
+	started = std::chrono::steady_clock::now();
+	vsrm::hashPassword("benchmark", salt, vsrm::kDefaultPasswordIterations);
+	double single = msSince(started);
+	auto threads = intOption(a, "threads", 0);
+	if (!threads) return false;
+	int cores = *threads > 0 ? static_cast<int>(*threads) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<vsrm::PasswordHashJob> jobs(static_cast<size_t>(cores) * 4, vsrm::PasswordHashJob{"benchmark", salt, false});
+	std::vector<std::string> out(jobs.size());
+	started = std::chrono::steady_clock::now();
+	vsrm::hashPasswordsBatch(jobs, vsrm::kDefaultPasswordIterations, out, cores);
+	double batch = msSince(started);
+	std::cout << sformat("hash: pbkdf2 x %u %.1f ms per login; batch of %zu %.1f hashes/s on %d threads\n",
+		vsrm::kDefaultPasswordIterations, single, jobs.size(), jobs.size() / (batch / 1000.0), cores);
+	return true;
+}
+
+bool benchScheduler(const Args&) {
+	for (int n : {1000, 5000, 20000}) {
+		vsrm::SyntheticWorkload w = vsrm::makeSyntheticWorkload(n, 40, 1);
+		double best = 0;
+		vsrm::SchedulePlan plan;
+		for (int run = 0; run < 5; ++run) {
+			plan = vsrm::balanceWorkload(w.pending, w.mechanics, w.openLoad, vsrm::SchedulerOptions{0});
+			if (run == 0 || plan.milliseconds < best) best = plan.milliseconds;
+		}
+		std::cout << sformat("scheduler: %6d appointments %.3f ms, %zu assigned, spread %d-%d\n",
+			n, best, plan.assignments.size(), plan.minDayLoad, plan.maxDayLoad);
+	}
+	return true;
+}
+
+// Synthetic service records in the temp directory, kept between runs (one per row count)
+std::optional<std::string> syntheticServiceDatabase(int64_t rows) {
+	std::error_code ec;
+	fs::path path = fs::temp_directory_path(ec) / ("vsrm_analytics_bench_" + std::to_string(rows) + ".db");
+	std::string benchPath = vsrm::toUtf8(path.u16string());
+	std::string error;
+	if (!fs::exists(path, ec)) {
+		std::cerr << "writing " << rows << " synthetic rows to " << benchPath << "\n";
+		if (!vsrm::writeSyntheticServiceDatabase(benchPath, rows, 1, error)) { std::cerr << "vsrm-cli: " << error << "\n"; return std::nullopt; }
+	}
+	return benchPath;
+}
+
+bool benchAnalytics(const Args& a) {
+	auto rows = intOption(a, "rows", 1000000), threads = intOption(a, "threads", 0);
+	if (!rows || !threads || *rows <= 0) return false;
+	auto synthetic = syntheticServiceDatabase(*rows);
+	if (!synthetic) return false;
+	const std::string& benchPath = *synthetic;
+	std::string error;
+	int cores = *threads > 0 ? static_cast<int>(*threads) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<int> counts;
+	for (int t = 1; t < cores; t *= 2) counts.push_back(t);
+	counts.push_back(cores);
+	double base = 0;
+	for (int t : counts) {
+		vsrm::AnalyticsOptions opts;
+		opts.threads = t;
+		vsrm::AnalyticsReport report;
+		if (!vsrm::runAnalytics(benchPath, opts, report, error)) { std::cerr << "vsrm-cli: " << error << "\n"; return false; }
+		if (t == 1) base = report.milliseconds;
+		std::cout << sformat("analytics: %lld rows, %2d threads %.0f ms (%.2fx)\n", (long long)report.records, t,
+			report.milliseconds, report.milliseconds > 0 ? base / report.milliseconds : 0.0);
+	}
+	return true;
+}
+
+// Count and group-by queries on the column cache of the synthetic database (10M rows by default)
+bool benchColumns(const Args& a) {
+	auto rows = intOption(a, "rows", 10000000);
+	if (!rows || *rows <= 0) return false;
+	auto synthetic = syntheticServiceDatabase(*rows);
+	if (!synthetic) return false;
+	vsrm::Database db;
+	if (!openDatabase(db, *synthetic)) return false;
+	auto started = std::chrono::steady_clock::now();
+	const vsrm::ServiceColumns* cols = db.serviceColumns();
+	if (!cols) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return false; }
+	std::cout << sformat("columns: %zu rows loaded in %.0f ms, %.1f MB\n", cols->size(), msSince(started), cols->memoryBytes() / 1e6);
+
+	vsrm::ColumnFilter all, year;
+	year.fromDate = 20220101;
+	year.toDate = 20221231;
+	vsrm::ColumnFilter yearMechanic = year;
+	yearMechanic.mechanic = cols->mechanics().find("Mechanic 07");
+	if (!yearMechanic.mechanic) { std::cerr << "vsrm-cli: synthetic database has no 'Mechanic 07'\n"; return false; }
+
+	auto best = [](auto&& query) {
+		double fastest = 0;
+		for (int run = 0; run < 5; ++run) {
+			auto t = std::chrono::steady_clock::now();
+			query();
+			double ms = msSince(t);
+			if (run == 0 || ms < fastest) fastest = ms;
+		}
+		return fastest;
+	};
+	auto count = [&](const char* name, const vsrm::ColumnFilter& filter) {
+		int64_t matched = 0;
+		double ms = best([&] { matched = cols->count(filter); });
+		std::cout << sformat("columns: count %-26s %8.2f ms  %lld rows\n", name, ms, (long long)matched);
+	};
+	auto group = [&](const char* name, vsrm::ServiceGroup by, const vsrm::ColumnFilter& filter) {
+		size_t groups = 0;
+		double ms = best([&] { groups = cols->countBy(by, filter).size(); });
+		std::cout << sformat("columns: group %-26s %8.2f ms  %zu groups\n", name, ms, groups);
+	};
+	count("all", all);
+	count("one year", year);
+	count("one year, one mechanic", yearMechanic);
+	group("by month", vsrm::ServiceGroup::Month, all);
+	group("by mechanic, one year", vsrm::ServiceGroup::Mechanic, year);
+	group("by customer, one year", vsrm::ServiceGroup::Customer, year);
+	group("by vin", vsrm::ServiceGroup::Vin, all);
+	return true;
+}
+
+// Plain vs dictionary-packed descriptions of the same synthetic notes: the codec on its own, then
+// two databases loaded alike (the packed one trains on its first rows and recompresses them)
+bool benchDescriptions(const Args& a) {
+	auto rows = intOption(a, "rows", 100000);
+	if (!rows || *rows <= 0) return false;
+	const size_t n = static_cast<size_t>(*rows);
+	const size_t trainOn = std::min<size_t>(std::max<size_t>(n / 5, 1), 20000);
+	std::vector<std::string> notes = vsrm::makeSyntheticServiceNotes(n, 1);
+	uint64_t textBytes = 0;
+	for (const auto& note : notes) textBytes += note.size();
+
+	auto started = std::chrono::steady_clock::now();
+	std::string dictionary = vsrm::trainTextDictionary({notes.begin(), notes.begin() + trainOn}, vsrm::DictionaryTrainOptions{}.dictionaryBytes);
+	double trainMs = msSince(started);
+	if (dictionary.empty()) { std::cerr << "vsrm-cli: nothing to train on\n"; return false; }
+	vsrm::DescriptionCodec codec;
+	codec.setActive(dictionary);
+	std::vector<std::string> packed(n);
+	std::vector<char> isPacked(n);
+	uint64_t storedBytes = 0;
+	started = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < n; ++i) isPacked[i] = codec.pack(nullptr, notes[i], packed[i]);
+	double packMs = msSince(started);
+	for (size_t i = 0; i < n; ++i) storedBytes += isPacked[i] ? packed[i].size() : notes[i].size();
+	std::string text, error;
+	size_t mismatches = 0;
+	started = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < n; ++i) {
+		if (!isPacked[i]) continue;
+		if (!codec.unpack(nullptr, packed[i], text, error) || text != notes[i]) ++mismatches;
+	}
+	double unpackMs = msSince(started);
+	if (mismatches) { std::cerr << "vsrm-cli: " << mismatches << " descriptions did not round-trip\n"; return false; }
+	std::cout << sformat("descriptions: %zu notes, %.2f MB of text -> %.2f MB packed (%.1f%%), %zu-byte dictionary trained on %zu in %.0f ms\n",
+		n, textBytes / 1e6, storedBytes / 1e6, 100.0 * storedBytes / textBytes, dictionary.size(), trainOn, trainMs);
+	std::cout << sformat("descriptions: pack %.2f us, unpack %.2f us per note\n", packMs * 1000 / n, unpackMs * 1000 / n);
+
+	std::error_code ec;
+	fs::path dir = fs::temp_directory_path(ec) / "vsrm_descriptions_bench";
+	fs::remove_all(dir, ec);
+	fs::create_directories(dir, ec);
+	const char* mechanics[] = {"Banda", "Mwale", "Phiri", "Tembo", "Zulu", "Lungu"};
+	auto load = [&](const char* name, bool compress) {
+		std::string path = vsrm::toUtf8((dir / (std::string(name) + ".db")).u16string());
+		double insertMs = 0, scanMs = 0;
+		{
+			vsrm::Database db;
+			if (!openDatabase(db, path, true)) return false;
+			std::vector<vsrm::ServiceRecord> batch;
+			std::vector<std::optional<int>> ids;
+			std::vector<std::string> errors;
+			auto insert = [&](size_t from, size_t to) {
+				for (size_t i = from; i < to;) {
+					batch.clear();
+					for (size_t end = std::min(to, i + 1000); i < end; ++i) {
+						vsrm::ServiceRecord r;
+						char vin[18];
+						// Serial reduced to its seven digits so it always fits the VIN
+						auto serial = static_cast<unsigned>(i % (n / 4 + 1) % 10000000);
+						std::snprintf(vin, sizeof(vin), "JTDKB20U0A%07u", serial);
+						vin[8] = vsrm::vinCheckDigit(vin);
+						r.vin = vin;
+						r.customerName = "Customer " + std::to_string(i % (n / 5 + 1));
+						r.serviceDate = sformat("%04zu-%02zu-%02zu", 2023 + i % 3, 1 + i % 12, 1 + i % 28);
+						r.description = notes[i];
+						r.mechanic = mechanics[i % std::size(mechanics)];
+						batch.push_back(std::move(r));
+					}
+					if (!db.addServiceRecordsBatch(batch, ids, errors)) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return false; }
+				}
+				return true;
+			};
+			if (!insert(0, trainOn)) return false;
+			if (compress) {
+				vsrm::DictionaryTrainOptions opts;
+				opts.maxSamples = trainOn;
+				vsrm::DictionaryTrainStats trained;
+				vsrm::DescriptionRecompressStats rewritten;
+				if (!db.trainDescriptionDictionary(opts, trained) || !db.recompressDescriptions(rewritten)) {
+					std::cerr << "vsrm-cli: " << db.getLastError() << "\n";
+					return false;
+				}
+			}
+			started = std::chrono::steady_clock::now();
+			if (!insert(trainOn, n)) return false;
+			insertMs = msSince(started);
+			if (!db.vacuum()) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return false; }
+			uint64_t seen = 0;
+			started = std::chrono::steady_clock::now();
+			db.forEachServiceRecord("", [&](const vsrm::ServiceRecord& r) { seen += r.description.size(); return true; });
+			scanMs = msSince(started);
+			if (seen != textBytes) { std::cerr << "vsrm-cli: " << name << " read back " << seen << " bytes of text\n"; return false; }
+		}
+		uintmax_t size = fs::file_size(fs::u8path(path), ec);
+		std::cout << sformat("descriptions: %-6s database %6.2f MB, %zu inserts %.1f us/row, full scan %.0f ms\n",
+			name, size / 1e6, n - trainOn, n > trainOn ? insertMs * 1000 / (n - trainOn) : 0.0, scanMs);
+		return true;
+	};
+	bool ok = load("plain", false) && load("packed", true);
+	fs::remove_all(dir, ec);
+	return ok;
+}
+
+// Day, week and month views over a synthetic calendar in the temp directory (kept between runs,
+// one per row count): two years of appointments, most assigned, some reassigned
+bool benchCalendar(const Args& a) {
+	auto rows = intOption(a, "rows", 100000);
+	if (!rows || *rows <= 0) return false;
+	constexpr int kDays = 730;
+	const int64_t base = *vsrm::isoToMinutes("2025-01-01T00:00");
+	std::error_code ec;
+	fs::path path = fs::temp_directory_path(ec) / ("vsrm_calendar_bench_" + std::to_string(*rows) + ".db");
+	std::string benchPath = vsrm::toUtf8(path.u16string());
+	vsrm::Database db;
+	if (!fs::exists(path, ec)) {
+		std::cerr << "writing " << *rows << " synthetic appointments to " << benchPath << "\n";
+		auto started = std::chrono::steady_clock::now();
+		bool ok = openDatabase(db, benchPath, true) && db.enableWriteAheadLog();
+		std::mt19937 rng(1);
+		const char* statuses[] = {"scheduled", "scheduled", "in_progress", "done", "done", "cancelled"};
+		std::vector<int> mechanics;
+		for (int m = 0; ok && m < 30; ++m) {
+			auto id = db.addMechanic(vsrm::Mechanic{0, sformat("Mechanic %02d", m + 1), m % 3 ? "general" : "electrical", true});
+			ok = id.has_value();
+			if (ok) mechanics.push_back(*id);
+		}
+		std::vector<vsrm::Assignment> assignments;
+		for (int64_t i = 0; ok && i < *rows; ++i) {
+			vsrm::Appointment appt{};
+			char vin[18];
+			std::snprintf(vin, sizeof(vin), "JTDKB20U0A%07u", static_cast<unsigned>(i % 10000000));
+			vin[8] = vsrm::vinCheckDigit(vin);
+			appt.vin = vin;
+			appt.customerName = "Customer " + std::to_string(i % 997);
+			appt.scheduledAt = vsrm::minutesToIso(base + int64_t(rng() % kDays) * 1440 + (8 + rng() % 9) * 60 + (rng() % 4) * 15);
+			appt.status = statuses[rng() % std::size(statuses)];
+			appt.durationMin = 30 + static_cast<int>(rng() % 4) * 30;
+			auto id = db.addAppointment(appt);
+			ok = id.has_value();
+			if (!ok) break;
+			// Seven in ten get a mechanic, one in ten of those a second one later
+			for (unsigned k = rng() % 10 < 7 ? (rng() % 10 ? 1u : 2u) : 0u; k > 0; --k) {
+				assignments.push_back(vsrm::Assignment{0, *id, mechanics[rng() % mechanics.size()], appt.scheduledAt, std::nullopt});
+			}
+		}
+		ok = ok && db.addAssignmentsBatch(assignments);
+		if (!ok) {
+			std::cerr << "vsrm-cli: " << db.getLastError() << "\n";
+			db.close();
+			fs::remove(path, ec);
+			return false;
+		}
+		std::cerr << sformat("written in %.1f s\n", msSince(started) / 1000);
+	} else if (!openDatabase(db, benchPath)) {
+		return false;
+	}
+
+	struct View {
+		const char* name;
+		int days;
+		int queries;
+		unsigned mask;
+	};
+	const View views[] = {{"day", 1, 500, vsrm::kApptAnyStatus}, {"day open", 1, 500, vsrm::kApptOpen},
+		{"week", 7, 200, vsrm::kApptAnyStatus}, {"month", 30, 50, vsrm::kApptAnyStatus}};
+	std::mt19937 rng(2);
+	for (const View& v : views) {
+		std::vector<double> latencies;
+		size_t returned = 0;
+		for (int q = 0; q < v.queries; ++q) {
+			const int64_t from = base + int64_t(rng() % (kDays - v.days + 1)) * 1440;
+			const std::string lo = vsrm::minutesToIso(from), hi = vsrm::minutesToIso(from + int64_t(v.days) * 1440);
+			auto started = std::chrono::steady_clock::now();
+			auto entries = db.listAppointmentsInRange(lo, hi, v.mask);
+			latencies.push_back(msSince(started));
+			returned += entries.size();
+		}
+		std::sort(latencies.begin(), latencies.end());
+		auto pct = [&](double p) { return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))]; };
+		std::cout << sformat("calendar: %lld appointments, %-8s %4.0f rows  p50 %.3f ms  p95 %.3f ms  max %.3f ms\n",
+			(long long)*rows, v.name, double(returned) / v.queries, pct(0.50), pct(0.95), latencies.back());
+	}
+	return true;
+}
+
+// Grid cells (seven per row, a few customer names non-ASCII) through the old byte-widening W() and
+// its narrowing inverse, then through the transcoder: per cell, and a whole page into one arena
+bool benchUtf(const Args& a) {
+	auto rows = intOption(a, "rows", 100000);
+	if (!rows || *rows <= 0) return false;
+	const size_t n = static_cast<size_t>(*rows);
+	const char* names[] = {"Banda", "Mwale", "Phiri", "M\xC3\xBCller", "Zo\xC3\xAB", "\xE7\x94\xB0\xE4\xB8\xAD"};
+	const char* jobs[] = {"Oil change", "Brake pads and rotors", "Tyre rotation", "Battery replaced", "Timing belt", "Annual inspection"};
+	std::vector<std::string> cells;
+	cells.reserve(n * 7);
+	uint64_t bytes = 0;
+	size_t nonAscii = 0;
+	for (size_t i = 0; i < n; ++i) {
+		const std::string name = names[i % std::size(names)];
+		nonAscii += i % std::size(names) >= 3;
+		cells.push_back(sformat("JTDKB20U%c%07zu", "ABCDEFGHJ"[i % 9], i % 10000000));
+		cells.push_back(name + " " + std::to_string(i % 5000));
+		cells.push_back(sformat("%04zu-%02zu-%02zu", 2020 + i % 6, 1 + i % 12, 1 + i % 28));
+		cells.push_back(jobs[i % std::size(jobs)]);
+		cells.push_back(std::string("Mechanic ") + names[i % 3]);
+		cells.push_back(sformat("%04zu-%02zu-%02zu", 2021 + i % 6, 1 + i % 12, 1 + i % 28));
+		cells.push_back(i % 4 ? "ok" : "due");
+	}
+	for (const auto& c : cells) bytes += c.size();
+
+	// Best of five; units keeps the work observable
+	uint64_t units = 0;
+	auto best = [&](auto&& body) {
+		double fastest = 0;
+		for (int run = 0; run < 5; ++run) {
+			auto started = std::chrono::steady_clock::now();
+			body();
+			double ms = msSince(started);
+			if (run == 0 || ms < fastest) fastest = ms;
+		}
+		return fastest;
+	};
+	double widenMs = best([&] { for (const auto& c : cells) units += std::u16string(c.begin(), c.end()).size(); });
+	double perCellMs = best([&] { for (const auto& c : cells) units += vsrm::toUtf16(c).size(); });
+	vsrm::Utf16Arena arena;
+	double arenaMs = best([&] {
+		arena.clear();
+		for (const auto& c : cells) arena.add(c);
+		units += arena.codeUnits();
+	});
+	std::vector<std::u16string> wide;
+	wide.reserve(cells.size());
+	for (const auto& c : cells) wide.push_back(vsrm::toUtf16(c));
+	double narrowMs = best([&] { for (const auto& w : wide) units += std::string(w.begin(), w.end()).size(); });
+	double toUtf8Ms = best([&] { for (const auto& w : wide) units += vsrm::toUtf8(w).size(); });
+
+	size_t widenWrong = 0, narrowWrong = 0, roundTrips = 0;
+	for (size_t i = 0; i < cells.size(); ++i) {
+		widenWrong += std::u16string(cells[i].begin(), cells[i].end()) != wide[i];
+		narrowWrong += std::string(wide[i].begin(), wide[i].end()) != cells[i];
+		roundTrips += vsrm::toUtf8(wide[i]) == cells[i];
+	}
+	if (roundTrips != cells.size()) { std::cerr << "vsrm-cli: " << cells.size() - roundTrips << " cells did not round-trip\n"; return false; }
+
+	const double mb = bytes / 1e6;
+	std::cout << sformat("utf: %zu cells (%zu rows), %.2f MB, %zu rows with non-ASCII names [%02x]\n",
+		cells.size(), n, mb, nonAscii, static_cast<unsigned>(units & 0xff));
+	std::cout << sformat("utf: to UTF-16  W() widen %6.1f ms (%5.0f MB/s, %zu cells wrong), per cell %6.1f ms (%5.0f MB/s), arena %6.1f ms (%5.0f MB/s)\n",
+		widenMs, mb / (widenMs / 1000), widenWrong, perCellMs, mb / (perCellMs / 1000), arenaMs, mb / (arenaMs / 1000));
+	std::cout << sformat("utf: to UTF-8   narrow    %6.1f ms (%5.0f MB/s, %zu cells wrong), toUtf8   %6.1f ms (%5.0f MB/s)\n",
+		narrowMs, mb / (narrowMs / 1000), narrowWrong, toUtf8Ms, mb / (toUtf8Ms / 1000));
+	return true;
+}
+
+int runBench(const Args& a) {
+	using BenchFn = bool (*)(const Args&);
+	const std::pair<const char*, BenchFn> benches[] = {
+		{"vin", benchVin}, {"hash", benchHash}, {"scheduler", benchScheduler}, {"analytics", benchAnalytics},
+		{"descriptions", benchDescriptions}, {"utf", benchUtf}, {"calendar", benchCalendar},
+		{"columns", benchColumns}};
+	std::vector<std::string> names = a.positional;
+	if (names.empty()) { std::cerr << kUsageText; return kUsage; }
+	for (const std::string& name : names) {
+		BenchFn fn = nullptr;
+		for (const auto& [n, f] : benches) if (name == n) fn = f;
+		if (!fn) { std::cerr << "vsrm-cli: unknown benchmark '" << name << "'\n"; return kUsage; }
+		if (!fn(a)) return kFailed;
+		std::cout.flush();
+	}
+	return kOk;
+}
+
+// ---- serve / loadtest ----
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+extern "C" void onStopSignal(int) { stopRequested = 1; }
+
+std::string socketPath(const Args& a) { return option(a, "socket").value_or(a.db + ".sock"); }
+
+void printServerStats(const vsrm::ServerStats& st) {
+	std::cout << sformat("%llu connections, %llu requests (%llu reads, %llu writes in %llu transactions, largest %llu), %llu failed\n",
+		(unsigned long long)st.connections, (unsigned long long)st.requests, (unsigned long long)st.reads,
+		(unsigned long long)st.writes, (unsigned long long)st.writeBatches, (unsigned long long)st.largestBatch,
+		(unsigned long long)st.failed);
+	if (st.maintenancePasses)
+		std::cout << sformat("%llu idle maintenance passes (%.0f ms in all, longest write lock %.1f ms)\n",
+			(unsigned long long)st.maintenancePasses, st.maintenanceMilliseconds, st.longestMaintenanceLock);
+}
+
+bool startServer(const Args& a, vsrm::ServiceServer& server) {
+	std::error_code ec;
+	if (!fs::exists(fs::u8path(a.db), ec)) {
+		std::cerr << "vsrm-cli: database not found: " << a.db << " (run 'vsrm-cli migrate' to create one)\n";
+		return false;
+	}
+	auto readers = intOption(a, "readers", 0), batch = intOption(a, "batch", 256);
+	if (!readers || !batch || *batch <= 0) return false;
+	vsrm::ServerOptions opts;
+	opts.dbPath = a.db;
+	opts.socketPath = socketPath(a);
+	opts.readers = static_cast<int>(*readers);
+	opts.maxWriteBatch = static_cast<size_t>(*batch);
+	auto idleAfter = intOption(a, "idle-after", 30), lockBudget = intOption(a, "lock-budget", 50);
+	if (!idleAfter || !lockBudget || *idleAfter < 0 || *lockBudget <= 0) return false;
+	opts.idleMaintenance = !option(a, "no-maintenance");
+	opts.maintenance.idleAfterMs = static_cast<int>(*idleAfter * 1000);
+	opts.maintenance.lockBudgetMs = static_cast<int>(*lockBudget);
+	std::string error;
+	if (!server.start(opts, error)) { std::cerr << "vsrm-cli: " << error << "\n"; return false; }
+	return true;
+}
+
+int runServe(const Args& a) {
+	if (!a.positional.empty()) { std::cerr << kUsageText; return kUsage; }
+	vsrm::ServiceServer server;
+	if (!startServer(a, server)) return kFailed;
+	std::signal(SIGINT, onStopSignal);
+	std::signal(SIGTERM, onStopSignal);
+	std::cerr << "serving " << a.db << " on " << socketPath(a) << " (Ctrl+C to stop)\n";
+	while (!stopRequested) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	vsrm::ServerStats st = server.stats();
+	server.stop();
+	printServerStats(st);
+	return kOk;
+}
+
+enum class DeskOp { AddRecord, ListRecords, Summaries, Count, Count_ };
+
+constexpr const char* kDeskOpNames[] = {"add_service_record", "list_service_records", "list_vehicle_summaries", "count_service_records"};
+
+struct DeskResult {
+	std::vector<double> latencies[static_cast<int>(DeskOp::Count_)]; // ms
+	uint64_t errors[static_cast<int>(DeskOp::Count_)]{};
+	std::string fatal;
+};
+
+// One service desk: keeps `pipeline` requests in flight, mostly look-ups with some inserts
+void runDesk(const std::string& path, int desk, std::chrono::steady_clock::time_point deadline, int pipeline, int writePercent,
+	const std::vector<std::string>& vins, DeskResult& result) {
+	using Clock = std::chrono::steady_clock;
+	vsrm::ServiceClient client;
+	if (!client.connect(path)) { result.fatal = client.getLastError(); return; }
+	std::mt19937 rng(static_cast<uint32_t>(desk) * 7919u + 1u);
+	const char* mechanics[] = {"Banda", "Mwale", "Phiri", "Tembo", "Zulu", "Lungu"};
+	std::unordered_map<uint32_t, std::pair<DeskOp, Clock::time_point>> inFlight;
+	for (;;) {
+		while (static_cast<int>(inFlight.size()) < pipeline && Clock::now() < deadline) {
+			const std::string& vin = vins[rng() % vins.size()];
+			int roll = static_cast<int>(rng() % 100);
+			vsrm::WireWriter body;
+			DeskOp op;
+			vsrm::Op wireOp;
+			if (roll < writePercent) {
+				vsrm::ServiceRecord r;
+				r.vin = vin;
+				r.customerName = "Desk " + std::to_string(desk) + " customer " + std::to_string(rng() % 500);
+				r.serviceDate = sformat("%04d-%02d-%02d", 2020 + static_cast<int>(rng() % 6), 1 + static_cast<int>(rng() % 12), 1 + static_cast<int>(rng() % 28));
+				r.description = "Load test visit " + std::to_string(rng());
+				r.mechanic = mechanics[rng() % 6];
+				vsrm::writeServiceRecord(body, r);
+				op = DeskOp::AddRecord; wireOp = vsrm::Op::AddServiceRecord;
+			} else if (roll < writePercent + (100 - writePercent) / 2) {
+				body.str(vin);
+				op = DeskOp::ListRecords; wireOp = vsrm::Op::ListServiceRecordsByVin;
+			} else if (roll < 95) {
+				body.str(vin.substr(0, 10));
+				body.optStr(std::nullopt); body.optStr(std::nullopt); body.optStr(std::nullopt);
+				body.u8(0);
+				op = DeskOp::Summaries; wireOp = vsrm::Op::ListVehicleSummaries;
+			} else {
+				op = DeskOp::Count; wireOp = vsrm::Op::CountServiceRecords;
+			}
+			uint32_t id = client.request(wireOp, body.out);
+			inFlight[id] = {op, Clock::now()};
+		}
+		if (inFlight.empty()) break;
+		if (!client.flush()) { result.fatal = client.getLastError(); return; }
+		vsrm::ServiceResponse response;
+		if (!client.receive(response)) { result.fatal = client.getLastError(); return; }
+		auto it = inFlight.find(response.requestId);
+		if (it == inFlight.end()) { result.fatal = "Unexpected response id"; return; }
+		int k = static_cast<int>(it->second.first);
+		if (response.status == vsrm::Status::Ok) result.latencies[k].push_back(msSince(it->second.second));
+		else ++result.errors[k];
+		inFlight.erase(it);
+	}
+}
+
+double percentile(std::vector<double>& sorted, double p) {
+	if (sorted.empty()) return 0;
+	size_t i = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+int runLoadTest(const Args& a) {
+	if (!a.positional.empty()) { std::cerr << kUsageText; return kUsage; }
+	auto desks = intOption(a, "desks", 50), seconds = intOption(a, "seconds", 10), pipeline = intOption(a, "pipeline", 4),
+		writes = intOption(a, "writes", 20);
+	if (!desks || !seconds || !pipeline || !writes) return kUsage;
+	if (*desks <= 0 || *seconds <= 0 || *pipeline <= 0 || *writes < 0 || *writes > 100) {
+		std::cerr << "vsrm-cli: --desks, --seconds and --pipeline must be positive and --writes 0-100\n";
+		return kUsage;
+	}
+	vsrm::ServiceServer server;
+	bool inProcess = option(a, "start-server").has_value();
+	if (inProcess && !startServer(a, server)) return kFailed;
+
+	// A fixed fleet so look-ups hit the vehicles other desks are adding records for
+	const char* prefixes[] = {"4T1BF1FK", "2T3ZF4DV", "5TDKK3DC", "JTDKB20U", "JTHBK1GG", "5TFDW5F1"};
+	std::vector<std::string> vins;
+	for (int i = 0; i < 2000; ++i) {
+		char buf[18];
+		std::snprintf(buf, sizeof(buf), "%s0%c%07d", prefixes[i % 6], "ABCDEFGHJKLMNPRS"[i % 16], i);
+		buf[8] = vsrm::vinCheckDigit(buf);
+		vins.emplace_back(buf);
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	auto deadline = started + std::chrono::seconds(*seconds);
+	std::vector<DeskResult> results(static_cast<size_t>(*desks));
+	std::vector<std::thread> threads;
+	for (int d = 0; d < *desks; ++d) {
+		threads.emplace_back(runDesk, socketPath(a), d, deadline, static_cast<int>(*pipeline), static_cast<int>(*writes),
+			std::cref(vins), std::ref(results[static_cast<size_t>(d)]));
+	}
+	for (auto& t : threads) t.join();
+	double elapsed = msSince(started) / 1000.0;
+
+	int code = kOk;
+	for (size_t d = 0; d < results.size(); ++d) {
+		if (results[d].fatal.empty()) continue;
+		std::cerr << "vsrm-cli: desk " << d << ": " << results[d].fatal << "\n";
+		code = kFailed;
+	}
+	uint64_t total = 0, errors = 0;
+	std::cout << sformat("%d desks, pipeline %lld, %.1f s\n", static_cast<int>(*desks), *pipeline, elapsed);
+	std::cout << sformat("%-24s %9s %7s %9s %9s %9s %9s\n", "request", "ok", "errors", "p50 ms", "p95 ms", "p99 ms", "max ms");
+	for (int k = 0; k < static_cast<int>(DeskOp::Count_); ++k) {
+		std::vector<double> all;
+		uint64_t failed = 0;
+		for (auto& r : results) {
+			all.insert(all.end(), r.latencies[k].begin(), r.latencies[k].end());
+			failed += r.errors[k];
+		}
+		std::sort(all.begin(), all.end());
+		total += all.size();
+		errors += failed;
+		std::cout << sformat("%-24s %9zu %7llu %9.2f %9.2f %9.2f %9.2f\n", kDeskOpNames[k], all.size(), (unsigned long long)failed,
+			percentile(all, 0.5), percentile(all, 0.95), percentile(all, 0.99), all.empty() ? 0.0 : all.back());
+	}
+	std::cout << sformat("%llu requests/s, %llu errors\n", (unsigned long long)(total / elapsed), (unsigned long long)errors);
+	if (inProcess) {
+		printServerStats(server.stats());
+		server.stop();
+	}
+	if (code == kOk && errors) code = kPartial;
+	return code;
+}
+
+// ---- replicate ----
+
+int runReplicate(const Args& a) {
+	const std::string action = a.positional.empty() ? "" : a.positional[0];
+	const size_t args = a.positional.size() - (action.empty() ? 0 : 1);
+	bool usageOk = (action == "enable" && args == 2) || (action == "status" && args == 0) ||
+		(action == "export" && args == 1) || (action == "apply" && args >= 1) || (action == "prune" && args == 0);
+	if (!usageOk) { std::cerr << kUsageText; return kUsage; }
+	vsrm::Database db;
+	if (!openDatabase(db, a.db)) return kFailed;
+	auto fail = [&](const char* what) {
+		std::cerr << "vsrm-cli: " << what << " failed: " << db.getLastError() << "\n";
+		return kFailed;
+	};
+
+	if (action == "enable") {
+		char* end = nullptr;
+		long number = std::strtol(a.positional[1].c_str(), &end, 10);
+		if (*end || number < 1 || number > vsrm::kMaxBranchNumber) {
+			std::cerr << "vsrm-cli: branch number must be 1-" << vsrm::kMaxBranchNumber << "\n";
+			return kUsage;
+		}
+		if (!db.enableReplication(static_cast<int>(number), a.positional[2])) return fail("enable");
+		std::cout << sformat("branch %ld (%s) is recording; ids start at %lld\n", number, a.positional[2].c_str(),
+			(long long)vsrm::branchIdBase(static_cast<int>(number)));
+		return kOk;
+	}
+	if (action == "status") {
+		vsrm::ReplicationStatus st;
+		if (!db.replicationStatus(st)) return fail("status");
+		if (st.recording)
+			std::cout << sformat("branch %d (%s): last commit %lld, exported up to %lld, %lld commits in the outbox\n",
+				st.branchNumber, st.branchName.c_str(), (long long)st.lastSeq, (long long)st.shippedSeq, (long long)st.outboxCommits);
+		else
+			std::cout << sformat("not a branch; changesets applied from %d branches\n", st.appliedBranches);
+		return kOk;
+	}
+	if (action == "export") {
+		std::optional<int64_t> from;
+		if (option(a, "from")) {
+			auto n = intOption(a, "from", 0);
+			if (!n || *n < 1) return kUsage;
+			from = *n;
+		}
+		vsrm::ReplicationExport ex;
+		if (!db.exportChangesets(a.positional[1], from, ex)) return fail("export");
+		if (ex.empty) std::cout << "nothing to export\n";
+		else
+			std::cout << sformat("commits %lld-%lld (%zu) -> %s: %zu bytes of changes, %zu byte file\n",
+				(long long)ex.firstSeq, (long long)ex.lastSeq, ex.commits, a.positional[1].c_str(), ex.changesetBytes, ex.fileBytes);
+		return kOk;
+	}
+	if (action == "prune") {
+		int64_t removed = 0;
+		if (!db.pruneReplicationOutbox(removed)) return fail("prune");
+		std::cout << sformat("%lld exported commits removed\n", (long long)removed);
+		return kOk;
+	}
+	// apply: files in the order given; stop at the first failure so later files do not leave a gap
+	auto policy = option(a, "head-office-wins") ? vsrm::ReplicationConflict::HeadOfficeWins : vsrm::ReplicationConflict::BranchWins;
+	int code = kOk;
+	for (size_t i = 1; i < a.positional.size(); ++i) {
+		vsrm::ReplicationApplyStats st;
+		if (!db.applyChangesetFile(a.positional[i], policy, st)) return fail(("apply " + a.positional[i]).c_str());
+		if (st.alreadyApplied) {
+			std::cout << sformat("%s: branch %d commits %lld-%lld already applied\n", a.positional[i].c_str(), st.branchNumber,
+				(long long)st.firstSeq, (long long)st.lastSeq);
+			continue;
+		}
+		std::cout << sformat("%s: branch %d (%s) commits %lld-%lld: %zu inserts, %zu updates, %zu deletes; "
+			"%zu duplicates, %zu conflicts, %zu skipped (%.0f ms)\n", a.positional[i].c_str(), st.branchNumber,
+			st.branchName.c_str(), (long long)st.firstSeq, (long long)st.lastSeq, st.inserts, st.updates, st.deletes,
+			st.duplicates, st.conflicts, st.skipped, st.milliseconds);
+		if (st.skipped) code = kPartial;
+	}
+	return code;
+}
+
+// ---- backup ----
+
+std::string backupDirectory(const Args& a) {
+	if (auto dir = option(a, "dir")) return *dir;
+	fs::path parent = fs::u8path(a.db).parent_path();
+	std::u8string dir = (parent.empty() ? fs::path("backups") : parent / "backups").u8string();
+	return std::string(dir.begin(), dir.end());
+}
+
+std::string backupPrefix(const Args& a) {
+	std::u8string stem = fs::u8path(a.db).stem().u8string();
+	return stem.empty() ? "vsrm" : std::string(stem.begin(), stem.end());
+}
+
+// A desk's history lookup (the most recent record's VIN) on its own connection, repeated until
+// stop is set, or for `seconds` when that is positive
+std::vector<double> timeDeskQueries(const std::string& dbPath, const std::atomic<bool>& stop, double seconds = 0) {
+	std::vector<double> latencies;
+	vsrm::Database db;
+	if (!db.openOrCreate(dbPath)) return latencies;
+	auto recent = db.fetchRecentServiceRecords(1);
+	const std::string vin = recent.empty() ? "" : recent[0].vin;
+	auto started = std::chrono::steady_clock::now();
+	while (!stop && (seconds <= 0 || msSince(started) < seconds * 1000)) {
+		auto queryStarted = std::chrono::steady_clock::now();
+		db.listServiceRecordsByVin(vin);
+		db.countServiceRecords();
+		latencies.push_back(msSince(queryStarted));
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	std::sort(latencies.begin(), latencies.end());
+	return latencies;
+}
+
+void printLatencies(const char* label, std::vector<double>& sorted) {
+	std::cout << sformat("%-16s %7zu %9.2f %9.2f %9.2f %9.2f\n", label, sorted.size(), percentile(sorted, 0.5),
+		percentile(sorted, 0.95), percentile(sorted, 0.99), sorted.empty() ? 0.0 : sorted.back());
+}
+
+int runBackup(const Args& a) {
+	const std::string action = a.positional.empty() ? "create" : a.positional[0];
+	if (action == "verify") {
+		if (a.positional.size() != 2) { std::cerr << kUsageText; return kUsage; }
+		vsrm::BackupCheck check;
+		std::string error;
+		if (!vsrm::verifyBackup(a.positional[1], check, error)) { std::cerr << "vsrm-cli: verify failed: " << error << "\n"; return kFailed; }
+		for (const auto& p : check.problems) std::cerr << "integrity: " << p << "\n";
+		std::cout << sformat("%s: %s, schema version %d, %lld service records", a.positional[1].c_str(),
+			check.problems.empty() ? "ok" : "DAMAGED", check.schemaVersion, (long long)check.serviceRecords);
+		if (check.partitions) std::cout << sformat(" + %lld archived in %d files", (long long)check.archivedRecords, check.partitions);
+		std::cout << "\n";
+		return check.problems.empty() ? kOk : kPartial;
+	}
+	if (action == "list") {
+		if (a.positional.size() != 1) { std::cerr << kUsageText; return kUsage; }
+		for (const auto& path : vsrm::listBackups(backupDirectory(a), backupPrefix(a))) {
+			std::error_code ec;
+			std::cout << sformat("%12llu  %s\n", (unsigned long long)fs::file_size(fs::u8path(path), ec), path.c_str());
+		}
+		return kOk;
+	}
+	if (action != "create" || a.positional.size() > 1) { std::cerr << kUsageText; return kUsage; }
+	auto keep = intOption(a, "keep", 7), pages = intOption(a, "pages", 64), pause = intOption(a, "pause", 2);
+	if (!keep || !pages || !pause || *keep < 0 || *pages < 1 || *pause < 0) return kUsage;
+	std::error_code ec;
+	if (!fs::exists(fs::u8path(a.db), ec)) { std::cerr << "vsrm-cli: database not found: " << a.db << "\n"; return kFailed; }
+
+	vsrm::BackupOptions opts;
+	opts.directory = backupDirectory(a);
+	opts.prefix = backupPrefix(a);
+	opts.keep = static_cast<int>(*keep);
+	opts.pagesPerStep = static_cast<int>(*pages);
+	opts.pauseMs = static_cast<int>(*pause);
+	opts.compress = !option(a, "no-compress");
+	opts.verify = !option(a, "no-verify");
+
+	// With --measure the same query runs alone first, then alongside the copy
+	const bool measure = option(a, "measure").has_value();
+	std::vector<double> idle, during;
+	std::atomic<bool> stop{false};
+	if (measure) idle = timeDeskQueries(a.db, stop, 2.0);
+
+	vsrm::BackupJob job;
+	if (!job.start(a.db, opts)) return kFailed;
+	std::future<std::vector<double>> foreground;
+	if (measure) foreground = std::async(std::launch::async, [&] { return timeDeskQueries(a.db, stop); });
+	int64_t shown = -1;
+	while (job.running()) {
+		auto p = job.progress();
+		if (p.pageCount && p.pagesDone != shown) {
+			shown = p.pagesDone;
+			std::cerr << (p.pagesDone < p.pageCount ? sformat("\rcopying %lld/%lld pages ", (long long)p.pagesDone, (long long)p.pageCount)
+				: std::string("\rverifying and compressing...  "));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	if (shown >= 0) std::cerr << "\n";
+	stop = true;
+	if (measure) during = foreground.get();
+
+	vsrm::BackupResult r;
+	std::string error;
+	if (!job.wait(r, error)) { std::cerr << "vsrm-cli: backup failed: " << error << "\n"; return kFailed; }
+	std::cout << sformat("%s: %lld pages, %llu bytes -> %llu bytes%s\n", r.path.c_str(), (long long)r.pages,
+		(unsigned long long)r.databaseBytes, (unsigned long long)r.fileBytes, r.compressed ? " (gzip)" : "");
+	for (const auto& archive : r.archives) std::cout << "with " << archive << "\n";
+	std::cout << sformat("copy %.0f ms in %d steps (%d busy, %d restarts), verify %.0f ms%s, compress %.0f ms\n",
+		r.copyMilliseconds, r.steps, r.busyRetries, r.restarts, r.verifyMilliseconds, r.verified ? "" : " (skipped)",
+		r.compressMilliseconds);
+	for (const auto& old : r.removed) std::cout << "removed " << old << "\n";
+	if (measure) {
+		std::cout << sformat("%-16s %7s %9s %9s %9s %9s\n", "desk query", "runs", "p50 ms", "p95 ms", "p99 ms", "max ms");
+		printLatencies("idle", idle);
+		printLatencies("during backup", during);
+	}
+	return kOk;
+}
+
+// ---- archive ----
+
+int runArchive(const Args& a) {
+	const std::string action = a.positional.empty() ? "" : a.positional[0];
+	if (a.positional.size() > 1 || (!action.empty() && action != "list")) { std::cerr << kUsageText; return kUsage; }
+	vsrm::Database db;
+	if (!openDatabase(db, a.db)) return kFailed;
+
+	if (action == "list") {
+		std::vector<vsrm::ArchivePartition> partitions;
+		if (!db.listArchivePartitions(partitions)) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return kFailed; }
+		for (const auto& p : partitions)
+			std::cout << sformat("%d  %9lld records  %s..%s  %s (archived %s)\n", p.year, (long long)p.records,
+				p.firstDate.c_str(), p.lastDate.c_str(), p.file.c_str(), p.archivedAt.c_str());
+		return kOk;
+	}
+	std::string cutoff;
+	if (auto before = option(a, "before")) {
+		cutoff = *before;
+	} else {
+		auto keepYears = intOption(a, "keep-years", 2);
+		if (!keepYears || *keepYears < 1) return kUsage;
+		int year = std::stoi(currentMonth().substr(0, 4));
+		cutoff = sformat("%04d-01-01", year - static_cast<int>(*keepYears) + 1);
+	}
+	vsrm::ArchiveStats st;
+	if (!db.archiveServiceRecords(cutoff, st)) { std::cerr << "vsrm-cli: archive failed: " << db.getLastError() << "\n"; return kFailed; }
+	for (const auto& p : st.partitions)
+		std::cout << sformat("%d: %lld records in %s\n", p.year, (long long)p.records, p.file.c_str());
+	std::cout << sformat("%lld records before %s archived (%.0f ms)\n", (long long)st.moved, cutoff.c_str(), st.milliseconds);
+	return kOk;
+}
+
+// ---- descriptions ----
+
+int runDescriptions(const Args& a) {
+	const std::string action = a.positional.empty() ? "status" : a.positional[0];
+	if (a.positional.size() > 1 || (action != "status" && action != "train" && action != "recompress")) { std::cerr << kUsageText; return kUsage; }
+	vsrm::Database db;
+	if (!openDatabase(db, a.db)) return kFailed;
+
+	if (action == "train") {
+		auto samples = intOption(a, "samples", 20000), size = intOption(a, "size", 8192);
+		if (!samples || !size || *samples <= 0 || *size <= 0) return kUsage;
+		vsrm::DictionaryTrainOptions opts;
+		opts.maxSamples = static_cast<size_t>(*samples);
+		opts.dictionaryBytes = static_cast<size_t>(*size);
+		vsrm::DictionaryTrainStats st;
+		if (!db.trainDescriptionDictionary(opts, st)) { std::cerr << "vsrm-cli: training failed: " << db.getLastError() << "\n"; return kFailed; }
+		std::cout << sformat("dictionary %08x: %zu bytes from %zu descriptions (%.0f ms)%s\n", st.id, st.dictionaryBytes,
+			st.samples, st.milliseconds, st.alreadyStored ? ", already stored" : "");
+		if (st.sampleBytes)
+			std::cout << sformat("samples: %.1f KB -> %.1f KB with the dictionary (%.1f%%), %.1f KB with plain deflate (%.1f%%)\n",
+				st.sampleBytes / 1024.0, st.packedBytes / 1024.0, 100.0 * st.packedBytes / st.sampleBytes,
+				st.plainDeflateBytes / 1024.0, 100.0 * st.plainDeflateBytes / st.sampleBytes);
+		std::cout << "new descriptions are packed with it; 'descriptions recompress' rewrites the stored ones\n";
+		return kOk;
+	}
+	if (action == "recompress") {
+		vsrm::DescriptionRecompressStats st;
+		if (!db.recompressDescriptions(st)) { std::cerr << "vsrm-cli: recompress failed: " << db.getLastError() << "\n"; return kFailed; }
+		std::cout << sformat("%lld descriptions rewritten, %.1f KB -> %.1f KB (%.0f ms)\n", (long long)st.rewritten,
+			st.bytesBefore / 1024.0, st.bytesAfter / 1024.0, st.milliseconds);
+		return kOk;
+	}
+	vsrm::DescriptionStorage st;
+	if (!db.descriptionStorage(st)) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return kFailed; }
+	std::cout << sformat("%lld descriptions, %lld packed (%lld with an older dictionary)\n", (long long)st.rows,
+		(long long)st.packedRows, (long long)st.packedWithOlder);
+	std::cout << sformat("stored %.1f KB for %.1f KB of text (%.1f%%), plus %lld dictionaries (%.1f KB)\n", st.storedBytes / 1024.0,
+		st.textBytes / 1024.0, st.textBytes ? 100.0 * st.storedBytes / st.textBytes : 100.0, (long long)st.dictionaries,
+		st.dictionaryBytes / 1024.0);
+	std::cout << (st.activeId ? sformat("newest dictionary %08x", *st.activeId) : std::string("no dictionary trained"))
+		<< sformat("; reading every description took %.0f ms\n", st.readMilliseconds);
+	return kOk;
+}
+
+std::optional<int64_t> idArgument(const std::string& s) {
+	char* end = nullptr;
+	long long n = std::strtoll(s.c_str(), &end, 10);
+	if (s.empty() || *end || n <= 0) { std::cerr << "vsrm-cli: expected an id, got '" << s << "'\n"; return std::nullopt; }
+	return n;
+}
+
+std::string byteSize(int64_t bytes) {
+	if (bytes < 1024) return sformat("%lld B", (long long)bytes);
+	if (bytes < 1024 * 1024) return sformat("%.1f KB", bytes / 1024.0);
+	return sformat("%.1f MB", bytes / (1024.0 * 1024.0));
+}
+
+int runAttachments(const Args& a) {
+	const std::string action = a.positional.empty() ? "status" : a.positional[0];
+	const size_t operands = action == "add" ? 2 : action == "status" || action == "prune" ? 0 : 1;
+	if (a.positional.size() != (a.positional.empty() ? 0 : 1) + operands ||
+		(action != "add" && action != "list" && action != "get" && action != "thumbnail" && action != "remove" &&
+			action != "prune" && action != "status")) {
+		std::cerr << kUsageText;
+		return kUsage;
+	}
+	std::optional<int64_t> id;
+	if (operands && !(id = idArgument(a.positional[1]))) return kUsage;
+	auto output = option(a, "output");
+	if ((action == "get" || action == "thumbnail") && !output) { std::cerr << "vsrm-cli: attachments " << action << " needs --output FILE\n"; return kUsage; }
+	vsrm::Database db;
+	if (!openDatabase(db, a.db)) return kFailed;
+
+	if (action == "add") {
+		const std::string& path = a.positional[2];
+		std::u8string base = fs::u8path(path).filename().u8string();
+		std::string name = option(a, "name").value_or(std::string(base.begin(), base.end()));
+		vsrm::AttachmentAddResult r;
+		if (!db.addAttachment(*id, path, name, r)) { std::cerr << "vsrm-cli: cannot attach " << path << ": " << db.getLastError() << "\n"; return kFailed; }
+		std::cout << sformat("attachment %lld: %s (%s, %s) on record %lld\n", (long long)r.info.id, r.info.fileName.c_str(),
+			r.info.mediaType.c_str(), byteSize(r.info.size).c_str(), (long long)r.info.serviceRecordId);
+		std::cout << sformat("sha256 %s; hashed in %.0f ms, %s in %.0f ms\n", r.info.sha256.c_str(), r.hashMilliseconds,
+			r.deduplicated ? "content already stored, linked" : "written", r.writeMilliseconds);
+		return kOk;
+	}
+	if (action == "list") {
+		std::vector<vsrm::AttachmentInfo> list;
+		if (!db.listAttachments(*id, list)) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return kFailed; }
+		for (const auto& info : list)
+			std::cout << sformat("%lld\t%s\t%s\t%lld\t%s\t%s\n", (long long)info.id, info.fileName.c_str(), info.mediaType.c_str(),
+				(long long)info.size, info.addedAt.c_str(), info.sha256.c_str());
+		return kOk;
+	}
+	if (action == "get" || action == "thumbnail") {
+		// Written beside the target and renamed into place once complete, so a failure leaves no file behind
+		const fs::path target = fs::u8path(*output);
+		fs::path part = target;
+		part += ".part";
+		auto discard = [&](const std::string& message) {
+			std::error_code ec;
+			fs::remove(part, ec);
+			std::cerr << "vsrm-cli: " << message << "\n";
+			return kFailed;
+		};
+		auto publish = [&] {
+			std::error_code ec;
+			fs::rename(part, target, ec);
+			return !ec;
+		};
+		auto started = std::chrono::steady_clock::now();
+		if (action == "get") {
+			std::ofstream file(part, std::ios::binary);
+			if (!file) { std::cerr << "vsrm-cli: cannot write " << *output << "\n"; return kFailed; }
+			vsrm::AttachmentInfo info;
+			bool ok = db.readAttachment(*id, info, [&](std::string_view chunk) {
+				file.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+				return static_cast<bool>(file);
+			});
+			bool written = ok && file.flush();
+			file.close();
+			if (!written || !publish()) return discard(ok ? "cannot write " + *output : db.getLastError());
+			std::cout << sformat("%s: %s written (%.0f ms)\n", info.fileName.c_str(), byteSize(info.size).c_str(), msSince(started));
+			return kOk;
+		}
+		auto edge = intOption(a, "edge", 160);
+		if (!edge || *edge <= 0) return kUsage;
+		vsrm::ThumbnailImage thumb;
+		bool cached = false;
+		if (!db.attachmentThumbnail(*id, static_cast<int>(*edge), thumb, cached)) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return kFailed; }
+		if (thumb.mediaType.empty()) {
+			std::cerr << "vsrm-cli: attachment " << *id << " has no thumbnail (only JPEGs with an EXIF preview and PNGs do)\n";
+			return kFailed;
+		}
+		std::ofstream file(part, std::ios::binary);
+		file.write(thumb.data.data(), static_cast<std::streamsize>(thumb.data.size()));
+		bool written = file && file.flush();
+		file.close();
+		if (!written || !publish()) return discard("cannot write " + *output);
+		std::cout << sformat("%dx%d %s, %s (%s, %.1f ms)\n", thumb.width, thumb.height, thumb.mediaType.c_str(),
+			byteSize(static_cast<int64_t>(thumb.data.size())).c_str(), cached ? "cached" : "made now", msSince(started));
+		return kOk;
+	}
+	if (action == "remove") {
+		bool freed = false;
+		if (!db.removeAttachment(*id, freed)) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return kFailed; }
+		std::cout << "attachment " << *id << " removed" << (freed ? ", its content with it" : "; its content is still attached elsewhere") << "\n";
+		return kOk;
+	}
+	if (action == "prune") {
+		int64_t removed = 0, freed = 0;
+		if (!db.pruneOrphanedAttachments(removed, freed)) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return kFailed; }
+		std::cout << sformat("%lld attachments of deleted records removed, %lld stored files freed\n", (long long)removed, (long long)freed);
+		return kOk;
+	}
+	vsrm::AttachmentStorage st;
+	if (!db.attachmentStorage(st)) { std::cerr << "vsrm-cli: " << db.getLastError() << "\n"; return kFailed; }
+	std::cout << sformat("%lld attachments (%s) stored as %lld distinct files (%s)\n", (long long)st.attachments,
+		byteSize(st.attachedBytes).c_str(), (long long)st.contents, byteSize(st.storedBytes).c_str());
+	std::cout << sformat("%lld cached thumbnails (%s)\n", (long long)st.thumbnails, byteSize(st.thumbnailBytes).c_str());
+	return kOk;
+}
+
+int run(const std::vector<std::string>& argv) {
+	auto parsed = parseArgs(argv);
+	if (!parsed) return kUsage;
+	const Args& a = *parsed;
+	if (a.command.empty() || a.command == "help" || option(a, "help")) {
+		std::cout << kUsageText;
+		return a.command.empty() && !option(a, "help") ? kUsage : kOk;
+	}
+	if (a.command == "import") return runImport(a);
+	if (a.command == "export") return runExport(a);
+	if (a.command == "report") return runReports(a);
+	if (a.command == "maintenance") return runMaintenance(a);
+	if (a.command == "migrate") return runMigrate(a);
+	if (a.command == "bench") return runBench(a);
+	if (a.command == "serve") return runServe(a);
+	if (a.command == "loadtest") return runLoadTest(a);
+	if (a.command == "replicate") return runReplicate(a);
+	if (a.command == "backup") return runBackup(a);
+	if (a.command == "archive") return runArchive(a);
+	if (a.command == "descriptions") return runDescriptions(a);
+	if (a.command == "attachments") return runAttachments(a);
+	std::cerr << "vsrm-cli: unknown command '" << a.command << "'\n" << kUsageText;
+	return kUsage;
+}
+
+} // namespace
+
+// Arguments are handed on as UTF-8, which is what Database expects for paths
+#ifdef _WIN32
+int wmain(int argc, wchar_t** argv) {
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; ++i) args.push_back(vsrm::toUtf8(reinterpret_cast<const char16_t*>(argv[i])));
+	return run(args);
+}
+#else
+int main(int argc, char** argv) {
+	std::ios::sync_with_stdio(false);
+	return run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
@@ -1,19 +1,48 @@
 #include <windows.h>
+#include <algorithm>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <commctrl.h>
+#include <commdlg.h>
 #include <gdiplus.h>
 #include <shlobj.h>
 #include <fstream>
+#include <thread>
+#include <chrono>
 
+#include "../app/Analytics.h"
+#include "../app/Backup.h"
 #include "../app/Database.h"
+#include "../app/Dates.h"
+#include "../app/GridDiff.h"
+#include "../app/GridSnapshot.h"
+#include "../app/PasswordHash.h"
+#include "../app/Scheduler.h"
+#include "../app/Sha256.h"
+#include "../app/Utf.h"
+#include "../app/VinDecoder.h"
 
 namespace fs = std::filesystem;
 
-static std::wstring W(const std::string& s) {
-	return std::wstring(s.begin(), s.end());
+static_assert(sizeof(wchar_t) == sizeof(char16_t), "Win32 wide strings are UTF-16");
+
+// UTF-8 (data layer) -> UTF-16 (Win32)
+static std::wstring W(std::string_view s) {
+	std::wstring out(s.size(), L'\0');
+	out.resize(vsrm::utf8ToUtf16(s.data(), s.size(), reinterpret_cast<char16_t*>(out.data())));
+	return out;
+}
+
+// UTF-16 (Win32) -> UTF-8 (data layer)
+static std::string N(const wchar_t* w, size_t len) {
+	std::string out(len * 3, '\0');
+	out.resize(vsrm::utf16ToUtf8(reinterpret_cast<const char16_t*>(w), len, out.data()));
+	return out;
 }
+static std::string N(const wchar_t* w) { return N(w, wcslen(w)); }
+static std::string N(const std::wstring& w) { return N(w.data(), w.size()); }
 
 // Edit control helpers for placeholders/padding (may require Common Controls v6)
 #ifndef ECM_FIRST
@@ -33,7 +62,7 @@ static std::wstring W(const std::string& s) {
 #endif
 
 static void ShowError(HWND hwnd, const wchar_t* title, const std::string& msg) {
-	std::wstring wmsg(msg.begin(), msg.end());
+	std::wstring wmsg = W(msg);
 	MessageBoxW(hwnd, wmsg.c_str(), title, MB_ICONERROR | MB_OK);
 }
 
@@ -196,7 +225,7 @@ static LRESULT CALLBACK LoginProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPa
         }
         if (id == 6003) {
             wchar_t u[128], p[128]; GetWindowTextW(ctx->eUser, u, 128); GetWindowTextW(ctx->ePass, p, 128);
-            std::string su(u, u + wcslen(u)); std::string sp(p, p + wcslen(p));
+            std::string su = N(u); std::string sp = N(p);
             ctx->authed = (su == "admin" && sp == "admin");
             if (!ctx->authed) MessageBoxW(hwnd, L"Invalid credentials", L"Login", MB_ICONWARNING);
             else DestroyWindow(hwnd);
@@ -233,6 +262,7 @@ static bool ShowLoginDialog(AppState* state, HINSTANCE hInst, HFONT hFont) {
 struct AppState {
 	vsrm::Database db;
 	std::wstring dbPath;
+    bool backupRunning{false};
     HFONT hFont{};
     HBRUSH hBg{};           // main background
     HBRUSH hHeaderBg{};     // banner background
@@ -263,11 +293,25 @@ struct AppState {
     HWND hChkDue{};
     // Data grid
     HWND hList{};
+    vsrm::Utf16Arena gridText; // reused UTF-16 cell buffer for grid refreshes
+    std::vector<vsrm::VehicleSummary> gridRows; // rows currently shown, in display order
+    struct GridFilter {
+        std::string vinLike;
+        std::optional<std::string> from, to, mech;
+        bool dueOnly{};
+        bool operator==(const GridFilter&) const = default;
+    } gridFilter;
+    bool gridLoaded{false};
+    uint64_t gridChangeSeq{0}; // last Database::changeSequence() reflected in the grid
+    std::optional<uint32_t> gridDbCounter; // Database::fileChangeCounter() read before the rows were queried
+    std::wstring snapshotPath;
     // Views
     enum class View { Vehicles, Reports } currentView{ View::Vehicles };
     HWND hReportsPanel{};
     // Settings persistence
     std::wstring settingsPath;
+    // Schema migrations applied at startup (shown once the window exists)
+    std::vector<vsrm::MigrationStep> migrations;
 };
 
 static const wchar_t* kClassName = L"VSRMMainWindow";
@@ -307,6 +351,32 @@ static void LoadUiSettings(AppState* state) {
     }
 }
 
+// Reports panel metrics from the per-month sketches: constant-time regardless of table size
+static void RefreshReportMetrics(AppState* state) {
+    HWND metrics = GetDlgItem(state->hReportsPanel, 4412);
+    if (!metrics) return;
+    SYSTEMTIME st{}; GetLocalTime(&st);
+    wchar_t from[8], to[8];
+    int fromYear = st.wYear - (st.wMonth == 12 ? 0 : 1), fromMonth = st.wMonth % 12 + 1;
+    swprintf_s(from, L"%04d-%02d", fromYear, fromMonth);
+    swprintf_s(to, L"%04u-%02u", st.wYear, st.wMonth);
+    vsrm::SketchSummary s;
+    if (!state->db.sketchSummary(N(from), N(to), s)) { SetWindowTextW(metrics, W(state->db.getLastError()).c_str()); return; }
+    wchar_t line[256];
+    swprintf_s(line, L"Last 12 months (%ls to %ls): %llu service records\r\n", from, to, (unsigned long long)s.records);
+    std::wstring text = line;
+    swprintf_s(line, L"Distinct customers ~%.0f, vehicles ~%.0f (\u00B1%.1f%%)\r\n\r\n",
+        s.distinctCustomers, s.distinctVins, s.distinctRelativeError * 100.0);
+    text += line;
+    swprintf_s(line, L"Top mechanics / services (may overcount by up to %llu, %.0f%% confidence):\r\n",
+        (unsigned long long)s.countErrorBound, s.countConfidence * 100.0);
+    text += line;
+    for (const auto& m : s.topMechanics) text += L"  " + W(m.key) + L"  " + std::to_wstring(m.estimate) + L"\r\n";
+    text += L"\r\n";
+    for (const auto& k : s.topKeywords) text += L"  " + W(k.key) + L"  " + std::to_wstring(k.estimate) + L"\r\n";
+    SetWindowTextW(metrics, text.c_str());
+}
+
 static void SwitchView(HWND hwnd, AppState* state, AppState::View view) {
     state->currentView = view;
     BOOL veh = (view == AppState::View::Vehicles);
@@ -317,6 +387,7 @@ static void SwitchView(HWND hwnd, AppState* state, AppState::View view) {
     ShowWindow(state->hChkDue, veh ? SW_SHOW : SW_HIDE);
     ShowWindow(state->hList, veh ? SW_SHOW : SW_HIDE);
     ShowWindow(state->hReportsPanel, veh ? SW_HIDE : SW_SHOW);
+    if (!veh) RefreshReportMetrics(state);
     InvalidateRect(hwnd, nullptr, TRUE);
 }
 
@@ -358,11 +429,11 @@ static void OpenRecordEditor(HWND parent, AppState* state, const std::string& vi
             int id = LOWORD(m.wParam);
             if (id == 5190) {
                 wchar_t wb[512]; vsrm::ServiceRecord rec{};
-                GetWindowTextW(eVin, wb, 512); rec.vin = std::string(wb, wb + wcslen(wb));
-                GetWindowTextW(eCust, wb, 512); rec.customerName = std::string(wb, wb + wcslen(wb));
-                GetWindowTextW(eDate, wb, 512); rec.serviceDate = std::string(wb, wb + wcslen(wb));
-                GetWindowTextW(eDesc, wb, 512); rec.description = std::string(wb, wb + wcslen(wb));
-                GetWindowTextW(eMech, wb, 512); rec.mechanic = std::string(wb, wb + wcslen(wb));
+                GetWindowTextW(eVin, wb, 512); rec.vin = N(wb);
+                GetWindowTextW(eCust, wb, 512); rec.customerName = N(wb);
+                GetWindowTextW(eDate, wb, 512); rec.serviceDate = N(wb);
+                GetWindowTextW(eDesc, wb, 512); rec.description = N(wb);
+                GetWindowTextW(eMech, wb, 512); rec.mechanic = N(wb);
                 if (rec.vin.empty() || rec.customerName.empty() || rec.serviceDate.empty()) {
                     MessageBoxW(dlg, L"Please fill VIN, Customer and Date.", L"Validation", MB_ICONWARNING);
                 } else {
@@ -435,11 +506,11 @@ static void ShowAddRecordDialog(HWND parent, AppState* state) {
             if (id == IDC_BTN_SAVE) {
                 wchar_t wbuf[512];
                 vsrm::ServiceRecord rec{};
-                GetWindowTextW(eVin, wbuf, 512); rec.vin = std::string(wbuf, wbuf + wcslen(wbuf));
-                GetWindowTextW(eCust, wbuf, 512); rec.customerName = std::string(wbuf, wbuf + wcslen(wbuf));
-                GetWindowTextW(eDate, wbuf, 512); rec.serviceDate = std::string(wbuf, wbuf + wcslen(wbuf));
-                GetWindowTextW(eDesc, wbuf, 512); rec.description = std::string(wbuf, wbuf + wcslen(wbuf));
-                GetWindowTextW(eMech, wbuf, 512); rec.mechanic = std::string(wbuf, wbuf + wcslen(wbuf));
+                GetWindowTextW(eVin, wbuf, 512); rec.vin = N(wbuf);
+                GetWindowTextW(eCust, wbuf, 512); rec.customerName = N(wbuf);
+                GetWindowTextW(eDate, wbuf, 512); rec.serviceDate = N(wbuf);
+                GetWindowTextW(eDesc, wbuf, 512); rec.description = N(wbuf);
+                GetWindowTextW(eMech, wbuf, 512); rec.mechanic = N(wbuf);
                 if (rec.vin.empty() || rec.customerName.empty() || rec.serviceDate.empty()) {
                     MessageBoxW(dlg, L"Please fill VIN, Customer, and Date.", L"Validation", MB_ICONWARNING);
                 } else {
@@ -501,8 +572,8 @@ static void ShowManageMechanicsDialog(HWND parent, AppState* state) {
                         int id2 = LOWORD(m.wParam);
                         if (id2 == IDC_MECH_OK) {
                             wchar_t wbuf[512]; vsrm::Mechanic mm{};
-                            GetWindowTextW(eName, wbuf, 512); mm.name = std::string(wbuf, wbuf + wcslen(wbuf));
-                            GetWindowTextW(eSkill, wbuf, 512); mm.skill = std::string(wbuf, wbuf + wcslen(wbuf));
+                            GetWindowTextW(eName, wbuf, 512); mm.name = N(wbuf);
+                            GetWindowTextW(eSkill, wbuf, 512); mm.skill = N(wbuf);
                             mm.active = (SendMessageW(chkActive, BM_GETCHECK, 0, 0) == BST_CHECKED);
                             if (mm.name.empty() || mm.skill.empty()) {
                                 MessageBoxW(addDlg, L"Please enter name and skill.", L"Validation", MB_ICONWARNING);
@@ -546,6 +617,229 @@ static std::wstring GetExecutableDir() {
 	return p.parent_path().wstring();
 }
 
+// Brings the grid in line with `rows`, touching only inserted, removed or changed rows.
+// Returns the number of row operations applied.
+static size_t ApplyGridRows(AppState* state, std::vector<vsrm::VehicleSummary>&& rows) {
+    auto ops = vsrm::diffVehicleSummaries(state->gridRows, rows);
+    // Convert only the cells that are about to be written (7 strings per row) into one UTF-16 arena
+    vsrm::Utf16Arena& cells = state->gridText;
+    cells.clear();
+    for (const auto& op : ops) {
+        if (op.kind == vsrm::GridOp::Kind::Remove) continue;
+        const auto& v = rows[op.source];
+        cells.add(v.vin); cells.add(v.make); cells.add(v.model); cells.add(v.lastServiceDate);
+        cells.add(v.mechanic); cells.add(v.nextService ? std::string_view(*v.nextService) : std::string_view()); cells.add(v.status);
+    }
+    auto cell = [&](size_t base, int col) { return const_cast<LPWSTR>(reinterpret_cast<const wchar_t*>(cells.at(base + col))); };
+    if (!ops.empty()) SendMessageW(state->hList, WM_SETREDRAW, FALSE, 0);
+    size_t base = 0;
+    LVITEMW it{}; it.mask = LVIF_TEXT;
+    for (const auto& op : ops) {
+        if (op.kind == vsrm::GridOp::Kind::Remove) { ListView_DeleteItem(state->hList, op.row); continue; }
+        if (op.kind == vsrm::GridOp::Kind::Insert) {
+            it.iItem = op.row; it.iSubItem = 0; it.pszText = cell(base, 0); ListView_InsertItem(state->hList, &it);
+        } else {
+            ListView_SetItemText(state->hList, op.row, 0, cell(base, 0));
+        }
+        for (int c = 1; c < 7; ++c) ListView_SetItemText(state->hList, op.row, c, cell(base, c));
+        base += 7;
+    }
+    if (!ops.empty()) {
+        SendMessageW(state->hList, WM_SETREDRAW, TRUE, 0);
+        InvalidateRect(state->hList, nullptr, TRUE);
+    }
+    state->gridRows = std::move(rows);
+    state->gridLoaded = true;
+    return ops.size();
+}
+
+static AppState::GridFilter ReadGridFilter(AppState* state) {
+    wchar_t wbuf[256];
+    AppState::GridFilter f{};
+    GetWindowTextW(state->hSearchVin, wbuf, 256); f.vinLike = N(wbuf);
+    GetWindowTextW(state->hSearchDateFrom, wbuf, 256); f.from = wcslen(wbuf) ? std::optional<std::string>(N(wbuf)) : std::nullopt;
+    GetWindowTextW(state->hSearchDateTo, wbuf, 256); f.to = wcslen(wbuf) ? std::optional<std::string>(N(wbuf)) : std::nullopt;
+    GetWindowTextW(state->hSearchMechanic, wbuf, 256); f.mech = wcslen(wbuf) ? std::optional<std::string>(N(wbuf)) : std::nullopt;
+    f.dueOnly = (SendMessageW(state->hChkDue, BM_GETCHECK, 0, 0) == BST_CHECKED);
+    return f;
+}
+
+// Posted by the snapshot revalidation thread; lParam owns a GridRefresh
+static const UINT WM_APP_GRID_FRESH = WM_APP + 1;
+struct GridRefresh {
+    AppState::GridFilter filter;
+    std::optional<uint32_t> dbCounter;
+    std::vector<vsrm::VehicleSummary> rows;
+};
+
+// Posted by the service-due recompute thread; lParam owns a ServiceDueDone
+static const UINT WM_APP_DUE_DONE = WM_APP + 2;
+struct ServiceDueDone {
+    bool ok{false};
+    std::string error;
+    vsrm::ServiceDueStats stats;
+};
+
+// Runs the prediction on its own connection so the UI stays responsive; the
+// worker threads inside open their own read-only connections.
+static void RecomputeServiceDue(HWND hwnd, AppState* state) {
+    std::string dbPath = N(state->dbPath);
+    std::thread([hwnd, dbPath] {
+        auto* done = new ServiceDueDone{};
+        vsrm::Database bg;
+        if (!bg.openOrCreate(dbPath)) done->error = bg.getLastError();
+        else if (!(done->ok = bg.recomputeServiceDue(vsrm::workshopDueRules(), 0, &done->stats))) done->error = bg.getLastError();
+        if (!PostMessageW(hwnd, WM_APP_DUE_DONE, 0, (LPARAM)done)) delete done;
+    }).detach();
+}
+
+// Posted by the analytics threads; lParam owns an AnalyticsDone
+static const UINT WM_APP_ANALYTICS_DONE = WM_APP + 3;
+struct AnalyticsDone {
+    bool ok{false};
+    std::string error;
+    std::wstring text;
+};
+
+static std::wstring FormatAnalytics(const vsrm::AnalyticsReport& r) {
+    wchar_t line[256];
+    swprintf_s(line, L"Analytics: %lld records, %d threads, %d partitions, %.0f ms\r\n",
+        (long long)r.records, r.threads, r.partitions, r.milliseconds);
+    std::wstring out = line;
+    swprintf_s(line, L"  Vehicles %lld (repeat %.1f%%), customers %lld (repeat %.1f%%)\r\n",
+        (long long)r.vehicles, r.vehicleRepeatRate() * 100.0, (long long)r.customers, r.customerRepeatRate() * 100.0);
+    out += line;
+    out += L"  Visits per month:\r\n";
+    for (const auto& b : r.byMonth) out += L"    " + W(b.key) + L"  " + std::to_wstring(b.visits) + L"\r\n";
+    out += L"  Mechanic throughput:\r\n";
+    for (const auto& b : r.byMechanic) out += L"    " + W(b.key) + L"  " + std::to_wstring(b.visits) + L"\r\n";
+    out += L"  Top customers:\r\n";
+    for (size_t i = 0; i < r.byCustomer.size() && i < 10; ++i) {
+        const auto& b = r.byCustomer[i];
+        out += L"    " + W(b.key) + L"  " + std::to_wstring(b.visits) + L" visits, " + std::to_wstring(b.vehicles) + L" vehicles\r\n";
+    }
+    return out;
+}
+
+static void RunAnalyticsReport(HWND hwnd, AppState* state) {
+    std::string dbPath = N(state->dbPath);
+    std::thread([hwnd, dbPath] {
+        auto* done = new AnalyticsDone{};
+        vsrm::AnalyticsReport report;
+        if ((done->ok = vsrm::runAnalytics(dbPath, {}, report, done->error))) done->text = FormatAnalytics(report);
+        if (!PostMessageW(hwnd, WM_APP_ANALYTICS_DONE, 0, (LPARAM)done)) delete done;
+    }).detach();
+}
+
+// Builds a 10M-row scratch database next to the executable (once) and times the engine
+// at doubling thread counts up to the core count.
+static void BenchmarkAnalytics(HWND hwnd, const std::wstring& exeDir) {
+    std::string benchPath = N(exeDir + L"/vsrm_analytics_bench.db");
+    std::thread([hwnd, benchPath] {
+        auto* done = new AnalyticsDone{};
+        constexpr int64_t kRows = 10'000'000;
+        std::error_code ec;
+        if (!fs::exists(fs::path(std::u8string(benchPath.begin(), benchPath.end())), ec) &&
+            !vsrm::writeSyntheticServiceDatabase(benchPath, kRows, 1, done->error)) {
+            if (!PostMessageW(hwnd, WM_APP_ANALYTICS_DONE, 0, (LPARAM)done)) delete done;
+            return;
+        }
+        done->ok = true;
+        done->text = L"Analytics scaling benchmark (10M synthetic rows):\r\n";
+        int cores = (int)std::thread::hardware_concurrency();
+        if (cores < 1) cores = 1;
+        std::vector<int> counts;
+        for (int t = 1; t < cores; t *= 2) counts.push_back(t);
+        counts.push_back(cores);
+        double base = 0;
+        for (int t : counts) {
+            vsrm::AnalyticsOptions opts; opts.threads = t;
+            vsrm::AnalyticsReport report;
+            if (!vsrm::runAnalytics(benchPath, opts, report, done->error)) { done->ok = false; break; }
+            if (t == 1) base = report.milliseconds;
+            wchar_t line[160];
+            swprintf_s(line, L"  %2d threads: %.0f ms (%.2fx)\r\n", t, report.milliseconds, report.milliseconds > 0 ? base / report.milliseconds : 0.0);
+            done->text += line;
+        }
+        if (!PostMessageW(hwnd, WM_APP_ANALYTICS_DONE, 0, (LPARAM)done)) delete done;
+    }).detach();
+}
+
+// Posted by the backup thread: WM_APP_BACKUP_PROGRESS carries the percent copied in wParam,
+// WM_APP_BACKUP_DONE owns a BackupDone in lParam
+static const UINT WM_APP_BACKUP_PROGRESS = WM_APP + 4;
+static const UINT WM_APP_BACKUP_DONE = WM_APP + 5;
+static const UINT_PTR IDT_IDLE_MAINTENANCE = 5001;
+struct BackupDone {
+    bool ok{false};
+    std::string error;
+    vsrm::BackupResult result;
+};
+
+// Online copy into backups\ beside the database; the grid keeps working while it runs
+static void BackUpDatabase(HWND hwnd, AppState* state) {
+    std::string dbPath = N(state->dbPath);
+    fs::path db(state->dbPath);
+    vsrm::BackupOptions opts;
+    opts.directory = N((db.parent_path() / L"backups").wstring());
+    opts.prefix = N(db.stem().wstring());
+    state->backupRunning = true;
+    std::thread([hwnd, dbPath, opts] {
+        auto* done = new BackupDone{};
+        int shown = -1;
+        done->ok = vsrm::backupDatabase(dbPath, opts, done->result, done->error, [&](const vsrm::BackupProgress& p) {
+            int percent = p.pageCount ? (int)(p.pagesDone * 100 / p.pageCount) : 0;
+            if (percent != shown) { shown = percent; PostMessageW(hwnd, WM_APP_BACKUP_PROGRESS, (WPARAM)percent, 0); }
+            return true;
+        });
+        if (!PostMessageW(hwnd, WM_APP_BACKUP_DONE, 0, (LPARAM)done)) delete done;
+    }).detach();
+}
+
+static void SaveGridSnapshot(AppState* state) {
+    if (!state || !state->gridLoaded) return;
+    vsrm::GridSnapshot snap;
+    snap.filter.vinLike = state->gridFilter.vinLike;
+    snap.filter.fromDate = state->gridFilter.from;
+    snap.filter.toDate = state->gridFilter.to;
+    snap.filter.mechanicLike = state->gridFilter.mech;
+    snap.filter.dueOnly = state->gridFilter.dueOnly;
+    snap.dbChangeCounter = state->gridDbCounter;
+    snap.rows = state->gridRows;
+    std::string err;
+    vsrm::GridSnapshotFile::write(N(state->snapshotPath), snap, err); // best effort; next launch just starts cold
+}
+
+// Warm start: show the grid persisted on exit right away, then re-check it on a
+// separate connection and swap in fresh rows only if the database moved on.
+static bool LoadGridSnapshot(HWND hwnd, AppState* state) {
+    vsrm::GridSnapshot snap;
+    {
+        vsrm::GridSnapshotFile file; std::string err;
+        if (!file.open(N(state->snapshotPath), err)) return false;
+        snap = file.load();
+    }
+    AppState::GridFilter f = ReadGridFilter(state);
+    if (f.vinLike != snap.filter.vinLike || f.from != snap.filter.fromDate || f.to != snap.filter.toDate ||
+        f.mech != snap.filter.mechanicLike || f.dueOnly != snap.filter.dueOnly) return false; // taken with other filters
+    ApplyGridRows(state, std::move(snap.rows));
+    state->gridFilter = f;
+    state->gridDbCounter = snap.dbChangeCounter;
+    state->gridChangeSeq = state->db.changeSequence();
+
+    std::string dbPath = N(state->dbPath);
+    std::optional<uint32_t> seen = snap.dbChangeCounter;
+    std::thread([hwnd, dbPath, f, seen] {
+        vsrm::Database bg;
+        if (!bg.openOrCreate(dbPath)) return;
+        auto counter = bg.fileChangeCounter();
+        if (seen && counter == seen) return; // nothing committed since the snapshot was taken
+        auto* fresh = new GridRefresh{ f, counter, bg.listVehicleSummaries(f.vinLike, f.from, f.to, f.mech, f.dueOnly) };
+        if (!PostMessageW(hwnd, WM_APP_GRID_FRESH, 0, (LPARAM)fresh)) delete fresh;
+    }).detach();
+    return true;
+}
+
 static void AppendText(HWND edit, const std::wstring& text) {
 	int len = GetWindowTextLengthW(edit);
 	SendMessageW(edit, EM_SETSEL, (WPARAM)len, (LPARAM)len);
@@ -691,6 +985,19 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
         // Persisted UI settings
         state->settingsPath = exeDir + L"/ui.settings";
         LoadUiSettings(state);
+        state->snapshotPath = exeDir + L"/grid.snapshot";
+        if (LoadGridSnapshot(hwnd, state)) SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Showing saved grid; checking for changes...");
+        for (const auto& m : state->migrations) {
+            wchar_t line[160];
+            swprintf_s(line, L"Applied schema migration %d (%s) in %.1f ms\r\n", m.version, W(m.name).c_str(), m.milliseconds);
+            AppendText(hEdit, line);
+        }
+        if (!state->migrations.empty()) {
+            std::wstring msgText = L"Database upgraded to schema v" + std::to_wstring(state->migrations.back().version);
+            SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)msgText.c_str());
+        }
+        // The scheduler decides whether the database has been idle long enough; ticks are cheap
+        SetTimer(hwnd, IDT_IDLE_MAINTENANCE, 5000, nullptr);
 		return 0;
 	}
 	case WM_SIZE: {
@@ -739,7 +1046,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                 int sel = ListView_GetNextItem(state->hList, -1, LVNI_SELECTED);
                 if (sel >= 0) {
                     wchar_t wvin[256]; ListView_GetItemText(state->hList, sel, 0, wvin, 256);
-                    OpenRecordEditor(hwnd, state, std::string(wvin, wvin + wcslen(wvin)));
+                    OpenRecordEditor(hwnd, state, N(wvin));
                     SendMessageW(hwnd, WM_COMMAND, 2501, 0);
 		}
 		return 0;
@@ -827,6 +1134,53 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             SendMessageW(hwnd, WM_COMMAND, 2501, 0); // Refresh
 			return 0;
 		}
+		if (LOWORD(wParam) == 2006) { // Back up now
+			if (state->backupRunning) { SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"A backup is already running"); return 0; }
+			BackUpDatabase(hwnd, state);
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Backing up...");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2004 || LOWORD(wParam) == 2005) { // Import CSV; rows already stored are recognised by fingerprint
+			wchar_t file[MAX_PATH] = L"";
+			OPENFILENAMEW ofn{}; ofn.lStructSize = sizeof(ofn); ofn.hwndOwner = hwnd;
+			ofn.lpstrFilter = L"CSV files (*.csv)\0*.csv\0All files\0*.*\0"; ofn.lpstrFile = file; ofn.nMaxFile = MAX_PATH;
+			ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+			if (!GetOpenFileNameW(&ofn)) return 0;
+			auto policy = LOWORD(wParam) == 2005 ? vsrm::ImportConflict::Merge : vsrm::ImportConflict::Skip;
+			vsrm::ImportStats st;
+			if (!state->db.importServiceRecordsCsv(N(file), policy, st)) { ShowError(hwnd, L"Import Failed", state->db.getLastError()); return 0; }
+			wchar_t line[256];
+			swprintf_s(line, L"Imported %ls: %zu rows, %zu inserted, %zu skipped, %zu merged, %zu rejected (%.0f ms)\r\n",
+				file, st.rows, st.inserted, st.skipped, st.merged, st.rejected, st.milliseconds);
+			AppendText(hEdit, line);
+			swprintf_s(line, L"  Bloom filter: %zu rows known new without a lookup, %zu lookups, %zu false positives\r\n",
+				st.probesAvoided, st.probes, st.falsePositives);
+			AppendText(hEdit, line);
+			for (const auto& e : st.errors) AppendText(hEdit, L"  " + W(e) + L"\r\n");
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Import finished");
+			SendMessageW(hwnd, WM_COMMAND, 2501, 0); // Refresh
+			return 0;
+		}
+		if (LOWORD(wParam) == 2007) { // Attach a photo or document; identical files are stored once
+			auto rows = state->db.listServiceRecordsByVin("JT123TESTVIN00001");
+			if (rows.empty()) { ShowError(hwnd, L"Attach File", "The sample VIN has no service records yet."); return 0; }
+			auto latest = std::max_element(rows.begin(), rows.end(), [](const auto& x, const auto& y) { return x.serviceDate < y.serviceDate; });
+			wchar_t file[MAX_PATH] = L"";
+			OPENFILENAMEW ofn{}; ofn.lStructSize = sizeof(ofn); ofn.hwndOwner = hwnd;
+			ofn.lpstrFilter = L"Photos and documents (*.jpg;*.jpeg;*.png;*.pdf)\0*.jpg;*.jpeg;*.png;*.pdf\0All files\0*.*\0";
+			ofn.lpstrFile = file; ofn.nMaxFile = MAX_PATH;
+			ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+			if (!GetOpenFileNameW(&ofn)) return 0;
+			vsrm::AttachmentAddResult r;
+			if (!state->db.addAttachment(latest->id, N(file), N(file + ofn.nFileOffset), r)) { ShowError(hwnd, L"Attach Failed", state->db.getLastError()); return 0; }
+			wchar_t line[512];
+			swprintf_s(line, L"Attached %ls to record %lld as attachment %lld (%ls, %lld bytes, %ls)\r\n", file + ofn.nFileOffset,
+				(long long)latest->id, (long long)r.info.id, W(r.info.mediaType).c_str(), (long long)r.info.size,
+				r.deduplicated ? L"same content already stored" : L"stored");
+			AppendText(hEdit, line);
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"File attached");
+			return 0;
+		}
 		if (LOWORD(wParam) == 2002) { // Query by VIN
 			auto rows = state->db.listServiceRecordsByVin("JT123TESTVIN00001");
 			AppendText(hEdit, L"Records for VIN JT123TESTVIN00001:\r\n");
@@ -864,22 +1218,141 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 			}
 			return 0;
 		}
+		if (LOWORD(wParam) == 2203) { // Conflicts for the sample slot, then mechanic 1's free time that day
+			auto conflicts = state->db.findBookingConflicts("2025-09-20T09:00:00", 60, 1, std::string("JT123TESTVIN00001"));
+			AppendText(hEdit, std::wstring(L"Conflicts for 2025-09-20 09:00 (60 min, mechanic 1 / sample VIN): ") + std::to_wstring(conflicts.size()) + L"\r\n");
+			for (const auto& c : conflicts) {
+				std::wstring who = c.kind == vsrm::BookingConflict::Kind::Mechanic ? L"mechanic busy" : L"vehicle booked";
+				AppendText(hEdit, L"  [" + std::to_wstring(c.appointmentId) + L"] " + who + L" " + W(c.startsAt) + L" - " + W(c.endsAt) + L" (" + W(c.vin) + L")\r\n");
+			}
+			AppendText(hEdit, L"Free slots for mechanic 1 (08:00-17:00, 30 min or longer):\r\n");
+			for (const auto& f : state->db.findFreeSlots(1, "2025-09-20T08:00:00", "2025-09-20T17:00:00", 30))
+				AppendText(hEdit, L"  " + W(f.startsAt) + L" - " + W(f.endsAt) + L"\r\n");
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Checked booking conflicts");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2204) { // Merged history for the sample VIN, one page at a time
+			AppendText(hEdit, L"Timeline for sample VIN:\r\n");
+			std::optional<std::string> cursor;
+			int pages = 0;
+			do {
+				vsrm::TimelinePage page;
+				if (!state->db.vehicleTimeline("JT123TESTVIN00001", 50, cursor, page)) { ShowError(hwnd, L"DB Error", state->db.getLastError()); return 0; }
+				for (const auto& e : page.events) AppendText(hEdit, L"  " + W(e.at) + L"  " + W(e.title) + L" - " + W(e.detail) + L"\r\n");
+				cursor = page.nextCursor;
+			} while (cursor && ++pages < 4);
+			if (cursor) AppendText(hEdit, L"  ...\r\n");
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Listed timeline");
+			return 0;
+		}
 		if (LOWORD(wParam) == 2301) { // Add sample assignment (mechanic 1 to appt 1)
 			vsrm::Assignment s{}; s.appointmentId = 1; s.mechanicId = 1; s.assignedAt = "2025-09-19T12:00:00";
 			auto id = state->db.addAssignment(s);
 			if (!id) ShowError(hwnd, L"DB Error", state->db.getLastError()); else { AppendText(hEdit, std::wstring(L"Inserted assignment ID: ") + std::to_wstring(*id) + L"\r\n"); SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Added assignment"); }
 			return 0;
 		}
-		if (LOWORD(wParam) == 2302) { // List assignments for mechanic 1
-			auto list = state->db.listAssignmentsByMechanic(1);
+		if (LOWORD(wParam) == 2302) { // List assignments for mechanic 1, with appointment details from the same query
+			vsrm::AssignmentDetailQuery q; q.mechanicIds = {1};
+			vsrm::AssignmentDetailBatch list;
+			if (!state->db.listAssignmentDetails(q, list)) { ShowError(hwnd, L"DB Error", state->db.getLastError()); return 0; }
 			AppendText(hEdit, L"Assignments for mechanic 1:\r\n");
 			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Listed assignments");
-			for (const auto& s : list) {
-				std::wstring line = std::wstring(L"  [") + std::to_wstring(s.id) + L"] appt=" + std::to_wstring(s.appointmentId) + L" assigned=" + W(s.assignedAt) + L"\r\n";
+			for (size_t i = 0; i < list.size(); ++i) {
+				std::wstring line = std::wstring(L"  [") + std::to_wstring(list.assignmentId(i)) + L"] " + W(list.scheduledAt(i)) +
+					L" " + W(list.vin(i)) + L" (" + W(list.customerName(i)) + L") " + W(list.status(i)) +
+					(list.completedAt(i) ? L", completed " + W(*list.completedAt(i)) : std::wstring()) + L"\r\n";
 				AppendText(hEdit, line);
 			}
 			return 0;
 		}
+		if (LOWORD(wParam) == 2303) { // Balance pending appointments across active mechanics
+			vsrm::SchedulePlan plan; std::string err;
+			if (!vsrm::assignPendingAppointments(state->db, vsrm::SchedulerOptions{}, plan, err)) { ShowError(hwnd, L"DB Error", err); return 0; }
+			wchar_t line[160];
+			swprintf_s(line, L"Assigned %zu appointments (%zu left unassigned), %d-%d jobs per mechanic-day, planned in %.2f ms\r\n",
+				plan.assignments.size(), plan.unassigned.size(), plan.minDayLoad, plan.maxDayLoad, plan.milliseconds);
+			AppendText(hEdit, line);
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Auto-assigned appointments");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2304) { // Synthetic scheduler benchmark (nothing is written)
+			AppendText(hEdit, L"Scheduler benchmark (one day's intake, 40 mechanics, no capacity limit):\r\n");
+			for (int n : {1000, 5000, 20000}) {
+				vsrm::SyntheticWorkload w = vsrm::makeSyntheticWorkload(n, 40, 1);
+				double best = 0; vsrm::SchedulePlan plan;
+				for (int run = 0; run < 5; ++run) {
+					plan = vsrm::balanceWorkload(w.pending, w.mechanics, w.openLoad, vsrm::SchedulerOptions{0});
+					if (run == 0 || plan.milliseconds < best) best = plan.milliseconds;
+				}
+				wchar_t line[160];
+				swprintf_s(line, L"  %6d appointments: %.3f ms, %zu assigned, spread %d-%d\r\n",
+					n, best, plan.assignments.size(), plan.minDayLoad, plan.maxDayLoad);
+				AppendText(hEdit, line);
+			}
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Scheduler benchmark done");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2409) { // VIN decoder throughput (nothing is written)
+			const char* prefixes[] = {"4T1BF1FK", "2T3ZF4DV", "5TDKK3DC", "JTDKB20U", "JTHBK1GG", "5TFDW5F1", "JHHZCL2H", "WVWZZZ1J"};
+			const char years[] = "ABCDEFGHJKLMNPRSTVWXY123456789";
+			constexpr size_t kVins = 1000000;
+			std::vector<std::string> vins(kVins);
+			for (size_t i = 0; i < kVins; ++i) {
+				char buf[18];
+				snprintf(buf, sizeof(buf), "%s0%c%07zu", prefixes[i % 8], years[i % 30], i % 10000000);
+				buf[8] = vsrm::vinCheckDigit(buf);
+				vins[i] = buf;
+			}
+			std::vector<std::string_view> views(vins.begin(), vins.end());
+			std::vector<vsrm::DecodedVin> decoded(kVins);
+			double best = 0;
+			for (int run = 0; run < 5; ++run) {
+				auto started = std::chrono::steady_clock::now();
+				vsrm::decodeVins(views, decoded);
+				std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+				if (run == 0 || took.count() < best) best = took.count();
+			}
+			size_t named = 0;
+			for (const auto& d : decoded) if (!d.model.empty()) ++named;
+			wchar_t line[160];
+			swprintf_s(line, L"VIN decoder: %zu VINs in %.1f ms (%.1f M VINs/s), %zu with a known model\r\n",
+				kVins, best, kVins / best / 1000.0, named);
+			AppendText(hEdit, line);
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"VIN decoder benchmark done");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2410) { // SHA-256 and PBKDF2 throughput (nothing is written)
+			using Ms = std::chrono::duration<double, std::milli>;
+			wchar_t line[200];
+			std::string block(16 << 20, 'x');
+			auto started = std::chrono::steady_clock::now();
+			vsrm::Sha256Digest d = vsrm::Sha256::hash(block);
+			Ms bulk = std::chrono::steady_clock::now() - started;
+			std::string message(64, 'm');
+			vsrm::Sha256 ctx;
+			started = std::chrono::steady_clock::now();
+			for (int i = 0; i < 1000000; ++i) { message[0] = static_cast<char>(i); ctx.update(message); d = ctx.finish(); }
+			Ms small = std::chrono::steady_clock::now() - started;
+			swprintf_s(line, L"SHA-256 (%hs): %.0f MB/s bulk, %.2f M hashes/s of 64 bytes [%02x]\r\n",
+				vsrm::Sha256::implementation(), 16.0 / (bulk.count() / 1000.0), 1.0 / (small.count() / 1000.0), d[0]);
+			AppendText(hEdit, line);
+
+			std::string salt = vsrm::newPasswordSalt();
+			started = std::chrono::steady_clock::now();
+			vsrm::hashPassword("benchmark", salt, vsrm::kDefaultPasswordIterations);
+			Ms single = std::chrono::steady_clock::now() - started;
+			int cores = static_cast<int>(std::thread::hardware_concurrency());
+			std::vector<vsrm::PasswordHashJob> jobs(static_cast<size_t>(cores > 0 ? cores : 1) * 4, vsrm::PasswordHashJob{"benchmark", salt, false});
+			std::vector<std::string> out(jobs.size());
+			started = std::chrono::steady_clock::now();
+			vsrm::hashPasswordsBatch(jobs, vsrm::kDefaultPasswordIterations, out);
+			Ms batch = std::chrono::steady_clock::now() - started;
+			swprintf_s(line, L"PBKDF2 x %u: %.1f ms per login; batch of %zu: %.1f hashes/s on %d threads\r\n",
+				vsrm::kDefaultPasswordIterations, single.count(), jobs.size(), jobs.size() / (batch.count() / 1000.0), cores);
+			AppendText(hEdit, line);
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Password hashing benchmark done");
+			return 0;
+		}
 		if (LOWORD(wParam) == 2401) { // Export CSV for sample VIN to Desktop
 			PWSTR pDesktop = nullptr; std::wstring outPath;
 			if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_Desktop, 0, nullptr, &pDesktop))) {
@@ -888,7 +1361,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 			} else {
 				outPath = GetExecutableDir() + L"/vsrm_history_JT123TESTVIN00001.csv";
 			}
-			bool ok = state->db.exportServiceHistoryCsv("JT123TESTVIN00001", std::string(outPath.begin(), outPath.end()));
+			bool ok = state->db.exportServiceHistoryCsv("JT123TESTVIN00001", N(outPath));
 			if (!ok) ShowError(hwnd, L"Export Failed", state->db.getLastError()); else { AppendText(hEdit, L"Exported CSV to " + outPath + L"\r\n"); SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"CSV exported"); }
 			return 0;
 		}
@@ -898,28 +1371,81 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Report updated");
 			return 0;
 		}
+		if (LOWORD(wParam) == 2403) { // Open appointments for the next 7 days, mechanic included
+			SYSTEMTIME st{}; GetLocalTime(&st);
+			wchar_t today[16]; swprintf_s(today, L"%04u-%02u-%02u", st.wYear, st.wMonth, st.wDay);
+			int64_t start = *vsrm::isoToMinutes(N(today));
+			std::string from = vsrm::minutesToIso(start), to = vsrm::minutesToIso(start + 7 * 1440);
+			auto started = std::chrono::steady_clock::now();
+			auto week = state->db.listAppointmentsInRange(from, to, vsrm::kApptOpen);
+			std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - started;
+			wchar_t head[128]; swprintf_s(head, L"Open appointments, next 7 days: %zu (%.2f ms)\r\n", week.size(), took.count());
+			AppendText(hEdit, head);
+			for (const auto& e : week) {
+				std::wstring mech = e.mechanicId ? W(e.mechanicName) : std::wstring(L"unassigned");
+				AppendText(hEdit, L"  " + W(e.appointment.scheduledAt) + L"  " + W(e.appointment.vin) + L"  " + W(e.appointment.customerName) + L"  " + mech + L"\r\n");
+			}
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Report updated");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2404) {
+			RecomputeServiceDue(hwnd, state);
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Predicting service due dates...");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2405) {
+			RunAnalyticsReport(hwnd, state);
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Running analytics...");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2407) { // Same breakdown as a SQL GROUP BY, from the in-memory columns
+			auto started = std::chrono::steady_clock::now();
+			const vsrm::ServiceColumns* cols = state->db.serviceColumns();
+			if (!cols) { ShowError(hwnd, L"Columnar cache failed", state->db.getLastError()); return 0; }
+			std::chrono::duration<double, std::milli> syncMs = std::chrono::steady_clock::now() - started;
+			vsrm::ColumnFilter year2025; year2025.fromDate = 20250101; year2025.toDate = 20251231;
+			started = std::chrono::steady_clock::now();
+			int64_t total = cols->count(year2025);
+			auto byMechanic = cols->countBy(vsrm::ServiceGroup::Mechanic, year2025);
+			std::chrono::duration<double, std::milli> queryMs = std::chrono::steady_clock::now() - started;
+			wchar_t head[200];
+			swprintf_s(head, L"2025 by mechanic (columnar, %zu rows, %zu MB): %lld records, sync %.1f ms, query %.2f ms\r\n",
+				cols->size(), cols->memoryBytes() >> 20, (long long)total, syncMs.count(), queryMs.count());
+			AppendText(hEdit, head);
+			for (const auto& g : byMechanic) AppendText(hEdit, L"  " + W(g.key) + L"  " + std::to_wstring(g.count) + L"\r\n");
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Report updated");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2408) {
+			if (!state->db.rebuildSketches()) { ShowError(hwnd, L"Rebuild failed", state->db.getLastError()); return 0; }
+			if (state->currentView == AppState::View::Reports) RefreshReportMetrics(state);
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Analytics sketches rebuilt");
+			return 0;
+		}
+		if (LOWORD(wParam) == 2406) {
+			BenchmarkAnalytics(hwnd, GetExecutableDir());
+			SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Benchmarking analytics...");
+			return 0;
+		}
         if (LOWORD(wParam) == 2501) { // Refresh current view
             // Populate vehicle grid from filters
-            wchar_t wbuf[256];
-            GetWindowTextW(state->hSearchVin, wbuf, 256); std::string vinLike(wbuf, wbuf + wcslen(wbuf));
-            GetWindowTextW(state->hSearchDateFrom, wbuf, 256); std::optional<std::string> from = wcslen(wbuf) ? std::optional<std::string>(std::string(wbuf, wbuf + wcslen(wbuf))) : std::nullopt;
-            GetWindowTextW(state->hSearchDateTo, wbuf, 256); std::optional<std::string> to = wcslen(wbuf) ? std::optional<std::string>(std::string(wbuf, wbuf + wcslen(wbuf))) : std::nullopt;
-            GetWindowTextW(state->hSearchMechanic, wbuf, 256); std::optional<std::string> mech = wcslen(wbuf) ? std::optional<std::string>(std::string(wbuf, wbuf + wcslen(wbuf))) : std::nullopt;
-            bool dueOnly = (SendMessageW(state->hChkDue, BM_GETCHECK, 0, 0) == BST_CHECKED);
-            auto list = state->db.listVehicleSummaries(vinLike, from, to, mech, dueOnly);
-            ListView_DeleteAllItems(state->hList);
-            LVITEMW it{}; it.mask = LVIF_TEXT;
-            for (size_t i = 0; i < list.size(); ++i) {
-                std::wstring vin = W(list[i].vin);
-                it.iItem = (int)i; it.iSubItem = 0; it.pszText = const_cast<LPWSTR>(vin.c_str()); ListView_InsertItem(state->hList, &it);
-                ListView_SetItemText(state->hList, (int)i, 1, const_cast<LPWSTR>(W(list[i].make).c_str()));
-                ListView_SetItemText(state->hList, (int)i, 2, const_cast<LPWSTR>(W(list[i].model).c_str()));
-                ListView_SetItemText(state->hList, (int)i, 3, const_cast<LPWSTR>(W(list[i].lastServiceDate).c_str()));
-                ListView_SetItemText(state->hList, (int)i, 4, const_cast<LPWSTR>(W(list[i].mechanic).c_str()));
-                ListView_SetItemText(state->hList, (int)i, 5, const_cast<LPWSTR>(W(list[i].nextService.value_or("")).c_str()));
-                ListView_SetItemText(state->hList, (int)i, 6, const_cast<LPWSTR>(W(list[i].status).c_str()));
+            AppState::GridFilter f = ReadGridFilter(state);
+            // Programmatic refreshes (lParam == 0, e.g. after a dialog closes) skip the query when
+            // nothing relevant was committed since the last load; user-initiated ones always re-query.
+            std::vector<vsrm::CommitChanges> commits;
+            bool dataChanged = !state->db.changesSince(state->gridChangeSeq, commits);
+            for (const auto& c : commits) dataChanged |= c.touches("service_records") || c.touches("appointments");
+            state->gridChangeSeq = state->db.changeSequence();
+            if (lParam == 0 && state->gridLoaded && f == state->gridFilter && !dataChanged) {
+                SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Grid up to date");
+                return 0;
             }
-            SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Grid refreshed");
+            state->gridDbCounter = state->db.fileChangeCounter(); // read first: a racing write then only forces a revalidation
+            auto list = state->db.listVehicleSummaries(f.vinLike, f.from, f.to, f.mech, f.dueOnly);
+            state->gridFilter = std::move(f);
+            size_t changed = ApplyGridRows(state, std::move(list));
+            std::wstring msgText = L"Grid refreshed (" + std::to_wstring(changed) + L" row changes)";
+            SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)msgText.c_str());
             return 0;
         }
         if (LOWORD(wParam) == 4411) { // Export all CSV
@@ -931,7 +1457,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             } else {
                 outPath = GetExecutableDir() + L"/vsrm_all_records.csv";
             }
-            bool ok = state->db.exportAllServiceRecordsCsv(std::string(outPath.begin(), outPath.end()));
+            bool ok = state->db.exportAllServiceRecordsCsv(N(outPath));
             if (!ok) ShowError(hwnd, L"Export Failed", state->db.getLastError()); else SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"All records CSV exported");
             return 0;
         }
@@ -941,8 +1467,77 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
         if (LOWORD(wParam) == 4104) { SwitchView(hwnd, state, AppState::View::Reports); return 0; }
 		return 0;
 	}
+    case WM_APP_GRID_FRESH: {
+        std::unique_ptr<GridRefresh> fresh(reinterpret_cast<GridRefresh*>(lParam));
+        if (state && fresh && fresh->filter == state->gridFilter) { // ignore if the user re-filtered meanwhile
+            state->gridDbCounter = fresh->dbCounter;
+            size_t changed = ApplyGridRows(state, std::move(fresh->rows));
+            std::wstring msgText = L"Grid revalidated (" + std::to_wstring(changed) + L" row changes)";
+            SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)msgText.c_str());
+        }
+        return 0;
+    }
+    case WM_APP_DUE_DONE: {
+        std::unique_ptr<ServiceDueDone> done(reinterpret_cast<ServiceDueDone*>(lParam));
+        if (!done) return 0;
+        if (!done->ok) { ShowError(hwnd, L"Service due prediction failed", done->error); return 0; }
+        wchar_t line[200];
+        swprintf_s(line, L"Service due dates: %zu vehicles from %zu records, %d partitions, scan %.0f ms, write %.0f ms\r\n",
+            done->stats.vehicles, done->stats.records, done->stats.partitions, done->stats.scanMilliseconds, done->stats.writeMilliseconds);
+        AppendText(hEdit, line);
+        SendMessageW(hwnd, WM_COMMAND, 2501, 1); // written on another connection, so force the re-query
+        return 0;
+    }
+    case WM_APP_ANALYTICS_DONE: {
+        std::unique_ptr<AnalyticsDone> done(reinterpret_cast<AnalyticsDone*>(lParam));
+        if (!done) return 0;
+        if (!done->text.empty()) AppendText(hEdit, done->text);
+        if (!done->ok) { ShowError(hwnd, L"Analytics failed", done->error); return 0; }
+        SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Analytics done");
+        return 0;
+    }
+    case WM_APP_BACKUP_PROGRESS: {
+        wchar_t line[64];
+        swprintf_s(line, L"Backing up... %d%%", (int)wParam);
+        SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)line);
+        return 0;
+    }
+    case WM_APP_BACKUP_DONE: {
+        std::unique_ptr<BackupDone> done(reinterpret_cast<BackupDone*>(lParam));
+        if (state) state->backupRunning = false;
+        if (!done) return 0;
+        if (!done->ok) { SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Backup failed"); ShowError(hwnd, L"Backup failed", done->error); return 0; }
+        const auto& r = done->result;
+        wchar_t line[512];
+        swprintf_s(line, L"Backup %ls: %llu KB -> %llu KB, copy %.0f ms (%d restarts), verified %ls\r\n", W(r.path).c_str(),
+            (unsigned long long)(r.databaseBytes / 1024), (unsigned long long)(r.fileBytes / 1024), r.copyMilliseconds, r.restarts,
+            r.verified ? L"ok" : L"no");
+        AppendText(hEdit, line);
+        for (const auto& old : r.removed) AppendText(hEdit, L"  Removed old backup " + W(old) + L"\r\n");
+        SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)L"Backup finished");
+        return 0;
+    }
+    case WM_TIMER: {
+        if (wParam != IDT_IDLE_MAINTENANCE || !state) break;
+        // A pass runs on the UI thread, so it gives way as soon as the user types or clicks
+        vsrm::MaintenanceReport report;
+        bool ok = state->db.runIdleMaintenance(report, [] {
+            MSG m;
+            return PeekMessageW(&m, nullptr, 0, 0, PM_NOREMOVE | PM_QS_INPUT) != 0;
+        });
+        if (!report.ran) return 0;
+        wchar_t line[160];
+        swprintf_s(line, L"Idle maintenance: %zu steps in %.0f ms, longest write lock %.1f ms%ls",
+            report.steps.size(), report.milliseconds, report.longestLockMilliseconds, report.yielded ? L" (interrupted)" : L"");
+        SendMessageW(hStatus, SB_SETTEXT, 0, (LPARAM)line);
+        if (!ok) AppendText(hEdit, L"Idle maintenance: " + W(state->db.getLastError()) + L"\r\n");
+        for (const auto& p : report.problems) AppendText(hEdit, L"Integrity problem: " + W(p) + L"\r\n");
+        return 0;
+    }
 	case WM_DESTROY:
+        KillTimer(hwnd, IDT_IDLE_MAINTENANCE);
         SaveUiSettings(state);
+        SaveGridSnapshot(state);
         if (state && state->logo) { delete state->logo; state->logo = nullptr; }
 		if (GetPropW(hwnd, L"__gdipToken")) { ULONG_PTR t = (ULONG_PTR)GetPropW(hwnd, L"__gdipToken"); Gdiplus::GdiplusShutdown(t); RemovePropW(hwnd, L"__gdipToken"); }
 		PostQuitMessage(0);
@@ -957,6 +1552,12 @@ static HMENU CreateMainMenu() {
 	AppendMenuW(hFile, MF_STRING, 2001, L"Add Sample Record\tCtrl+N");
 	AppendMenuW(hFile, MF_STRING, 2002, L"Query Sample VIN\tCtrl+Q");
 	AppendMenuW(hFile, MF_SEPARATOR, 0, nullptr);
+	AppendMenuW(hFile, MF_STRING, 2004, L"Import Service Records CSV (Skip Duplicates)...");
+	AppendMenuW(hFile, MF_STRING, 2005, L"Import Service Records CSV (Merge Duplicates)...");
+	AppendMenuW(hFile, MF_STRING, 2007, L"Attach File to Sample VIN's Latest Record...");
+	AppendMenuW(hFile, MF_SEPARATOR, 0, nullptr);
+	AppendMenuW(hFile, MF_STRING, 2006, L"Back Up Database Now");
+	AppendMenuW(hFile, MF_SEPARATOR, 0, nullptr);
 	AppendMenuW(hFile, MF_STRING, 2003, L"Exit");
 	AppendMenuW(hMenu, MF_POPUP, (UINT_PTR)hFile, L"&File");
 
@@ -966,14 +1567,26 @@ static HMENU CreateMainMenu() {
 	AppendMenuW(hData, MF_SEPARATOR, 0, nullptr);
 	AppendMenuW(hData, MF_STRING, 2201, L"Add Sample Appointment");
 	AppendMenuW(hData, MF_STRING, 2202, L"List Appointments (Sample VIN)");
+	AppendMenuW(hData, MF_STRING, 2203, L"Check Booking Conflicts (Sample Slot)");
+	AppendMenuW(hData, MF_STRING, 2204, L"Vehicle Timeline (Sample VIN)");
 	AppendMenuW(hData, MF_SEPARATOR, 0, nullptr);
 	AppendMenuW(hData, MF_STRING, 2301, L"Add Sample Assignment (Mech 1 → Appt 1)");
 	AppendMenuW(hData, MF_STRING, 2302, L"List Assignments (Mechanic 1)");
+	AppendMenuW(hData, MF_STRING, 2303, L"Auto-Assign Pending Appointments");
+	AppendMenuW(hData, MF_STRING, 2304, L"Benchmark Scheduler (Synthetic)");
 	AppendMenuW(hMenu, MF_POPUP, (UINT_PTR)hData, L"&Data");
 
 	HMENU hReports = CreatePopupMenu();
 	AppendMenuW(hReports, MF_STRING, 2401, L"Export Service History CSV (Sample VIN)");
 	AppendMenuW(hReports, MF_STRING, 2402, L"Count Records in 2025");
+	AppendMenuW(hReports, MF_STRING, 2403, L"Appointments: Next 7 Days");
+	AppendMenuW(hReports, MF_STRING, 2404, L"Recompute Service Due Dates");
+	AppendMenuW(hReports, MF_STRING, 2405, L"Analytics Report");
+	AppendMenuW(hReports, MF_STRING, 2406, L"Benchmark Analytics Scaling (10M Synthetic Rows)");
+	AppendMenuW(hReports, MF_STRING, 2407, L"Records in 2025 by Mechanic (Columnar Cache)");
+	AppendMenuW(hReports, MF_STRING, 2408, L"Rebuild Analytics Sketches");
+	AppendMenuW(hReports, MF_STRING, 2409, L"Benchmark VIN Decoder (1M Synthetic VINs)");
+	AppendMenuW(hReports, MF_STRING, 2410, L"Benchmark Password Hashing");
 	AppendMenuW(hMenu, MF_POPUP, (UINT_PTR)hReports, L"&Reports");
 	return hMenu;
 }
@@ -995,15 +1608,18 @@ int APIENTRY wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR, int nCmdShow) {
     DeleteObject(tempFont);
 
 	// Open DB
-	if (!state.db.openOrCreate(std::string(state.dbPath.begin(), state.dbPath.end()))) {
+	if (!state.db.openOrCreate(N(state.dbPath))) {
 		const std::string err = state.db.getLastError();
 		MessageBoxW(nullptr, W(err).c_str(), L"Failed to open database", MB_ICONERROR);
 		return -1;
 	}
-    // Initialize schema and ensure default admin user exists
-	std::wstring schemaPath = exeDir + L"/schema.sql";
-    state.db.initializeSchema(std::string(schemaPath.begin(), schemaPath.end()));
+    // Bring the schema up to date (embedded migrations) and ensure default admin user exists
+    if (!state.db.migrateSchema(&state.migrations)) {
+        MessageBoxW(nullptr, W(state.db.getLastError()).c_str(), L"Failed to upgrade database", MB_ICONERROR);
+        return -1;
+    }
     state.db.ensureDefaultAdmin();
+    state.db.upgradeLegacyPasswords();
 
 	WNDCLASSEXW wc{ sizeof(WNDCLASSEXW) };
 	wc.style = CS_HREDRAW | CS_VREDRAW;